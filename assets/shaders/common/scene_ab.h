@@ -8,6 +8,12 @@
 using namespace metal;
 using namespace raytracing;
 
+#define VERTEX_FORMAT_FLOAT 0
+#define VERTEX_FORMAT_COMPACT 1
+
+#define INDEX_FORMAT_UINT32 0
+#define INDEX_FORMAT_UINT16 1
+
 struct MeshVertex
 {
     packed_float3 position;
@@ -16,6 +22,15 @@ struct MeshVertex
     packed_float4 tangent;
 };
 
+// Positions are relative to the submesh bounds, directions are octahedral
+struct CompactMeshVertex
+{
+    packed_ushort4 position;
+    packed_half2 uv;
+    packed_short2 normal;
+    packed_short2 tangent;
+};
+
 struct SceneMaterial
 {
     texture2d<float> Albedo;
@@ -25,6 +40,7 @@ struct SceneMaterial
     bool HasAlbedo;
     bool HasNormal;
     bool HasPBR;
+    bool Opaque;
 };
 
 struct SceneInstance
@@ -33,19 +49,88 @@ struct SceneInstance
     uint ModelIndex;
     uint IndexCount;
     uint IndexOffset;
-    
+    uint BaseVertex;
+    uint LodOffset;
+    uint LodCount;
+    float TransformScale;
+    uint Occluded;
+
     float3 Min;
     float3 Max;
+    float3 WorldMin;
+    float3 WorldMax;
+    float4x4 Transform;
+};
+
+struct SceneLod
+{
+    uint IndexOffset;
+    uint IndexCount;
+    float Error;
 };
 
 struct SceneModel
 {
     const device MeshVertex* Vertices;
     const device uint* Indices;
+    const device void* Positions; // packed_float3 or packed_ushort4 per vertex, null without a position stream
     uint InstanceOffset;
     uint InstanceCount;
+    uint VertexFormat;
+    uint IndexFormat;
 };
 
+inline float3 oct_decode(float2 e)
+{
+    float3 n = float3(e.x, e.y, 1.0 - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.xy += select(float2(t), float2(-t), n.xy >= 0.0);
+    return normalize(n);
+}
+
+inline MeshVertex load_vertex(SceneModel model, SceneInstance instance, uint vertexID)
+{
+    if (model.VertexFormat != VERTEX_FORMAT_COMPACT)
+        return model.Vertices[vertexID];
+
+    CompactMeshVertex c = ((const device CompactMeshVertex*)model.Vertices)[vertexID];
+    short2 tangent = short2(c.tangent);
+
+    MeshVertex v;
+    v.position = mix(instance.Min, instance.Max, float3(ushort3(c.position.xyz)) / 65535.0);
+    v.normal = oct_decode(max(float2(short2(c.normal)) / 32767.0, -1.0));
+    v.uv = float2(half2(c.uv));
+    v.tangent = float4(oct_decode(max(float2(tangent) / 32767.0, -1.0)), (tangent.y & 1) ? -1.0 : 1.0);
+    return v;
+}
+
+// Reads only the position, from the position stream when there is one
+inline float3 load_position(SceneModel model, SceneInstance instance, uint vertexID)
+{
+    if (model.Positions == nullptr)
+        return float3(load_vertex(model, instance, vertexID).position);
+    if (model.VertexFormat != VERTEX_FORMAT_COMPACT)
+        return float3(((const device packed_float3*)model.Positions)[vertexID]);
+
+    ushort4 q = ushort4(((const device packed_ushort4*)model.Positions)[vertexID]);
+    return mix(instance.Min, instance.Max, float3(q.xyz) / 65535.0);
+}
+
+// Moves a mesh-space vertex into world space. Normals go through the cofactor matrix, the inverse transpose up to
+// scale, and a mirroring transform flips the bitangent handedness.
+inline MeshVertex transform_vertex(SceneInstance instance, MeshVertex v)
+{
+    float3x3 m = float3x3(instance.Transform[0].xyz, instance.Transform[1].xyz, instance.Transform[2].xyz);
+    float3x3 cofactor = float3x3(cross(m[1], m[2]), cross(m[2], m[0]), cross(m[0], m[1]));
+    float handedness = dot(m[0], cofactor[0]) < 0.0 ? -1.0 : 1.0;
+
+    MeshVertex out = v;
+    out.position = (instance.Transform * float4(float3(v.position), 1.0)).xyz;
+    out.normal = normalize(cofactor * float3(v.normal)) * handedness;
+    out.tangent = float4(normalize(m * float3(v.tangent.xyz)), v.tangent.w * handedness);
+    return out;
+}
+
 struct SceneCamera
 {
     float4x4 View;
@@ -67,6 +152,7 @@ struct SceneArgumentBuffer
     const device PointLight* PointLights;
     const device SceneCamera& Camera;
     instance_acceleration_structure AS;
+    const device SceneLod* Lods;
     
     uint PointLightCount;
     DirectionalLight Sun;
@@ -36,10 +36,31 @@ bool frustum_cull(constant Plane plane[6], float3 min, float3 max)
     return true;
 }
 
+// Picks the coarsest level whose projected error stays within the threshold folded into lodScale,
+// measured from the main camera so every view draws the same level
+SceneLod select_lod(const device SceneArgumentBuffer& arguments, SceneInstance instance, float lodScale)
+{
+    SceneLod selected = { instance.IndexOffset, instance.IndexCount, 0.0 };
+    if (lodScale <= 0.0)
+        return selected;
+
+    float3 eye = arguments.Camera.Position;
+    float distance = max(length(clamp(eye, instance.WorldMin, instance.WorldMax) - eye), arguments.Camera.Near);
+    for (uint i = 0; i < instance.LodCount; i++) {
+        SceneLod lod = arguments.Lods[instance.LodOffset + i];
+        if (lod.Error * instance.TransformScale * lodScale > distance)
+            break;
+        selected = lod;
+    }
+    return selected;
+}
+
 kernel void cull_geometry(const device SceneArgumentBuffer& arguments [[buffer(0)]],
                           device ICBWrapper& icb [[buffer(1)]],
                           constant Plane* planes [[buffer(2)]],
                           constant uint& instanceCount [[buffer(3)]],
+                          constant float& lodScale [[buffer(4)]],
+                          constant uint& skipOccluded [[buffer(5)]],
                           uint threadID [[thread_position_in_grid]])
 {
     uint instanceIndex = threadID;
@@ -49,8 +70,15 @@ kernel void cull_geometry(const device SceneArgumentBuffer& arguments [[buffer(0
     SceneModel model = arguments.Models[instance.ModelIndex];
 
     render_command command(icb.CommandBuffer, instanceIndex);
-    bool visible = frustum_cull(planes, instance.Min, instance.Max);
+    // Occlusion is tested from the main camera, other views pass skipOccluded = 0
+    bool visible = !(skipOccluded && instance.Occluded) && frustum_cull(planes, instance.WorldMin, instance.WorldMax);
     if (visible) {
-        command.draw_indexed_primitives<uint>(primitive_type::triangle, instance.IndexCount, model.Indices + instance.IndexOffset, 1, 0, instanceIndex);
+        SceneLod lod = select_lod(arguments, instance, lodScale);
+        if (model.IndexFormat == INDEX_FORMAT_UINT16) {
+            const device ushort* indices = (const device ushort*)model.Indices + lod.IndexOffset;
+            command.draw_indexed_primitives<ushort>(primitive_type::triangle, lod.IndexCount, indices, 1, instance.BaseVertex, instanceIndex);
+        } else {
+            command.draw_indexed_primitives<uint>(primitive_type::triangle, lod.IndexCount, model.Indices + lod.IndexOffset, 1, instance.BaseVertex, instanceIndex);
+        }
     }
 }
@@ -25,7 +25,7 @@ vertex VSOutput gbuffer_vs(uint vertexID [[vertex_id]],
 {
     SceneInstance instance = scene.Instances[instanceId];
     SceneModel model = scene.Models[instance.ModelIndex];
-    MeshVertex v = model.Vertices[vertexID];
+    MeshVertex v = transform_vertex(instance, load_vertex(model, instance, vertexID));
 
     VSOutput out;
     out.position = scene.Camera.ViewProjection * float4(float3(v.position), 1.0);
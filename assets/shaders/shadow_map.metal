@@ -13,11 +13,12 @@ vertex VSOutput shadow_vs(uint vertexID [[vertex_id]],
 {
     SceneInstance instance = scene.Instances[instanceId];
     SceneModel model = scene.Models[instance.ModelIndex];
-    MeshVertex v = model.Vertices[vertexID];
+    SceneMaterial material = scene.Materials[instance.MaterialIndex];
 
+    // Opaque casters only read the position stream, alpha-tested ones also need the UV
     VSOutput out;
-    out.position = vp * float4(float3(v.position), 1.0);
-    out.uv = v.uv;
+    out.position = vp * (instance.Transform * float4(load_position(model, instance, vertexID), 1.0));
+    out.uv = material.Opaque ? float2(0.0) : float2(load_vertex(model, instance, vertexID).uv);
     out.objectId = instanceId;
     return out;
 }
@@ -35,6 +36,8 @@ fragment void shadow_fs(VSOutput in [[stage_in]],
         
    SceneInstance instance = scene.Instances[in.objectId];
    SceneMaterial material = scene.Materials[instance.MaterialIndex];
+   if (material.Opaque)
+       return;
 
    float4 albedoSample = material.HasAlbedo ? material.Albedo.sample(textureSampler, in.uv) : 1.0;
    if (albedoSample.a < 0.25)
@@ -15,6 +15,18 @@ ASSETS_DIR="$PROJECT_ROOT/assets"
 TOKTX="toktx"
 GLTFCOMPRESS="$PROJECT_ROOT/tools/bin/gltfcompress"
 
+# Worker threads for mesh compression (all cores by default)
+JOBS="${JOBS:-$(sysctl -n hw.ncpu 2>/dev/null || nproc 2>/dev/null || echo 4)}"
+
+# Vertex layout written by gltfcompress (float or compact)
+VERTEX_FORMAT="${VERTEX_FORMAT:-compact}"
+
+# VB/IB storage written by gltfcompress (raw or chunked)
+PAYLOAD="${PAYLOAD:-chunked}"
+
+# Submesh order written by gltfcompress (gltf, morton or hilbert)
+SUBMESH_ORDER="${SUBMESH_ORDER:-hilbert}"
+
 # ASTC compression settings
 BLOCK_SIZE="6x6"      # Block size (4x4, 6x6, 8x8, etc. - 6x6 is a good balance)
 
@@ -46,6 +58,7 @@ echo ""
 # Counter for statistics
 total_files=0
 compressed_files=0
+cached_files=0
 failed_files=0
 total_mesh_files=0
 compressed_mesh_files=0
@@ -72,6 +85,12 @@ while IFS= read -r -d '' input_file; do
     # Output file path (using .ktx2 extension even though we call it .astc conceptually)
     output_file="$output_dir/${name}.ktx2"
 
+    # Skip textures whose output is newer than the source (FORCE=1 recompresses everything)
+    if [ -z "$FORCE" ] && [ "$output_file" -nt "$input_file" ]; then
+        cached_files=$((cached_files + 1))
+        continue
+    fi
+
     echo "Compressing: $rel_path -> ${rel_dir}/${name}.ktx2"
 
     # Run toktx with ASTC compression and mipmap generation
@@ -97,6 +116,7 @@ echo "Texture Compression Summary"
 echo "=========================================="
 echo "Total files:      $total_files"
 echo "Compressed:       $compressed_files"
+echo "Up to date:       $cached_files"
 echo "Failed:           $failed_files"
 echo "=========================================="
 echo ""
@@ -107,48 +127,28 @@ echo "GLTF Mesh Compression"
 echo "=========================================="
 echo "Input:  $RAW_ASSETS_DIR"
 echo "Output: $ASSETS_DIR"
+echo "Jobs:   $JOBS"
+echo "Format: $VERTEX_FORMAT"
+echo "Payload: $PAYLOAD"
+echo "Order:  $SUBMESH_ORDER"
 echo "=========================================="
 echo ""
 
-while IFS= read -r -d '' input_file; do
-
-    total_mesh_files=$((total_mesh_files + 1))
-
-    # Get relative path from raw_assets
-    rel_path="${input_file#$RAW_ASSETS_DIR/}"
-
-    # Get directory and filename
-    rel_dir=$(dirname "$rel_path")
-    filename=$(basename "$input_file")
-    name="${filename%.*}"
-
-    # For GLTF files, preserve directory structure and use filename as mesh name
-    # e.g., raw_assets/models/Sponza/Sponza.gltf -> assets/models/Sponza/Sponza.mesh
+# gltfcompress discovers every .gltf/.glb itself and cooks them concurrently,
+# preserving the directory structure and using the filename as mesh name
+# e.g., raw_assets/models/Sponza/Sponza.gltf -> assets/models/Sponza/Sponza.mesh
+total_mesh_files=$(find "$RAW_ASSETS_DIR" -type f \( -iname "*.gltf" -o -iname "*.glb" \) | wc -l | tr -d ' ')
 
-    # Create output directory structure (preserve the same directory)
-    output_dir="$ASSETS_DIR/$rel_dir"
-    mkdir -p "$output_dir"
-
-    # Output file path - use the filename (without extension) as the mesh name
-    output_file="$output_dir/${name}.mesh"
-
-    echo "Compressing: $rel_path -> ${rel_dir}/${name}.mesh"
-
-    # Run gltfcompress
-    if "$GLTFCOMPRESS" "$input_file" "$output_file"; then
-        compressed_mesh_files=$((compressed_mesh_files + 1))
-
-        # Show file sizes
-        input_size=$(du -h "$input_file" | cut -f1)
-        output_size=$(du -h "$output_file" | cut -f1)
-        echo "  ✓ Done: $input_size -> $output_size"
-    else
-        failed_mesh_files=$((failed_mesh_files + 1))
-        echo "  ✗ Failed to compress $filename"
-    fi
+# Meshes whose inputs, options and tool binary match the cook cache in assets/ are skipped
+CACHE_FLAG=""
+if [ -n "$FORCE" ]; then
+    CACHE_FLAG="--no-cache"
+fi
 
-    echo ""
-done < <(find "$RAW_ASSETS_DIR" -type f \( -iname "*.gltf" -o -iname "*.glb" \) -print0)
+# Batch mode exits with the number of files that failed to compress
+"$GLTFCOMPRESS" --batch "$RAW_ASSETS_DIR" "$ASSETS_DIR" -j "$JOBS" --vertex-format "$VERTEX_FORMAT" --payload "$PAYLOAD" --submesh-order "$SUBMESH_ORDER" $CACHE_FLAG || failed_mesh_files=$?
+compressed_mesh_files=$((total_mesh_files - failed_mesh_files))
+echo ""
 
 # Print final summary
 echo "=========================================="
@@ -157,6 +157,7 @@ echo "=========================================="
 echo "Textures:"
 echo "  Total:          $total_files"
 echo "  Compressed:     $compressed_files"
+echo "  Up to date:     $cached_files"
 echo "  Failed:         $failed_files"
 echo ""
 echo "Meshes:"
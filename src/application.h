@@ -94,6 +94,7 @@ private:
 
     float m_TimeAccumulator = 0.0f;
     std::vector<simd::float3> m_InitialLightPositions;
+    int m_TextureCacheBudgetMB = (int)(TEXTURE_CACHE_DEFAULT_BUDGET >> 20);
     
     // UI state
     int m_LightsToAdd = 10;
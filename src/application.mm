@@ -80,7 +80,8 @@ bool Application::Initialize(id<MTLDevice> device)
 
     // World
     m_World = new World();
-    m_World->AddModel("models/Sponza/Sponza.mesh");
+    // Streams in while the first frames render, World::Update adds it once its geometry is ready
+    m_World->AddModelAsync("models/Sponza/Sponza.mesh");
 
     // Directional light
     m_World->GetDirectionalLight() = {
@@ -134,6 +135,16 @@ void Application::RegisterCVars()
                           max:1.0f
                   displayName:@"Color"];
 
+    [registry registerBool:@"Application.OcclusionCulling"
+                   pointer:&m_World->GetOcclusionCuller().Enabled
+               displayName:@"CPU Occlusion Culling"];
+
+    [registry registerInt:@"TextureCache.BudgetMB"
+                  pointer:&m_TextureCacheBudgetMB
+                      min:0
+                      max:16384
+              displayName:@"Texture Cache Budget (MB)"];
+
     // Register actions for point lights
     [actions registerAction:@"Application.AddLights"
                    callback:^{
@@ -236,6 +247,7 @@ void Application::OnResize(uint32_t width, uint32_t height)
 
 void Application::OnUpdate(float deltaTime)
 {
+    TextureCache::SetBudget((uint64_t)m_TextureCacheBudgetMB << 20);
     m_ResidencySet.Update();
     m_Renderer->Prepare();
 
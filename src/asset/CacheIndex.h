@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct CacheStats
+{
+    uint64_t Hits = 0;
+    uint64_t Misses = 0;
+    uint64_t Evictions = 0;
+    uint64_t Entries = 0;
+    uint64_t Bytes = 0;             // Every cached entry, referenced or not
+    uint64_t UnreferencedBytes = 0; // Entries that may be evicted
+    uint64_t Budget = 0;
+};
+
+// Bookkeeping of a ref-counted cache keyed by path, independent of what is cached so it builds without Metal. Entries
+// nobody references stay cached in least recently released order, the oldest are evicted while the total goes over the
+// budget. Referenced entries are never evicted, the cache stays over budget while they are in use. Not thread-safe.
+class CacheIndex
+{
+public:
+    using EntryId = uint32_t;
+    static constexpr EntryId INVALID_ENTRY = 0xFFFFFFFF;
+
+    explicit CacheIndex(uint64_t budget) : m_Budget(budget) {}
+
+    // Lexically normalized, "a/./b/../c" and "a/c" are the same entry. Every key passed in goes through this.
+    static std::string CanonicalKey(const std::string& path);
+
+    // References the entry for key, INVALID_ENTRY when it isn't cached. Counts a hit or a miss.
+    EntryId Acquire(const std::string& key);
+    // Adds an entry holding one reference, INVALID_ENTRY when key is already cached. Ids of the entries evicted to
+    // make room are appended to outEvicted.
+    EntryId Insert(const std::string& key, uint64_t bytes, std::vector<EntryId>& outEvicted);
+    void AddReference(EntryId id);
+    // Entries left without references become evictable. Unknown ids are ignored.
+    void Release(EntryId id, std::vector<EntryId>& outEvicted);
+    void SetBudget(uint64_t budget, std::vector<EntryId>& outEvicted);
+
+    CacheStats GetStats() const;
+    // Ids of every cached entry
+    std::vector<EntryId> GetEntries() const;
+
+private:
+    struct Entry
+    {
+        std::string Key;
+        uint64_t Bytes = 0;
+        uint32_t References = 0;
+        bool Used = false;
+        std::list<EntryId>::iterator LruPosition; // Valid while References is 0
+    };
+
+    bool IsValid(EntryId id) const { return id < m_Entries.size() && m_Entries[id].Used; }
+    void Reference(EntryId id);
+    void EvictOverBudget(std::vector<EntryId>& outEvicted);
+
+    std::vector<Entry> m_Entries;
+    std::vector<EntryId> m_FreeEntries;
+    std::unordered_map<std::string, EntryId> m_Lookup;
+    std::list<EntryId> m_Unreferenced; // Least recently released first
+
+    uint64_t m_Budget;
+    uint64_t m_Bytes = 0;
+    uint64_t m_UnreferencedBytes = 0;
+    uint64_t m_Hits = 0;
+    uint64_t m_Misses = 0;
+    uint64_t m_Evictions = 0;
+};
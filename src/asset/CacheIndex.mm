@@ -0,0 +1,123 @@
+#include "CacheIndex.h"
+
+#include <filesystem>
+
+std::string CacheIndex::CanonicalKey(const std::string& path)
+{
+    return std::filesystem::path(path).lexically_normal().generic_string();
+}
+
+CacheIndex::EntryId CacheIndex::Acquire(const std::string& key)
+{
+    auto it = m_Lookup.find(CanonicalKey(key));
+    if (it == m_Lookup.end()) {
+        m_Misses++;
+        return INVALID_ENTRY;
+    }
+
+    m_Hits++;
+    Reference(it->second);
+    return it->second;
+}
+
+CacheIndex::EntryId CacheIndex::Insert(const std::string& key, uint64_t bytes, std::vector<EntryId>& outEvicted)
+{
+    std::string canonical = CanonicalKey(key);
+    if (m_Lookup.count(canonical))
+        return INVALID_ENTRY;
+
+    EntryId id;
+    if (!m_FreeEntries.empty()) {
+        id = m_FreeEntries.back();
+        m_FreeEntries.pop_back();
+    } else {
+        id = (EntryId)m_Entries.size();
+        m_Entries.emplace_back();
+    }
+
+    Entry& entry = m_Entries[id];
+    entry.Key = canonical;
+    entry.Bytes = bytes;
+    entry.References = 1;
+    entry.Used = true;
+    m_Lookup.emplace(std::move(canonical), id);
+    m_Bytes += bytes;
+
+    // The new entry is referenced, only older unreferenced ones can make room for it
+    EvictOverBudget(outEvicted);
+    return id;
+}
+
+void CacheIndex::AddReference(EntryId id)
+{
+    if (IsValid(id))
+        Reference(id);
+}
+
+void CacheIndex::Reference(EntryId id)
+{
+    Entry& entry = m_Entries[id];
+    if (entry.References++ == 0) {
+        m_Unreferenced.erase(entry.LruPosition);
+        m_UnreferencedBytes -= entry.Bytes;
+    }
+}
+
+void CacheIndex::Release(EntryId id, std::vector<EntryId>& outEvicted)
+{
+    if (!IsValid(id) || m_Entries[id].References == 0)
+        return;
+
+    Entry& entry = m_Entries[id];
+    if (--entry.References > 0)
+        return;
+
+    entry.LruPosition = m_Unreferenced.insert(m_Unreferenced.end(), id);
+    m_UnreferencedBytes += entry.Bytes;
+    EvictOverBudget(outEvicted);
+}
+
+void CacheIndex::SetBudget(uint64_t budget, std::vector<EntryId>& outEvicted)
+{
+    m_Budget = budget;
+    EvictOverBudget(outEvicted);
+}
+
+void CacheIndex::EvictOverBudget(std::vector<EntryId>& outEvicted)
+{
+    while (m_Bytes > m_Budget && !m_Unreferenced.empty()) {
+        EntryId id = m_Unreferenced.front();
+        m_Unreferenced.pop_front();
+
+        Entry& entry = m_Entries[id];
+        m_Lookup.erase(entry.Key);
+        m_Bytes -= entry.Bytes;
+        m_UnreferencedBytes -= entry.Bytes;
+        m_Evictions++;
+        entry = Entry();
+        m_FreeEntries.push_back(id);
+        outEvicted.push_back(id);
+    }
+}
+
+CacheStats CacheIndex::GetStats() const
+{
+    CacheStats stats;
+    stats.Hits = m_Hits;
+    stats.Misses = m_Misses;
+    stats.Evictions = m_Evictions;
+    stats.Entries = m_Lookup.size();
+    stats.Bytes = m_Bytes;
+    stats.UnreferencedBytes = m_UnreferencedBytes;
+    stats.Budget = m_Budget;
+    return stats;
+}
+
+std::vector<CacheIndex::EntryId> CacheIndex::GetEntries() const
+{
+    std::vector<EntryId> entries;
+    entries.reserve(m_Lookup.size());
+    for (const auto& entry : m_Lookup)
+        entries.push_back(entry.second);
+    return entries;
+}
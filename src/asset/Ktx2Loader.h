@@ -2,9 +2,18 @@
 
 #import <Metal/Metal.h>
 #include <string>
+#include <vector>
+
+struct ktxTexture;
 
 class KTX2Loader
 {
 public:
     static id<MTLTexture> LoadKTX2(const std::string& path);
+
+    // The phases of LoadKTX2 for loaders that batch many textures, each logs its own failures. Read and Parse touch no
+    // shared state and may run on any thread. Upload frees the parsed texture.
+    static bool Read(const std::string& path, std::vector<uint8_t>& outData);
+    static ktxTexture* Parse(const std::string& path, const std::vector<uint8_t>& data);
+    static id<MTLTexture> Upload(const std::string& path, ktxTexture* texture);
 };
\ No newline at end of file
@@ -10,34 +10,54 @@
 API_AVAILABLE(macos(15.0))
 id<MTLTexture> KTX2Loader::LoadKTX2(const std::string& path)
 {
-    // Load file into memory
+    std::vector<uint8_t> data;
+    if (!Read(path, data))
+        return nil;
+    ktxTexture* texture = Parse(path, data);
+    if (!texture)
+        return nil;
+    return Upload(path, texture);
+}
+
+bool KTX2Loader::Read(const std::string& path, std::vector<uint8_t>& outData)
+{
     auto file = fs::LoadBinaryFile(path);
     if (!file.success) {
         LOG_ERROR_FMT("Failed to load KTX2 file: %s - %s", path.c_str(), file.error.c_str());
-        return nil;
+        return false;
     }
+    outData = std::move(file.data);
+    return true;
+}
 
+ktxTexture* KTX2Loader::Parse(const std::string& path, const std::vector<uint8_t>& data)
+{
     // Create KTX texture from memory
     ktxTexture* texture = nullptr;
     KTX_error_code result = ktxTexture_CreateFromMemory(
-        file.data.data(),
-        file.data.size(),
+        data.data(),
+        data.size(),
         KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT,
         &texture
     );
 
     if (result != KTX_SUCCESS) {
         LOG_ERROR_FMT("Failed to parse KTX2 file: %s - Error code: %d", path.c_str(), result);
-        return nil;
+        return nullptr;
     }
 
     // Ensure we have a KTX2 texture
     if (texture->classId != ktxTexture2_c) {
         LOG_ERROR_FMT("File is not KTX2 format: %s", path.c_str());
         ktxTexture_Destroy(texture);
-        return nil;
+        return nullptr;
     }
+    return texture;
+}
 
+API_AVAILABLE(macos(15.0))
+id<MTLTexture> KTX2Loader::Upload(const std::string& path, ktxTexture* texture)
+{
     ktxTexture2* ktx2Texture = (ktxTexture2*)texture;
 
     // Get texture properties
@@ -98,7 +118,7 @@ id<MTLTexture> KTX2Loader::LoadKTX2(const std::string& path)
         for (ktx_uint32_t face = 0; face < numFaces; ++face) {
             for (ktx_uint32_t level = 0; level < numLevels; ++level) {
                 ktx_size_t offset;
-                result = ktxTexture_GetImageOffset(texture, level, layer, face, &offset);
+                KTX_error_code result = ktxTexture_GetImageOffset(texture, level, layer, face, &offset);
                 if (result != KTX_SUCCESS) {
                     LOG_WARNING_FMT("Failed to get image offset for level %u: %s", level, path.c_str());
                     continue;
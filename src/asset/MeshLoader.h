@@ -7,15 +7,58 @@
 #include <string>
 #include <unordered_map>
 
+#include "Asset/TextureCache.h"
 #include "Metal/Buffer.h"
 #include "Metal/Texture.h"
 
-struct Vertex
+// Matches L_StaticMeshHeader::VertexFormat written by gltfcompress
+enum class VertexFormat : uint32_t
 {
-    simd::float3 position;
-    simd::float3 normal;
-    simd::float2 uv;
-    simd::float4 tangent;
+    Float = 0,   // PackedVertex
+    Compact = 1  // CompactVertex
+};
+
+// Matches L_StaticMeshHeader::IndexFormat, 16-bit indices are relative to Mesh::VertexOffset
+enum class IndexFormat : uint32_t
+{
+    UInt32 = 0,
+    UInt16 = 1
+};
+
+// Vertex of VertexFormat::Float as gltfcompress writes it (L_StaticVertex) and the shaders read it (MeshVertex). Plain
+// floats, the simd vector types would pad it to 64 bytes.
+struct PackedVertex
+{
+    float px, py, pz;
+    float nx, ny, nz;
+    float u, v;
+    float tx, ty, tz, tw;
+};
+static_assert(sizeof(PackedVertex) == 48, "PackedVertex must match the 48-byte file and shader layout");
+
+struct CompactVertex
+{
+    uint16_t position[4]; // unorm16 within the submesh bounds, w unused
+    uint16_t uv[2];       // half floats
+    int16_t normal[2];    // Octahedral snorm16
+    int16_t tangent[2];   // Octahedral snorm16, lowest bit of y holds the bitangent sign
+};
+
+// Entry of Model::PositionBuffer, packed float3 for VertexFormat::Float and this for VertexFormat::Compact
+struct CompactPosition
+{
+    uint16_t position[4]; // Same values as CompactVertex::position
+};
+
+// Levels per submesh including the full-resolution one
+constexpr uint32_t MAX_MESH_LODS = 5;
+
+// Index range of one simplification level, sharing the submesh's vertices and VertexOffset
+struct MeshLod
+{
+    uint32_t IndexOffset;
+    uint32_t IndexCount;
+    float Error; // World-space geometric error, 0 for the full-resolution level
 };
 
 struct Mesh
@@ -26,6 +69,67 @@ struct Mesh
     int MaterialIndex = -1;
     simd::float3 Min;
     simd::float3 Max;
+    uint32_t MeshletOffset = 0;
+    uint32_t MeshletCount = 0;
+    // Lods[0] is the submesh itself, coarser levels follow with increasing error
+    MeshLod Lods[MAX_MESH_LODS] = {};
+    uint32_t LodCount = 1;
+};
+
+// Contiguous triangle range of a submesh with its own culling bounds
+struct Meshlet
+{
+    uint32_t IndexOffset;
+    uint32_t TriangleCount;
+    uint32_t VertexCount;
+    simd::float3 Min;
+    simd::float3 Max;
+    simd::float3 SphereCenter;
+    float SphereRadius;
+    simd::float3 ConeAxis;
+    float ConeCutoff; // Back-facing when dot(center - eye, axis) >= cutoff * length(center - eye) + radius
+};
+
+// Draws Meshes[MeshOffset, MeshOffset + MeshCount) with a transform. Meshes shared by several glTF nodes are stored
+// once in mesh space with one instance per node, the rest are baked in world space under an identity instance.
+struct MeshInstance
+{
+    uint32_t MeshOffset;
+    uint32_t MeshCount;
+    simd::float4x4 Transform;
+};
+
+// Box inside the closed volume of Meshes[MeshIndex] (or of the submesh it was split from), in the space the meshes are
+// stored in. Instances that draw MeshIndex place it with their transform.
+struct MeshOccluder
+{
+    uint32_t MeshIndex;
+    simd::float3 Min;
+    simd::float3 Max;
+};
+
+constexpr uint32_t MESH_BVH_EMPTY = 0xFFFFFFFF;
+
+// 4-wide BVH node matching L_BvhNode, child bounds are stored SoA so a ray is tested against all four at once
+struct MeshBvhNode
+{
+    float MinX[4];
+    float MinY[4];
+    float MinZ[4];
+    float MaxX[4];
+    float MaxY[4];
+    float MaxZ[4];
+    uint32_t Child[4]; // Inner: index into Model::BvhNodes. Leaf: first entry of Model::BvhTriangles. MESH_BVH_EMPTY = unused
+    uint32_t Leaf[4];  // 0 for inner children, leaves hold triangle count | mesh index << 8
+};
+
+// BVH over Meshes[MeshOffset, MeshOffset + MeshCount) in the space they are stored in, shared by every instance of
+// that range. Model::BvhTriangles holds base-level triangles as (index offset of the first index) / 3.
+struct MeshBvh
+{
+    uint32_t MeshOffset;
+    uint32_t MeshCount;
+    uint32_t RootNode;
 };
 
 struct MeshMaterial
@@ -38,23 +142,46 @@ struct MeshMaterial
 
 struct MeshTexture
 {
-    Texture* Texture;
+    TextureHandle Texture; // Empty until loaded, or when loading failed
+    std::string Path;      // .ktx2 file next to the model
 };
 
 struct Model
 {
     Buffer VertexBuffer;
     Buffer IndexBuffer;
+    Buffer PositionBuffer; // Positions only, for depth passes and BLAS builds. Empty when the file has no position stream.
+    VertexFormat Format = VertexFormat::Float;
+    IndexFormat IndexType = IndexFormat::UInt32;
 
     std::vector<Mesh> Meshes;
+    std::vector<Meshlet> Meshlets;
+    std::vector<MeshInstance> Instances;
     std::vector<MeshMaterial> Materials;
     std::vector<MeshTexture> Textures;
+    std::vector<MeshOccluder> Occluders; // Sorted by MeshIndex, empty when the file has none
+
+    // Empty when the file was cooked without a BVH, see RayQuery
+    std::vector<MeshBvh> Bvhs;
+    std::vector<MeshBvhNode> BvhNodes;
+    std::vector<uint32_t> BvhTriangles;
 
     Model() = default;
     ~Model();
 
-    bool Load(const std::string& path);
+    // Loads the geometry and tables, then every texture unless deferTextures is set. Deferred textures stay empty
+    // until SetTexture hands them one.
+    bool Load(const std::string& path, bool deferTextures = false);
+    // Gets a texture through the cache, empty when it fails. Doesn't touch the model, safe to call from any thread.
+    static TextureHandle LoadTexture(const MeshTexture& texture);
+    void SetTexture(uint32_t index, TextureHandle texture);
+
+    bool HasPositionStream() const { return PositionBuffer.IsValid(); }
+    uint32_t GetPositionSize() const { return Format == VertexFormat::Compact ? sizeof(CompactPosition) : 3 * sizeof(float); }
+    uint32_t GetIndexSize() const { return IndexType == IndexFormat::UInt16 ? sizeof(uint16_t) : sizeof(uint32_t); }
+    MTLIndexType GetMTLIndexType() const { return IndexType == IndexFormat::UInt16 ? MTLIndexTypeUInt16 : MTLIndexTypeUInt32; }
 
 private:
+    void LoadTextures();
     void Cleanup();
 };
@@ -2,11 +2,17 @@
 #include "Asset/TextureCache.h"
 #include "Ktx2Loader.h"
 #include "Metal/Device.h"
-#include "TextureCache.h"
 #include "Core/Logger.h"
+#include "gltfcompress/MeshCodec.h"
+#include "gltfcompress/MeshFile.h"
 
 #include <fs.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <iostream>
+#include <sys/resource.h>
 
 struct vec3 {
     float x, y, z;
@@ -20,6 +26,19 @@ struct L_SubmeshData {
     vec3 Max;
 };
 
+struct L_TextureData {
+    uint32_t PathOffset; // Into the string table
+    uint32_t Usage;      // MeshTextureUsage
+};
+
+struct L_MaterialEntry {
+    uint32_t AlbedoTexture; // kMeshNoTexture when unset
+    uint32_t NormalTexture;
+    uint32_t ORMTexture;
+    uint32_t Opaque; // 1 = opaque, 0 = alpha cutout/blend
+};
+
+// Fixed-size material of files written before the texture table
 struct L_MaterialData {
     char AlbedoPath[256];
     char NormalPath[256];
@@ -27,6 +46,58 @@ struct L_MaterialData {
     uint32_t Opaque; // 1 = opaque, 0 = alpha cutout/blend
 };
 
+struct L_MeshletData {
+    uint32_t IndexOffset;
+    uint32_t TriangleCount;
+    uint32_t VertexCount;
+    uint32_t SubmeshIndex;
+    vec3 Min;
+    vec3 Max;
+    vec3 SphereCenter;
+    float SphereRadius;
+    vec3 ConeAxis;
+    float ConeCutoff;
+};
+
+struct L_LodData {
+    uint32_t SubmeshIndex;
+    uint32_t Level;
+    uint32_t IndexOffset;
+    uint32_t IndexCount;
+    float Error;
+};
+
+struct L_InstanceData {
+    uint32_t SubmeshOffset;
+    uint32_t SubmeshCount;
+    float Transform[16]; // Column-major
+};
+
+struct L_OccluderData {
+    uint32_t SubmeshIndex;
+    vec3 Min;
+    vec3 Max;
+};
+
+struct L_BvhNode {
+    float MinX[4];
+    float MinY[4];
+    float MinZ[4];
+    float MaxX[4];
+    float MaxY[4];
+    float MaxZ[4];
+    uint32_t Child[4];
+    uint32_t Leaf[4];
+};
+
+struct L_BvhRootData {
+    uint32_t SubmeshOffset;
+    uint32_t SubmeshCount;
+    uint32_t RootNode;
+    uint32_t NodeCount;
+};
+
+// Version 0 header, files written since start with an L_MeshFileHeader instead
 struct L_StaticMeshHeader {
     uint32_t VertexCount;
     uint32_t IndexCount;
@@ -42,8 +113,272 @@ struct L_StaticMeshHeader {
     uint32_t VBSize;
     uint32_t IBOffset;
     uint32_t IBSize;
+    uint32_t MeshletCount;
+    uint32_t MeshletTableOffset;
+    uint32_t BaseVertexTableOffset;
+    uint32_t LodCount;
+    uint32_t LodTableOffset;
+    uint32_t InstanceCount;
+    uint32_t InstanceTableOffset;
+    uint32_t PayloadCodec;
+    uint32_t VBStoredSize; // 0 in older files, the VB is then stored raw
+    uint32_t IBStoredSize;
+    uint32_t BvhRootCount;
+    uint32_t BvhRootTableOffset;
+    uint32_t BvhNodeCount;
+    uint32_t BvhNodeTableOffset;
+    uint32_t BvhTriangleCount;
+    uint32_t BvhTriangleTableOffset;
+    uint32_t PositionOffset; // 0 without a position stream
+    uint32_t PositionSize;
+    uint32_t PositionStoredSize;
+};
+
+// Describes a version 0 file with the same sections a version 1 file lists in its directory
+static const char* ReadLegacyDirectory(const uint8_t* bytes, size_t fileSize, MeshFileDirectory& out)
+{
+    if (fileSize < offsetof(L_StaticMeshHeader, MeshletCount))
+        return "file too small for the header";
+
+    // Older files end the header before the meshlet fields, the submesh table follows right after it
+    L_StaticMeshHeader header = {};
+    memcpy(&header, bytes, offsetof(L_StaticMeshHeader, MeshletCount));
+    size_t headerSize = std::min<size_t>(header.SubmeshTableOffset, sizeof(L_StaticMeshHeader));
+    if (fileSize < headerSize)
+        return "file too small for the header";
+    memcpy(&header, bytes, headerSize);
+
+    out.Version = 0;
+    out.VertexCount = header.VertexCount;
+    out.IndexCount = header.IndexCount;
+    out.VertexFormat = header.VertexFormat;
+    out.IndexFormat = header.IndexFormat;
+    memcpy(out.Min, &header.Min, sizeof(out.Min));
+    memcpy(out.Max, &header.Max, sizeof(out.Max));
+    out.Sections.clear();
+
+    auto addSection = [&](MeshSectionType type, uint32_t codec, uint64_t offset, uint64_t storedSize, uint64_t decodedSize) {
+        if (offset != 0 && decodedSize > 0)
+            out.Sections.push_back({ (uint32_t)type, codec, offset, storedSize, 0, decodedSize });
+    };
+    auto addTable = [&](MeshSectionType type, uint64_t offset, uint64_t size) {
+        addSection(type, (uint32_t)PayloadCodec::Raw, offset, size, size);
+    };
+    addTable(MeshSectionType::Submeshes, header.SubmeshTableOffset, (uint64_t)header.SubmeshCount * sizeof(L_SubmeshData));
+    addTable(MeshSectionType::Materials, header.MaterialTableOffset, (uint64_t)header.MaterialCount * sizeof(L_MaterialData));
+    addTable(MeshSectionType::Meshlets, header.MeshletTableOffset, (uint64_t)header.MeshletCount * sizeof(L_MeshletData));
+    addTable(MeshSectionType::BaseVertices, header.BaseVertexTableOffset, (uint64_t)header.SubmeshCount * sizeof(uint32_t));
+    addTable(MeshSectionType::Lods, header.LodTableOffset, (uint64_t)header.LodCount * sizeof(L_LodData));
+    addTable(MeshSectionType::Instances, header.InstanceTableOffset, (uint64_t)header.InstanceCount * sizeof(L_InstanceData));
+    addTable(MeshSectionType::BvhRoots, header.BvhRootTableOffset, (uint64_t)header.BvhRootCount * sizeof(L_BvhRootData));
+    addTable(MeshSectionType::BvhNodes, header.BvhNodeTableOffset, (uint64_t)header.BvhNodeCount * sizeof(L_BvhNode));
+    addTable(MeshSectionType::BvhTriangles, header.BvhTriangleTableOffset, (uint64_t)header.BvhTriangleCount * sizeof(uint32_t));
+
+    // Chunked payloads store fewer bytes than they decode to
+    bool chunked = header.PayloadCodec == (uint32_t)PayloadCodec::Chunked;
+    if (header.PayloadCodec != (uint32_t)PayloadCodec::Raw && !chunked)
+        return "unsupported payload codec";
+    addSection(MeshSectionType::Vertices, header.PayloadCodec, header.VBOffset, chunked ? header.VBStoredSize : header.VBSize, header.VBSize);
+    addSection(MeshSectionType::Indices, header.PayloadCodec, header.IBOffset, chunked ? header.IBStoredSize : header.IBSize, header.IBSize);
+    addSection(MeshSectionType::Positions, header.PayloadCodec, header.PositionOffset,
+               chunked ? header.PositionStoredSize : header.PositionSize, header.PositionSize);
+
+    for (const L_MeshSection& section : out.Sections) {
+        if (section.Offset > fileSize || section.StoredSize > fileSize - section.Offset)
+            return "section past the end of the file";
+    }
+    return nullptr;
+}
+
+// Table sections are stored raw, count is 0 when the file doesn't have the table
+template <typename T>
+static const T* GetTable(const MeshFileDirectory& directory, const uint8_t* bytes, MeshSectionType type, uint32_t& outCount)
+{
+    const L_MeshSection* section = directory.FindTable(type);
+    outCount = 0;
+    if (!section || section->Codec != (uint32_t)PayloadCodec::Raw || section->DecodedSize / sizeof(T) > UINT32_MAX)
+        return nullptr;
+    outCount = (uint32_t)(section->DecodedSize / sizeof(T));
+    return (const T*)(bytes + section->Offset);
+}
+
+// Material and texture tables, pointing either into the file or at tables converted from an older one
+struct MaterialTables
+{
+    const L_MaterialEntry* Materials = nullptr;
+    uint32_t MaterialCount = 0;
+    const L_TextureData* Textures = nullptr;
+    uint32_t TextureCount = 0;
+    const char* Strings = nullptr;
+    uint32_t StringsSize = 0;
+
+    std::vector<L_MaterialEntry> ConvertedMaterials;
+    std::vector<L_TextureData> ConvertedTextures;
+    std::vector<char> ConvertedStrings;
 };
 
+// Builds the tables gltfcompress writes today from fixed-size paths, deduplicating them in the same first-use order
+static void ConvertLegacyMaterials(const L_MaterialData* legacy, uint32_t count, MaterialTables& out)
+{
+    std::unordered_map<std::string, uint32_t> textureIndices;
+    auto findTexture = [&](const char* field, size_t fieldSize, MeshTextureUsage usage) -> uint32_t {
+        std::string path(field, strnlen(field, fieldSize));
+        if (path.empty())
+            return kMeshNoTexture;
+        auto found = textureIndices.find(path);
+        if (found != textureIndices.end())
+            return found->second;
+
+        L_TextureData texture = { (uint32_t)out.ConvertedStrings.size(), (uint32_t)usage };
+        out.ConvertedStrings.insert(out.ConvertedStrings.end(), path.begin(), path.end());
+        out.ConvertedStrings.push_back('\0');
+        out.ConvertedTextures.push_back(texture);
+        textureIndices.emplace(path, (uint32_t)out.ConvertedTextures.size() - 1);
+        return (uint32_t)out.ConvertedTextures.size() - 1;
+    };
+
+    out.ConvertedMaterials.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        L_MaterialEntry entry;
+        entry.AlbedoTexture = findTexture(legacy[i].AlbedoPath, sizeof(legacy[i].AlbedoPath), MeshTextureUsage::Albedo);
+        entry.NormalTexture = findTexture(legacy[i].NormalPath, sizeof(legacy[i].NormalPath), MeshTextureUsage::Normal);
+        entry.ORMTexture = findTexture(legacy[i].ORMPath, sizeof(legacy[i].ORMPath), MeshTextureUsage::ORM);
+        entry.Opaque = legacy[i].Opaque;
+        out.ConvertedMaterials.push_back(entry);
+    }
+
+    out.Materials = out.ConvertedMaterials.data();
+    out.MaterialCount = (uint32_t)out.ConvertedMaterials.size();
+    out.Textures = out.ConvertedTextures.data();
+    out.TextureCount = (uint32_t)out.ConvertedTextures.size();
+    out.Strings = out.ConvertedStrings.data();
+    out.StringsSize = (uint32_t)out.ConvertedStrings.size();
+}
+
+// Reads the material, texture and string tables, or converts the fixed-size materials of older files. Returns why
+// the tables are invalid, nullptr when they aren't.
+static const char* ReadMaterialTables(const MeshFileDirectory& directory, const uint8_t* bytes, MaterialTables& out)
+{
+    out.Materials = GetTable<L_MaterialEntry>(directory, bytes, MeshSectionType::MaterialEntries, out.MaterialCount);
+    if (!out.Materials) {
+        uint32_t legacyCount;
+        const L_MaterialData* legacy = GetTable<L_MaterialData>(directory, bytes, MeshSectionType::Materials, legacyCount);
+        ConvertLegacyMaterials(legacy, legacyCount, out);
+        return nullptr;
+    }
+
+    out.Textures = GetTable<L_TextureData>(directory, bytes, MeshSectionType::Textures, out.TextureCount);
+    out.Strings = GetTable<char>(directory, bytes, MeshSectionType::Strings, out.StringsSize);
+    if (out.StringsSize > 0 && out.Strings[out.StringsSize - 1] != '\0')
+        return "unterminated string table";
+    for (uint32_t i = 0; i < out.TextureCount; i++) {
+        if (out.Textures[i].PathOffset >= out.StringsSize)
+            return "texture path outside the string table";
+    }
+    return nullptr;
+}
+
+// Fills buffer with every segment of a stream, chunks of chunked segments decode in parallel straight into their slice.
+// A stream stored as one raw segment is wrapped in place in the mapped file instead and adds to mappedBytes. Fails when
+// the segments don't add up to expectedSize.
+static bool LoadStream(Buffer& buffer, const MeshFileDirectory& directory, const std::shared_ptr<fs::MappedFile>& file,
+                       MeshSectionType type, uint64_t expectedSize, uint64_t& mappedBytes)
+{
+    std::vector<L_MeshSection> segments;
+    uint64_t decodedSize = 0;
+    if (!directory.GetStream(type, segments, decodedSize) || decodedSize != expectedSize || decodedSize == 0)
+        return false;
+
+    // Version 1 files start raw streams on a 16 KB page, older files and chunked or split streams are copied
+    if (segments.size() == 1 && segments[0].Codec == (uint32_t)PayloadCodec::Raw &&
+        buffer.InitializeNoCopy(file->data + segments[0].Offset, decodedSize, file)) {
+        mappedBytes += decodedSize;
+        return true;
+    }
+
+    const uint8_t* bytes = file->data;
+    buffer.Initialize(decodedSize);
+    uint8_t* contents = (uint8_t*)buffer.Contents();
+    for (const L_MeshSection& segment : segments) {
+        const uint8_t* payload = bytes + segment.Offset;
+        uint8_t* destination = contents + segment.DecodedOffset;
+        if (segment.Codec == (uint32_t)PayloadCodec::Raw) {
+            memcpy(destination, payload, segment.DecodedSize);
+            continue;
+        }
+        if (segment.Codec != (uint32_t)PayloadCodec::Chunked)
+            return false;
+
+        uint32_t chunkCount = GetPayloadChunkCount(payload, segment.StoredSize, segment.DecodedSize);
+        if (chunkCount == 0)
+            return false;
+
+        std::atomic<uint32_t> failures{0};
+        std::atomic<uint32_t>* failuresPtr = &failures;
+        size_t payloadSize = segment.StoredSize;
+        size_t segmentSize = segment.DecodedSize;
+        dispatch_apply(chunkCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t chunk) {
+            if (!DecodePayloadChunk(payload, payloadSize, (uint32_t)chunk, destination, segmentSize))
+                failuresPtr->fetch_add(1);
+        });
+        if (failures != 0)
+            return false;
+    }
+    return true;
+}
+
+// Copies the BVH tables into model, rejecting out-of-range roots, children, triangles and submeshes
+static bool LoadBvh(const MeshFileDirectory& directory, const uint8_t* bytes, Model& model)
+{
+    uint32_t rootCount, nodeCount, triangleCount;
+    const L_BvhRootData* rootData = GetTable<L_BvhRootData>(directory, bytes, MeshSectionType::BvhRoots, rootCount);
+    const L_BvhNode* nodeData = GetTable<L_BvhNode>(directory, bytes, MeshSectionType::BvhNodes, nodeCount);
+    const uint32_t* triangleData = GetTable<uint32_t>(directory, bytes, MeshSectionType::BvhTriangles, triangleCount);
+    size_t meshCount = model.Meshes.size();
+
+    for (uint32_t i = 0; i < triangleCount; i++) {
+        if (((uint64_t)triangleData[i] + 1) * 3 > directory.IndexCount)
+            return false;
+    }
+
+    std::vector<MeshBvh> bvhs(rootCount);
+    for (uint32_t i = 0; i < rootCount; i++) {
+        const L_BvhRootData& src = rootData[i];
+        if ((size_t)src.SubmeshOffset + src.SubmeshCount > meshCount || src.RootNode >= nodeCount ||
+            (size_t)src.RootNode + src.NodeCount > nodeCount) {
+            return false;
+        }
+        bvhs[i] = { src.SubmeshOffset, src.SubmeshCount, src.RootNode };
+
+        // Children stay within their root's node range and leaves within its submesh range
+        for (uint32_t n = src.RootNode; n < src.RootNode + src.NodeCount; n++) {
+            const L_BvhNode& node = nodeData[n];
+            for (uint32_t c = 0; c < 4; c++) {
+                uint32_t child = node.Child[c];
+                if (child == MESH_BVH_EMPTY)
+                    continue;
+                if (node.Leaf[c] == 0) {
+                    if (child < src.RootNode || child >= src.RootNode + src.NodeCount)
+                        return false;
+                    continue;
+                }
+                uint32_t count = node.Leaf[c] & 0xFF;
+                uint32_t submesh = node.Leaf[c] >> 8;
+                if ((size_t)child + count > triangleCount || submesh < src.SubmeshOffset ||
+                    submesh >= src.SubmeshOffset + src.SubmeshCount) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    model.Bvhs = std::move(bvhs);
+    model.BvhNodes.resize(nodeCount);
+    memcpy(model.BvhNodes.data(), nodeData, nodeCount * sizeof(L_BvhNode));
+    model.BvhTriangles.assign(triangleData, triangleData + triangleCount);
+    return true;
+}
+
 // Helper function to convert texture path to .ktx2 format
 static std::string ConvertToKTX2Path(const std::string& originalPath)
 {
@@ -82,192 +417,347 @@ Model::~Model()
 
 void Model::Cleanup()
 {
-    // Release textures
-    for (auto& tex : Textures) {
-        if (tex.Texture) {
-            delete tex.Texture;
-            tex.Texture = nullptr;
-        }
-    }
+    // Releases the texture handles, the cache keeps the textures until it needs the room
     Textures.clear();
     Meshes.clear();
+    Meshlets.clear();
     Materials.clear();
+    Occluders.clear();
+    Bvhs.clear();
+    BvhNodes.clear();
+    BvhTriangles.clear();
+}
+
+// Peak resident memory of the process so far, ru_maxrss is in bytes on Apple platforms
+static uint64_t GetPeakResidentBytes()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return (uint64_t)usage.ru_maxrss;
+}
+
+TextureHandle Model::LoadTexture(const MeshTexture& texture)
+{
+    TextureHandle handle = TextureCache::GetTexture(texture.Path);
+    if (!handle)
+        LOG_WARNING_FMT("Failed to load texture: %s", texture.Path.c_str());
+    return handle;
+}
+
+void Model::SetTexture(uint32_t index, TextureHandle texture)
+{
+    // Failed loads keep their empty entry so material indices stay valid
+    if (index < Textures.size() && !Textures[index].Texture)
+        Textures[index].Texture = std::move(texture);
+}
+
+// Loads every texture not already in the cache as one batch. Files are read and parsed in parallel, the parsed images
+// are then uploaded in a final pass on the calling thread.
+void Model::LoadTextures()
+{
+    struct PendingTexture
+    {
+        uint32_t Index;
+        ktxTexture* Parsed;
+        double ReadMs;
+        double ParseMs;
+    };
+
+    std::vector<PendingTexture> pending;
+    for (uint32_t i = 0; i < Textures.size(); i++) {
+        TextureHandle cached = TextureCache::Find(Textures[i].Path);
+        if (cached)
+            SetTexture(i, std::move(cached));
+        else
+            pending.push_back({ i, nullptr, 0.0, 0.0 });
+    }
+    if (pending.empty())
+        return;
+
+    // The file bytes only live until their parse finishes, just the parsed images wait for the upload
+    auto startTime = std::chrono::steady_clock::now();
+    PendingTexture* pendingData = pending.data();
+    const MeshTexture* textures = Textures.data();
+    dispatch_apply(pending.size(), dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t i) {
+        PendingTexture& texture = pendingData[i];
+        const std::string& texturePath = textures[texture.Index].Path;
+        auto readStart = std::chrono::steady_clock::now();
+        std::vector<uint8_t> data;
+        bool read = KTX2Loader::Read(texturePath, data);
+        auto parseStart = std::chrono::steady_clock::now();
+        if (read)
+            texture.Parsed = KTX2Loader::Parse(texturePath, data);
+        auto parseEnd = std::chrono::steady_clock::now();
+        texture.ReadMs = std::chrono::duration<double, std::milli>(parseStart - readStart).count();
+        texture.ParseMs = std::chrono::duration<double, std::milli>(parseEnd - parseStart).count();
+    });
+    auto decodedTime = std::chrono::steady_clock::now();
+
+    double readMs = 0.0;
+    double parseMs = 0.0;
+    uint32_t failed = 0;
+    for (const PendingTexture& texture : pending) {
+        readMs += texture.ReadMs;
+        parseMs += texture.ParseMs;
+
+        const MeshTexture& entry = Textures[texture.Index];
+        TextureHandle handle;
+        if (texture.Parsed)
+            handle = TextureCache::Insert(entry.Path, KTX2Loader::Upload(entry.Path, texture.Parsed));
+        if (!handle) {
+            LOG_WARNING_FMT("Failed to load texture: %s", entry.Path.c_str());
+            failed++;
+        }
+        SetTexture(texture.Index, std::move(handle));
+    }
+    auto endTime = std::chrono::steady_clock::now();
+
+    // Read and parse times are summed over the workers, the wall time of both together is given separately
+    LOG_INFO_FMT("Loaded %zu textures (%u failed, %zu cached) in %.1f ms: read %.1f ms, parse %.1f ms, %.1f ms wall on "
+                 "workers, upload %.1f ms", pending.size() - failed, failed, Textures.size() - pending.size(),
+                 std::chrono::duration<double, std::milli>(endTime - startTime).count(), readMs, parseMs,
+                 std::chrono::duration<double, std::milli>(decodedTime - startTime).count(),
+                 std::chrono::duration<double, std::milli>(endTime - decodedTime).count());
 }
 
-bool Model::Load(const std::string& path)
+bool Model::Load(const std::string& path, bool deferTextures)
 {
-    // Load the binary mesh file
-    fs::BinaryResult result = fs::LoadBinaryFile(path);
+    auto startTime = std::chrono::steady_clock::now();
+
+    // Map the binary mesh file, tables are read in place and raw streams become the GPU buffers without a copy
+    fs::MappedResult result = fs::MapBinaryFile(path);
     if (!result.success) {
         LOG_ERROR_FMT("Failed to load model from path: %s, error: %s", path.c_str(), result.error.c_str());
         return false;
     }
 
-    const uint8_t* bytes = result.data.data();
-    size_t fileSize = result.data.size();
+    const uint8_t* bytes = result.file->data;
+    size_t fileSize = result.file->size;
 
-    // Read header
-    if (fileSize < sizeof(L_StaticMeshHeader)) {
-        LOG_ERROR("File too small to contain valid mesh header");
+    // Version 1 files list their sections in a directory, version 0 files are described the same way from their header
+    MeshFileDirectory directory;
+    const char* directoryError = IsMeshFileV1(bytes, fileSize) ? ReadMeshFileDirectory(bytes, fileSize, directory)
+                                                               : ReadLegacyDirectory(bytes, fileSize, directory);
+    if (directoryError) {
+        LOG_ERROR_FMT("Invalid mesh file %s: %s", path.c_str(), directoryError);
         return false;
     }
 
-    L_StaticMeshHeader header;
-    memcpy(&header, bytes, sizeof(L_StaticMeshHeader));
+    uint32_t submeshCount;
+    const L_SubmeshData* submeshData = GetTable<L_SubmeshData>(directory, bytes, MeshSectionType::Submeshes, submeshCount);
+    MaterialTables materialTables;
+    const char* materialError = ReadMaterialTables(directory, bytes, materialTables);
+    if (materialError) {
+        LOG_ERROR_FMT("Invalid mesh file %s: %s", path.c_str(), materialError);
+        return false;
+    }
+    uint32_t materialCount = materialTables.MaterialCount;
 
-    LOG_INFO_FMT("Loading mesh: %d vertices, %d indices, %d submeshes, %d materials",
-          header.VertexCount, header.IndexCount, header.SubmeshCount, header.MaterialCount);
+    LOG_INFO_FMT("Loading mesh (v%u): %llu vertices, %llu indices, %u submeshes, %u materials", directory.Version,
+          directory.VertexCount, directory.IndexCount, submeshCount, materialCount);
 
-    // Read submesh data
-    L_SubmeshData* submeshData = (L_SubmeshData*)(bytes + header.SubmeshTableOffset);
+    if (directory.VertexFormat != (uint32_t)VertexFormat::Float && directory.VertexFormat != (uint32_t)VertexFormat::Compact) {
+        LOG_ERROR_FMT("Unsupported vertex format %u in %s", directory.VertexFormat, path.c_str());
+        return false;
+    }
+    Format = (VertexFormat)directory.VertexFormat;
 
-    // Read material data
-    L_MaterialData* materialData = (L_MaterialData*)(bytes + header.MaterialTableOffset);
+    if (directory.IndexFormat != (uint32_t)IndexFormat::UInt32 && directory.IndexFormat != (uint32_t)IndexFormat::UInt16) {
+        LOG_ERROR_FMT("Unsupported index format %u in %s", directory.IndexFormat, path.c_str());
+        return false;
+    }
+    IndexType = (IndexFormat)directory.IndexFormat;
 
-    // Get vertex and index data pointers
-    const Vertex* vertexData = (Vertex*)(bytes + header.VBOffset);
-    const uint32_t* indexData = (uint32_t*)(bytes + header.IBOffset);
+    // Per-submesh base vertices, only present with 16-bit indices
+    uint32_t baseVertexCount;
+    const uint32_t* baseVertexData = GetTable<uint32_t>(directory, bytes, MeshSectionType::BaseVertices, baseVertexCount);
+    if (baseVertexData && baseVertexCount < submeshCount) {
+        LOG_ERROR_FMT("Truncated base vertex table in %s", path.c_str());
+        return false;
+    } else if (!baseVertexData && IndexType == IndexFormat::UInt16) {
+        LOG_ERROR_FMT("16-bit indices without a base vertex table in %s", path.c_str());
+        return false;
+    }
 
-    // Load textures and build texture array
+    // One entry per unique texture, headless loads keep them empty as there is no device to create textures on
+    bool headless = Device::GetDevice() == nil;
     Textures.clear();
-    std::unordered_map<std::string, int> texturePathToIndex;
-
-    for (uint32_t i = 0; i < header.MaterialCount; i++) {
-        // Process albedo texture
-        if (materialData[i].AlbedoPath[0] != '\0') {
-            std::string albedoPath(materialData[i].AlbedoPath);
-            if (texturePathToIndex.find(albedoPath) == texturePathToIndex.end()) {
-                int texIndex = (int)Textures.size();
-                texturePathToIndex[albedoPath] = texIndex;
-
-                // Convert to .ktx2 format and make relative to model path
-                std::string ktx2Path = ConvertToKTX2Path(albedoPath);
-                std::string fullPath = MakeRelativeTexturePath(path, ktx2Path);
-
-                MeshTexture tex;
-                id<MTLTexture> mtlTexture = TextureCache::GetTexture(fullPath);
-                if (mtlTexture) {
-                    tex.Texture = new Texture(mtlTexture);
-                    Textures.push_back(tex);
-                } else {
-                    LOG_WARNING_FMT("Failed to load albedo texture: %s", fullPath.c_str());
-                    // Still add a null entry to maintain indices
-                    tex.Texture = nullptr;
-                    Textures.push_back(tex);
-                }
-            }
-        }
-
-        // Process normal texture
-        if (materialData[i].NormalPath[0] != '\0') {
-            std::string normalPath(materialData[i].NormalPath);
-            if (texturePathToIndex.find(normalPath) == texturePathToIndex.end()) {
-                int texIndex = (int)Textures.size();
-                texturePathToIndex[normalPath] = texIndex;
-
-                // Convert to .ktx2 format and make relative to model path
-                std::string ktx2Path = ConvertToKTX2Path(normalPath);
-                std::string fullPath = MakeRelativeTexturePath(path, ktx2Path);
-
-                MeshTexture tex;
-                id<MTLTexture> mtlTexture = KTX2Loader::LoadKTX2(fullPath);
-                if (mtlTexture) {
-                    tex.Texture = new Texture(mtlTexture);
-                    Textures.push_back(tex);
-                } else {
-                    LOG_WARNING_FMT("Failed to load normal texture: %s", fullPath.c_str());
-                    // Still add a null entry to maintain indices
-                    tex.Texture = nullptr;
-                    Textures.push_back(tex);
-                }
-            }
-        }
-
-        // Process ORM (PBR) texture
-        if (materialData[i].ORMPath[0] != '\0') {
-            std::string ormPath(materialData[i].ORMPath);
-            if (texturePathToIndex.find(ormPath) == texturePathToIndex.end()) {
-                int texIndex = (int)Textures.size();
-                texturePathToIndex[ormPath] = texIndex;
-
-                // Convert to .ktx2 format and make relative to model path
-                std::string ktx2Path = ConvertToKTX2Path(ormPath);
-                std::string fullPath = MakeRelativeTexturePath(path, ktx2Path);
-
-                MeshTexture tex;
-                id<MTLTexture> mtlTexture = KTX2Loader::LoadKTX2(fullPath);
-                if (mtlTexture) {
-                    tex.Texture = new Texture(mtlTexture);
-                    Textures.push_back(tex);
-                } else {
-                    LOG_WARNING_FMT("Failed to load ORM texture: %s", fullPath.c_str());
-                    // Still add a null entry to maintain indices
-                    tex.Texture = nullptr;
-                    Textures.push_back(tex);
-                }
-            }
-        }
+    Textures.reserve(materialTables.TextureCount);
+    for (uint32_t i = 0; i < materialTables.TextureCount; i++) {
+        const L_TextureData& texture = materialTables.Textures[i];
+        std::string ktx2Path = ConvertToKTX2Path(materialTables.Strings + texture.PathOffset);
+        MeshTexture tex;
+        tex.Path = MakeRelativeTexturePath(path, ktx2Path);
+        Textures.push_back(std::move(tex));
     }
+    if (!headless && !deferTextures)
+        LoadTextures();
 
     // Build materials with texture indices
+    auto textureIndex = [&](uint32_t index) { return index < materialTables.TextureCount ? (int)index : -1; };
     Materials.clear();
-    Materials.reserve(header.MaterialCount);
-    for (uint32_t i = 0; i < header.MaterialCount; i++) {
+    Materials.reserve(materialCount);
+    for (uint32_t i = 0; i < materialCount; i++) {
+        const L_MaterialEntry& entry = materialTables.Materials[i];
         MeshMaterial mat;
-        mat.AlbedoIndex = -1;
-        mat.NormalIndex = -1;
-        mat.PBRIndex = -1;
-        mat.Opaque = (materialData[i].Opaque != 0);
-
-        if (materialData[i].AlbedoPath[0] != '\0') {
-            std::string albedoPath(materialData[i].AlbedoPath);
-            auto it = texturePathToIndex.find(albedoPath);
-            if (it != texturePathToIndex.end()) {
-                mat.AlbedoIndex = it->second;
-            }
-        }
-
-        if (materialData[i].NormalPath[0] != '\0') {
-            std::string normalPath(materialData[i].NormalPath);
-            auto it = texturePathToIndex.find(normalPath);
-            if (it != texturePathToIndex.end()) {
-                mat.NormalIndex = it->second;
-            }
-        }
-
-        if (materialData[i].ORMPath[0] != '\0') {
-            std::string ormPath(materialData[i].ORMPath);
-            auto it = texturePathToIndex.find(ormPath);
-            if (it != texturePathToIndex.end()) {
-                mat.PBRIndex = it->second;
-            }
-        }
-
+        mat.AlbedoIndex = textureIndex(entry.AlbedoTexture);
+        mat.NormalIndex = textureIndex(entry.NormalTexture);
+        mat.PBRIndex = textureIndex(entry.ORMTexture);
+        mat.Opaque = (entry.Opaque != 0);
         Materials.push_back(mat);
     }
 
     // Create shared vertex and index buffers for the entire model
-    VertexBuffer.Initialize(vertexData, header.VBSize);
+    uint64_t vertexSize = Format == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(PackedVertex);
+    uint64_t mappedBytes = 0;
+    if (!LoadStream(VertexBuffer, directory, result.file, MeshSectionType::Vertices, directory.VertexCount * vertexSize,
+                    mappedBytes) ||
+        !LoadStream(IndexBuffer, directory, result.file, MeshSectionType::Indices, directory.IndexCount * GetIndexSize(),
+                    mappedBytes)) {
+        LOG_ERROR_FMT("Missing or corrupt vertex or index data in %s", path.c_str());
+        return false;
+    }
     VertexBuffer.SetLabel([NSString stringWithFormat:@"VB %s", path.c_str()]);
-    IndexBuffer.Initialize(indexData, header.IBSize);
     IndexBuffer.SetLabel([NSString stringWithFormat:@"IB %s", path.c_str()]);
 
+    // Position-only stream, optional. Without it depth passes and BLAS builds read the full vertices.
+    PositionBuffer.Cleanup();
+    if (directory.FindTable(MeshSectionType::Positions)) {
+        if (LoadStream(PositionBuffer, directory, result.file, MeshSectionType::Positions,
+                       directory.VertexCount * GetPositionSize(), mappedBytes)) {
+            PositionBuffer.SetLabel([NSString stringWithFormat:@"Positions %s", path.c_str()]);
+        } else {
+            PositionBuffer.Cleanup();
+            LOG_WARNING_FMT("Ignoring invalid position stream in %s", path.c_str());
+        }
+    }
+
     // Build submeshes
     Meshes.clear();
-    Meshes.reserve(header.SubmeshCount);
-    for (uint32_t i = 0; i < header.SubmeshCount; i++) {
+    Meshes.reserve(submeshCount);
+    for (uint32_t i = 0; i < submeshCount; i++) {
+        // Ranges go straight into draws, BLAS descriptors and ray queries, nothing past the streams may be read
+        if ((uint64_t)submeshData[i].IndexOffset + submeshData[i].IndexCount > directory.IndexCount) {
+            LOG_ERROR_FMT("Submesh %u indices out of range in %s", i, path.c_str());
+            return false;
+        }
+        if (baseVertexData && baseVertexData[i] >= directory.VertexCount) {
+            LOG_ERROR_FMT("Submesh %u base vertex out of range in %s", i, path.c_str());
+            return false;
+        }
+
         Mesh mesh;
-        mesh.VertexOffset = 0; // All submeshes share the same vertex buffer, starting at 0
+        // All submeshes share the same vertex buffer, 16-bit indices are relative to a per-submesh base vertex
+        mesh.VertexOffset = baseVertexData ? baseVertexData[i] : 0;
         mesh.IndexOffset = submeshData[i].IndexOffset;
         mesh.IndexCount = submeshData[i].IndexCount;
         mesh.MaterialIndex = submeshData[i].MaterialIndex;
         mesh.Min = simd::make_float3(submeshData[i].Min.x, submeshData[i].Min.y, submeshData[i].Min.z);
         mesh.Max = simd::make_float3(submeshData[i].Max.x, submeshData[i].Max.y, submeshData[i].Max.z);
+        mesh.Lods[0] = { mesh.IndexOffset, mesh.IndexCount, 0.0f };
         Meshes.push_back(mesh);
     }
 
-    LOG_INFO_FMT("Successfully loaded mesh with %lu submeshes, %lu materials, %lu textures",
-          Meshes.size(), Materials.size(), Textures.size());
+    // Simplified levels, sorted by submesh then level in the file
+    uint32_t lodCount;
+    const L_LodData* lodData = GetTable<L_LodData>(directory, bytes, MeshSectionType::Lods, lodCount);
+    for (uint32_t i = 0; i < lodCount; i++) {
+        const L_LodData& src = lodData[i];
+        if (src.SubmeshIndex >= Meshes.size() || (uint64_t)src.IndexOffset + src.IndexCount > directory.IndexCount)
+            continue;
+
+        Mesh& mesh = Meshes[src.SubmeshIndex];
+        if (mesh.LodCount >= MAX_MESH_LODS || src.Level != mesh.LodCount)
+            continue;
+        mesh.Lods[mesh.LodCount++] = { src.IndexOffset, src.IndexCount, src.Error };
+    }
+
+    // Instances, files without a table draw every submesh once as stored
+    Instances.clear();
+    uint32_t instanceCount;
+    const L_InstanceData* instanceData = GetTable<L_InstanceData>(directory, bytes, MeshSectionType::Instances, instanceCount);
+    if (instanceCount > 0) {
+        Instances.reserve(instanceCount);
+        for (uint32_t i = 0; i < instanceCount; i++) {
+            const L_InstanceData& src = instanceData[i];
+            if ((uint64_t)src.SubmeshOffset + src.SubmeshCount > Meshes.size()) {
+                LOG_ERROR_FMT("Instance %u references missing submeshes in %s", i, path.c_str());
+                return false;
+            }
+
+            MeshInstance instance;
+            instance.MeshOffset = src.SubmeshOffset;
+            instance.MeshCount = src.SubmeshCount;
+            memcpy(&instance.Transform, src.Transform, sizeof(src.Transform));
+            Instances.push_back(instance);
+        }
+    } else {
+        Instances.push_back({ 0, (uint32_t)Meshes.size(), matrix_identity_float4x4 });
+    }
+
+    // Build meshlets, sorted by submesh in the file
+    Meshlets.clear();
+    uint32_t meshletCount;
+    const L_MeshletData* meshletData = GetTable<L_MeshletData>(directory, bytes, MeshSectionType::Meshlets, meshletCount);
+    Meshlets.reserve(meshletCount);
+    for (uint32_t i = 0; i < meshletCount; i++) {
+        const L_MeshletData& src = meshletData[i];
+        if (src.SubmeshIndex >= Meshes.size())
+            continue;
+
+        Mesh& mesh = Meshes[src.SubmeshIndex];
+        if (mesh.MeshletCount == 0)
+            mesh.MeshletOffset = (uint32_t)Meshlets.size();
+        mesh.MeshletCount++;
+
+        Meshlet meshlet;
+        meshlet.IndexOffset = src.IndexOffset;
+        meshlet.TriangleCount = src.TriangleCount;
+        meshlet.VertexCount = src.VertexCount;
+        meshlet.Min = simd::make_float3(src.Min.x, src.Min.y, src.Min.z);
+        meshlet.Max = simd::make_float3(src.Max.x, src.Max.y, src.Max.z);
+        meshlet.SphereCenter = simd::make_float3(src.SphereCenter.x, src.SphereCenter.y, src.SphereCenter.z);
+        meshlet.SphereRadius = src.SphereRadius;
+        meshlet.ConeAxis = simd::make_float3(src.ConeAxis.x, src.ConeAxis.y, src.ConeAxis.z);
+        meshlet.ConeCutoff = src.ConeCutoff;
+        Meshlets.push_back(meshlet);
+    }
+
+    // Occluder boxes for CPU occlusion culling, optional and sorted by submesh
+    Occluders.clear();
+    uint32_t occluderCount;
+    const L_OccluderData* occluderData = GetTable<L_OccluderData>(directory, bytes, MeshSectionType::Occluders, occluderCount);
+    Occluders.reserve(occluderCount);
+    for (uint32_t i = 0; i < occluderCount; i++) {
+        const L_OccluderData& src = occluderData[i];
+        if (src.SubmeshIndex >= Meshes.size() || (!Occluders.empty() && src.SubmeshIndex < Occluders.back().MeshIndex))
+            continue;
+
+        MeshOccluder occluder;
+        occluder.MeshIndex = src.SubmeshIndex;
+        occluder.Min = simd::make_float3(src.Min.x, src.Min.y, src.Min.z);
+        occluder.Max = simd::make_float3(src.Max.x, src.Max.y, src.Max.z);
+        Occluders.push_back(occluder);
+    }
+
+    // BVHs for CPU ray queries, optional. Every reference is checked here so traversal doesn't have to.
+    Bvhs.clear();
+    BvhNodes.clear();
+    BvhTriangles.clear();
+    if (directory.FindTable(MeshSectionType::BvhRoots)) {
+        if (LoadBvh(directory, bytes, *this))
+            LOG_INFO_FMT("Loaded BVH with %lu roots, %lu nodes", Bvhs.size(), BvhNodes.size());
+        else
+            LOG_WARNING_FMT("Ignoring invalid BVH tables in %s", path.c_str());
+    }
+
+    LOG_INFO_FMT("Successfully loaded mesh with %lu submeshes, %lu instances, %lu meshlets, %lu materials, %lu textures, %lu occluders",
+          Meshes.size(), Instances.size(), Meshlets.size(), Materials.size(), Textures.size(), Occluders.size());
+
+    double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    LOG_INFO_FMT("Loaded %s in %.2f ms, %.1f of %.1f MB mapped without a copy, peak RSS %.1f MB", path.c_str(), loadMs,
+                 mappedBytes / (1024.0 * 1024.0), fileSize / (1024.0 * 1024.0), GetPeakResidentBytes() / (1024.0 * 1024.0));
 
     return true;
 }
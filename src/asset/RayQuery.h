@@ -0,0 +1,45 @@
+#pragma once
+
+#import <simd/simd.h>
+
+#include <vector>
+
+#include "MeshLoader.h"
+
+struct RayHit
+{
+    float Distance = 0.0f;      // In units of the ray direction's length
+    uint32_t InstanceIndex = 0; // Model::Instances
+    uint32_t MeshIndex = 0;     // Model::Meshes
+    uint32_t TriangleIndex = 0; // Base-level triangle within the mesh
+    simd::float2 Barycentrics = 0.0f;
+    simd::float3 Normal = 0.0f; // Model-space geometric normal facing the ray origin
+};
+
+// CPU ray casts against the BVH baked into a model, for picking, audio occlusion and validating GPU results.
+// Positions are decoded once on construction, the model has to outlive the query. Const methods are thread safe.
+class RayQuery
+{
+public:
+    explicit RayQuery(const Model& model);
+
+    // False when the model was cooked without a BVH
+    bool IsValid() const { return !m_InstanceBvh.empty(); }
+
+    // Closest two-sided hit along origin + t * direction for t in [0, maxDistance], in model space
+    bool Intersect(simd::float3 origin, simd::float3 direction, float maxDistance, RayHit& outHit) const;
+    // True as soon as anything is hit, cheaper than Intersect for visibility checks
+    bool Occluded(simd::float3 origin, simd::float3 direction, float maxDistance) const;
+
+private:
+    bool Trace(simd::float3 origin, simd::float3 direction, float maxDistance, bool anyHit, RayHit* outHit) const;
+    bool TraverseBvh(const MeshBvh& bvh, simd::float3 origin, simd::float3 direction, float& maxDistance, bool anyHit,
+                     RayHit* outHit) const;
+    simd::uint3 GetTriangle(const Mesh& mesh, uint32_t triangle) const;
+
+    const Model& m_Model;
+    std::vector<simd::float3> m_Positions;
+    // Per instance, index into Model::Bvhs and the transform rays are brought into mesh space with
+    std::vector<uint32_t> m_InstanceBvh;
+    std::vector<simd::float4x4> m_InverseTransforms;
+};
@@ -0,0 +1,206 @@
+#include "RayQuery.h"
+#include "Core/Logger.h"
+
+#include <algorithm>
+
+RayQuery::RayQuery(const Model& model)
+    : m_Model(model)
+{
+    if (model.Bvhs.empty())
+        return;
+
+    // Decode every position once, compact vertices are quantized within their mesh's bounds
+    const uint8_t* vertexData = (const uint8_t*)model.VertexBuffer.Contents();
+    if (model.Format == VertexFormat::Float) {
+        uint64_t vertexCount = model.VertexBuffer.GetSize() / sizeof(PackedVertex);
+        m_Positions.resize(vertexCount);
+        const PackedVertex* vertices = (const PackedVertex*)vertexData;
+        for (uint64_t i = 0; i < vertexCount; i++)
+            m_Positions[i] = simd::make_float3(vertices[i].px, vertices[i].py, vertices[i].pz);
+    } else {
+        uint64_t vertexCount = model.VertexBuffer.GetSize() / sizeof(CompactVertex);
+        m_Positions.resize(vertexCount);
+        const CompactVertex* vertices = (const CompactVertex*)vertexData;
+        for (const Mesh& mesh : model.Meshes) {
+            simd::float3 extent = mesh.Max - mesh.Min;
+            for (uint32_t i = 0; i < mesh.IndexCount; i += 3) {
+                simd::uint3 triangle = GetTriangle(mesh, (mesh.IndexOffset + i) / 3);
+                for (int k = 0; k < 3; k++) {
+                    const uint16_t* q = vertices[triangle[k]].position;
+                    m_Positions[triangle[k]] = mesh.Min + extent * (simd::make_float3((float)q[0], (float)q[1], (float)q[2]) / 65535.0f);
+                }
+            }
+        }
+    }
+
+    // Instances share the BVH of their mesh range
+    m_InstanceBvh.resize(model.Instances.size(), MESH_BVH_EMPTY);
+    m_InverseTransforms.resize(model.Instances.size());
+    for (size_t i = 0; i < model.Instances.size(); i++) {
+        const MeshInstance& instance = model.Instances[i];
+        for (size_t b = 0; b < model.Bvhs.size(); b++) {
+            if (model.Bvhs[b].MeshOffset == instance.MeshOffset && model.Bvhs[b].MeshCount == instance.MeshCount)
+                m_InstanceBvh[i] = (uint32_t)b;
+        }
+        if (m_InstanceBvh[i] == MESH_BVH_EMPTY)
+            LOG_WARNING_FMT("No BVH for instance %lu, ray queries will skip it", i);
+        m_InverseTransforms[i] = simd::inverse(instance.Transform);
+    }
+}
+
+simd::uint3 RayQuery::GetTriangle(const Mesh& mesh, uint32_t triangle) const
+{
+    const void* indexData = m_Model.IndexBuffer.Contents();
+    if (m_Model.IndexType == IndexFormat::UInt16) {
+        const uint16_t* indices = (const uint16_t*)indexData + triangle * 3;
+        return simd::make_uint3(indices[0], indices[1], indices[2]) + mesh.VertexOffset;
+    }
+    const uint32_t* indices = (const uint32_t*)indexData + triangle * 3;
+    return simd::make_uint3(indices[0], indices[1], indices[2]);
+}
+
+// Two-sided Möller–Trumbore, returns t and the barycentrics of p1 and p2
+static bool IntersectTriangle(simd::float3 origin, simd::float3 direction, simd::float3 p0, simd::float3 p1, simd::float3 p2,
+                              float& t, simd::float2& barycentrics)
+{
+    simd::float3 e1 = p1 - p0;
+    simd::float3 e2 = p2 - p0;
+    simd::float3 pv = simd::cross(direction, e2);
+    float det = simd::dot(e1, pv);
+    if (det == 0.0f)
+        return false;
+
+    float invDet = 1.0f / det;
+    simd::float3 tv = origin - p0;
+    float u = simd::dot(tv, pv) * invDet;
+    if (u < 0.0f || u > 1.0f)
+        return false;
+
+    simd::float3 qv = simd::cross(tv, e1);
+    float v = simd::dot(direction, qv) * invDet;
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+
+    t = simd::dot(e2, qv) * invDet;
+    barycentrics = simd::make_float2(u, v);
+    return true;
+}
+
+bool RayQuery::TraverseBvh(const MeshBvh& bvh, simd::float3 origin, simd::float3 direction, float& maxDistance, bool anyHit,
+                           RayHit* outHit) const
+{
+    // Near-zero components are clamped so slabs parallel to the ray give +-inf instead of NaN
+    simd::float3 safeDirection = simd::select(direction, simd::copysign(simd::float3(1e-30f), direction), simd::fabs(direction) < 1e-30f);
+    simd::float3 invDir = 1.0f / safeDirection;
+    simd::float4 originX = origin.x, originY = origin.y, originZ = origin.z;
+    simd::float4 invX = invDir.x, invY = invDir.y, invZ = invDir.z;
+    simd::float4 zero = 0.0f;
+
+    bool hit = false;
+    thread_local std::vector<uint32_t> stack;
+    stack.clear();
+    stack.push_back(bvh.RootNode);
+
+    while (!stack.empty()) {
+        const MeshBvhNode& node = m_Model.BvhNodes[stack.back()];
+        stack.pop_back();
+
+        // Slab test against all four children at once
+        simd::float4 tx0 = (simd::float4{ node.MinX[0], node.MinX[1], node.MinX[2], node.MinX[3] } - originX) * invX;
+        simd::float4 tx1 = (simd::float4{ node.MaxX[0], node.MaxX[1], node.MaxX[2], node.MaxX[3] } - originX) * invX;
+        simd::float4 ty0 = (simd::float4{ node.MinY[0], node.MinY[1], node.MinY[2], node.MinY[3] } - originY) * invY;
+        simd::float4 ty1 = (simd::float4{ node.MaxY[0], node.MaxY[1], node.MaxY[2], node.MaxY[3] } - originY) * invY;
+        simd::float4 tz0 = (simd::float4{ node.MinZ[0], node.MinZ[1], node.MinZ[2], node.MinZ[3] } - originZ) * invZ;
+        simd::float4 tz1 = (simd::float4{ node.MaxZ[0], node.MaxZ[1], node.MaxZ[2], node.MaxZ[3] } - originZ) * invZ;
+        simd::float4 tNear = simd::max(simd::max(simd::min(tx0, tx1), simd::min(ty0, ty1)), simd::max(simd::min(tz0, tz1), zero));
+        simd::float4 limit = maxDistance;
+        simd::float4 tFar = simd::min(simd::min(simd::max(tx0, tx1), simd::max(ty0, ty1)), simd::min(simd::max(tz0, tz1), limit));
+
+        float entries[4];
+        uint32_t order[4];
+        uint32_t innerCount = 0;
+        for (uint32_t slot = 0; slot < 4; slot++) {
+            // Widened by a few ulps so rounding never misses a box whose triangle the ray grazes
+            if (node.Child[slot] == MESH_BVH_EMPTY || tNear[slot] > tFar[slot] * 1.0000004f)
+                continue;
+
+            if (node.Leaf[slot] != 0) {
+                uint32_t count = node.Leaf[slot] & 0xFF;
+                uint32_t meshIndex = node.Leaf[slot] >> 8;
+                const Mesh& mesh = m_Model.Meshes[meshIndex];
+                for (uint32_t i = 0; i < count; i++) {
+                    uint32_t triangle = m_Model.BvhTriangles[node.Child[slot] + i];
+                    simd::uint3 vertices = GetTriangle(mesh, triangle);
+                    float t;
+                    simd::float2 barycentrics;
+                    if (!IntersectTriangle(origin, direction, m_Positions[vertices.x], m_Positions[vertices.y],
+                                           m_Positions[vertices.z], t, barycentrics) || t < 0.0f || t > maxDistance) {
+                        continue;
+                    }
+
+                    hit = true;
+                    maxDistance = t;
+                    if (anyHit)
+                        return true;
+                    outHit->Distance = t;
+                    outHit->MeshIndex = meshIndex;
+                    outHit->TriangleIndex = triangle - mesh.IndexOffset / 3;
+                    outHit->Barycentrics = barycentrics;
+                    simd::float3 normal = simd::cross(m_Positions[vertices.y] - m_Positions[vertices.x],
+                                                      m_Positions[vertices.z] - m_Positions[vertices.x]);
+                    outHit->Normal = simd::dot(normal, direction) > 0.0f ? -normal : normal;
+                }
+                continue;
+            }
+
+            // Keep inner children sorted far to near so the nearest is popped first
+            uint32_t at = innerCount++;
+            while (at > 0 && entries[at - 1] < tNear[slot]) {
+                entries[at] = entries[at - 1];
+                order[at] = order[at - 1];
+                at--;
+            }
+            entries[at] = tNear[slot];
+            order[at] = node.Child[slot];
+        }
+        for (uint32_t i = 0; i < innerCount; i++)
+            stack.push_back(order[i]);
+    }
+    return hit;
+}
+
+bool RayQuery::Trace(simd::float3 origin, simd::float3 direction, float maxDistance, bool anyHit, RayHit* outHit) const
+{
+    bool hit = false;
+    for (size_t i = 0; i < m_InstanceBvh.size(); i++) {
+        if (m_InstanceBvh[i] == MESH_BVH_EMPTY)
+            continue;
+
+        // The direction isn't renormalized in mesh space, so distances stay comparable across instances
+        const simd::float4x4& inverse = m_InverseTransforms[i];
+        simd::float3 localOrigin = simd_mul(inverse, simd::make_float4(origin, 1.0f)).xyz;
+        simd::float3 localDirection = simd_mul(inverse, simd::make_float4(direction, 0.0f)).xyz;
+
+        if (!TraverseBvh(m_Model.Bvhs[m_InstanceBvh[i]], localOrigin, localDirection, maxDistance, anyHit, outHit))
+            continue;
+        if (anyHit)
+            return true;
+
+        hit = true;
+        outHit->InstanceIndex = (uint32_t)i;
+        // Normals leave mesh space through the inverse transpose
+        simd::float3 normal = simd_mul(simd::transpose(inverse), simd::make_float4(outHit->Normal, 0.0f)).xyz;
+        outHit->Normal = simd::normalize(normal);
+    }
+    return hit;
+}
+
+bool RayQuery::Intersect(simd::float3 origin, simd::float3 direction, float maxDistance, RayHit& outHit) const
+{
+    return IsValid() && Trace(origin, direction, maxDistance, false, &outHit);
+}
+
+bool RayQuery::Occluded(simd::float3 origin, simd::float3 direction, float maxDistance) const
+{
+    return IsValid() && Trace(origin, direction, maxDistance, true, nullptr);
+}
@@ -1,16 +1,65 @@
 #pragma once
 
 #include "AstcLoader.h"
-#include <unordered_map>
+#include "CacheIndex.h"
+#include <mutex>
+#include <vector>
 
+// Cache budget until Application sets the TextureCache.BudgetMB CVar
+constexpr uint64_t TEXTURE_CACHE_DEFAULT_BUDGET = 1024ull << 20;
+
+// Counted reference to a cached texture, the cache may evict the texture once no handle refers to it. Handles can be
+// copied and destroyed on any thread.
+class TextureHandle
+{
+public:
+    TextureHandle() = default;
+    TextureHandle(const TextureHandle& other);
+    TextureHandle(TextureHandle&& other);
+    TextureHandle& operator=(const TextureHandle& other);
+    TextureHandle& operator=(TextureHandle&& other);
+    ~TextureHandle();
+
+    id<MTLTexture> GetTexture() const { return m_Texture; }
+    uint64_t GetResourceID() const { return m_Texture ? (uint64_t)m_Texture.gpuResourceID._impl : 0; }
+    explicit operator bool() const { return m_Texture != nil; }
+    void Reset();
+
+private:
+    friend class TextureCache;
+    TextureHandle(CacheIndex::EntryId entry, id<MTLTexture> texture) : m_Entry(entry), m_Texture(texture) {}
+
+    CacheIndex::EntryId m_Entry = CacheIndex::INVALID_ENTRY;
+    id<MTLTexture> m_Texture = nil;
+};
+
+// Every model texture, keyed by canonical path. Textures stay cached after their last handle is gone and are evicted
+// least recently used first once the cache is over budget. All calls are safe from any thread.
 class TextureCache
 {
 public:
     static void Shutdown();
 
-    static id<MTLTexture> GetTexture(const std::string& path);
+    // Loads path unless it is cached, the file is read outside the lock. Empty when loading fails.
+    static TextureHandle GetTexture(const std::string& path);
+    // Empty when path isn't cached
+    static TextureHandle Find(const std::string& path);
+    // Adds a texture loaded by the caller, returns the cached one instead when another thread got there first
+    static TextureHandle Insert(const std::string& path, id<MTLTexture> texture);
+
+    static void SetBudget(uint64_t bytes);
+    static CacheStats GetStats();
+    static void LogStats();
 private:
+    friend class TextureHandle;
+    static void AddReference(CacheIndex::EntryId entry);
+    static void Release(CacheIndex::EntryId entry);
+    // Call with the lock held
+    static void Evict(const std::vector<CacheIndex::EntryId>& entries);
+
     static struct Data {
-        std::unordered_map<std::string, id<MTLTexture>> Textures;
+        std::mutex Mutex;
+        CacheIndex Index{ TEXTURE_CACHE_DEFAULT_BUDGET };
+        std::vector<id<MTLTexture>> Textures; // By entry id
     } sData;
 };
@@ -2,26 +2,179 @@
 #include "AstcLoader.h"
 #include "Ktx2Loader.h"
 #include "Metal/Device.h"
+#include "Core/Logger.h"
+#import "Swift/DebugBridge.h"
+
+#include <fs.h>
 
 TextureCache::Data TextureCache::sData;
 
+TextureHandle::TextureHandle(const TextureHandle& other)
+    : m_Entry(other.m_Entry)
+    , m_Texture(other.m_Texture)
+{
+    if (m_Texture)
+        TextureCache::AddReference(m_Entry);
+}
+
+TextureHandle::TextureHandle(TextureHandle&& other)
+    : m_Entry(other.m_Entry)
+    , m_Texture(other.m_Texture)
+{
+    other.m_Entry = CacheIndex::INVALID_ENTRY;
+    other.m_Texture = nil;
+}
+
+TextureHandle& TextureHandle::operator=(const TextureHandle& other)
+{
+    if (this != &other) {
+        if (other.m_Texture)
+            TextureCache::AddReference(other.m_Entry);
+        Reset();
+        m_Entry = other.m_Entry;
+        m_Texture = other.m_Texture;
+    }
+    return *this;
+}
+
+TextureHandle& TextureHandle::operator=(TextureHandle&& other)
+{
+    if (this != &other) {
+        Reset();
+        m_Entry = other.m_Entry;
+        m_Texture = other.m_Texture;
+        other.m_Entry = CacheIndex::INVALID_ENTRY;
+        other.m_Texture = nil;
+    }
+    return *this;
+}
+
+TextureHandle::~TextureHandle()
+{
+    Reset();
+}
+
+void TextureHandle::Reset()
+{
+    if (m_Texture)
+        TextureCache::Release(m_Entry);
+    m_Entry = CacheIndex::INVALID_ENTRY;
+    m_Texture = nil;
+}
+
 void TextureCache::Shutdown()
 {
-    for (auto& texture : sData.Textures)
-        Device::GetResidencySet().RemoveResource(texture.second);
+    LogStats();
+
+    // Handles that outlive the cache release into a fresh index, which ignores ids it never handed out
+    std::lock_guard<std::mutex> lock(sData.Mutex);
+    for (id<MTLTexture> texture : sData.Textures) {
+        if (!texture)
+            continue;
+        NSString* name = texture.label ?: [NSString stringWithFormat:@"Texture_%p", texture];
+        [[DebugBridge shared] removeAllocation:name];
+        Device::GetResidencySet().RemoveResource(texture);
+    }
     sData.Textures.clear();
+    sData.Index = CacheIndex(sData.Index.GetStats().Budget);
 }
 
-id<MTLTexture> TextureCache::GetTexture(const std::string& path)
+TextureHandle TextureCache::GetTexture(const std::string& path)
 {
-    auto it = sData.Textures.find(path);
-    if (it != sData.Textures.end())
-        return it->second;
+    TextureHandle texture = Find(path);
+    if (texture)
+        return texture;
+
+    // Two threads may load the same path at once, the first to finish wins and the other copy is dropped
+    id<MTLTexture> loaded = KTX2Loader::LoadKTX2(path);
+    if (!loaded)
+        return TextureHandle();
+    return Insert(path, loaded);
+}
 
-    id<MTLTexture> texture = KTX2Loader::LoadKTX2(path);
-    sData.Textures[path] = texture;
+TextureHandle TextureCache::Find(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(sData.Mutex);
+    CacheIndex::EntryId entry = sData.Index.Acquire(fs::ResolvePath(path));
+    if (entry == CacheIndex::INVALID_ENTRY)
+        return TextureHandle();
+    return TextureHandle(entry, sData.Textures[entry]);
+}
 
+TextureHandle TextureCache::Insert(const std::string& path, id<MTLTexture> texture)
+{
+    if (!texture)
+        return TextureHandle();
+
+    // Absolute so a texture reached through different relative paths is one entry
+    std::string key = fs::ResolvePath(path);
+    std::lock_guard<std::mutex> lock(sData.Mutex);
+    std::vector<CacheIndex::EntryId> evicted;
+    CacheIndex::EntryId entry = sData.Index.Insert(key, texture.allocatedSize, evicted);
+    if (entry == CacheIndex::INVALID_ENTRY) {
+        entry = sData.Index.Acquire(key);
+        return TextureHandle(entry, sData.Textures[entry]);
+    }
+    Evict(evicted);
+
+    if (entry >= sData.Textures.size())
+        sData.Textures.resize(entry + 1);
+    sData.Textures[entry] = texture;
     Device::GetResidencySet().AddResource(texture);
 
-    return texture;
+    // Track allocation in Debug Bridge
+    NSString* name = texture.label ?: [NSString stringWithFormat:@"Texture_%p", texture];
+    [[DebugBridge shared] trackAllocation:name resource:texture];
+
+    return TextureHandle(entry, texture);
+}
+
+void TextureCache::SetBudget(uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(sData.Mutex);
+    if (sData.Index.GetStats().Budget == bytes)
+        return;
+
+    std::vector<CacheIndex::EntryId> evicted;
+    sData.Index.SetBudget(bytes, evicted);
+    Evict(evicted);
+}
+
+CacheStats TextureCache::GetStats()
+{
+    std::lock_guard<std::mutex> lock(sData.Mutex);
+    return sData.Index.GetStats();
+}
+
+void TextureCache::LogStats()
+{
+    CacheStats stats = GetStats();
+    LOG_INFO_FMT("Texture cache: %llu textures, %.1f of %.1f MB (%.1f MB unreferenced), %llu hits, %llu misses, %llu evictions",
+                 stats.Entries, stats.Bytes / (1024.0 * 1024.0), stats.Budget / (1024.0 * 1024.0),
+                 stats.UnreferencedBytes / (1024.0 * 1024.0), stats.Hits, stats.Misses, stats.Evictions);
+}
+
+void TextureCache::AddReference(CacheIndex::EntryId entry)
+{
+    std::lock_guard<std::mutex> lock(sData.Mutex);
+    sData.Index.AddReference(entry);
+}
+
+void TextureCache::Release(CacheIndex::EntryId entry)
+{
+    std::lock_guard<std::mutex> lock(sData.Mutex);
+    std::vector<CacheIndex::EntryId> evicted;
+    sData.Index.Release(entry, evicted);
+    Evict(evicted);
+}
+
+void TextureCache::Evict(const std::vector<CacheIndex::EntryId>& entries)
+{
+    for (CacheIndex::EntryId entry : entries) {
+        id<MTLTexture> texture = sData.Textures[entry];
+        NSString* name = texture.label ?: [NSString stringWithFormat:@"Texture_%p", texture];
+        [[DebugBridge shared] removeAllocation:name];
+        Device::GetResidencySet().RemoveResource(texture);
+        sData.Textures[entry] = nil;
+    }
 }
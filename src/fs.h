@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <optional>
@@ -24,6 +25,24 @@ struct BinaryResult {
     std::string error;
 };
 
+// Whole file mapped copy-on-write, pages are read from disk as they are first touched and the mapping goes away with
+// the last reference. Writes through data stay private to the process.
+struct MappedFile {
+    uint8_t* data = nullptr;
+    size_t size = 0;
+
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+struct MappedResult {
+    bool success;
+    std::shared_ptr<MappedFile> file;
+    std::string error;
+};
+
 // Path resolution functions
 // Get the path to the application bundle's Resources directory (if running from .app)
 std::string GetResourcesPath();
@@ -50,6 +69,7 @@ FileResult WriteTextFile(const std::string& path, const std::string& content);
 
 // Binary file operations
 BinaryResult LoadBinaryFile(const std::string& path);
+MappedResult MapBinaryFile(const std::string& path); // Fails for empty files, there is nothing to map
 FileResult WriteBinaryFile(const std::string& path, const std::vector<uint8_t>& data);
 FileResult WriteBinaryFile(const std::string& path, const void* data, size_t size);
 
@@ -6,6 +6,9 @@
 #include <mach-o/dyld.h>
 #include <libgen.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 namespace fs {
 
@@ -167,6 +170,48 @@ BinaryResult LoadBinaryFile(const std::string& path) {
     return result;
 }
 
+MappedFile::~MappedFile() {
+    if (data) {
+        munmap(data, size);
+    }
+}
+
+// Map binary file
+MappedResult MapBinaryFile(const std::string& path) {
+    MappedResult result;
+    std::string resolvedPath = ResolvePath(path);
+
+    int fd = open(resolvedPath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        result.success = false;
+        result.error = "Failed to open file: " + resolvedPath;
+        return result;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        result.success = false;
+        result.error = "Failed to map empty or unreadable file: " + resolvedPath;
+        return result;
+    }
+
+    // Writable so Metal can wrap the pages in no-copy buffers, MAP_PRIVATE keeps the file itself untouched
+    void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        result.success = false;
+        result.error = "Failed to map file: " + resolvedPath;
+        return result;
+    }
+
+    result.file = std::make_shared<MappedFile>();
+    result.file->data = (uint8_t*)data;
+    result.file->size = (size_t)info.st_size;
+    result.success = true;
+    return result;
+}
+
 // Write binary file (vector)
 FileResult WriteBinaryFile(const std::string& path, const std::vector<uint8_t>& data) {
     return WriteBinaryFile(path, data.data(), data.size());
@@ -30,7 +30,7 @@ void AccelerationEncoder::BuildTLAS(TLAS* tlas)
 {
     [[DebugBridge shared] recordAccelerationStructureBuild];
     MTLInstanceAccelerationStructureDescriptor* descriptor = tlas->GetDescriptor();
-    descriptor.instanceCount = [tlas->GetBLASMap() count];
+    descriptor.instanceCount = tlas->GetInstanceCount();
     descriptor.instancedAccelerationStructures = tlas->GetBLASMap();
 
     [m_Encoder buildAccelerationStructure:tlas->GetTLAS()
@@ -2,6 +2,9 @@
 
 #include <Metal/Metal.h>
 
+#include <mutex>
+
+// Resources may be added and removed from any thread, Update commits them on the render thread
 class API_AVAILABLE(macos(15.0)) ResidencySet
 {
 public:
@@ -17,6 +20,7 @@ public:
     id<MTLResidencySet> GetResidencySet() const { return m_ResidencySet; }
 private:
     id<MTLResidencySet> m_ResidencySet;
+    std::mutex m_Mutex;
     
     bool m_Dirty = false;
 };
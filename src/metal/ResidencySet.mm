@@ -27,6 +27,7 @@ ResidencySet::~ResidencySet()
 API_AVAILABLE(macos(15.0))
 void ResidencySet::AddResource(id<MTLAllocation> resource)
 {
+    std::lock_guard<std::mutex> lock(m_Mutex);
     [m_ResidencySet addAllocation:resource];
     m_Dirty = true;
 }
@@ -34,12 +35,14 @@ void ResidencySet::AddResource(id<MTLAllocation> resource)
 API_AVAILABLE(macos(15.0))
 void ResidencySet::RemoveResource(id<MTLAllocation> resource)
 {
+    std::lock_guard<std::mutex> lock(m_Mutex);
     [m_ResidencySet removeAllocation:resource];
     m_Dirty = true;
 }
 
 void ResidencySet::Update()
 {
+    std::lock_guard<std::mutex> lock(m_Mutex);
     if (m_Dirty) {
         [m_ResidencySet commit];
         m_Dirty = false;
@@ -7,7 +7,8 @@
 class BLAS
 {
 public:
-    BLAS(const Model& model);
+    // Builds the meshes [meshOffset, meshOffset + meshCount) of the model as one geometry each
+    BLAS(const Model& model, uint32_t meshOffset, uint32_t meshCount);
     ~BLAS();
 
     uint64_t GetResourceID();
@@ -24,4 +25,5 @@ private:
 
     id<MTLAccelerationStructure> m_AccelerationStructure;
     Buffer m_Scratch;
+    Buffer m_GeometryTransforms;
 };
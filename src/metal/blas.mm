@@ -3,26 +3,49 @@
 #include <Metal/Metal.h>
 #import "Swift/DebugBridge.h"
 
-struct PackedVertex
-{
-    float px, py, pz;
-    float nx, ny, nz;
-    float u, v;
-    float tx, ty, tz, tw;
-};
+#include <vector>
 
-BLAS::BLAS(const Model& model)
+BLAS::BLAS(const Model& model, uint32_t meshOffset, uint32_t meshCount)
 {
     m_Geometries = [NSMutableArray array];
 
-    for (auto& mesh : model.Meshes) {
+    // Compact positions are unorm16 within each submesh's bounds, a per-geometry transform expands them
+    bool compact = model.Format == VertexFormat::Compact;
+    if (compact) {
+        std::vector<MTLPackedFloat4x3> transforms(meshCount);
+        for (uint32_t i = 0; i < meshCount; i++) {
+            const Mesh& mesh = model.Meshes[meshOffset + i];
+            simd::float3 extent = mesh.Max - mesh.Min;
+            transforms[i] = MTLPackedFloat4x3();
+            transforms[i].columns[0].x = extent.x;
+            transforms[i].columns[1].y = extent.y;
+            transforms[i].columns[2].z = extent.z;
+            transforms[i].columns[3] = MTLPackedFloat3Make(mesh.Min.x, mesh.Min.y, mesh.Min.z);
+        }
+        m_GeometryTransforms.Initialize(transforms.data(), transforms.size() * sizeof(MTLPackedFloat4x3));
+        m_GeometryTransforms.SetLabel(@"BLAS Geometry Transforms");
+    }
+
+    // The position stream holds the same positions packed tightly, the build then doesn't stride over the other attributes
+    bool positionStream = model.HasPositionStream();
+    uint32_t stride = positionStream ? model.GetPositionSize() : (compact ? sizeof(CompactVertex) : sizeof(PackedVertex));
+
+    for (uint32_t i = 0; i < meshCount; i++) {
+        const Mesh& mesh = model.Meshes[meshOffset + i];
         MTLAccelerationStructureTriangleGeometryDescriptor* geometry = [MTLAccelerationStructureTriangleGeometryDescriptor descriptor];
-        geometry.vertexBuffer = model.VertexBuffer.GetBuffer();
-        geometry.vertexStride = sizeof(PackedVertex);
+        geometry.vertexBuffer = positionStream ? model.PositionBuffer.GetBuffer() : model.VertexBuffer.GetBuffer();
+        // 16-bit indices are relative to the submesh's base vertex, the descriptor has no base vertex so offset the buffer
+        geometry.vertexBufferOffset = mesh.VertexOffset * stride;
+        geometry.vertexStride = stride;
+        if (compact) {
+            geometry.vertexFormat = MTLAttributeFormatUShort4Normalized;
+            geometry.transformationMatrixBuffer = m_GeometryTransforms.GetBuffer();
+            geometry.transformationMatrixBufferOffset = i * sizeof(MTLPackedFloat4x3);
+        }
         geometry.indexBuffer = model.IndexBuffer.GetBuffer();
-        geometry.indexBufferOffset = mesh.IndexOffset * sizeof(uint);
+        geometry.indexBufferOffset = mesh.IndexOffset * model.GetIndexSize();
         geometry.triangleCount = mesh.IndexCount / 3;
-        geometry.indexType = MTLIndexTypeUInt32;
+        geometry.indexType = model.GetMTLIndexType();
         geometry.opaque = model.Materials[mesh.MaterialIndex].Opaque;
 
         [m_Geometries addObject:geometry];
@@ -1,9 +1,12 @@
 #pragma once
 
 #include <stdint.h>
+#include <memory>
 
 #import <Metal/Metal.h>
 
+// Shared-storage GPU buffer. Without a Metal device (headless tools and benchmarks) the same calls are backed by host
+// memory instead, GetBuffer() is nil and Contents() still works.
 class Buffer
 {
 public:
@@ -14,15 +17,28 @@ public:
 
     void Initialize(const void* data, uint64_t size);
     void Initialize(uint64_t size);
+    // Wraps size bytes at a page-aligned address without copying them, owner stays alive until the buffer is released.
+    // The pages up to the next page boundary after size must be mapped too. Returns false when the memory can't be
+    // wrapped, the caller copies it with Initialize instead.
+    bool InitializeNoCopy(void* data, uint64_t size, std::shared_ptr<void> owner);
 
     void SetLabel(NSString* label);
     id<MTLBuffer> GetBuffer() const { return m_Buffer; }
+    bool IsValid() const { return m_Buffer != nil || m_HostData != nullptr; }
+    // Bytes asked for, wrapped buffers can be longer on the GPU as Metal rounds them up to whole pages
+    uint64_t GetSize() const { return m_Size; }
 
     uint64_t GetResourceID() const { return (uint64_t)m_Buffer.gpuAddress; }
 
-    void* Contents() const { return [m_Buffer contents]; }
+    void* Contents() const { return m_Buffer ? [m_Buffer contents] : m_HostData; }
     void Write(const void* data, uint64_t size);
     void Cleanup();
 private:
+    void Track();
+
     id<MTLBuffer> m_Buffer = nil;
+    // Host memory backend, m_HostOwner keeps m_HostData alive whether it was allocated here or wrapped
+    void* m_HostData = nullptr;
+    std::shared_ptr<void> m_HostOwner;
+    uint64_t m_Size = 0;
 };
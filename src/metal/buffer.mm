@@ -2,6 +2,9 @@
 #include "Device.h"
 #import "Swift/DebugBridge.h"
 
+#include <unistd.h>
+#include <vector>
+
 Buffer::Buffer(const void* data, uint64_t size)
 {
     Initialize(data, size);
@@ -25,17 +28,62 @@ Buffer::~Buffer()
 
 void Buffer::Initialize(const void* data, uint64_t size)
 {
+    if (!Device::GetDevice()) {
+        Initialize(size);
+        memcpy(m_HostData, data, size);
+        return;
+    }
+
     m_Buffer = [Device::GetDevice() newBufferWithBytes:data length:size options:MTLResourceStorageModeShared];
-    Device::GetResidencySet().AddResource(m_Buffer);
-    
-    // Track allocation in Debug Bridge
-    NSString* name = m_Buffer.label ?: [NSString stringWithFormat:@"Buffer_%p", m_Buffer];
-    [[DebugBridge shared] trackAllocation:name resource:m_Buffer];
+    m_Size = size;
+    Track();
 }
 
 void Buffer::Initialize(uint64_t size)
 {
+    if (!Device::GetDevice()) {
+        // Zero-filled like a new Metal buffer
+        auto storage = std::make_shared<std::vector<uint8_t>>(size);
+        m_HostData = storage->data();
+        m_HostOwner = storage;
+        m_Size = size;
+        return;
+    }
+
     m_Buffer = [Device::GetDevice() newBufferWithLength:size options:MTLResourceStorageModeShared];
+    m_Size = size;
+    Track();
+}
+
+bool Buffer::InitializeNoCopy(void* data, uint64_t size, std::shared_ptr<void> owner)
+{
+    uint64_t pageSize = (uint64_t)getpagesize();
+    if ((uintptr_t)data % pageSize != 0 || size == 0)
+        return false;
+
+    if (!Device::GetDevice()) {
+        m_HostData = data;
+        m_HostOwner = std::move(owner);
+        m_Size = size;
+        return true;
+    }
+
+    // Metal only wraps whole pages, the tail past size is never read
+    uint64_t length = (size + pageSize - 1) / pageSize * pageSize;
+    __block std::shared_ptr<void> keepAlive = std::move(owner);
+    m_Buffer = [Device::GetDevice() newBufferWithBytesNoCopy:data
+                                                      length:length
+                                                     options:MTLResourceStorageModeShared
+                                                 deallocator:^(void*, NSUInteger) { keepAlive.reset(); }];
+    if (!m_Buffer)
+        return false;
+    m_Size = size;
+    Track();
+    return true;
+}
+
+void Buffer::Track()
+{
     Device::GetResidencySet().AddResource(m_Buffer);
     
     // Track allocation in Debug Bridge
@@ -45,7 +93,7 @@ void Buffer::Initialize(uint64_t size)
 
 void Buffer::Write(const void* data, uint64_t size)
 {
-    void* ptr = [m_Buffer contents];
+    void* ptr = Contents();
     memcpy(ptr, data, size);
 }
 
@@ -57,6 +105,9 @@ void Buffer::Cleanup()
         Device::GetResidencySet().RemoveResource(m_Buffer);
         m_Buffer = nil;
     }
+    m_HostData = nullptr;
+    m_HostOwner.reset();
+    m_Size = 0;
 }
 
 void Buffer::SetLabel(NSString* label)
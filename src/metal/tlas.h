@@ -11,7 +11,7 @@ public:
 
     void Initialize();
     void ResetInstanceBuffer();
-    void AddInstance(BLAS* blas);
+    void AddInstance(BLAS* blas, const simd::float4x4& transform = matrix_identity_float4x4);
     void Update();
     void SetLabel(NSString* label);
 
@@ -19,6 +19,7 @@ public:
     id<MTLAccelerationStructure> GetTLAS() { return m_TLAS; }
     MTLInstanceAccelerationStructureDescriptor* GetDescriptor() { return m_Descriptor; }
     NSMutableArray* GetBLASMap() { return m_BLASMap; }
+    uint32_t GetInstanceCount() const { return (uint32_t)m_InstanceDescriptors.size(); }
 
     Buffer* GetScratchBuffer() { return &m_ScratchBuffer; }
 private:
@@ -29,4 +30,6 @@ private:
     Buffer m_ScratchBuffer;
     std::vector<MTLAccelerationStructureInstanceDescriptor> m_InstanceDescriptors;
     NSMutableArray* m_BLASMap;
+    uint32_t m_DroppedInstanceCount = 0;  // Instances past MAX_SCENE_INSTANCES since the last reset
+    uint32_t m_ReportedDroppedCount = 0;  // Last count warned about, so a full TLAS isn't logged every frame
 };
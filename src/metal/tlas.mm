@@ -1,6 +1,7 @@
 #include "Tlas.h"
 #include "Device.h"
 #include "Renderer/SceneAb.h"
+#include "Core/Logger.h"
 #include <Metal/Metal.h>
 #include <simd/matrix.h>
 #import "Swift/DebugBridge.h"
@@ -43,10 +44,16 @@ void TLAS::ResetInstanceBuffer()
 {
     m_InstanceDescriptors.clear();
     m_BLASMap = [NSMutableArray array];
+    m_DroppedInstanceCount = 0;
 }
 
-void TLAS::AddInstance(BLAS* blas)
+void TLAS::AddInstance(BLAS* blas, const simd::float4x4& transform)
 {
+    if (m_InstanceDescriptors.size() >= MAX_SCENE_INSTANCES) {
+        m_DroppedInstanceCount++;
+        return;
+    }
+
     int found = -1;
     for (int i = 0; i < [m_BLASMap count]; i++) {
         if (m_BLASMap[i] == blas->GetAccelerationStructure()) {
@@ -63,15 +70,21 @@ void TLAS::AddInstance(BLAS* blas)
     instanceDescriptor.options = MTLAccelerationStructureInstanceOptionNonOpaque;
     instanceDescriptor.mask = 0xFF;
     instanceDescriptor.accelerationStructureIndex = found;
-    instanceDescriptor.transformationMatrix.columns[0][0] = 1.0f;
-    instanceDescriptor.transformationMatrix.columns[1][1] = 1.0f;
-    instanceDescriptor.transformationMatrix.columns[2][2] = 1.0f;
+    // Packed 4x3 drops the bottom row, which is (0, 0, 0, 1) for affine transforms
+    for (int column = 0; column < 4; column++) {
+        instanceDescriptor.transformationMatrix.columns[column] =
+            MTLPackedFloat3Make(transform.columns[column].x, transform.columns[column].y, transform.columns[column].z);
+    }
 
     m_InstanceDescriptors.push_back(instanceDescriptor);
 }
 
 void TLAS::Update()
 {
+    if (m_DroppedInstanceCount != m_ReportedDroppedCount && m_DroppedInstanceCount > 0)
+        LOG_WARNING_FMT("TLAS is full, %u instances past %d are missing from ray tracing", m_DroppedInstanceCount, MAX_SCENE_INSTANCES);
+    m_ReportedDroppedCount = m_DroppedInstanceCount;
+
     void* ptr = m_InstanceBuffer.Contents();
     memcpy(ptr, m_InstanceDescriptors.data(), sizeof(MTLAccelerationStructureInstanceDescriptor) * m_InstanceDescriptors.size());
 }
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <simd/simd.h>
+
+#include <vector>
+
+// Resolution of the CPU depth buffer, independent of the viewport aspect since occluders and occludees share the mapping
+constexpr int OCCLUSION_BUFFER_WIDTH = 256;
+constexpr int OCCLUSION_BUFFER_HEIGHT = 128;
+
+// Software occlusion culling for the main camera. The occluder boxes gltfcompress fits inside large opaque meshes are
+// rasterized into a small depth buffer every frame, then instance bounds are tested against a max-depth pyramid of it.
+// Occluders only ever cover what their mesh covers, so a bounds test that fails can be trusted to skip the instance.
+class OcclusionCuller
+{
+public:
+    bool Enabled = true;
+
+    // Clears the depth buffer for a new view
+    void Begin(const simd::float4x4& viewProjection);
+    // Rasterizes the box [min, max] placed in the world by transform
+    void AddOccluder(const simd::float4x4& transform, simd::float3 min, simd::float3 max);
+    // Builds the max-depth pyramid, call once every occluder is added
+    void End();
+
+    // True when every pixel the world-space box could cover already has a nearer occluder. Boxes crossing the near
+    // plane or outside the view are never occluded, frustum culling handles the latter.
+    bool IsOccluded(simd::float3 worldMin, simd::float3 worldMax) const;
+
+    uint32_t GetOccluderCount() const { return m_OccluderCount; }
+
+private:
+    // A quad clipped by the near plane gains at most one vertex
+    static constexpr int MAX_CLIPPED_VERTICES = 5;
+
+    void RasterizeClipped(const simd::float4* clip, int count);
+    void RasterizePolygon(const simd::float3* screen, int count);
+
+    simd::float4x4 m_ViewProjection = matrix_identity_float4x4;
+    uint32_t m_OccluderCount = 0;
+    // Level 0 holds the nearest occluder depth per pixel, every further level the farthest of 2x2 texels below it
+    std::vector<std::vector<float>> m_Levels;
+    std::vector<simd::int2> m_LevelSizes;
+};
@@ -0,0 +1,221 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Box corners are numbered by bit: 1 = max x, 2 = max y, 4 = max z. Winding doesn't matter, both sides rasterize.
+// Faces are rasterized whole, split into triangles the texels along the diagonal would be covered by neither half.
+static const int kBoxFaces[6][4] = {
+    { 0, 2, 3, 1 }, // -z
+    { 4, 5, 7, 6 }, // +z
+    { 0, 1, 5, 4 }, // -y
+    { 2, 6, 7, 3 }, // +y
+    { 0, 4, 6, 2 }, // -x
+    { 1, 3, 7, 5 }, // +x
+};
+
+static simd::float3 BoxCorner(simd::float3 min, simd::float3 max, int corner)
+{
+    return simd::make_float3((corner & 1) ? max.x : min.x, (corner & 2) ? max.y : min.y, (corner & 4) ? max.z : min.z);
+}
+
+// Pixel coordinates with y down and the Metal depth in z
+static simd::float3 ToScreen(simd::float4 clip)
+{
+    float inverseW = 1.0f / clip.w;
+    return simd::make_float3((clip.x * inverseW * 0.5f + 0.5f) * OCCLUSION_BUFFER_WIDTH,
+                             (0.5f - clip.y * inverseW * 0.5f) * OCCLUSION_BUFFER_HEIGHT, clip.z * inverseW);
+}
+
+void OcclusionCuller::Begin(const simd::float4x4& viewProjection)
+{
+    if (m_Levels.empty()) {
+        simd::int2 size = simd::make_int2(OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT);
+        while (true) {
+            m_LevelSizes.push_back(size);
+            m_Levels.emplace_back(size.x * size.y);
+            if (size.x == 1 && size.y == 1)
+                break;
+            size = simd::make_int2(std::max(1, (size.x + 1) / 2), std::max(1, (size.y + 1) / 2));
+        }
+    }
+
+    m_ViewProjection = viewProjection;
+    m_OccluderCount = 0;
+    std::fill(m_Levels[0].begin(), m_Levels[0].end(), 1.0f);
+}
+
+void OcclusionCuller::AddOccluder(const simd::float4x4& transform, simd::float3 min, simd::float3 max)
+{
+    simd::float4x4 toClip = simd_mul(m_ViewProjection, transform);
+    simd::float4 clip[8];
+    // Planes every corner is outside of, any left means the box can't touch the view
+    int outside = 0x3F;
+    for (int corner = 0; corner < 8; corner++) {
+        clip[corner] = simd_mul(toClip, simd::make_float4(BoxCorner(min, max, corner), 1.0f));
+        simd::float4 c = clip[corner];
+        outside &= (c.x < -c.w ? 1 : 0) | (c.x > c.w ? 2 : 0) | (c.y < -c.w ? 4 : 0) | (c.y > c.w ? 8 : 0) |
+                   (c.z < 0.0f ? 16 : 0) | (c.z > c.w ? 32 : 0);
+    }
+    if (outside)
+        return;
+
+    m_OccluderCount++;
+    for (const auto& face : kBoxFaces) {
+        simd::float4 vertices[4] = { clip[face[0]], clip[face[1]], clip[face[2]], clip[face[3]] };
+        RasterizeClipped(vertices, 4);
+    }
+}
+
+// Clips a clip-space quad against the near plane (z >= 0), then rasterizes it in screen space
+void OcclusionCuller::RasterizeClipped(const simd::float4* clip, int count)
+{
+    simd::float4 clipped[MAX_CLIPPED_VERTICES];
+    int clippedCount = 0;
+    for (int i = 0; i < count; i++) {
+        simd::float4 current = clip[i];
+        simd::float4 next = clip[(i + 1) % count];
+        if (current.z >= 0.0f)
+            clipped[clippedCount++] = current;
+        if ((current.z >= 0.0f) != (next.z >= 0.0f)) {
+            float t = current.z / (current.z - next.z);
+            clipped[clippedCount++] = current + (next - current) * t;
+        }
+    }
+
+    if (clippedCount < 3)
+        return;
+    simd::float3 screen[MAX_CLIPPED_VERTICES];
+    for (int i = 0; i < clippedCount; i++)
+        screen[i] = ToScreen(clipped[i]);
+    RasterizePolygon(screen, clippedCount);
+}
+
+// Inner-conservative: a texel is only covered when the whole of it lies inside the convex polygon, and it takes the
+// farthest depth the polygon has over it. Partly covered texels at the silhouette are left alone, so an occluder never
+// claims more of the screen than it hides.
+void OcclusionCuller::RasterizePolygon(const simd::float3* screen, int count)
+{
+    auto edge = [](simd::float3 from, simd::float3 to, float x, float y) {
+        return (to.x - from.x) * (y - from.y) - (to.y - from.y) * (x - from.x);
+    };
+
+    // Depth is affine in screen space after the divide, its plane comes from the largest fan triangle
+    float area = 0.0f;
+    float apexArea = 0.0f;
+    int apex = 1;
+    for (int i = 1; i + 1 < count; i++) {
+        float fanArea = edge(screen[0], screen[i], screen[i + 1].x, screen[i + 1].y);
+        area += fanArea;
+        if (std::fabs(fanArea) > std::fabs(apexArea)) {
+            apexArea = fanArea;
+            apex = i;
+        }
+    }
+    simd::float3 a = screen[0];
+    simd::float3 b = screen[apex];
+    simd::float3 c = screen[apex + 1];
+    if (std::fabs(area) < 1e-6f || std::fabs(apexArea) < 1e-6f)
+        return;
+    simd::float3 e1 = b - a;
+    simd::float3 e2 = c - a;
+    float dzdx = (e1.z * e2.y - e2.z * e1.y) / (e1.x * e2.y - e2.x * e1.y);
+    float dzdy = (e2.z * e1.x - e1.z * e2.x) / (e1.x * e2.y - e2.x * e1.y);
+    // Farthest depth over a texel is its center depth plus this
+    float depthSlack = 0.5f * (std::fabs(dzdx) + std::fabs(dzdy));
+
+    // Edge functions oriented so the inside is positive, with the margin that keeps every texel corner inside
+    float sign = area > 0.0f ? 1.0f : -1.0f;
+    float margins[MAX_CLIPPED_VERTICES];
+    float minX = INFINITY, maxX = -INFINITY, minY = INFINITY, maxY = -INFINITY;
+    for (int i = 0; i < count; i++) {
+        simd::float3 from = screen[i];
+        simd::float3 to = screen[(i + 1) % count];
+        margins[i] = 0.5f * (std::fabs(to.x - from.x) + std::fabs(to.y - from.y));
+        minX = std::min(minX, from.x);
+        maxX = std::max(maxX, from.x);
+        minY = std::min(minY, from.y);
+        maxY = std::max(maxY, from.y);
+    }
+
+    int x0 = std::max(0, (int)std::floor(minX));
+    int x1 = std::min(OCCLUSION_BUFFER_WIDTH - 1, (int)std::ceil(maxX));
+    int y0 = std::max(0, (int)std::floor(minY));
+    int y1 = std::min(OCCLUSION_BUFFER_HEIGHT - 1, (int)std::ceil(maxY));
+
+    std::vector<float>& depth = m_Levels[0];
+    for (int y = y0; y <= y1; y++) {
+        float py = y + 0.5f;
+        for (int x = x0; x <= x1; x++) {
+            float px = x + 0.5f;
+            bool inside = true;
+            for (int i = 0; i < count && inside; i++)
+                inside = sign * edge(screen[i], screen[(i + 1) % count], px, py) >= margins[i];
+            if (!inside)
+                continue;
+
+            float z = a.z + dzdx * (px - a.x) + dzdy * (py - a.y) + depthSlack;
+            float& stored = depth[y * OCCLUSION_BUFFER_WIDTH + x];
+            stored = std::min(stored, z);
+        }
+    }
+}
+
+void OcclusionCuller::End()
+{
+    for (size_t level = 1; level < m_Levels.size(); level++) {
+        simd::int2 size = m_LevelSizes[level];
+        simd::int2 below = m_LevelSizes[level - 1];
+        const std::vector<float>& source = m_Levels[level - 1];
+        std::vector<float>& destination = m_Levels[level];
+        for (int y = 0; y < size.y; y++) {
+            for (int x = 0; x < size.x; x++) {
+                int x1 = std::min(2 * x + 1, below.x - 1);
+                int y1 = std::min(2 * y + 1, below.y - 1);
+                destination[y * size.x + x] = std::max(std::max(source[2 * y * below.x + 2 * x], source[2 * y * below.x + x1]),
+                                                       std::max(source[y1 * below.x + 2 * x], source[y1 * below.x + x1]));
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::IsOccluded(simd::float3 worldMin, simd::float3 worldMax) const
+{
+    if (m_OccluderCount == 0)
+        return false;
+
+    simd::float2 screenMin = simd::make_float2(INFINITY, INFINITY);
+    simd::float2 screenMax = simd::make_float2(-INFINITY, -INFINITY);
+    float nearest = INFINITY;
+    for (int corner = 0; corner < 8; corner++) {
+        simd::float4 clip = simd_mul(m_ViewProjection, simd::make_float4(BoxCorner(worldMin, worldMax, corner), 1.0f));
+        if (clip.z < 0.0f)
+            return false;
+        simd::float3 screen = ToScreen(clip);
+        screenMin = simd::min(screenMin, screen.xy);
+        screenMax = simd::max(screenMax, screen.xy);
+        nearest = std::min(nearest, screen.z);
+    }
+
+    int x0 = std::max(0, (int)std::floor(screenMin.x));
+    int x1 = std::min(OCCLUSION_BUFFER_WIDTH - 1, (int)std::floor(screenMax.x));
+    int y0 = std::max(0, (int)std::floor(screenMin.y));
+    int y1 = std::min(OCCLUSION_BUFFER_HEIGHT - 1, (int)std::floor(screenMax.y));
+    if (x0 > x1 || y0 > y1)
+        return false;
+
+    // Coarsest level where the rectangle still spans at most 2x2 texels
+    size_t level = 0;
+    while (level + 1 < m_Levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+        level++;
+
+    const std::vector<float>& depth = m_Levels[level];
+    int width = m_LevelSizes[level].x;
+    for (int y = y0 >> level; y <= y1 >> level; y++) {
+        for (int x = x0 >> level; x <= x1 >> level; x++) {
+            if (depth[y * width + x] >= nearest)
+                return false;
+        }
+    }
+    return true;
+}
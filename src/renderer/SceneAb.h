@@ -3,12 +3,13 @@
 #include <simd/matrix_types.h>
 #include <simd/simd.h>
 #include <Asset/MeshLoader.h>
+#include "gltfcompress/SceneLimits.h"
 
 #include "Light.h"
 
 constexpr int MAX_SCENE_MODELS = 1024;
-constexpr int MAX_SCENE_INSTANCES = 2048;
 constexpr int MAX_SCENE_MATERIALS = 2048;
+constexpr int MAX_SCENE_LODS = MAX_SCENE_INSTANCES * (MAX_MESH_LODS - 1);
 
 struct SceneMaterial
 {
@@ -19,6 +20,7 @@ struct SceneMaterial
     bool HasAlbedo;
     bool HasNormal;
     bool HasMetallicRoughness;
+    bool Opaque; // Alpha is ignored, shadow casters skip the alpha test
 };
 
 struct SceneInstance
@@ -27,18 +29,36 @@ struct SceneInstance
     uint32_t ModelIndex;
     uint32_t IndexCount;
     uint32_t IndexOffset;
+    uint32_t BaseVertex;
+    uint32_t LodOffset; // Levels past the full-resolution one in the scene LOD buffer
+    uint32_t LodCount;
+    float TransformScale; // Largest axis scale of Transform, LOD errors are in mesh space
+    uint32_t Occluded;    // Hidden from the camera by the CPU occlusion culler, shadow views still draw it
 
-    simd::float3 Min;
+    simd::float3 Min; // Mesh-space bounds, compact positions are quantized within them
     simd::float3 Max;
+    simd::float3 WorldMin;
+    simd::float3 WorldMax;
+    simd::float4x4 Transform;
+};
+
+struct SceneLod
+{
+    uint32_t IndexOffset;
+    uint32_t IndexCount;
+    float Error;
 };
 
 struct SceneModel
 {
     uint64_t VertexBufferID;
     uint64_t IndexBufferID;
+    uint64_t PositionBufferID; // 0 when the model has no position stream
 
     uint32_t InstanceOffset;
     uint32_t InstanceCount;
+    uint32_t VertexFormat;
+    uint32_t IndexFormat;
 };
 
 struct SceneCamera
@@ -62,7 +82,17 @@ struct SceneArgumentBuffer
     uint64_t PointLightBufferID;
     uint64_t CameraBufferID;
     uint64_t SceneTLASID;
+    uint64_t LodBufferID;
 
     uint32_t PointLightCount;
     DirectionalLight DirectionalLight;
 };
+
+// cull_geometry keeps the coarsest LOD whose Error * scale / distance stays <= 1, which is an error of at most
+// thresholdPixels on screen. A threshold of 0 always draws the full-resolution level.
+inline float ComputeLodScale(const simd::float4x4& projection, float viewportHeight, float thresholdPixels)
+{
+    if (thresholdPixels <= 0.0f)
+        return 0.0f;
+    return projection.columns[1][1] * viewportHeight * 0.5f / thresholdPixels;
+}
@@ -23,6 +23,9 @@ public:
     bool GetFreezeICB() const { return m_FreezeICB; }
     void SetFreezeICB(bool freeze) { m_FreezeICB = freeze; }
 
+    float GetLodErrorPixels() const { return m_LodErrorPixels; }
+    void SetLodErrorPixels(float pixels) { m_LodErrorPixels = pixels; }
+
 private:
     void BuildAccelerationStructure(CommandBuffer& cmdBuffer, World& world, Camera& camera);
     void CullInstances(CommandBuffer& cmdBuffer, World& world, Camera& camera);
@@ -33,4 +36,5 @@ private:
     GraphicsPipeline m_Pipeline;
 
     bool m_FreezeICB = false;
+    float m_LodErrorPixels = 1.0f;
 };
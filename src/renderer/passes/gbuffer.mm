@@ -69,7 +69,10 @@ void GBufferPass::CullInstances(CommandBuffer& cmdBuffer, World& world, Camera&
     Plane frustumPlanes[6];
     extract_frustum_planes(camera.GetViewProjectionMatrix(), frustumPlanes);
 
+    float lodScale = ComputeLodScale(camera.GetProjectionMatrix(), ResourceIO::GetTexture(GBUFFER_DEPTH_OUTPUT).Height(), m_LodErrorPixels);
+
     uint instanceCount = world.GetInstanceCount();
+    uint skipOccluded = 1;
     if (instanceCount > 0) {
         ComputeEncoder computeEncoder = cmdBuffer.ComputePass(@"Cull Instances");
         computeEncoder.SetPipeline(m_CullPipeline);
@@ -77,6 +80,8 @@ void GBufferPass::CullInstances(CommandBuffer& cmdBuffer, World& world, Camera&
         computeEncoder.SetBuffer(icb.GetBuffer(), 1);
         computeEncoder.SetBytes(frustumPlanes, sizeof(frustumPlanes), 2);
         computeEncoder.SetBytes(&instanceCount, sizeof(uint), 3);
+        computeEncoder.SetBytes(&lodScale, sizeof(float), 4);
+        computeEncoder.SetBytes(&skipOccluded, sizeof(uint), 5);
         computeEncoder.Dispatch(MTLSizeMake(instanceCount, 1, 1), MTLSizeMake(1, 1, 1));
         computeEncoder.End();
 
@@ -118,4 +123,9 @@ void GBufferPass::RegisterCVars()
     [registry registerBool:@"GBuffer.FreezeICB"
                    pointer:&m_FreezeICB
                displayName:@"Freeze Indirect Command Buffer"];
+    [registry registerFloat:@"GBuffer.LodErrorPixels"
+                    pointer:&m_LodErrorPixels
+                        min:0.0f
+                        max:16.0f
+                displayName:@"LOD Error Threshold (px, 0 = off)"];
 }
@@ -69,6 +69,9 @@ public:
     bool GetUpdateCascades() const { return m_UpdateCascades; }
     void SetUpdateCascades(bool u) { m_UpdateCascades = u; }
 
+    float GetLodErrorPixels() const { return m_LodErrorPixels; }
+    void SetLodErrorPixels(float pixels) { m_LodErrorPixels = pixels; }
+
 private:
     void None(CommandBuffer& cmdBuffer, World& world, Camera& camera);
     void RaytracedHard(CommandBuffer& cmdBuffer, World& world, Camera& camera);
@@ -91,6 +94,7 @@ private:
     ShadowCascade m_Cascades[SHADOW_CASCADE_COUNT];
     float m_SplitLambda = 0.95f;
     bool m_UpdateCascades = true;
+    float m_LodErrorPixels = 2.0f; // Shadow casters can be coarser than what the gbuffer draws
 
     ComputePipeline m_CullCascadesKernel;
     GraphicsPipeline m_DrawCascadesPipeline;
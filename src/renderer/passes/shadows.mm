@@ -104,6 +104,12 @@ void ShadowPass::RegisterCVars()
     [registry registerBool:@"Shadows.UpdateCascades"
                    pointer:&m_UpdateCascades
                displayName:@"Update Cascades"];
+
+    [registry registerFloat:@"Shadows.LodErrorPixels"
+                    pointer:&m_LodErrorPixels
+                        min:0.0f
+                        max:16.0f
+                displayName:@"Caster LOD Error Threshold (px, 0 = off)"];
 }
 
 void ShadowPass::None(CommandBuffer& cmdBuffer, World& world, Camera& camera)
@@ -230,6 +236,8 @@ void ShadowPass::CullCascades(CommandBuffer& cmdBuffer, World& world, Camera& ca
         return;
 
     uint instanceCount = world.GetInstanceCount();
+    // LODs are picked from the main camera so casters match what's on screen
+    float lodScale = ComputeLodScale(camera.GetProjectionMatrix(), ResourceIO::GetTexture(SHADOW_VISIBILITY_OUTPUT).Height(), m_LodErrorPixels);
 
     BlitEncoder resetIcbEncoder = cmdBuffer.BlitPass(@"Reset CSM ICBs");
     for (int i = 0; i < SHADOW_CASCADE_COUNT; i++) {
@@ -242,6 +250,10 @@ void ShadowPass::CullCascades(CommandBuffer& cmdBuffer, World& world, Camera& ca
     computeEncoder.WaitForFence();
     computeEncoder.SetPipeline(m_CullCascadesKernel);
     computeEncoder.SetBytes(&instanceCount, sizeof(uint), 3);
+    computeEncoder.SetBytes(&lodScale, sizeof(float), 4);
+    // Casters hidden from the camera can still shadow what it sees
+    uint skipOccluded = 0;
+    computeEncoder.SetBytes(&skipOccluded, sizeof(uint), 5);
     computeEncoder.SetBuffer(world.GetSceneAB(), 0);
     for (int i = 0; i < SHADOW_CASCADE_COUNT; i++) {
         // Planes
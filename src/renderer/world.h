@@ -4,18 +4,54 @@
 
 #include <simd/quaternion.h>
 #include <simd/simd.h>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 #include "Core/Camera.h"
 #include "Metal/Blas.h"
 #include "Metal/Tlas.h"
 #include "Renderer/Light.h"
+#include "Renderer/OcclusionCuller.h"
 #include "SceneAb.h"
+#include "gltfcompress/SpatialOrder.h"
 
-struct Entity
+// Progress of a model's load. Models added with World::AddModel are Complete or Failed at once.
+enum class ModelLoadState
+{
+    Loading,   // Geometry still decoding on a worker
+    Streaming, // Drawn with placeholders while its textures decode
+    Complete,
+    Failed
+};
+
+struct Entity;
+
+// Geometry, textures and BLASes of one model file, shared by every entity placed from it
+struct ModelAsset
 {
+    std::string Path;
     Model Mesh;
-    BLAS* BLAS;
+    // One BLAS per distinct mesh range of the model's instances, InstanceBLAS maps each instance onto its BLAS
+    std::vector<BLAS*> BLASes;
+    std::vector<uint32_t> InstanceBLAS;
+
+    // Render thread only
+    ModelLoadState State = ModelLoadState::Loading;
+    bool BLASesBuilt = false;
+    std::vector<Entity*> Entities; // Placements in the order they were added
+
+    ~ModelAsset();
+    bool IsDrawable() const { return State == ModelLoadState::Streaming || State == ModelLoadState::Complete; }
+};
+
+// One placement of a model, every instance of the model is drawn with Transform applied on top of its own
+struct Entity
+{
+    ModelAsset* Asset = nullptr;
+    simd::float4x4 Transform = matrix_identity_float4x4;
 };
 
 class World
@@ -27,33 +63,79 @@ public:
     void Prepare();
     void Update(Camera& camera);
 
-    Entity& AddModel(const std::string& modelPath);
+    // Places the model at transform. A model already added from the same file is shared, its geometry, textures and
+    // BLASes are loaded once however many entities place it.
+    Entity& AddModel(const std::string& modelPath, const simd::float4x4& transform = matrix_identity_float4x4);
+    // Same as AddModel but loads a new model on background queues and returns at once. The entity is drawn from the
+    // first Update after the model's buffers and BLASes exist, then its textures replace the placeholders one by one
+    // as they finish decoding.
+    Entity& AddModelAsync(const std::string& modelPath, const simd::float4x4& transform = matrix_identity_float4x4);
+    ModelLoadState GetLoadState(const Entity& entity) const { return entity.Asset->State; }
     std::vector<Entity*>& GetEntities() { return m_Entities; };
 
     LightList& GetLightList() { return m_LightList; }
     Buffer& GetSceneAB() { return m_SceneAB; }
 
     uint GetInstanceCount() const { return (uint)m_SceneInstances.size(); }
+    // Order of each model's scene instances, grouped by material
+    void SetInstanceOrder(SpatialOrder order) { m_InstanceOrder = order; }
     TLAS* GetTLAS() { return &m_TLAS; }
 
+    OcclusionCuller& GetOcclusionCuller() { return m_OcclusionCuller; }
+    uint GetOccludedInstanceCount() const { return m_OccludedInstanceCount; }
+
     DirectionalLight& GetDirectionalLight() { return m_DirectionalLight; }
     Texture& GetSkybox() { return *m_Skybox; }
 
 private:
+    // State of one model loading in the background, shared with its worker blocks which may outlive the world
+    struct AsyncLoad
+    {
+        // The worker fills in its Mesh and BLASes, the render thread only reads them once GeometryDone is set
+        std::shared_ptr<ModelAsset> Asset;
+        std::chrono::steady_clock::time_point StartTime;
+        uint32_t TexturesPending = 0; // Render thread only
+
+        // Written by the workers
+        std::mutex Mutex;
+        bool Cancelled = false;
+        bool GeometryDone = false;
+        bool Loaded = false;
+        std::vector<std::pair<uint32_t, TextureHandle>> ReadyTextures;
+    };
+
+    // The model added from path, nullptr when there is none or it failed to load
+    ModelAsset* FindModel(const std::string& path) const;
+    ModelAsset& CreateModel(const std::string& path);
+    Entity& AddEntity(ModelAsset& asset, const simd::float4x4& transform);
+    // Builds the BLASes of every drawable model that doesn't have them yet
+    void BuildBLASes();
+    void PublishAsyncLoads();
+
     std::vector<Entity*> m_Entities;
+    // Every model in the order it was added, including those still loading or that failed to
+    std::vector<std::shared_ptr<ModelAsset>> m_Models;
+    std::unordered_map<std::string, ModelAsset*> m_ModelLookup;
+    std::vector<std::shared_ptr<AsyncLoad>> m_AsyncLoads; // Loads not yet Complete or Failed
     LightList m_LightList;
 
     SceneArgumentBuffer m_SceneArgumentBuffer;
     std::vector<SceneMaterial> m_SceneMaterials;
     std::vector<SceneModel> m_SceneModels;
     std::vector<SceneInstance> m_SceneInstances;
+    std::vector<SceneLod> m_SceneLods;
+    SpatialOrder m_InstanceOrder = SpatialOrder::Hilbert;
     SceneCamera m_SceneCamera;
+    OcclusionCuller m_OcclusionCuller;
+    uint m_OccludedInstanceCount = 0;
+    uint m_DroppedInstanceCount = 0; // Draws past MAX_SCENE_INSTANCES last frame, warned about when it changes
 
     Buffer m_SceneAB;
     Buffer m_ModelBuffer;
     Buffer m_InstanceBuffer;
     Buffer m_MaterialBuffer;
     Buffer m_CameraBuffer;
+    Buffer m_LodBuffer;
     TLAS m_TLAS;
     DirectionalLight m_DirectionalLight;
     Texture* m_Skybox;
@@ -1,10 +1,98 @@
 #include "World.h"
+#include "Asset/CacheIndex.h"
 #include "Asset/SkyLoader.h"
 #include "Metal/AccelerationEncoder.h"
 #include "Metal/CommandBuffer.h"
+#include "Metal/Device.h"
 #include "Passes/DebugRenderer.h"
+#include "Renderer/ResourceIo.h"
+#include "Core/Logger.h"
+#include "gltfcompress/SpatialOrder.h"
 
 #include <simd/quaternion.h>
+#include <algorithm>
+#include <map>
+#include <fs.h>
+
+// Axis-aligned bounds of a transformed box
+static void TransformBounds(const simd::float4x4& transform, simd::float3 min, simd::float3 max, simd::float3& outMin, simd::float3& outMax)
+{
+    simd::float3 center = (min + max) * 0.5f;
+    simd::float3 extent = (max - min) * 0.5f;
+    simd::float3 worldCenter = simd_mul(transform, simd::make_float4(center, 1.0f)).xyz;
+    simd::float3 worldExtent = simd::abs(transform.columns[0].xyz) * extent.x + simd::abs(transform.columns[1].xyz) * extent.y +
+                               simd::abs(transform.columns[2].xyz) * extent.z;
+    outMin = worldCenter - worldExtent;
+    outMax = worldCenter + worldExtent;
+}
+
+// Sorts instances[first, end) by material, then along a space-filling curve over their world bounds, so culling and
+// the ICB walk neighbouring instances with the same material together
+static void SortInstances(std::vector<SceneInstance>& instances, size_t first, SpatialOrder order)
+{
+    if (order == SpatialOrder::None || instances.size() - first < 2)
+        return;
+
+    simd::float3 boundsMin = instances[first].WorldMin;
+    simd::float3 boundsMax = instances[first].WorldMax;
+    for (size_t i = first; i < instances.size(); i++) {
+        boundsMin = simd::min(boundsMin, instances[i].WorldMin);
+        boundsMax = simd::max(boundsMax, instances[i].WorldMax);
+    }
+
+    std::vector<std::pair<uint64_t, uint32_t>> keys;
+    keys.reserve(instances.size() - first);
+    for (size_t i = first; i < instances.size(); i++) {
+        simd::float3 center = (instances[i].WorldMin + instances[i].WorldMax) * 0.5f;
+        float point[3] = { center.x, center.y, center.z };
+        float lo[3] = { boundsMin.x, boundsMin.y, boundsMin.z };
+        float hi[3] = { boundsMax.x, boundsMax.y, boundsMax.z };
+        uint64_t key = ((uint64_t)instances[i].MaterialID << 32) | GetSpatialCode(order, point, lo, hi);
+        keys.push_back({ key, (uint32_t)i });
+    }
+    std::stable_sort(keys.begin(), keys.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::vector<SceneInstance> sorted;
+    sorted.reserve(keys.size());
+    for (const auto& key : keys)
+        sorted.push_back(instances[key.second]);
+    std::copy(sorted.begin(), sorted.end(), instances.begin() + first);
+}
+
+// Creates one BLAS per distinct mesh range of the model's instances, they still have to be built
+static void CreateBLASes(ModelAsset& asset)
+{
+    // Instances that draw the same mesh range share one BLAS
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> blasIndices;
+    for (const MeshInstance& instance : asset.Mesh.Instances) {
+        auto key = std::make_pair(instance.MeshOffset, instance.MeshCount);
+        auto it = blasIndices.find(key);
+        if (it == blasIndices.end()) {
+            it = blasIndices.emplace(key, (uint32_t)asset.BLASes.size()).first;
+            BLAS* blas = new BLAS(asset.Mesh, instance.MeshOffset, instance.MeshCount);
+            blas->SetLabel([NSString stringWithFormat:@"%s [%u]", asset.Path.c_str(), it->second]);
+            asset.BLASes.push_back(blas);
+        }
+        asset.InstanceBLAS.push_back(it->second);
+    }
+}
+
+// Spellings of the same file share one model
+static std::string ModelKey(const std::string& path)
+{
+    return CacheIndex::CanonicalKey(fs::ResolvePath(path));
+}
+
+static double MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+ModelAsset::~ModelAsset()
+{
+    for (BLAS* blas : BLASes)
+        delete blas;
+}
 
 World::World()
 {
@@ -23,6 +111,9 @@ World::World()
     m_CameraBuffer.Initialize(sizeof(SceneCamera));
     m_CameraBuffer.SetLabel(@"Scene Camera Buffer");
 
+    m_LodBuffer.Initialize(sizeof(SceneLod) * MAX_SCENE_LODS);
+    m_LodBuffer.SetLabel(@"Scene LOD Buffer");
+
     m_TLAS.Initialize();
     m_TLAS.SetLabel(@"Top Level Acceleration Structure");
 
@@ -32,32 +123,105 @@ World::World()
 World::~World()
 {
     delete m_Skybox;
-    for (auto& entity : m_Entities) {
-        delete entity->BLAS;
+    for (auto& entity : m_Entities)
         delete entity;
+
+    // Loads still in flight drop their results, their workers free the models they were loading when they finish
+    for (auto& load : m_AsyncLoads) {
+        std::lock_guard<std::mutex> lock(load->Mutex);
+        load->Cancelled = true;
     }
 }
 
 void World::Prepare()
 {
+    BuildBLASes();
+}
+
+void World::BuildBLASes()
+{
+    std::vector<ModelAsset*> pending;
+    for (auto& asset : m_Models) {
+        if (asset->IsDrawable() && !asset->BLASesBuilt)
+            pending.push_back(asset.get());
+    }
+    if (pending.empty())
+        return;
+
     CommandBuffer cmdBuffer;
 
     AccelerationEncoder encoder = cmdBuffer.AccelerationPass(@"Build BLASes");
-    for (auto& entity : m_Entities) {
-        encoder.BuildBLAS(entity->BLAS);
+    for (ModelAsset* asset : pending) {
+        for (BLAS* blas : asset->BLASes)
+            encoder.BuildBLAS(blas);
     }
     encoder.End();
     // Must wait synchronously here because we're freeing scratch buffers immediately after
     // The scratch buffers are still in use by the GPU during BLAS build
     cmdBuffer.Commit(true);
 
-    for (auto& entity : m_Entities) {
-        entity->BLAS->FreeScratchBuffer();
+    for (ModelAsset* asset : pending) {
+        for (BLAS* blas : asset->BLASes)
+            blas->FreeScratchBuffer();
+        asset->BLASesBuilt = true;
     }
 }
 
+void World::PublishAsyncLoads()
+{
+    bool published = false;
+    bool changed = false;
+    for (auto& load : m_AsyncLoads) {
+        ModelAsset& asset = *load->Asset;
+        std::vector<std::pair<uint32_t, TextureHandle>> ready;
+        {
+            std::lock_guard<std::mutex> lock(load->Mutex);
+            if (asset.State == ModelLoadState::Loading) {
+                if (!load->GeometryDone)
+                    continue;
+                if (!load->Loaded) {
+                    // Entities placing it are never drawn, adding the file again retries
+                    asset.State = ModelLoadState::Failed;
+                    m_ModelLookup.erase(ModelKey(asset.Path));
+                    LOG_ERROR_FMT("Failed to load model %s", asset.Path.c_str());
+                    continue;
+                }
+                load->TexturesPending = (uint32_t)asset.Mesh.Textures.size();
+                asset.State = ModelLoadState::Streaming;
+                published = true;
+                LOG_INFO_FMT("Model %s drawn after %.1f ms in %zu entities, %u textures still loading", asset.Path.c_str(),
+                             MillisecondsSince(load->StartTime), asset.Entities.size(), load->TexturesPending);
+            }
+            ready.swap(load->ReadyTextures);
+        }
+
+        changed = changed || !ready.empty();
+        for (auto& texture : ready)
+            asset.Mesh.SetTexture(texture.first, std::move(texture.second));
+        load->TexturesPending -= (uint32_t)ready.size();
+        if (load->TexturesPending == 0) {
+            asset.State = ModelLoadState::Complete;
+            LOG_INFO_FMT("Model %s complete after %.1f ms", asset.Path.c_str(), MillisecondsSince(load->StartTime));
+            TextureCache::LogStats();
+        }
+    }
+    m_AsyncLoads.erase(std::remove_if(m_AsyncLoads.begin(), m_AsyncLoads.end(),
+                                      [](const std::shared_ptr<AsyncLoad>& load) {
+                                          return load->Asset->State == ModelLoadState::Complete ||
+                                                 load->Asset->State == ModelLoadState::Failed;
+                                      }),
+                       m_AsyncLoads.end());
+
+    if (published)
+        BuildBLASes();
+    // Workers added the new buffers and textures after this frame's commit, they have to be resident before drawing
+    if (changed || published)
+        Device::GetResidencySet().Update();
+}
+
 void World::Update(Camera& camera)
 {
+    PublishAsyncLoads();
     m_LightList.Update();
 
     // Update scene argument buffer
@@ -68,6 +232,7 @@ void World::Update(Camera& camera)
     m_SceneArgumentBuffer.CameraBufferID = m_CameraBuffer.GetResourceID();
     m_SceneArgumentBuffer.MaterialBufferID = m_MaterialBuffer.GetResourceID();
     m_SceneArgumentBuffer.SceneTLASID = m_TLAS.GetResourceID();
+    m_SceneArgumentBuffer.LodBufferID = m_LodBuffer.GetResourceID();
 
     // Update camera buffer
     m_SceneCamera.View = camera.GetViewMatrix();
@@ -84,16 +249,22 @@ void World::Update(Camera& camera)
     m_SceneMaterials.clear();
     m_SceneModels.clear();
     m_SceneInstances.clear();
+    m_SceneLods.clear();
+
+    // Albedo maps still loading, or that failed to, sample white. Normal and ORM maps are left out until they arrive,
+    // neither default texture is a neutral value for them.
+    uint64_t placeholderAlbedoID = ResourceIO::GetTexture(DEFAULT_WHITE).GetResourceID();
 
-    // Material cache: maps (AlbedoID, NormalID, MetallicRoughnessID) to material index
+    // Material cache: maps (AlbedoID, NormalID, MetallicRoughnessID, flags) to material index
     std::unordered_map<uint64_t, uint32_t> materialCache;
 
     // Helper lambda to get or create a material index
-    auto GetOrCreateMaterial = [&](uint64_t albedoID, uint64_t normalID, uint64_t metallicRoughnessID, bool hasAlbedo, bool hasNormal, bool hasMetallicRoughness) -> uint32_t {
+    auto GetOrCreateMaterial = [&](uint64_t albedoID, uint64_t normalID, uint64_t metallicRoughnessID, bool hasAlbedo, bool hasNormal, bool hasMetallicRoughness, bool opaque) -> uint32_t {
         // Create a hash key from the texture IDs and boolean flags
         uint64_t boolFlags = (hasAlbedo ? 1ULL : 0ULL) |
                             (hasNormal ? 2ULL : 0ULL) |
-                            (hasMetallicRoughness ? 4ULL : 0ULL);
+                            (hasMetallicRoughness ? 4ULL : 0ULL) |
+                            (opaque ? 8ULL : 0ULL);
         uint64_t key = albedoID ^ (normalID << 1) ^ (metallicRoughnessID << 2) ^ (boolFlags << 3);
 
         auto it = materialCache.find(key);
@@ -111,6 +282,7 @@ void World::Update(Camera& camera)
         material.HasAlbedo = hasAlbedo;
         material.HasNormal = hasNormal;
         material.HasMetallicRoughness = hasMetallicRoughness;
+        material.Opaque = opaque;
 
         m_SceneMaterials.push_back(material);
         materialCache[key] = materialIndex;
@@ -118,64 +290,130 @@ void World::Update(Camera& camera)
         return materialIndex;
     };
 
-    // Loop over entities and create models with their instances
+    // Loop over models and create their instances for every entity placing them
     m_TLAS.ResetInstanceBuffer();
-    for (const Entity* entity : m_Entities) {
-        const Model& model = entity->Mesh;
-        m_TLAS.AddInstance(entity->BLAS);
+    uint32_t droppedInstances = 0;
+    for (const auto& asset : m_Models) {
+        if (!asset->IsDrawable() || asset->Entities.empty())
+            continue;
+        const Model& model = asset->Mesh;
 
-        // Create a SceneModel for this entity
+        // One SceneModel shared by all the entities, their instances make up its instance range
         uint32_t modelIndex = static_cast<uint32_t>(m_SceneModels.size());
         SceneModel sceneModel;
         sceneModel.VertexBufferID = model.VertexBuffer.GetResourceID();
         sceneModel.IndexBufferID = model.IndexBuffer.GetResourceID();
+        sceneModel.PositionBufferID = model.PositionBuffer.GetResourceID();
         sceneModel.InstanceOffset = static_cast<uint32_t>(m_SceneInstances.size());
-        sceneModel.InstanceCount = static_cast<uint32_t>(model.Meshes.size());
-
-        // Create instances for each mesh (submesh) in the model
-        for (const Mesh& mesh : model.Meshes) {
-            SceneInstance instance;
-            instance.ModelIndex = modelIndex;
-            instance.IndexCount = mesh.IndexCount;
-            instance.IndexOffset = mesh.IndexOffset;
-
-            // Get or create material
-            if (mesh.MaterialIndex >= 0 && mesh.MaterialIndex < model.Materials.size()) {
-                const MeshMaterial& meshMat = model.Materials[mesh.MaterialIndex];
-
-                uint64_t albedoID = 0;
-                uint64_t normalID = 0;
-                uint64_t metallicRoughnessID = 0;
-
-                // Get texture resource IDs
-                if (meshMat.AlbedoIndex >= 0 && meshMat.AlbedoIndex < model.Textures.size() && model.Textures[meshMat.AlbedoIndex].Texture) {
-                    albedoID = model.Textures[meshMat.AlbedoIndex].Texture->GetResourceID();
+        sceneModel.VertexFormat = static_cast<uint32_t>(model.Format);
+        sceneModel.IndexFormat = static_cast<uint32_t>(model.IndexType);
+
+        // Create a scene instance for each mesh (submesh) of every model instance
+        for (const Entity* entity : asset->Entities) {
+            for (size_t i = 0; i < model.Instances.size(); i++) {
+                const MeshInstance& meshInstance = model.Instances[i];
+                simd::float4x4 transform = simd_mul(entity->Transform, meshInstance.Transform);
+                m_TLAS.AddInstance(asset->BLASes[asset->InstanceBLAS[i]], transform);
+
+                float transformScale = simd::reduce_max(simd::make_float3(simd::length(transform.columns[0].xyz),
+                                                                          simd::length(transform.columns[1].xyz),
+                                                                          simd::length(transform.columns[2].xyz)));
+
+                for (uint32_t meshIndex = meshInstance.MeshOffset; meshIndex < meshInstance.MeshOffset + meshInstance.MeshCount; meshIndex++) {
+                    if (m_SceneInstances.size() >= MAX_SCENE_INSTANCES) {
+                        droppedInstances++;
+                        continue;
+                    }
+
+                    const Mesh& mesh = model.Meshes[meshIndex];
+                    SceneInstance instance;
+                    instance.ModelIndex = modelIndex;
+                    instance.IndexCount = mesh.IndexCount;
+                    instance.IndexOffset = mesh.IndexOffset;
+                    instance.BaseVertex = mesh.VertexOffset;
+
+                    // Level 0 is the instance's own index range, only the coarser ones go in the LOD buffer
+                    instance.LodOffset = static_cast<uint32_t>(m_SceneLods.size());
+                    instance.LodCount = 0;
+                    for (uint32_t l = 1; l < mesh.LodCount && m_SceneLods.size() < MAX_SCENE_LODS; l++) {
+                        m_SceneLods.push_back({ mesh.Lods[l].IndexOffset, mesh.Lods[l].IndexCount, mesh.Lods[l].Error });
+                        instance.LodCount++;
+                    }
+
+                    // Get or create material
+                    if (mesh.MaterialIndex >= 0 && mesh.MaterialIndex < model.Materials.size()) {
+                        const MeshMaterial& meshMat = model.Materials[mesh.MaterialIndex];
+
+                        uint64_t albedoID = 0;
+                        uint64_t normalID = 0;
+                        uint64_t metallicRoughnessID = 0;
+
+                        // Get texture resource IDs
+                        if (meshMat.AlbedoIndex >= 0 && meshMat.AlbedoIndex < model.Textures.size() && model.Textures[meshMat.AlbedoIndex].Texture) {
+                            albedoID = model.Textures[meshMat.AlbedoIndex].Texture.GetResourceID();
+                        }
+                        if (meshMat.NormalIndex >= 0 && meshMat.NormalIndex < model.Textures.size() && model.Textures[meshMat.NormalIndex].Texture) {
+                            normalID = model.Textures[meshMat.NormalIndex].Texture.GetResourceID();
+                        }
+                        if (meshMat.PBRIndex >= 0 && meshMat.PBRIndex < model.Textures.size() && model.Textures[meshMat.PBRIndex].Texture) {
+                            metallicRoughnessID = model.Textures[meshMat.PBRIndex].Texture.GetResourceID();
+                        }
+
+                        bool hasAlbedo = meshMat.AlbedoIndex != -1;
+                        bool hasNormal = normalID != 0;
+                        bool hasMetallicRoughness = metallicRoughnessID != 0;
+                        if (hasAlbedo && albedoID == 0)
+                            albedoID = placeholderAlbedoID;
+
+                        instance.MaterialID = GetOrCreateMaterial(albedoID, normalID, metallicRoughnessID, hasAlbedo, hasNormal, hasMetallicRoughness, meshMat.Opaque);
+                    } else {
+                        instance.MaterialID = GetOrCreateMaterial(0, 0, 0, false, false, false, true);
+                    }
+                    instance.Min = mesh.Min;
+                    instance.Max = mesh.Max;
+                    instance.Transform = transform;
+                    instance.TransformScale = transformScale;
+                    TransformBounds(transform, mesh.Min, mesh.Max, instance.WorldMin, instance.WorldMax);
+
+                    m_SceneInstances.push_back(instance);
                 }
-                if (meshMat.NormalIndex >= 0 && meshMat.NormalIndex < model.Textures.size() && model.Textures[meshMat.NormalIndex].Texture) {
-                    normalID = model.Textures[meshMat.NormalIndex].Texture->GetResourceID();
-                }
-                if (meshMat.PBRIndex >= 0 && meshMat.PBRIndex < model.Textures.size() && model.Textures[meshMat.PBRIndex].Texture) {
-                    metallicRoughnessID = model.Textures[meshMat.PBRIndex].Texture->GetResourceID();
-                }
-
-                bool hasAlbedo = meshMat.AlbedoIndex != -1;
-                bool hasNormal = meshMat.NormalIndex != -1;
-                bool hasMetallicRoughness = meshMat.PBRIndex != -1;
-
-                instance.MaterialID = GetOrCreateMaterial(albedoID, normalID, metallicRoughnessID, hasAlbedo, hasNormal, hasMetallicRoughness);
-            } else {
-                instance.MaterialID = GetOrCreateMaterial(0, 0, 0, false, false, false);
             }
-            instance.Min = mesh.Min;
-            instance.Max = mesh.Max;
-
-            m_SceneInstances.push_back(instance);
         }
+        // Models keep their instance range, the order only changes within it
+        SortInstances(m_SceneInstances, sceneModel.InstanceOffset, m_InstanceOrder);
+        sceneModel.InstanceCount = static_cast<uint32_t>(m_SceneInstances.size()) - sceneModel.InstanceOffset;
 
         m_SceneModels.push_back(sceneModel);
     }
     m_TLAS.Update();
 
+    if (droppedInstances != m_DroppedInstanceCount && droppedInstances > 0)
+        LOG_WARNING_FMT("Scene instance buffer is full, %u draws past %d are not rendered", droppedInstances, MAX_SCENE_INSTANCES);
+    m_DroppedInstanceCount = droppedInstances;
+
+    // Flag instances behind the occluder boxes, after sorting so the flags stay with their instances
+    m_OccludedInstanceCount = 0;
+    if (m_OcclusionCuller.Enabled) {
+        m_OcclusionCuller.Begin(m_SceneCamera.ViewProjection);
+        for (const Entity* entity : m_Entities) {
+            if (!entity->Asset->IsDrawable())
+                continue;
+            const Model& model = entity->Asset->Mesh;
+            for (const MeshInstance& meshInstance : model.Instances) {
+                auto first = std::lower_bound(model.Occluders.begin(), model.Occluders.end(), meshInstance.MeshOffset,
+                                              [](const MeshOccluder& occluder, uint32_t mesh) { return occluder.MeshIndex < mesh; });
+                simd::float4x4 transform = simd_mul(entity->Transform, meshInstance.Transform);
+                for (auto it = first; it != model.Occluders.end() && it->MeshIndex < meshInstance.MeshOffset + meshInstance.MeshCount; ++it)
+                    m_OcclusionCuller.AddOccluder(transform, it->Min, it->Max);
+            }
+        }
+        m_OcclusionCuller.End();
+    }
+    for (SceneInstance& instance : m_SceneInstances) {
+        instance.Occluded = m_OcclusionCuller.Enabled && m_OcclusionCuller.IsOccluded(instance.WorldMin, instance.WorldMax);
+        m_OccludedInstanceCount += instance.Occluded;
+    }
+
     // Update sun
     m_SceneArgumentBuffer.DirectionalLight = m_DirectionalLight;
 
@@ -186,6 +424,9 @@ void World::Update(Camera& camera)
     if (!m_SceneInstances.empty()) {
         m_InstanceBuffer.Write(m_SceneInstances.data(), sizeof(SceneInstance) * m_SceneInstances.size());
     }
+    if (!m_SceneLods.empty()) {
+        m_LodBuffer.Write(m_SceneLods.data(), sizeof(SceneLod) * m_SceneLods.size());
+    }
     if (!m_SceneMaterials.empty()) {
         m_MaterialBuffer.Write(m_SceneMaterials.data(), sizeof(SceneMaterial) * m_SceneMaterials.size());
     }
@@ -193,13 +434,92 @@ void World::Update(Camera& camera)
     m_SceneAB.Write(&m_SceneArgumentBuffer, sizeof(SceneArgumentBuffer));
 }
 
-Entity& World::AddModel(const std::string& path)
+ModelAsset* World::FindModel(const std::string& path) const
+{
+    auto it = m_ModelLookup.find(ModelKey(path));
+    return it != m_ModelLookup.end() ? it->second : nullptr;
+}
+
+ModelAsset& World::CreateModel(const std::string& path)
+{
+    std::shared_ptr<ModelAsset> asset = std::make_shared<ModelAsset>();
+    asset->Path = path;
+    m_Models.push_back(asset);
+    m_ModelLookup[ModelKey(path)] = asset.get();
+    return *asset;
+}
+
+Entity& World::AddEntity(ModelAsset& asset, const simd::float4x4& transform)
 {
     Entity* entity = new Entity;
-    entity->Mesh.Load(path);
-    entity->BLAS = new BLAS(entity->Mesh);
-    entity->BLAS->SetLabel([NSString stringWithUTF8String:path.c_str()]);
+    entity->Asset = &asset;
+    entity->Transform = transform;
+    asset.Entities.push_back(entity);
 
     m_Entities.push_back(entity);
-    return *m_Entities.back();
+    return *entity;
+}
+
+Entity& World::AddModel(const std::string& path, const simd::float4x4& transform)
+{
+    ModelAsset* asset = FindModel(path);
+    if (!asset) {
+        asset = &CreateModel(path);
+        if (asset->Mesh.Load(path)) {
+            CreateBLASes(*asset);
+            asset->State = ModelLoadState::Complete;
+        } else {
+            asset->State = ModelLoadState::Failed;
+            m_ModelLookup.erase(ModelKey(path));
+        }
+    }
+    return AddEntity(*asset, transform);
+}
+
+Entity& World::AddModelAsync(const std::string& path, const simd::float4x4& transform)
+{
+    // Shares the model when it is already loaded or still loading
+    if (ModelAsset* asset = FindModel(path))
+        return AddEntity(*asset, transform);
+
+    ModelAsset& asset = CreateModel(path);
+    std::shared_ptr<AsyncLoad> load = std::make_shared<AsyncLoad>();
+    load->Asset = m_Models.back();
+    load->StartTime = std::chrono::steady_clock::now();
+    m_AsyncLoads.push_back(load);
+
+    dispatch_queue_t queue = dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0);
+    dispatch_async(queue, ^{
+        ModelAsset& loading = *load->Asset;
+        bool loaded = loading.Mesh.Load(loading.Path, true);
+        if (loaded)
+            CreateBLASes(loading);
+
+        // Copied before publishing, the render thread owns the model from then on
+        std::vector<MeshTexture> textures = loaded ? loading.Mesh.Textures : std::vector<MeshTexture>();
+        {
+            std::lock_guard<std::mutex> lock(load->Mutex);
+            load->GeometryDone = true;
+            load->Loaded = loaded;
+            if (load->Cancelled)
+                return;
+        }
+
+        // Each texture decodes in its own block, the render thread picks them up one by one
+        for (uint32_t i = 0; i < textures.size(); i++) {
+            MeshTexture texture = textures[i];
+            dispatch_async(queue, ^{
+                {
+                    std::lock_guard<std::mutex> lock(load->Mutex);
+                    if (load->Cancelled)
+                        return;
+                }
+                TextureHandle handle = Model::LoadTexture(texture);
+                std::lock_guard<std::mutex> lock(load->Mutex);
+                load->ReadyTextures.push_back({ i, std::move(handle) });
+            });
+        }
+    });
+
+    return AddEntity(asset, transform);
 }
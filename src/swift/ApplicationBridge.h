@@ -47,6 +47,7 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic) NSInteger shadowResolution;
 @property (nonatomic) float shadowSplitLambda;
 @property (nonatomic) BOOL shadowUpdateCascades;
+@property (nonatomic) float shadowLodErrorPixels;
 
 // Deferred pass settings
 @property (nonatomic) BOOL deferredShowHeatmap;
@@ -57,6 +58,7 @@ NS_ASSUME_NONNULL_BEGIN
 
 // GBuffer pass settings
 @property (nonatomic) BOOL gbufferFreezeICB;
+@property (nonatomic) float gbufferLodErrorPixels;
 
 // Tonemap pass settings
 @property (nonatomic) float tonemapGamma;
@@ -210,6 +210,19 @@
     }
 }
 
+- (float)shadowLodErrorPixels {
+    if (auto* pass = _application->GetRenderer()->GetPass<ShadowPass>()) {
+        return pass->GetLodErrorPixels();
+    }
+    return 2.0f;
+}
+
+- (void)setShadowLodErrorPixels:(float)pixels {
+    if (auto* pass = _application->GetRenderer()->GetPass<ShadowPass>()) {
+        pass->SetLodErrorPixels(pixels);
+    }
+}
+
 #pragma mark - Deferred Pass
 
 - (BOOL)deferredShowHeatmap {
@@ -255,6 +268,19 @@
     }
 }
 
+- (float)gbufferLodErrorPixels {
+    if (auto* pass = _application->GetRenderer()->GetPass<GBufferPass>()) {
+        return pass->GetLodErrorPixels();
+    }
+    return 1.0f;
+}
+
+- (void)setGbufferLodErrorPixels:(float)pixels {
+    if (auto* pass = _application->GetRenderer()->GetPass<GBufferPass>()) {
+        pass->SetLodErrorPixels(pixels);
+    }
+}
+
 #pragma mark - Tonemap Pass
 
 - (float)tonemapGamma {
@@ -95,7 +95,10 @@ struct FrameRecord {
     entry.bytes = bytes;
     entry.type = type;
     entry.heapType = heapType;
-    _allocations[name.UTF8String] = entry;
+    // Resources are created on loader threads too
+    @synchronized (self) {
+        _allocations[name.UTF8String] = entry;
+    }
 }
 
 - (void)trackAllocation:(NSString*)name
@@ -126,19 +129,23 @@ struct FrameRecord {
 }
 
 - (void)removeAllocation:(NSString*)name {
-    _allocations.erase(name.UTF8String);
+    @synchronized (self) {
+        _allocations.erase(name.UTF8String);
+    }
 }
 
 - (NSArray<NSDictionary*>*)allAllocations {
     NSMutableArray* result = [NSMutableArray array];
     
-    for (const auto& pair : _allocations) {
-        [result addObject:@{
-            @"name": pair.second.name,
-            @"bytes": @(pair.second.bytes),
-            @"type": @(pair.second.type),
-            @"heapType": @(pair.second.heapType)
-        }];
+    @synchronized (self) {
+        for (const auto& pair : _allocations) {
+            [result addObject:@{
+                @"name": pair.second.name,
+                @"bytes": @(pair.second.bytes),
+                @"type": @(pair.second.type),
+                @"heapType": @(pair.second.heapType)
+            }];
+        }
     }
     
     // Sort by size descending
@@ -151,8 +158,10 @@ struct FrameRecord {
 
 - (size_t)totalMemoryUsed {
     size_t total = 0;
-    for (const auto& pair : _allocations) {
-        total += pair.second.bytes;
+    @synchronized (self) {
+        for (const auto& pair : _allocations) {
+            total += pair.second.bytes;
+        }
     }
     return total;
 }
@@ -160,10 +169,12 @@ struct FrameRecord {
 - (NSDictionary<NSNumber*, NSNumber*>*)memoryByType {
     NSMutableDictionary* result = [NSMutableDictionary dictionary];
     
-    for (const auto& pair : _allocations) {
-        NSNumber* typeKey = @(pair.second.type);
-        NSNumber* current = result[typeKey] ?: @0;
-        result[typeKey] = @(current.unsignedLongLongValue + pair.second.bytes);
+    @synchronized (self) {
+        for (const auto& pair : _allocations) {
+            NSNumber* typeKey = @(pair.second.type);
+            NSNumber* current = result[typeKey] ?: @0;
+            result[typeKey] = @(current.unsignedLongLongValue + pair.second.bytes);
+        }
     }
     
     return result;
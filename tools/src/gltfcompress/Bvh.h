@@ -0,0 +1,78 @@
+//
+// Binned SAH BVH over submesh triangles, collapsed to 4-wide nodes for the runtime CPU ray queries
+//
+
+#pragma once
+
+#include "JobPool.h"
+#include "MeshTypes.h"
+
+#include <cfloat>
+#include <vector>
+
+static const u32 kBvhWidth = 4;
+static const u32 kBvhBins = 16;
+// Leaves hold at most this many triangles, a leaf's count has to fit the low 8 bits of L_BvhNode::Leaf
+static const u32 kBvhMaxLeafTriangles = 8;
+static const u32 kBvhEmpty = 0xFFFFFFFFu;
+// Rays cast against the BVH and brute force to validate it
+static const u32 kBvhValidationRays = 256;
+
+struct BvhBuildStats
+{
+    u32 Nodes = 0;
+    u32 Leaves = 0;
+    u32 Triangles = 0;
+    u32 MaxDepth = 0;
+    float SahCost = 0.0f; // Expected node visits + triangle tests for a random ray, relative to the root
+};
+
+// Builds a BVH over the triangles of submeshes [submeshOffset, submeshOffset + submeshCount), appending its nodes and
+// triangle references to the shared tables. Returns the root node index.
+u32 BuildBvh(const std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices, const std::vector<L_SubmeshData>& submeshes,
+             u32 submeshOffset, u32 submeshCount, JobPool& pool, std::vector<L_BvhNode>& nodes, std::vector<u32>& triangles,
+             BvhBuildStats& stats);
+
+// A BVH built on its own and already moved to its place in the node table, with the bounds of its root
+struct BvhSubtree
+{
+    u32 RootNode = 0;
+    vec3 Min = vec3(FLT_MAX);
+    vec3 Max = vec3(-FLT_MAX);
+};
+
+// Union of a node's occupied slots, empty (min > max) when it has none
+void GetBvhNodeBounds(const L_BvhNode& node, vec3& outMin, vec3& outMax);
+
+// Nodes JoinBvhs puts above subtreeCount subtrees, 0 for a single one
+u32 CountBvhJoinNodes(u32 subtreeCount);
+
+// Joins separately built BVHs under CountBvhJoinNodes(subtrees.size()) new nodes numbered from firstNode, root first so
+// firstNode is the root of the whole range. Subtrees are grouped along a Hilbert curve through their centers.
+std::vector<L_BvhNode> JoinBvhs(const std::vector<BvhSubtree>& subtrees, u32 firstNode);
+
+struct BvhRayHit
+{
+    float Distance = 0.0f;
+    u32 Triangle = 0; // IndexOffset / 3
+    u32 Submesh = 0;
+};
+
+// Closest hit along origin + t * direction for t in [0, maxDistance], two-sided
+bool IntersectBvh(const std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices, const std::vector<L_BvhNode>& nodes,
+                  const std::vector<u32>& triangles, u32 rootNode, const vec3& origin, const vec3& direction, float maxDistance,
+                  BvhRayHit& outHit);
+
+struct BvhValidationStats
+{
+    u32 Rays = 0;
+    u32 Hits = 0;
+    u32 Mismatches = 0;       // Rays where the BVH and brute force disagree
+    uint64_t NodesVisited = 0;
+    u32 Errors = 0;           // Structural: triangles missing, duplicated, outside their leaf bounds or in the wrong submesh
+};
+
+// Checks every root's structure, then casts rayCount rays per root through it and against every triangle
+BvhValidationStats ValidateBvh(const std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices,
+                               const std::vector<L_SubmeshData>& submeshes, const std::vector<L_BvhRootData>& roots,
+                               const std::vector<L_BvhNode>& nodes, const std::vector<u32>& triangles, u32 rayCount, JobPool& pool);
@@ -0,0 +1,691 @@
+#include "Bvh.h"
+#include "SpatialOrder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <mutex>
+
+// Subtrees below this many triangles are built on the calling thread
+static const u32 kBvhParallelSubtree = 4096;
+// Nodes above this many triangles split their binning across the pool
+static const u32 kBvhParallelBinning = 65536;
+// Cost of visiting a 4-wide node relative to one triangle test, high enough that leaves fill up instead of
+// spending 128 bytes of node on every pair of triangles
+static const float kBvhTraversalCost = 3.0f;
+
+struct BvhBounds
+{
+    vec3 Min = vec3(FLT_MAX);
+    vec3 Max = vec3(-FLT_MAX);
+
+    void Grow(const vec3& p)
+    {
+        Min = minVec3(Min, p);
+        Max = maxVec3(Max, p);
+    }
+
+    void Grow(const BvhBounds& b)
+    {
+        Min = minVec3(Min, b.Min);
+        Max = maxVec3(Max, b.Max);
+    }
+
+    float Area() const
+    {
+        if (Min.x > Max.x)
+            return 0.0f;
+        vec3 e = Max - Min;
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+};
+
+struct BvhPrimitive
+{
+    BvhBounds Bounds;
+    vec3 Centroid;
+    u32 Triangle;
+    u32 Submesh;
+};
+
+// Binary node built first, Count > 0 marks a leaf over primitives [First, First + Count)
+struct BinaryNode
+{
+    BvhBounds Bounds;
+    u32 Left = 0;
+    u32 Right = 0;
+    u32 First = 0;
+    u32 Count = 0;
+};
+
+struct BvhBin
+{
+    BvhBounds Bounds;
+    u32 Count = 0;
+};
+
+static float Component(const vec3& v, u32 axis)
+{
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+class BvhBuilder
+{
+public:
+    BvhBuilder(std::vector<BvhPrimitive>& primitives, JobPool& pool)
+        : m_Primitives(primitives)
+        , m_Pool(pool)
+        , m_Nodes(std::max<size_t>(1, primitives.size() * 2))
+    {
+    }
+
+    void Build()
+    {
+        m_NodeCount = 1;
+        Build(0, 0, (u32)m_Primitives.size(), 1);
+    }
+
+    const std::vector<BinaryNode>& GetNodes() const { return m_Nodes; }
+    u32 GetMaxDepth() const { return m_MaxDepth; }
+
+private:
+    struct Split
+    {
+        u32 Axis = 0;
+        u32 Bin = 0;
+        float Cost = FLT_MAX;
+    };
+
+    void BinRange(u32 begin, u32 end, const BvhBounds& centroidBounds, const vec3& scale, BvhBin (&bins)[3][kBvhBins]) const
+    {
+        for (u32 i = begin; i < end; ++i) {
+            const BvhPrimitive& p = m_Primitives[i];
+            for (u32 axis = 0; axis < 3; ++axis) {
+                float s = Component(scale, axis);
+                if (s <= 0.0f)
+                    continue;
+                u32 bin = std::min(kBvhBins - 1, (u32)((Component(p.Centroid, axis) - Component(centroidBounds.Min, axis)) * s));
+                bins[axis][bin].Bounds.Grow(p.Bounds);
+                bins[axis][bin].Count++;
+            }
+        }
+    }
+
+    Split FindSplit(u32 first, u32 count, const BvhBounds& bounds, const BvhBounds& centroidBounds) const
+    {
+        vec3 extent = centroidBounds.Max - centroidBounds.Min;
+        vec3 scale(extent.x > 1e-12f ? kBvhBins / extent.x : 0.0f, extent.y > 1e-12f ? kBvhBins / extent.y : 0.0f,
+                   extent.z > 1e-12f ? kBvhBins / extent.z : 0.0f);
+
+        BvhBin bins[3][kBvhBins];
+        if (count > kBvhParallelBinning) {
+            std::mutex mergeMutex;
+            m_Pool.ParallelFor(count, kBvhParallelBinning / 4, [&](size_t begin, size_t end) {
+                BvhBin local[3][kBvhBins];
+                BinRange(first + (u32)begin, first + (u32)end, centroidBounds, scale, local);
+                std::lock_guard<std::mutex> lock(mergeMutex);
+                for (u32 axis = 0; axis < 3; ++axis) {
+                    for (u32 b = 0; b < kBvhBins; ++b) {
+                        bins[axis][b].Bounds.Grow(local[axis][b].Bounds);
+                        bins[axis][b].Count += local[axis][b].Count;
+                    }
+                }
+            });
+        } else {
+            BinRange(first, first + count, centroidBounds, scale, bins);
+        }
+
+        Split best;
+        float parentArea = std::max(bounds.Area(), 1e-20f);
+        for (u32 axis = 0; axis < 3; ++axis) {
+            if (Component(scale, axis) <= 0.0f)
+                continue;
+
+            // Right-to-left sweep for the right side, then left-to-right to evaluate every plane between bins
+            float rightArea[kBvhBins];
+            u32 rightCount[kBvhBins];
+            BvhBounds accumulated;
+            u32 accumulatedCount = 0;
+            for (u32 b = kBvhBins - 1; b > 0; --b) {
+                accumulated.Grow(bins[axis][b].Bounds);
+                accumulatedCount += bins[axis][b].Count;
+                rightArea[b] = accumulated.Area();
+                rightCount[b] = accumulatedCount;
+            }
+
+            accumulated = BvhBounds();
+            accumulatedCount = 0;
+            for (u32 b = 0; b < kBvhBins - 1; ++b) {
+                accumulated.Grow(bins[axis][b].Bounds);
+                accumulatedCount += bins[axis][b].Count;
+                if (accumulatedCount == 0 || rightCount[b + 1] == 0)
+                    continue;
+                float cost = kBvhTraversalCost +
+                             (accumulated.Area() * accumulatedCount + rightArea[b + 1] * rightCount[b + 1]) / parentArea;
+                if (cost < best.Cost) {
+                    best.Axis = axis;
+                    best.Bin = b;
+                    best.Cost = cost;
+                }
+            }
+        }
+        return best;
+    }
+
+    void Build(u32 nodeIndex, u32 first, u32 count, u32 depth)
+    {
+        BvhBounds bounds;
+        BvhBounds centroidBounds;
+        bool singleSubmesh = true;
+        for (u32 i = first; i < first + count; ++i) {
+            bounds.Grow(m_Primitives[i].Bounds);
+            centroidBounds.Grow(m_Primitives[i].Centroid);
+            singleSubmesh = singleSubmesh && m_Primitives[i].Submesh == m_Primitives[first].Submesh;
+        }
+
+        BinaryNode& node = m_Nodes[nodeIndex];
+        node.Bounds = bounds;
+
+        u32 previousDepth = m_MaxDepth.load();
+        while (depth > previousDepth && !m_MaxDepth.compare_exchange_weak(previousDepth, depth)) {
+        }
+
+        if (count <= 1) {
+            node.First = first;
+            node.Count = count;
+            return;
+        }
+
+        Split split = FindSplit(first, count, bounds, centroidBounds);
+        float leafCost = (float)count;
+        if (singleSubmesh && count <= kBvhMaxLeafTriangles && leafCost <= split.Cost) {
+            node.First = first;
+            node.Count = count;
+            return;
+        }
+
+        BvhPrimitive* begin = m_Primitives.data() + first;
+        BvhPrimitive* end = begin + count;
+        BvhPrimitive* middle = begin;
+        if (split.Cost < FLT_MAX) {
+            float minimum = Component(centroidBounds.Min, split.Axis);
+            float scale = kBvhBins / (Component(centroidBounds.Max, split.Axis) - minimum);
+            middle = std::partition(begin, end, [&](const BvhPrimitive& p) {
+                return std::min(kBvhBins - 1, (u32)((Component(p.Centroid, split.Axis) - minimum) * scale)) <= split.Bin;
+            });
+        }
+
+        // Coincident centroids: separate submeshes first so leaves stay within one, then halve
+        if (middle == begin || middle == end) {
+            if (!singleSubmesh) {
+                u32 submesh = begin->Submesh;
+                middle = std::partition(begin, end, [&](const BvhPrimitive& p) { return p.Submesh == submesh; });
+            } else {
+                middle = begin + count / 2;
+            }
+        }
+
+        u32 leftCount = (u32)(middle - begin);
+        u32 left = m_NodeCount.fetch_add(2);
+        node.Left = left;
+        node.Right = left + 1;
+
+        if (count > kBvhParallelSubtree) {
+            JobCounter counter;
+            m_Pool.Submit(counter, [this, left, first, leftCount, depth] { Build(left, first, leftCount, depth + 1); });
+            Build(left + 1, first + leftCount, count - leftCount, depth + 1);
+            m_Pool.Wait(counter);
+        } else {
+            Build(left, first, leftCount, depth + 1);
+            Build(left + 1, first + leftCount, count - leftCount, depth + 1);
+        }
+    }
+
+    std::vector<BvhPrimitive>& m_Primitives;
+    JobPool& m_Pool;
+    std::vector<BinaryNode> m_Nodes;
+    std::atomic<u32> m_NodeCount{0};
+    std::atomic<u32> m_MaxDepth{0};
+};
+
+static void SetEmptySlot(L_BvhNode& node, u32 slot)
+{
+    node.MinX[slot] = node.MinY[slot] = node.MinZ[slot] = FLT_MAX;
+    node.MaxX[slot] = node.MaxY[slot] = node.MaxZ[slot] = -FLT_MAX;
+    node.Child[slot] = kBvhEmpty;
+    node.Leaf[slot] = 0;
+}
+
+// Pulls grandchildren up until the node has kBvhWidth children, opening the largest inner child first
+// Pushes a bound outwards a little, so a ray lying exactly in the plane of a face (a ground plane at y = 0 cast along
+// it) isn't rejected by the 0 * inf of its slab test
+static float PadBound(float value, float direction)
+{
+    return value + direction * (std::abs(value) * 1e-6f + 1e-7f);
+}
+
+static u32 CollapseNode(const std::vector<BinaryNode>& binary, const std::vector<BvhPrimitive>& primitives, u32 binaryIndex,
+                        u32 triangleBase, float rootArea, std::vector<L_BvhNode>& nodes, BvhBuildStats& stats)
+{
+    u32 children[kBvhWidth];
+    u32 childCount = 0;
+    const BinaryNode& source = binary[binaryIndex];
+    if (source.Count > 0) {
+        children[childCount++] = binaryIndex;
+    } else {
+        children[childCount++] = source.Left;
+        children[childCount++] = source.Right;
+        while (childCount < kBvhWidth) {
+            int open = -1;
+            float openArea = -1.0f;
+            for (u32 i = 0; i < childCount; ++i) {
+                const BinaryNode& child = binary[children[i]];
+                if (child.Count == 0 && child.Bounds.Area() > openArea) {
+                    open = (int)i;
+                    openArea = child.Bounds.Area();
+                }
+            }
+            if (open < 0)
+                break;
+            u32 opened = children[open];
+            children[open] = binary[opened].Left;
+            children[childCount++] = binary[opened].Right;
+        }
+    }
+
+    u32 nodeIndex = (u32)nodes.size();
+    nodes.push_back(L_BvhNode{});
+    for (u32 slot = 0; slot < kBvhWidth; ++slot)
+        SetEmptySlot(nodes[nodeIndex], slot);
+    stats.Nodes++;
+    stats.SahCost += kBvhTraversalCost * source.Bounds.Area() / rootArea;
+
+    for (u32 slot = 0; slot < childCount; ++slot) {
+        const BinaryNode& child = binary[children[slot]];
+        u32 childIndex;
+        u32 leaf = 0;
+        if (child.Count > 0) {
+            childIndex = triangleBase + child.First;
+            leaf = child.Count | (primitives[child.First].Submesh << 8);
+            stats.Leaves++;
+            stats.SahCost += child.Count * child.Bounds.Area() / rootArea;
+        } else {
+            childIndex = CollapseNode(binary, primitives, children[slot], triangleBase, rootArea, nodes, stats);
+        }
+
+        // Recursion may have grown the node table, index again
+        L_BvhNode& node = nodes[nodeIndex];
+        node.MinX[slot] = PadBound(child.Bounds.Min.x, -1.0f);
+        node.MinY[slot] = PadBound(child.Bounds.Min.y, -1.0f);
+        node.MinZ[slot] = PadBound(child.Bounds.Min.z, -1.0f);
+        node.MaxX[slot] = PadBound(child.Bounds.Max.x, 1.0f);
+        node.MaxY[slot] = PadBound(child.Bounds.Max.y, 1.0f);
+        node.MaxZ[slot] = PadBound(child.Bounds.Max.z, 1.0f);
+        node.Child[slot] = childIndex;
+        node.Leaf[slot] = leaf;
+    }
+    return nodeIndex;
+}
+
+u32 BuildBvh(const std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices, const std::vector<L_SubmeshData>& submeshes,
+             u32 submeshOffset, u32 submeshCount, JobPool& pool, std::vector<L_BvhNode>& nodes, std::vector<u32>& triangles,
+             BvhBuildStats& stats)
+{
+    std::vector<BvhPrimitive> primitives;
+    for (u32 s = submeshOffset; s < submeshOffset + submeshCount; ++s) {
+        for (u32 i = submeshes[s].IndexOffset; i + 2 < submeshes[s].IndexOffset + submeshes[s].IndexCount; i += 3) {
+            BvhPrimitive p;
+            for (u32 k = 0; k < 3; ++k)
+                p.Bounds.Grow(vertices[indices[i + k]].Position);
+            p.Centroid = (p.Bounds.Min + p.Bounds.Max) * 0.5f;
+            p.Triangle = i / 3;
+            p.Submesh = s;
+            primitives.push_back(p);
+        }
+    }
+
+    u32 triangleBase = (u32)triangles.size();
+    if (primitives.empty()) {
+        u32 root = (u32)nodes.size();
+        nodes.push_back(L_BvhNode{});
+        for (u32 slot = 0; slot < kBvhWidth; ++slot)
+            SetEmptySlot(nodes[root], slot);
+        stats.Nodes++;
+        return root;
+    }
+
+    BvhBuilder builder(primitives, pool);
+    builder.Build();
+
+    for (const BvhPrimitive& p : primitives)
+        triangles.push_back(p.Triangle);
+    stats.Triangles += (u32)primitives.size();
+    stats.MaxDepth = std::max(stats.MaxDepth, builder.GetMaxDepth());
+
+    const std::vector<BinaryNode>& binary = builder.GetNodes();
+    float rootArea = std::max(binary[0].Bounds.Area(), 1e-20f);
+    return CollapseNode(binary, primitives, 0, triangleBase, rootArea, nodes, stats);
+}
+
+void GetBvhNodeBounds(const L_BvhNode& node, vec3& outMin, vec3& outMax)
+{
+    outMin = vec3(FLT_MAX);
+    outMax = vec3(-FLT_MAX);
+    for (u32 slot = 0; slot < kBvhWidth; ++slot) {
+        if (node.Child[slot] == kBvhEmpty)
+            continue;
+        outMin = minVec3(outMin, vec3(node.MinX[slot], node.MinY[slot], node.MinZ[slot]));
+        outMax = maxVec3(outMax, vec3(node.MaxX[slot], node.MaxY[slot], node.MaxZ[slot]));
+    }
+}
+
+u32 CountBvhJoinNodes(u32 subtreeCount)
+{
+    u32 nodes = 0;
+    while (subtreeCount > 1) {
+        subtreeCount = (subtreeCount + kBvhWidth - 1) / kBvhWidth;
+        nodes += subtreeCount;
+    }
+    return nodes;
+}
+
+std::vector<L_BvhNode> JoinBvhs(const std::vector<BvhSubtree>& subtrees, u32 firstNode)
+{
+    // Neighbouring subtrees along the curve share a parent, so the parents' boxes stay small
+    vec3 centersMin(FLT_MAX);
+    vec3 centersMax(-FLT_MAX);
+    std::vector<vec3> centers(subtrees.size());
+    for (size_t i = 0; i < subtrees.size(); ++i) {
+        centers[i] = (subtrees[i].Min + subtrees[i].Max) * 0.5f;
+        if (subtrees[i].Min.x <= subtrees[i].Max.x) {
+            centersMin = minVec3(centersMin, centers[i]);
+            centersMax = maxVec3(centersMax, centers[i]);
+        }
+    }
+    std::vector<std::pair<u32, BvhSubtree>> keyed(subtrees.size());
+    for (size_t i = 0; i < subtrees.size(); ++i) {
+        bool empty = subtrees[i].Min.x > subtrees[i].Max.x;
+        keyed[i] = { empty ? ~0u : GetSpatialCode(SpatialOrder::Hilbert, &centers[i].x, &centersMin.x, &centersMax.x), subtrees[i] };
+    }
+    std::stable_sort(keyed.begin(), keyed.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    // Level sizes from the subtrees up, stored with the root level first
+    std::vector<u32> levelSizes;
+    for (u32 count = (u32)subtrees.size(); count > 1;) {
+        count = (count + kBvhWidth - 1) / kBvhWidth;
+        levelSizes.push_back(count);
+    }
+    std::vector<u32> levelOffsets(levelSizes.size());
+    u32 nodeCount = 0;
+    for (size_t level = levelSizes.size(); level-- > 0;) {
+        levelOffsets[level] = nodeCount;
+        nodeCount += levelSizes[level];
+    }
+
+    std::vector<L_BvhNode> nodes(nodeCount);
+    std::vector<BvhSubtree> children(subtrees.size());
+    for (size_t i = 0; i < keyed.size(); ++i)
+        children[i] = keyed[i].second;
+    for (size_t level = 0; level < levelSizes.size(); ++level) {
+        std::vector<BvhSubtree> parents(levelSizes[level]);
+        for (u32 p = 0; p < levelSizes[level]; ++p) {
+            L_BvhNode& node = nodes[levelOffsets[level] + p];
+            parents[p].RootNode = firstNode + levelOffsets[level] + p;
+            for (u32 slot = 0; slot < kBvhWidth; ++slot) {
+                size_t c = (size_t)p * kBvhWidth + slot;
+                SetEmptySlot(node, slot);
+                if (c >= children.size() || children[c].Min.x > children[c].Max.x)
+                    continue;
+
+                const BvhSubtree& child = children[c];
+                node.MinX[slot] = child.Min.x;
+                node.MinY[slot] = child.Min.y;
+                node.MinZ[slot] = child.Min.z;
+                node.MaxX[slot] = child.Max.x;
+                node.MaxY[slot] = child.Max.y;
+                node.MaxZ[slot] = child.Max.z;
+                node.Child[slot] = child.RootNode;
+                node.Leaf[slot] = 0;
+                parents[p].Min = minVec3(parents[p].Min, child.Min);
+                parents[p].Max = maxVec3(parents[p].Max, child.Max);
+            }
+        }
+        children.swap(parents);
+    }
+    return nodes;
+}
+
+// Moller-Trumbore, two-sided
+static bool IntersectTriangle(const vec3& origin, const vec3& direction, const vec3& p0, const vec3& p1, const vec3& p2, float& t)
+{
+    vec3 e1 = p1 - p0;
+    vec3 e2 = p2 - p0;
+    vec3 pv = cross(direction, e2);
+    float det = dot(e1, pv);
+    if (det == 0.0f)
+        return false;
+
+    float invDet = 1.0f / det;
+    vec3 tv = origin - p0;
+    float u = dot(tv, pv) * invDet;
+    if (u < 0.0f || u > 1.0f)
+        return false;
+
+    vec3 qv = cross(tv, e1);
+    float v = dot(direction, qv) * invDet;
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+
+    t = dot(e2, qv) * invDet;
+    return true;
+}
+
+static bool IntersectBvhCounted(const std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices,
+                                const std::vector<L_BvhNode>& nodes, const std::vector<u32>& triangles, u32 rootNode,
+                                const vec3& origin, const vec3& direction, float maxDistance, BvhRayHit& outHit, uint64_t& visited)
+{
+    auto inverse = [](float d) { return 1.0f / (std::abs(d) > 1e-30f ? d : (d < 0.0f ? -1e-30f : 1e-30f)); };
+    vec3 invDir(inverse(direction.x), inverse(direction.y), inverse(direction.z));
+
+    bool hit = false;
+    float closest = maxDistance;
+    std::vector<u32> stack;
+    stack.reserve(64);
+    stack.push_back(rootNode);
+
+    while (!stack.empty()) {
+        const L_BvhNode& node = nodes[stack.back()];
+        stack.pop_back();
+        visited++;
+
+        float entries[kBvhWidth];
+        u32 order[kBvhWidth];
+        u32 innerCount = 0;
+        for (u32 slot = 0; slot < kBvhWidth; ++slot) {
+            if (node.Child[slot] == kBvhEmpty)
+                continue;
+            float tx0 = (node.MinX[slot] - origin.x) * invDir.x, tx1 = (node.MaxX[slot] - origin.x) * invDir.x;
+            float ty0 = (node.MinY[slot] - origin.y) * invDir.y, ty1 = (node.MaxY[slot] - origin.y) * invDir.y;
+            float tz0 = (node.MinZ[slot] - origin.z) * invDir.z, tz1 = (node.MaxZ[slot] - origin.z) * invDir.z;
+            float tNear = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), 0.0f));
+            float tFar = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::min(std::max(tz0, tz1), closest));
+            // Widened by a few ulps so rounding never misses a box whose triangle the ray grazes
+            if (tNear > tFar * 1.0000004f)
+                continue;
+
+            if (node.Leaf[slot] != 0) {
+                u32 count = node.Leaf[slot] & 0xFF;
+                for (u32 i = 0; i < count; ++i) {
+                    u32 triangle = triangles[node.Child[slot] + i];
+                    const u32* tri = &indices[triangle * 3];
+                    float t;
+                    if (IntersectTriangle(origin, direction, vertices[tri[0]].Position, vertices[tri[1]].Position,
+                                          vertices[tri[2]].Position, t) &&
+                        t >= 0.0f && t <= closest) {
+                        hit = true;
+                        closest = t;
+                        outHit.Distance = t;
+                        outHit.Triangle = triangle;
+                        outHit.Submesh = node.Leaf[slot] >> 8;
+                    }
+                }
+                continue;
+            }
+
+            // Keep inner children sorted far to near so the nearest is popped first
+            u32 at = innerCount++;
+            while (at > 0 && entries[at - 1] < tNear) {
+                entries[at] = entries[at - 1];
+                order[at] = order[at - 1];
+                --at;
+            }
+            entries[at] = tNear;
+            order[at] = node.Child[slot];
+        }
+        for (u32 i = 0; i < innerCount; ++i)
+            stack.push_back(order[i]);
+    }
+    return hit;
+}
+
+bool IntersectBvh(const std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices, const std::vector<L_BvhNode>& nodes,
+                  const std::vector<u32>& triangles, u32 rootNode, const vec3& origin, const vec3& direction, float maxDistance,
+                  BvhRayHit& outHit)
+{
+    uint64_t visited = 0;
+    return IntersectBvhCounted(vertices, indices, nodes, triangles, rootNode, origin, direction, maxDistance, outHit, visited);
+}
+
+static u32 ValidateStructure(const std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices,
+                             const std::vector<L_SubmeshData>& submeshes, const L_BvhRootData& root,
+                             const std::vector<L_BvhNode>& nodes, const std::vector<u32>& triangles)
+{
+    const float kBoundsEpsilon = 1e-5f;
+    u32 errors = 0;
+
+    // Every base-level triangle of the range must be referenced exactly once
+    std::vector<u8> seen(indices.size() / 3, 0);
+    std::vector<u32> stack = { root.RootNode };
+    while (!stack.empty()) {
+        u32 nodeIndex = stack.back();
+        stack.pop_back();
+        if (nodeIndex >= nodes.size()) {
+            errors++;
+            continue;
+        }
+
+        const L_BvhNode& node = nodes[nodeIndex];
+        for (u32 slot = 0; slot < kBvhWidth; ++slot) {
+            if (node.Child[slot] == kBvhEmpty)
+                continue;
+            if (node.Leaf[slot] == 0) {
+                stack.push_back(node.Child[slot]);
+                continue;
+            }
+
+            u32 count = node.Leaf[slot] & 0xFF;
+            u32 submesh = node.Leaf[slot] >> 8;
+            if (count == 0 || count > kBvhMaxLeafTriangles || submesh < root.SubmeshOffset ||
+                submesh >= root.SubmeshOffset + root.SubmeshCount || node.Child[slot] + count > triangles.size()) {
+                errors++;
+                continue;
+            }
+
+            vec3 boundsMin(node.MinX[slot], node.MinY[slot], node.MinZ[slot]);
+            vec3 boundsMax(node.MaxX[slot], node.MaxY[slot], node.MaxZ[slot]);
+            for (u32 i = 0; i < count; ++i) {
+                u32 triangle = triangles[node.Child[slot] + i];
+                u32 first = triangle * 3;
+                if (first < submeshes[submesh].IndexOffset || first + 3 > submeshes[submesh].IndexOffset + submeshes[submesh].IndexCount ||
+                    seen[triangle]++) {
+                    errors++;
+                    continue;
+                }
+                for (u32 k = 0; k < 3; ++k) {
+                    const vec3& p = vertices[indices[first + k]].Position;
+                    if (p.x < boundsMin.x - kBoundsEpsilon || p.y < boundsMin.y - kBoundsEpsilon || p.z < boundsMin.z - kBoundsEpsilon ||
+                        p.x > boundsMax.x + kBoundsEpsilon || p.y > boundsMax.y + kBoundsEpsilon || p.z > boundsMax.z + kBoundsEpsilon)
+                        errors++;
+                }
+            }
+        }
+    }
+
+    for (u32 s = root.SubmeshOffset; s < root.SubmeshOffset + root.SubmeshCount; ++s) {
+        for (u32 i = submeshes[s].IndexOffset; i + 2 < submeshes[s].IndexOffset + submeshes[s].IndexCount; i += 3)
+            errors += seen[i / 3] == 1 ? 0 : 1;
+    }
+    return errors;
+}
+
+BvhValidationStats ValidateBvh(const std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices,
+                               const std::vector<L_SubmeshData>& submeshes, const std::vector<L_BvhRootData>& roots,
+                               const std::vector<L_BvhNode>& nodes, const std::vector<u32>& triangles, u32 rayCount, JobPool& pool)
+{
+    BvhValidationStats stats;
+    for (const L_BvhRootData& root : roots) {
+        stats.Errors += ValidateStructure(vertices, indices, submeshes, root, nodes, triangles);
+
+        vec3 boundsMin(FLT_MAX);
+        vec3 boundsMax(-FLT_MAX);
+        for (u32 s = root.SubmeshOffset; s < root.SubmeshOffset + root.SubmeshCount; ++s) {
+            boundsMin = minVec3(boundsMin, submeshes[s].Min);
+            boundsMax = maxVec3(boundsMax, submeshes[s].Max);
+        }
+        if (boundsMin.x > boundsMax.x)
+            continue;
+        vec3 center = (boundsMin + boundsMax) * 0.5f;
+        vec3 extent = boundsMax - boundsMin;
+        float radius = std::max(extent.length() * 0.5f, 1e-3f);
+
+        std::atomic<u32> hits{0};
+        std::atomic<u32> mismatches{0};
+        std::atomic<uint64_t> visitedTotal{0};
+        pool.ParallelFor(rayCount, 16, [&](size_t begin, size_t end) {
+            uint64_t visited = 0;
+            for (size_t r = begin; r < end; ++r) {
+                // Fibonacci sphere of origins, half outside the bounds, aimed at scattered points inside them
+                float z = 1.0f - 2.0f * (r + 0.5f) / rayCount;
+                float ring = std::sqrt(std::max(0.0f, 1.0f - z * z));
+                float phi = r * 2.39996323f;
+                vec3 onSphere(ring * std::cos(phi), ring * std::sin(phi), z);
+                vec3 origin = center + onSphere * (r % 2 == 0 ? radius * 1.5f : radius * 0.25f);
+                vec3 jitter(std::sin(r * 12.9898f), std::sin(r * 78.233f), std::sin(r * 37.719f));
+                vec3 target = center + vec3(jitter.x * extent.x, jitter.y * extent.y, jitter.z * extent.z) * 0.5f;
+                vec3 direction = (target - origin).normalize();
+                if (direction.length() == 0.0f)
+                    direction = vec3(0.0f, 1.0f, 0.0f);
+
+                BvhRayHit bvhHit;
+                bool bvh = IntersectBvhCounted(vertices, indices, nodes, triangles, root.RootNode, origin, direction, FLT_MAX,
+                                               bvhHit, visited);
+
+                bool brute = false;
+                float closest = FLT_MAX;
+                for (u32 s = root.SubmeshOffset; s < root.SubmeshOffset + root.SubmeshCount; ++s) {
+                    for (u32 i = submeshes[s].IndexOffset; i + 2 < submeshes[s].IndexOffset + submeshes[s].IndexCount; i += 3) {
+                        float t;
+                        if (IntersectTriangle(origin, direction, vertices[indices[i]].Position, vertices[indices[i + 1]].Position,
+                                              vertices[indices[i + 2]].Position, t) &&
+                            t >= 0.0f && t <= closest) {
+                            brute = true;
+                            closest = t;
+                        }
+                    }
+                }
+
+                hits += bvh ? 1 : 0;
+                if (bvh != brute || (bvh && std::abs(bvhHit.Distance - closest) > 1e-4f * std::max(1.0f, closest)))
+                    mismatches++;
+            }
+            visitedTotal += visited;
+        });
+
+        stats.Rays += rayCount;
+        stats.Hits += hits;
+        stats.Mismatches += mismatches;
+        stats.NodesVisited += visitedTotal;
+    }
+    return stats;
+}
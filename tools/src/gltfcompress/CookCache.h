@@ -0,0 +1,55 @@
+//
+// Incremental cook cache: a manifest next to the outputs records the content key each .mesh was cooked from,
+// so unchanged inputs are skipped on the next run
+//
+
+#pragma once
+
+#include "MeshTypes.h"
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+typedef uint64_t CookKey;
+
+// Non-cryptographic 64-bit hash, chained through seed
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed);
+
+// Hash of the running gltfcompress binary, so any rebuild of the tool invalidates previous cooks
+uint64_t HashToolBinary(const char* argv0);
+
+// Hashes a .gltf/.glb together with every external buffer it references. Returns false when a file can't be read,
+// the caller then treats the input as changed.
+bool HashGLTFInputs(const std::string& inputPath, uint64_t seed, CookKey& outKey);
+
+class CookCache
+{
+public:
+    // Manifest file written into the output directory
+    static const char* const kManifestName;
+
+    explicit CookCache(const std::string& outputDir);
+
+    // Reads the manifest, a missing or outdated one starts an empty cache
+    void Load();
+    bool Save() const;
+
+    // True when output was cooked from key and still exists with the size it was written with
+    bool IsUpToDate(const std::string& outputPath, CookKey key) const;
+    void Record(const std::string& outputPath, CookKey key);
+    void Forget(const std::string& outputPath);
+
+private:
+    struct Entry
+    {
+        CookKey Key;
+        uint64_t OutputSize;
+    };
+
+    std::string RelativePath(const std::string& outputPath) const;
+
+    std::string m_OutputDir;
+    std::unordered_map<std::string, Entry> m_Entries;
+    mutable std::mutex m_Mutex;
+};
@@ -0,0 +1,225 @@
+#include "CookCache.h"
+#include "tiny_gltf.h"
+#include "json.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
+
+namespace stdfs = std::filesystem;
+
+const char* const CookCache::kManifestName = ".gltfcompress-cache";
+
+// Bump when the manifest layout changes
+static const u32 kManifestVersion = 1;
+
+static uint64_t MixHash(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed)
+{
+    const uint64_t kMultiplier = 0x9e3779b97f4a7c15ull;
+    const u8* bytes = (const u8*)data;
+    uint64_t h = seed ^ (size * kMultiplier);
+
+    size_t words = size / sizeof(uint64_t);
+    for (size_t i = 0; i < words; ++i) {
+        uint64_t w;
+        memcpy(&w, bytes + i * sizeof(uint64_t), sizeof(w));
+        w *= 0x87c37b91114253d5ull;
+        w = (w << 31) | (w >> 33);
+        h = (h ^ w) * kMultiplier;
+        h = (h << 27) | (h >> 37);
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, bytes + words * sizeof(uint64_t), size - words * sizeof(uint64_t));
+    return MixHash(h ^ tail);
+}
+
+static bool ReadFile(const std::string& path, std::vector<u8>& out)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+uint64_t HashToolBinary(const char* argv0)
+{
+    std::string path = argv0;
+#ifdef __APPLE__
+    char buffer[4096];
+    uint32_t size = sizeof(buffer);
+    if (_NSGetExecutablePath(buffer, &size) == 0)
+        path = buffer;
+#else
+    std::error_code ec;
+    stdfs::path self = stdfs::read_symlink("/proc/self/exe", ec);
+    if (!ec)
+        path = self.string();
+#endif
+
+    // Unreadable binaries still get a stable key, rebuilds then need --no-cache
+    std::vector<u8> binary;
+    if (!ReadFile(path, binary))
+        return HashBytes(path.data(), path.size(), 0);
+    return HashBytes(binary.data(), binary.size(), 0);
+}
+
+// JSON chunk of a .glb, empty when the container is malformed
+static std::string ExtractGLBJson(const std::vector<u8>& glb)
+{
+    const size_t kHeaderSize = 12;
+    const size_t kChunkHeaderSize = 8;
+    const u32 kJsonChunkType = 0x4E4F534A;
+    if (glb.size() < kHeaderSize + kChunkHeaderSize)
+        return {};
+
+    u32 chunkLength, chunkType;
+    memcpy(&chunkLength, glb.data() + kHeaderSize, sizeof(chunkLength));
+    memcpy(&chunkType, glb.data() + kHeaderSize + 4, sizeof(chunkType));
+    if (chunkType != kJsonChunkType || kHeaderSize + kChunkHeaderSize + chunkLength > glb.size())
+        return {};
+    return std::string((const char*)glb.data() + kHeaderSize + kChunkHeaderSize, chunkLength);
+}
+
+bool HashGLTFInputs(const std::string& inputPath, uint64_t seed, CookKey& outKey)
+{
+    std::vector<u8> data;
+    if (!ReadFile(inputPath, data))
+        return false;
+    uint64_t h = HashBytes(data.data(), data.size(), seed);
+
+    bool binary = data.size() >= 4 && memcmp(data.data(), "glTF", 4) == 0;
+    std::string jsonText = binary ? ExtractGLBJson(data) : std::string(data.begin(), data.end());
+    nlohmann::json json = nlohmann::json::parse(jsonText, nullptr, false);
+    if (json.is_discarded())
+        return false;
+
+    // Images only feed material paths into the .mesh, so only buffers are part of the key
+    stdfs::path baseDir = stdfs::path(inputPath).parent_path();
+    auto buffers = json.find("buffers");
+    if (buffers != json.end() && buffers->is_array()) {
+        for (const auto& buffer : *buffers) {
+            auto uri = buffer.find("uri");
+            if (uri == buffer.end() || !uri->is_string())
+                continue;
+
+            std::string encoded = uri->get<std::string>();
+            if (tinygltf::IsDataURI(encoded))
+                continue;
+
+            std::string decoded;
+            if (!tinygltf::URIDecode(encoded, &decoded, nullptr))
+                decoded = encoded;
+            if (!ReadFile((baseDir / decoded).string(), data))
+                return false;
+            h = HashBytes(data.data(), data.size(), h);
+        }
+    }
+
+    outKey = h;
+    return true;
+}
+
+CookCache::CookCache(const std::string& outputDir)
+    : m_OutputDir(outputDir)
+{
+}
+
+std::string CookCache::RelativePath(const std::string& outputPath) const
+{
+    return stdfs::path(outputPath).lexically_relative(m_OutputDir).generic_string();
+}
+
+void CookCache::Load()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Entries.clear();
+
+    std::ifstream file(stdfs::path(m_OutputDir) / kManifestName);
+    std::string magic;
+    u32 version = 0;
+    if (!(file >> magic >> version) || magic != "gltfcompress-cache" || version != kManifestVersion)
+        return;
+
+    // One "<key> <output size> <relative output path>" line per cooked file
+    std::string line;
+    std::getline(file, line);
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        Entry entry;
+        std::string path;
+        if (!(stream >> std::hex >> entry.Key >> std::dec >> entry.OutputSize) || !std::getline(stream >> std::ws, path))
+            continue;
+        m_Entries[path] = entry;
+    }
+}
+
+bool CookCache::Save() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    stdfs::path manifest = stdfs::path(m_OutputDir) / kManifestName;
+    stdfs::path temp = manifest;
+    temp += ".tmp";
+
+    {
+        std::ofstream file(temp);
+        if (!file)
+            return false;
+        file << "gltfcompress-cache " << kManifestVersion << "\n";
+        for (const auto& [path, entry] : m_Entries)
+            file << std::hex << entry.Key << std::dec << " " << entry.OutputSize << " " << path << "\n";
+        if (!file)
+            return false;
+    }
+
+    // Replace in one step so an interrupted run never leaves a half-written manifest
+    std::error_code ec;
+    stdfs::rename(temp, manifest, ec);
+    return !ec;
+}
+
+bool CookCache::IsUpToDate(const std::string& outputPath, CookKey key) const
+{
+    std::error_code ec;
+    uintmax_t size = stdfs::file_size(outputPath, ec);
+    if (ec)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto it = m_Entries.find(RelativePath(outputPath));
+    return it != m_Entries.end() && it->second.Key == key && it->second.OutputSize == size;
+}
+
+void CookCache::Record(const std::string& outputPath, CookKey key)
+{
+    std::error_code ec;
+    uintmax_t size = stdfs::file_size(outputPath, ec);
+    if (ec)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Entries[RelativePath(outputPath)] = Entry{ key, (uint64_t)size };
+}
+
+void CookCache::Forget(const std::string& outputPath)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Entries.erase(RelativePath(outputPath));
+}
@@ -0,0 +1,85 @@
+//
+// glTF input with zero-copy accessor views. By default the .glb BIN chunk and external .bin buffers are memory mapped
+// instead of being copied into the tinygltf model, only the JSON document is parsed into it.
+//
+
+#pragma once
+
+#include "MeshTypes.h"
+#include "tiny_gltf.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Read-only mapping of a whole file, pages are only faulted in as accessors touch them
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& path);
+    // Drops the pages faulted in so far from the process, they are read from the file again when touched
+    void Evict() const;
+
+    const u8* GetData() const { return m_Data; }
+    size_t GetSize() const { return m_Size; }
+
+private:
+    const u8* m_Data = nullptr;
+    size_t m_Size = 0;
+};
+
+// Strided view of an accessor's elements straight in the buffer they live in
+struct AccessorView
+{
+    const u8* Data = nullptr;
+    size_t Stride = 0;
+    size_t Count = 0;
+    int ComponentType = 0;
+
+    bool IsValid() const { return Data != nullptr; }
+
+    template<typename T>
+    T Get(size_t index) const
+    {
+        T value;
+        memcpy(&value, Data + index * Stride, sizeof(T));
+        return value;
+    }
+};
+
+class GLTFSource
+{
+public:
+    // mapBuffers = false lets tinygltf load every buffer into memory as before
+    bool Load(const std::string& path, bool mapBuffers, std::string& err, std::string& warn);
+
+    const tinygltf::Model& GetModel() const { return m_Model; }
+
+    // Fails for accessors without a buffer view or whose elements run past their buffer. Sparse substitutions are not
+    // applied, same as before mapping.
+    bool GetAccessor(int accessorIndex, size_t elementSize, AccessorView& outView) const;
+
+    // Bytes reachable through mappings rather than heap copies
+    size_t GetMappedBytes() const;
+    // Evicts every mapped file, so resident input stays at what has been read since the last call
+    void EvictMappedPages() const;
+
+private:
+    bool LoadMapped(const std::string& path, std::string& err, std::string& warn);
+
+    struct BufferData
+    {
+        const u8* Data = nullptr;
+        size_t Size = 0;
+    };
+
+    tinygltf::Model m_Model;
+    std::vector<BufferData> m_Buffers;
+    std::vector<std::unique_ptr<MappedFile>> m_Files;
+    std::vector<std::vector<u8>> m_DecodedBuffers; // Data URIs, the only buffers that need a copy
+};
@@ -0,0 +1,248 @@
+#include "GLTFSource.h"
+#include "json.hpp"
+
+#include <filesystem>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace stdfs = std::filesystem;
+
+// Stands in for every buffer and embedded image in the JSON handed to tinygltf, it has to decode to something
+static const char* const kPlaceholderBufferURI = "data:application/octet-stream;base64,AA==";
+static const char* const kPlaceholderImageURI = "data:image/png;base64,AA==";
+
+MappedFile::~MappedFile()
+{
+    if (m_Data)
+        munmap((void*)m_Data, m_Size);
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    m_Data = (const u8*)data;
+    m_Size = (size_t)info.st_size;
+    return true;
+}
+
+void MappedFile::Evict() const
+{
+    if (m_Data)
+        madvise((void*)m_Data, m_Size, MADV_DONTNEED);
+}
+
+// Only image URIs end up in the .mesh, the pixels are never decoded
+static bool SkipImageData(tinygltf::Image*, const int, std::string*, std::string*, int, int, const unsigned char*, int, void*)
+{
+    return true;
+}
+
+bool GLTFSource::Load(const std::string& path, bool mapBuffers, std::string& err, std::string& warn)
+{
+    m_Model = tinygltf::Model();
+    m_Buffers.clear();
+    m_Files.clear();
+    m_DecodedBuffers.clear();
+
+    if (mapBuffers)
+        return LoadMapped(path, err, warn);
+
+    tinygltf::TinyGLTF loader;
+    loader.SetImageLoader(SkipImageData, nullptr);
+    bool binary = path.size() >= 4 && path.substr(path.size() - 4) == ".glb";
+    bool ok = binary ? loader.LoadBinaryFromFile(&m_Model, &err, &warn, path) : loader.LoadASCIIFromFile(&m_Model, &err, &warn, path);
+    if (!ok)
+        return false;
+
+    for (const auto& buffer : m_Model.buffers)
+        m_Buffers.push_back({ buffer.data.data(), buffer.data.size() });
+    return true;
+}
+
+bool GLTFSource::LoadMapped(const std::string& path, std::string& err, std::string& warn)
+{
+    auto file = std::make_unique<MappedFile>();
+    if (!file->Open(path)) {
+        err = "Could not map " + path;
+        return false;
+    }
+
+    // A .glb is a 12-byte header, a JSON chunk and an optional BIN chunk
+    const u8* bytes = file->GetData();
+    size_t size = file->GetSize();
+    std::string jsonText;
+    const u8* binData = nullptr;
+    size_t binSize = 0;
+    bool binary = size >= 4 && memcmp(bytes, "glTF", 4) == 0;
+    if (binary) {
+        const u32 kJsonChunkType = 0x4E4F534A;
+        const u32 kBinChunkType = 0x004E4942;
+        u32 version, length, jsonLength, jsonType;
+        if (size < 20) {
+            err = "Truncated GLB header";
+            return false;
+        }
+        memcpy(&version, bytes + 4, 4);
+        memcpy(&length, bytes + 8, 4);
+        memcpy(&jsonLength, bytes + 12, 4);
+        memcpy(&jsonType, bytes + 16, 4);
+        if (version != 2 || length > size || jsonType != kJsonChunkType || 20 + (size_t)jsonLength > length) {
+            err = "Invalid GLB header";
+            return false;
+        }
+        jsonText.assign((const char*)bytes + 20, jsonLength);
+
+        // Chunks are 4-byte aligned
+        size_t binHeader = 20 + (((size_t)jsonLength + 3) & ~(size_t)3);
+        if (binHeader + 8 <= length) {
+            u32 chunkLength, chunkType;
+            memcpy(&chunkLength, bytes + binHeader, 4);
+            memcpy(&chunkType, bytes + binHeader + 4, 4);
+            if (chunkType == kBinChunkType && binHeader + 8 + (size_t)chunkLength <= length) {
+                binData = bytes + binHeader + 8;
+                binSize = chunkLength;
+            }
+        }
+    } else {
+        jsonText.assign((const char*)bytes, size);
+    }
+
+    nlohmann::json document = nlohmann::json::parse(jsonText, nullptr, false);
+    if (document.is_discarded() || !document.is_object()) {
+        err = "Could not parse glTF JSON";
+        return false;
+    }
+    jsonText.clear();
+    jsonText.shrink_to_fit();
+
+    // Resolve every buffer to mapped or decoded bytes, tinygltf only sees a one-byte placeholder
+    stdfs::path baseDir = stdfs::path(path).parent_path();
+    auto buffers = document.find("buffers");
+    if (buffers != document.end() && buffers->is_array()) {
+        for (size_t i = 0; i < buffers->size(); ++i) {
+            nlohmann::json& buffer = (*buffers)[i];
+            size_t byteLength = buffer.value("byteLength", (size_t)0);
+            std::string uri = buffer.value("uri", std::string());
+
+            BufferData data;
+            if (uri.empty()) {
+                if (!binary || i != 0 || byteLength > binSize) {
+                    err = "Buffer " + std::to_string(i) + " has no uri and no matching BIN chunk";
+                    return false;
+                }
+                data = { binData, byteLength };
+            } else if (tinygltf::IsDataURI(uri)) {
+                std::vector<u8> decoded;
+                std::string mimeType;
+                if (!tinygltf::DecodeDataURI(&decoded, mimeType, uri, byteLength, true)) {
+                    err = "Could not decode data URI of buffer " + std::to_string(i);
+                    return false;
+                }
+                m_DecodedBuffers.push_back(std::move(decoded));
+                data = { m_DecodedBuffers.back().data(), byteLength };
+            } else {
+                std::string decodedURI;
+                if (!tinygltf::URIDecode(uri, &decodedURI, nullptr))
+                    decodedURI = uri;
+                auto external = std::make_unique<MappedFile>();
+                if (!external->Open((baseDir / decodedURI).string()) || external->GetSize() < byteLength) {
+                    err = "Could not map buffer " + decodedURI;
+                    return false;
+                }
+                data = { external->GetData(), byteLength };
+                m_Files.push_back(std::move(external));
+            }
+            m_Buffers.push_back(data);
+
+            buffer["uri"] = kPlaceholderBufferURI;
+            buffer["byteLength"] = 1;
+        }
+    }
+
+    // Embedded images would be bounds checked against the placeholder buffers, their pixels aren't needed anyway
+    auto images = document.find("images");
+    if (images != document.end() && images->is_array()) {
+        for (auto& image : *images) {
+            if (!image.is_object() || !image.contains("bufferView"))
+                continue;
+            image.erase("bufferView");
+            image.erase("mimeType");
+            image["uri"] = kPlaceholderImageURI;
+        }
+    }
+
+    std::string placeholderJson = document.dump();
+    document = nlohmann::json();
+
+    tinygltf::TinyGLTF loader;
+    loader.SetImageLoader(SkipImageData, nullptr);
+    if (!loader.LoadASCIIFromString(&m_Model, &err, &warn, placeholderJson.c_str(), (unsigned int)placeholderJson.size(),
+                                    baseDir.string())) {
+        return false;
+    }
+
+    // A .gltf's own text isn't needed once parsed, a .glb's BIN chunk is
+    if (binary)
+        m_Files.push_back(std::move(file));
+    return true;
+}
+
+bool GLTFSource::GetAccessor(int accessorIndex, size_t elementSize, AccessorView& outView) const
+{
+    outView = AccessorView();
+    if (accessorIndex < 0 || accessorIndex >= (int)m_Model.accessors.size())
+        return false;
+
+    const auto& accessor = m_Model.accessors[accessorIndex];
+    if (accessor.bufferView < 0 || accessor.bufferView >= (int)m_Model.bufferViews.size())
+        return false;
+
+    const auto& view = m_Model.bufferViews[accessor.bufferView];
+    if (view.buffer < 0 || view.buffer >= (int)m_Buffers.size())
+        return false;
+
+    const BufferData& buffer = m_Buffers[view.buffer];
+    size_t stride = accessor.ByteStride(view);
+    size_t begin = view.byteOffset + accessor.byteOffset;
+    if (accessor.count > 0 && (stride == 0 || begin + (accessor.count - 1) * stride + elementSize > buffer.Size ||
+                               view.byteOffset + view.byteLength > buffer.Size)) {
+        return false;
+    }
+
+    outView.Data = buffer.Data + begin;
+    outView.Stride = stride;
+    outView.Count = accessor.count;
+    outView.ComponentType = accessor.componentType;
+    return true;
+}
+
+size_t GLTFSource::GetMappedBytes() const
+{
+    size_t bytes = 0;
+    for (const auto& file : m_Files)
+        bytes += file->GetSize();
+    return bytes;
+}
+
+void GLTFSource::EvictMappedPages() const
+{
+    for (const auto& file : m_Files)
+        file->Evict();
+}
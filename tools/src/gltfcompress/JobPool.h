@@ -0,0 +1,70 @@
+//
+// Work-stealing job pool
+// Each worker owns a deque: it pops its own jobs LIFO and steals from others FIFO.
+// Threads that wait on a counter keep executing jobs, so jobs can spawn and wait on nested jobs.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct JobCounter
+{
+    std::atomic<uint32_t> Pending{0};
+};
+
+class JobPool
+{
+public:
+    // threadCount includes the calling thread, 0 = hardware concurrency
+    explicit JobPool(uint32_t threadCount = 0);
+    ~JobPool();
+
+    JobPool(const JobPool&) = delete;
+    JobPool& operator=(const JobPool&) = delete;
+
+    uint32_t GetThreadCount() const { return (uint32_t)m_Queues.size(); }
+
+    void Submit(JobCounter& counter, std::function<void()> job);
+    void Wait(JobCounter& counter);
+
+    // Splits [0, count) into ranges of at most grainSize and runs them across the pool
+    void ParallelFor(size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end)>& fn);
+
+private:
+    struct Job
+    {
+        std::function<void()> Fn;
+        JobCounter* Counter;
+    };
+
+    struct WorkerQueue
+    {
+        std::mutex Mutex;
+        std::deque<Job> Jobs;
+    };
+
+    void WorkerLoop(uint32_t index);
+    bool TryRunJob(uint32_t index);
+    bool PopLocal(uint32_t index, Job& job);
+    bool Steal(uint32_t index, Job& job);
+    uint32_t CurrentQueueIndex();
+
+    std::vector<std::unique_ptr<WorkerQueue>> m_Queues;
+    std::vector<std::thread> m_Threads;
+
+    std::mutex m_SleepMutex;
+    std::condition_variable m_SleepCV;
+    std::atomic<uint32_t> m_QueuedJobs{0};
+    std::atomic<uint32_t> m_NextExternalQueue{0};
+    std::atomic<bool> m_Stop{false};
+};
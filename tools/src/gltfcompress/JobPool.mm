@@ -0,0 +1,161 @@
+#include "JobPool.h"
+
+#include <algorithm>
+#include <chrono>
+
+static thread_local const JobPool* tCurrentPool = nullptr;
+static thread_local uint32_t tCurrentIndex = 0;
+
+JobPool::JobPool(uint32_t threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    m_Queues.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; ++i)
+        m_Queues.push_back(std::make_unique<WorkerQueue>());
+
+    // The owning thread acts as worker 0 whenever it waits
+    tCurrentPool = this;
+    tCurrentIndex = 0;
+
+    for (uint32_t i = 1; i < threadCount; ++i)
+        m_Threads.emplace_back(&JobPool::WorkerLoop, this, i);
+}
+
+JobPool::~JobPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_SleepMutex);
+        m_Stop = true;
+    }
+    m_SleepCV.notify_all();
+
+    for (auto& thread : m_Threads)
+        thread.join();
+
+    if (tCurrentPool == this)
+        tCurrentPool = nullptr;
+}
+
+uint32_t JobPool::CurrentQueueIndex()
+{
+    if (tCurrentPool == this)
+        return tCurrentIndex;
+
+    // Foreign threads spread their submissions round-robin
+    return m_NextExternalQueue.fetch_add(1, std::memory_order_relaxed) % (uint32_t)m_Queues.size();
+}
+
+void JobPool::Submit(JobCounter& counter, std::function<void()> job)
+{
+    counter.Pending.fetch_add(1, std::memory_order_relaxed);
+    m_QueuedJobs.fetch_add(1, std::memory_order_release);
+
+    WorkerQueue& queue = *m_Queues[CurrentQueueIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        queue.Jobs.push_back({ std::move(job), &counter });
+    }
+    {
+        // Serialize with sleepers so the wakeup can't slip between their check and their wait
+        std::lock_guard<std::mutex> lock(m_SleepMutex);
+    }
+    m_SleepCV.notify_one();
+}
+
+bool JobPool::PopLocal(uint32_t index, Job& job)
+{
+    WorkerQueue& queue = *m_Queues[index];
+    std::lock_guard<std::mutex> lock(queue.Mutex);
+    if (queue.Jobs.empty())
+        return false;
+
+    job = std::move(queue.Jobs.back());
+    queue.Jobs.pop_back();
+    return true;
+}
+
+bool JobPool::Steal(uint32_t index, Job& job)
+{
+    uint32_t count = (uint32_t)m_Queues.size();
+    for (uint32_t offset = 1; offset < count; ++offset) {
+        WorkerQueue& victim = *m_Queues[(index + offset) % count];
+        std::lock_guard<std::mutex> lock(victim.Mutex);
+        if (victim.Jobs.empty())
+            continue;
+
+        // Oldest jobs are the biggest chunks of work, take those first
+        job = std::move(victim.Jobs.front());
+        victim.Jobs.pop_front();
+        return true;
+    }
+    return false;
+}
+
+bool JobPool::TryRunJob(uint32_t index)
+{
+    Job job;
+    if (!PopLocal(index, job) && !Steal(index, job))
+        return false;
+
+    m_QueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    job.Fn();
+
+    if (job.Counter->Pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        // Wake up anyone blocked in Wait() on this counter
+        std::lock_guard<std::mutex> lock(m_SleepMutex);
+        m_SleepCV.notify_all();
+    }
+    return true;
+}
+
+void JobPool::WorkerLoop(uint32_t index)
+{
+    tCurrentPool = this;
+    tCurrentIndex = index;
+
+    while (true) {
+        if (TryRunJob(index))
+            continue;
+
+        std::unique_lock<std::mutex> lock(m_SleepMutex);
+        m_SleepCV.wait(lock, [this] { return m_Stop || m_QueuedJobs.load(std::memory_order_acquire) > 0; });
+        if (m_Stop)
+            return;
+    }
+}
+
+void JobPool::Wait(JobCounter& counter)
+{
+    uint32_t index = CurrentQueueIndex();
+    while (counter.Pending.load(std::memory_order_acquire) > 0) {
+        if (TryRunJob(index))
+            continue;
+
+        // Nothing left to help with, the remaining jobs are running on other threads
+        std::unique_lock<std::mutex> lock(m_SleepMutex);
+        m_SleepCV.wait_for(lock, std::chrono::milliseconds(1), [&] {
+            return counter.Pending.load(std::memory_order_acquire) == 0 || m_QueuedJobs.load(std::memory_order_acquire) > 0;
+        });
+    }
+}
+
+void JobPool::ParallelFor(size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end)>& fn)
+{
+    if (count == 0)
+        return;
+
+    grainSize = std::max<size_t>(1, grainSize);
+    if (count <= grainSize || m_Queues.size() == 1) {
+        fn(0, count);
+        return;
+    }
+
+    JobCounter counter;
+    for (size_t begin = 0; begin < count; begin += grainSize) {
+        size_t end = std::min(count, begin + grainSize);
+        Submit(counter, [&fn, begin, end] { fn(begin, end); });
+    }
+    Wait(counter);
+}
@@ -0,0 +1,49 @@
+//
+// Chunked vertex/index payload codec, shared by gltfcompress (encode) and the runtime loader (decode)
+//
+// A payload is an L_PayloadHeader, a seek table of ChunkCount L_PayloadChunk entries and the chunk data. Every chunk
+// covers ElementsPerChunk elements (the last one the rest) and decodes on its own, so chunks can be decoded in parallel
+// straight into their slice of the destination buffer. Inside a chunk each lane is delta coded against the previous
+// element and zigzagged, then the bytes are split into planes, one per byte of the element. Each plane is stored as a
+// constant, raw, or order-0 rANS coded.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Written to L_MeshSection::Codec
+enum class PayloadCodec : uint32_t
+{
+    Raw = 0,    // VB and IB stored as-is
+    Chunked = 1 // VB and IB stored as chunked payloads
+};
+
+// Decoded bytes per chunk, rounded down to whole elements
+static const uint32_t kPayloadChunkBytes = 256 * 1024;
+
+struct L_PayloadHeader
+{
+    uint32_t ChunkCount;
+    uint32_t ElementSize;      // Bytes per vertex or index
+    uint32_t LaneSize;         // 2 or 4, delta coding works on lanes of this many bytes
+    uint32_t ElementsPerChunk;
+};
+
+struct L_PayloadChunk
+{
+    uint32_t Offset; // From the start of the payload
+    uint32_t Size;
+};
+
+// Encodes size bytes of elementSize-byte elements. elementSize must be a multiple of laneSize.
+std::vector<uint8_t> EncodePayload(const void* data, size_t size, uint32_t elementSize, uint32_t laneSize);
+
+// Returns the number of chunks after validating the header and seek table, 0 when the payload can't decode to decodedSize bytes
+uint32_t GetPayloadChunkCount(const uint8_t* payload, size_t payloadSize, size_t decodedSize);
+
+// Decodes one chunk into its slice of destination, which holds the whole decodedSize bytes. Safe to call concurrently
+// for different chunks. Returns false on corrupt data.
+bool DecodePayloadChunk(const uint8_t* payload, size_t payloadSize, uint32_t chunkIndex, uint8_t* destination, size_t decodedSize);
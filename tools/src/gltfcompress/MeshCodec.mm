@@ -0,0 +1,393 @@
+#include "MeshCodec.h"
+
+#include <algorithm>
+#include <cstring>
+
+enum class PlaneMode : uint8_t
+{
+    Raw = 0,
+    Constant = 1,
+    Rans = 2
+};
+
+// rANS with 12-bit probabilities and kRansStates interleaved 32-bit states. States renormalize 16 bits at a time, so decoding
+// reads at most one word per symbol and the refill needs no loop.
+static const uint32_t kRansProbabilityBits = 12;
+static const uint32_t kRansProbabilityScale = 1u << kRansProbabilityBits;
+static const uint32_t kRansLowerBound = 1u << 16;
+static const uint32_t kRansStates = 4;
+
+static uint32_t LoadLane(const uint8_t* p, uint32_t laneSize)
+{
+    if (laneSize == 2)
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static void StoreLane(uint8_t* p, uint32_t value, uint32_t laneSize)
+{
+    if (laneSize == 2) {
+        p[0] = (uint8_t)value;
+        p[1] = (uint8_t)(value >> 8);
+        return;
+    }
+    memcpy(p, &value, sizeof(value));
+}
+
+static uint32_t Zigzag(uint32_t delta, uint32_t laneSize)
+{
+    uint32_t bits = laneSize * 8;
+    uint32_t mask = bits == 32 ? ~0u : (1u << bits) - 1;
+    uint32_t sign = (delta >> (bits - 1)) & 1;
+    return ((delta << 1) ^ (0u - sign)) & mask;
+}
+
+static uint32_t Unzigzag(uint32_t value)
+{
+    return (value >> 1) ^ (0u - (value & 1));
+}
+
+static void NormalizeFrequencies(const uint32_t* counts, uint32_t total, uint32_t* freqs)
+{
+    uint32_t sum = 0;
+    uint32_t largest = 0;
+    for (uint32_t s = 0; s < 256; ++s) {
+        freqs[s] = counts[s] ? std::max<uint32_t>(1, (uint32_t)((uint64_t)counts[s] * kRansProbabilityScale / total)) : 0;
+        sum += freqs[s];
+        if (freqs[s] > freqs[largest])
+            largest = s;
+    }
+
+    // Rounding leaves the sum off by a little, the most frequent symbol absorbs it
+    while (sum > kRansProbabilityScale) {
+        uint32_t s = largest;
+        for (uint32_t t = 0; t < 256; ++t) {
+            if (freqs[t] > freqs[s])
+                s = t;
+        }
+        uint32_t take = std::min(sum - kRansProbabilityScale, freqs[s] - 1);
+        freqs[s] -= take;
+        sum -= take;
+    }
+    freqs[largest] += kRansProbabilityScale - sum;
+}
+
+static void RansEncodeSymbol(uint32_t& state, std::vector<uint8_t>& reversed, uint32_t start, uint32_t freq)
+{
+    uint64_t limit = (uint64_t)((kRansLowerBound >> kRansProbabilityBits) << 16) * freq;
+    if (state >= limit) {
+        // Reversed at the end, so the decoder reads the word low byte first
+        reversed.push_back((uint8_t)(state >> 8));
+        reversed.push_back((uint8_t)state);
+        state >>= 16;
+    }
+    state = ((state / freq) << kRansProbabilityBits) + (state % freq) + start;
+}
+
+static void RansFlush(uint32_t state, std::vector<uint8_t>& reversed)
+{
+    // Reversed at the end, so the decoder reads the state most significant byte first
+    for (int i = 0; i < 4; ++i)
+        reversed.push_back((uint8_t)(state >> (i * 8)));
+}
+
+// Appends the coded plane, falls back to raw bytes when coding doesn't pay off
+static void EncodePlane(const uint8_t* plane, uint32_t count, std::vector<uint8_t>& out)
+{
+    uint32_t counts[256] = {};
+    for (uint32_t i = 0; i < count; ++i)
+        counts[plane[i]]++;
+
+    uint32_t symbols = 0;
+    for (uint32_t s = 0; s < 256; ++s)
+        symbols += counts[s] ? 1 : 0;
+
+    if (symbols <= 1) {
+        out.push_back((uint8_t)PlaneMode::Constant);
+        out.push_back(count ? plane[0] : 0);
+        return;
+    }
+
+    uint32_t freqs[256];
+    uint32_t starts[256];
+    NormalizeFrequencies(counts, count, freqs);
+    for (uint32_t s = 0, start = 0; s < 256; ++s) {
+        starts[s] = start;
+        start += freqs[s];
+    }
+
+    // The encoder runs backwards, byte order is fixed up once at the end
+    std::vector<uint8_t> reversed;
+    reversed.reserve(count);
+    // Symbol i belongs to state i % kRansStates, the decoder walks forwards so the last symbols are encoded first
+    uint32_t states[kRansStates];
+    for (uint32_t j = 0; j < kRansStates; ++j)
+        states[j] = kRansLowerBound;
+    for (uint32_t i = count; i-- > 0;)
+        RansEncodeSymbol(states[i % kRansStates], reversed, starts[plane[i]], freqs[plane[i]]);
+    for (uint32_t j = kRansStates; j-- > 0;)
+        RansFlush(states[j], reversed);
+
+    size_t tableSize = 1 + symbols * 3;
+    if (tableSize + sizeof(uint32_t) + reversed.size() >= count) {
+        out.push_back((uint8_t)PlaneMode::Raw);
+        out.insert(out.end(), plane, plane + count);
+        return;
+    }
+
+    out.push_back((uint8_t)PlaneMode::Rans);
+    out.push_back((uint8_t)(symbols - 1));
+    for (uint32_t s = 0; s < 256; ++s) {
+        if (!freqs[s])
+            continue;
+        out.push_back((uint8_t)s);
+        out.push_back((uint8_t)freqs[s]);
+        out.push_back((uint8_t)(freqs[s] >> 8));
+    }
+    uint32_t streamSize = (uint32_t)reversed.size();
+    const uint8_t* sizeBytes = (const uint8_t*)&streamSize;
+    out.insert(out.end(), sizeBytes, sizeBytes + sizeof(streamSize));
+    out.insert(out.end(), reversed.rbegin(), reversed.rend());
+}
+
+static void EncodeChunk(const uint8_t* data, uint32_t count, uint32_t elementSize, uint32_t laneSize, std::vector<uint8_t>& out)
+{
+    uint32_t lanes = elementSize / laneSize;
+    std::vector<uint8_t> planes((size_t)count * elementSize);
+
+    for (uint32_t lane = 0; lane < lanes; ++lane) {
+        uint32_t previous = 0;
+        for (uint32_t e = 0; e < count; ++e) {
+            uint32_t value = LoadLane(data + (size_t)e * elementSize + lane * laneSize, laneSize);
+            uint32_t coded = Zigzag(value - previous, laneSize);
+            previous = value;
+            for (uint32_t b = 0; b < laneSize; ++b)
+                planes[(size_t)(lane * laneSize + b) * count + e] = (uint8_t)(coded >> (b * 8));
+        }
+    }
+
+    for (uint32_t p = 0; p < elementSize; ++p)
+        EncodePlane(planes.data() + (size_t)p * count, count, out);
+}
+
+std::vector<uint8_t> EncodePayload(const void* data, size_t size, uint32_t elementSize, uint32_t laneSize)
+{
+    uint32_t elementCount = (uint32_t)(size / elementSize);
+    uint32_t elementsPerChunk = std::max<uint32_t>(1, kPayloadChunkBytes / elementSize);
+
+    L_PayloadHeader header;
+    header.ChunkCount = (elementCount + elementsPerChunk - 1) / elementsPerChunk;
+    header.ElementSize = elementSize;
+    header.LaneSize = laneSize;
+    header.ElementsPerChunk = elementsPerChunk;
+
+    std::vector<L_PayloadChunk> chunks(header.ChunkCount);
+    std::vector<uint8_t> body;
+    size_t bodyOffset = sizeof(L_PayloadHeader) + chunks.size() * sizeof(L_PayloadChunk);
+    for (uint32_t c = 0; c < header.ChunkCount; ++c) {
+        uint32_t first = c * elementsPerChunk;
+        uint32_t count = std::min(elementsPerChunk, elementCount - first);
+        chunks[c].Offset = (uint32_t)(bodyOffset + body.size());
+        EncodeChunk((const uint8_t*)data + (size_t)first * elementSize, count, elementSize, laneSize, body);
+        chunks[c].Size = (uint32_t)(bodyOffset + body.size()) - chunks[c].Offset;
+    }
+
+    std::vector<uint8_t> payload(bodyOffset);
+    memcpy(payload.data(), &header, sizeof(header));
+    memcpy(payload.data() + sizeof(header), chunks.data(), chunks.size() * sizeof(L_PayloadChunk));
+    payload.insert(payload.end(), body.begin(), body.end());
+    return payload;
+}
+
+uint32_t GetPayloadChunkCount(const uint8_t* payload, size_t payloadSize, size_t decodedSize)
+{
+    if (payloadSize < sizeof(L_PayloadHeader))
+        return 0;
+
+    L_PayloadHeader header;
+    memcpy(&header, payload, sizeof(header));
+    if ((header.LaneSize != 2 && header.LaneSize != 4) || header.ElementSize == 0 || header.ElementSize % header.LaneSize != 0 ||
+        header.ElementsPerChunk == 0 || decodedSize % header.ElementSize != 0)
+        return 0;
+
+    uint64_t elementCount = decodedSize / header.ElementSize;
+    if (header.ChunkCount != (elementCount + header.ElementsPerChunk - 1) / header.ElementsPerChunk)
+        return 0;
+    if (sizeof(L_PayloadHeader) + (uint64_t)header.ChunkCount * sizeof(L_PayloadChunk) > payloadSize)
+        return 0;
+
+    const L_PayloadChunk* chunks = (const L_PayloadChunk*)(payload + sizeof(L_PayloadHeader));
+    for (uint32_t c = 0; c < header.ChunkCount; ++c) {
+        if ((uint64_t)chunks[c].Offset + chunks[c].Size > payloadSize)
+            return 0;
+    }
+    return header.ChunkCount;
+}
+
+// Decode table entry per probability slot, packed so the whole table stays in L1:
+// bits 0-11 frequency minus one, 12-23 slot minus symbol start, 24-31 symbol
+typedef uint32_t RansSlot;
+
+static bool DecodePlane(const uint8_t*& cursor, const uint8_t* end, uint8_t* plane, uint32_t count)
+{
+    if (cursor >= end)
+        return false;
+    PlaneMode mode = (PlaneMode)*cursor++;
+
+    switch (mode) {
+        case PlaneMode::Constant:
+            if (cursor >= end)
+                return false;
+            memset(plane, *cursor++, count);
+            return true;
+
+        case PlaneMode::Raw:
+            if ((size_t)(end - cursor) < count)
+                return false;
+            memcpy(plane, cursor, count);
+            cursor += count;
+            return true;
+
+        case PlaneMode::Rans:
+            break;
+
+        default:
+            return false;
+    }
+
+    if (cursor >= end)
+        return false;
+    uint32_t symbols = (uint32_t)*cursor++ + 1;
+    if ((size_t)(end - cursor) < symbols * 3 + sizeof(uint32_t))
+        return false;
+
+    RansSlot slots[kRansProbabilityScale];
+    uint32_t start = 0;
+    for (uint32_t i = 0; i < symbols; ++i) {
+        uint8_t symbol = cursor[0];
+        uint32_t freq = (uint32_t)cursor[1] | ((uint32_t)cursor[2] << 8);
+        cursor += 3;
+        if (freq == 0 || start + freq > kRansProbabilityScale)
+            return false;
+        for (uint32_t slot = start; slot < start + freq; ++slot)
+            slots[slot] = (freq - 1) | ((slot - start) << 12) | ((uint32_t)symbol << 24);
+        start += freq;
+    }
+    if (start != kRansProbabilityScale)
+        return false;
+
+    uint32_t streamSize;
+    memcpy(&streamSize, cursor, sizeof(streamSize));
+    cursor += sizeof(streamSize);
+    if ((size_t)(end - cursor) < streamSize || streamSize < kRansStates * sizeof(uint32_t))
+        return false;
+
+    const uint8_t* stream = cursor;
+    const uint8_t* streamEnd = cursor + streamSize;
+    cursor = streamEnd;
+
+    auto readState = [&]() {
+        uint32_t state = ((uint32_t)stream[0] << 24) | ((uint32_t)stream[1] << 16) | ((uint32_t)stream[2] << 8) | stream[3];
+        stream += 4;
+        return state;
+    };
+    uint32_t states[kRansStates];
+    for (uint32_t j = 0; j < kRansStates; ++j)
+        states[j] = readState();
+
+    // Branchless refill, the word is read from a clamped position so corrupt streams stay in bounds
+    const uint8_t* lastWord = streamEnd - 2;
+    auto decode = [&](uint32_t& state) -> uint8_t {
+        RansSlot slot = slots[state & (kRansProbabilityScale - 1)];
+        state = ((slot & 0xfff) + 1) * (state >> kRansProbabilityBits) + ((slot >> 12) & 0xfff);
+        const uint8_t* wordPtr = stream < lastWord ? stream : lastWord;
+        uint32_t refilled = (state << 16) | (uint32_t)wordPtr[0] | ((uint32_t)wordPtr[1] << 8);
+        bool refill = state < kRansLowerBound;
+        state = refill ? refilled : state;
+        stream += refill ? 2 : 0;
+        return (uint8_t)(slot >> 24);
+    };
+
+    uint32_t state0 = states[0], state1 = states[1], state2 = states[2], state3 = states[3];
+    uint32_t i = 0;
+    for (; i + kRansStates <= count; i += kRansStates) {
+        uint8_t s0 = decode(state0);
+        uint8_t s1 = decode(state1);
+        uint8_t s2 = decode(state2);
+        uint8_t s3 = decode(state3);
+        plane[i] = s0;
+        plane[i + 1] = s1;
+        plane[i + 2] = s2;
+        plane[i + 3] = s3;
+    }
+    if (i < count)
+        plane[i++] = decode(state0);
+    if (i < count)
+        plane[i++] = decode(state1);
+    if (i < count)
+        plane[i++] = decode(state2);
+    return true;
+}
+
+bool DecodePayloadChunk(const uint8_t* payload, size_t payloadSize, uint32_t chunkIndex, uint8_t* destination, size_t decodedSize)
+{
+    if (payloadSize < sizeof(L_PayloadHeader))
+        return false;
+    L_PayloadHeader header;
+    memcpy(&header, payload, sizeof(header));
+    if (chunkIndex >= header.ChunkCount || (header.LaneSize != 2 && header.LaneSize != 4) || header.ElementSize == 0 ||
+        header.ElementSize % header.LaneSize != 0)
+        return false;
+
+    // Checked again here so a chunk never reads outside the payload or writes outside destination on its own
+    uint64_t chunkEntry = sizeof(L_PayloadHeader) + (uint64_t)chunkIndex * sizeof(L_PayloadChunk);
+    if (chunkEntry + sizeof(L_PayloadChunk) > payloadSize)
+        return false;
+    L_PayloadChunk chunk;
+    memcpy(&chunk, payload + chunkEntry, sizeof(chunk));
+    if ((uint64_t)chunk.Offset + chunk.Size > payloadSize)
+        return false;
+
+    uint32_t elementCount = (uint32_t)(decodedSize / header.ElementSize);
+    uint64_t firstElement = (uint64_t)chunkIndex * header.ElementsPerChunk;
+    if (firstElement >= elementCount)
+        return false;
+    uint32_t first = (uint32_t)firstElement;
+    uint32_t count = std::min(header.ElementsPerChunk, elementCount - first);
+    uint32_t elementSize = header.ElementSize;
+    uint32_t laneSize = header.LaneSize;
+
+    thread_local std::vector<uint8_t> planes;
+    planes.resize((size_t)count * elementSize);
+
+    const uint8_t* cursor = payload + chunk.Offset;
+    const uint8_t* end = cursor + chunk.Size;
+    for (uint32_t p = 0; p < elementSize; ++p) {
+        if (!DecodePlane(cursor, end, planes.data() + (size_t)p * count, count))
+            return false;
+    }
+
+    uint8_t* out = destination + (size_t)first * elementSize;
+    uint32_t lanes = elementSize / laneSize;
+    for (uint32_t lane = 0; lane < lanes; ++lane) {
+        const uint8_t* low = planes.data() + (size_t)(lane * laneSize) * count;
+        uint32_t previous = 0;
+        if (laneSize == 2) {
+            const uint8_t* high = low + count;
+            for (uint32_t e = 0; e < count; ++e) {
+                previous += Unzigzag((uint32_t)low[e] | ((uint32_t)high[e] << 8));
+                StoreLane(out + (size_t)e * elementSize + lane * 2, previous, 2);
+            }
+        } else {
+            for (uint32_t e = 0; e < count; ++e) {
+                uint32_t coded = (uint32_t)low[e] | ((uint32_t)low[e + count] << 8) | ((uint32_t)low[e + 2 * count] << 16) |
+                                 ((uint32_t)low[e + 3 * count] << 24);
+                previous += Unzigzag(coded);
+                StoreLane(out + (size_t)e * elementSize + lane * 4, previous, 4);
+            }
+        }
+    }
+    return true;
+}
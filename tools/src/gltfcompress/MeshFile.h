@@ -0,0 +1,175 @@
+//
+// .mesh container layout, shared by gltfcompress (write) and the runtime loader (read)
+//
+// Version 1 files start with an L_MeshFileHeader followed by a directory of L_MeshSection entries, every offset and size
+// is 64-bit. Tables are one section each. The vertex, position and index streams are split into segments of at most
+// kMaxStreamSegmentBytes decoded bytes, each with its own payload, so the 32-bit chunk offsets of the payload codec
+// never overflow however large the scene is.
+//
+// Version 0 files start straight with the 32-bit L_StaticMeshHeader. They are told apart by the magic, which read as a
+// v0 VertexCount would be over a billion vertices.
+//
+
+#pragma once
+
+#include "MeshCodec.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+static const uint32_t kMeshFileMagic = 0x4853454D; // "MESH"
+static const uint32_t kMeshFileVersion = 1;
+
+// Decoded bytes per stream segment, rounded down to whole elements
+static const uint64_t kMaxStreamSegmentBytes = 1ull << 30;
+
+// Raw streams start on a 16 KB page so they can be mapped as they are, everything else only needs its fields aligned
+static const uint64_t kMeshStreamAlignment = 16384;
+static const uint64_t kMeshTableAlignment = 16;
+
+enum class MeshSectionType : uint32_t
+{
+    Submeshes = 1,   // L_SubmeshData
+    Materials,       // L_MaterialData, only in files written before the texture table
+    Meshlets,        // L_MeshletData
+    BaseVertices,    // uint32_t per submesh, only written with 16-bit indices
+    Lods,            // L_LodData
+    Instances,       // L_InstanceData
+    BvhRoots,        // L_BvhRootData
+    BvhNodes,        // L_BvhNode
+    BvhTriangles,    // uint32_t
+    Vertices,        // Streams, one section per segment
+    Positions,
+    Indices,
+    Strings,         // Null-terminated UTF-8 referenced by byte offset, the last byte is always a terminator
+    Textures,        // L_TextureData, one per unique path
+    MaterialEntries, // L_MaterialEntry
+    Occluders,       // L_OccluderData
+};
+
+// How a texture is loaded, a path referenced by several slots keeps the first one in material order
+enum class MeshTextureUsage : uint32_t
+{
+    Albedo = 0,
+    Normal = 1,
+    ORM = 2
+};
+
+// L_MaterialEntry slot without a texture
+static const uint32_t kMeshNoTexture = 0xFFFFFFFF;
+
+struct L_MeshFileHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t HeaderSize; // Later versions may append fields, the directory is found through SectionTableOffset
+    uint32_t SectionCount;
+    uint64_t SectionTableOffset;
+    uint64_t VertexCount;
+    uint64_t IndexCount;
+    uint32_t VertexFormat;
+    uint32_t IndexFormat;
+    float Min[3];
+    float Max[3];
+};
+
+struct L_MeshSection
+{
+    uint32_t Type;          // MeshSectionType, readers skip types they don't know
+    uint32_t Codec;         // PayloadCodec, tables are always raw
+    uint64_t Offset;        // From the start of the file
+    uint64_t StoredSize;    // Bytes at Offset
+    uint64_t DecodedOffset; // Where a stream segment goes in the decoded stream, 0 for tables
+    uint64_t DecodedSize;
+};
+
+// Header fields and sections of a file, whichever version it was read from
+struct MeshFileDirectory
+{
+    uint32_t Version = 0;
+    uint64_t VertexCount = 0;
+    uint64_t IndexCount = 0;
+    uint32_t VertexFormat = 0;
+    uint32_t IndexFormat = 0;
+    float Min[3] = {};
+    float Max[3] = {};
+    std::vector<L_MeshSection> Sections;
+
+    // First section of a type, nullptr when the file doesn't have it
+    const L_MeshSection* FindTable(MeshSectionType type) const
+    {
+        for (const L_MeshSection& section : Sections) {
+            if (section.Type == (uint32_t)type)
+                return &section;
+        }
+        return nullptr;
+    }
+
+    // Segments of a stream in decoded order, none when the file doesn't have it. Fails unless they cover
+    // [0, outDecodedSize) without gaps or overlaps.
+    bool GetStream(MeshSectionType type, std::vector<L_MeshSection>& outSegments, uint64_t& outDecodedSize) const
+    {
+        outSegments.clear();
+        for (const L_MeshSection& section : Sections) {
+            if (section.Type == (uint32_t)type)
+                outSegments.push_back(section);
+        }
+        std::sort(outSegments.begin(), outSegments.end(),
+                  [](const L_MeshSection& a, const L_MeshSection& b) { return a.DecodedOffset < b.DecodedOffset; });
+
+        outDecodedSize = 0;
+        for (const L_MeshSection& segment : outSegments) {
+            if (segment.DecodedOffset != outDecodedSize || segment.DecodedSize > UINT64_MAX - outDecodedSize)
+                return false;
+            outDecodedSize += segment.DecodedSize;
+        }
+        return true;
+    }
+};
+
+inline bool IsMeshFileV1(const uint8_t* bytes, size_t size)
+{
+    uint32_t magic = 0;
+    if (size >= sizeof(magic))
+        memcpy(&magic, bytes, sizeof(magic));
+    return magic == kMeshFileMagic;
+}
+
+// Reads a version 1 header and directory, checking that every section lies within the file and raw sections store
+// what they decode to. Returns why the file is invalid, nullptr when it isn't.
+inline const char* ReadMeshFileDirectory(const uint8_t* bytes, size_t size, MeshFileDirectory& out)
+{
+    L_MeshFileHeader header;
+    if (size < sizeof(header))
+        return "file too small for the header";
+    memcpy(&header, bytes, sizeof(header));
+    if (header.Magic != kMeshFileMagic)
+        return "missing magic";
+    if (header.Version != kMeshFileVersion)
+        return "unsupported version";
+    if (header.HeaderSize < sizeof(header) || header.SectionTableOffset < header.HeaderSize)
+        return "invalid header size";
+    if (header.SectionTableOffset > size || header.SectionCount > (size - header.SectionTableOffset) / sizeof(L_MeshSection))
+        return "truncated section directory";
+
+    out.Version = header.Version;
+    out.VertexCount = header.VertexCount;
+    out.IndexCount = header.IndexCount;
+    out.VertexFormat = header.VertexFormat;
+    out.IndexFormat = header.IndexFormat;
+    memcpy(out.Min, header.Min, sizeof(out.Min));
+    memcpy(out.Max, header.Max, sizeof(out.Max));
+    out.Sections.resize(header.SectionCount);
+    memcpy(out.Sections.data(), bytes + header.SectionTableOffset, header.SectionCount * sizeof(L_MeshSection));
+
+    for (const L_MeshSection& section : out.Sections) {
+        if (section.Offset > size || section.StoredSize > size - section.Offset)
+            return "section past the end of the file";
+        if (section.Codec == (uint32_t)PayloadCodec::Raw && section.StoredSize != section.DecodedSize)
+            return "raw section with mismatched sizes";
+    }
+    return nullptr;
+}
@@ -0,0 +1,137 @@
+//
+// Offline mesh optimization stages run by gltfcompress before the mesh is written
+//
+
+#pragma once
+
+#include "MeshTypes.h"
+
+#include <vector>
+
+enum class WeldMode
+{
+    None,
+    Exact,     // Bitwise identical vertices
+    Quantized  // Vertices that land in the same epsilon-sized cell
+};
+
+struct WeldStats
+{
+    u32 VerticesBefore = 0;
+    u32 VerticesAfter = 0;
+    u32 DroppedTriangles = 0;
+};
+
+// Merges duplicate vertices and rewrites the index buffer to reference the survivors.
+// Unreferenced vertices are removed and triangles that collapse are dropped, so submesh
+// index ranges are rebuilt. Surviving vertices keep their relative order.
+WeldStats WeldVertices(std::vector<L_StaticVertex>& vertices, std::vector<u32>& indices,
+                       std::vector<L_SubmeshData>& submeshes, WeldMode mode, float positionEpsilon);
+
+struct SubmeshSplitStats
+{
+    u32 SplitSubmeshes = 0;
+    u32 Clusters = 0;
+    u32 MaxTriangles = 0;       // Cluster size actually used, raised to stay within the instance budget
+    float MeanDiagonal = 0.0f;  // Average cluster bounds diagonal relative to the submesh it came from
+};
+
+// Clusters a submesh of triangleCount triangles is split into, 1 when it already fits
+u32 CountSubmeshClusters(u32 triangleCount, u32 maxTriangles);
+
+// Splits submeshes over maxTriangles into spatially compact clusters by recursive median splits of the triangle
+// centroids, each becoming its own submesh with tight bounds. Clusters of a submesh stay in its index range and follow
+// each other in kd order. outFirstCluster[s] is the new index of old submesh s's first cluster, with one extra entry
+// holding the new submesh count.
+SubmeshSplitStats SplitLargeSubmeshes(const std::vector<L_StaticVertex>& vertices, std::vector<u32>& indices,
+                                      std::vector<L_SubmeshData>& submeshes, u32 maxTriangles, std::vector<u32>& outFirstCluster);
+
+struct VertexCacheStats
+{
+    u32 Triangles = 0;
+    u32 VerticesTransformed = 0;
+    u32 VerticesReferenced = 0;
+
+    // Average cache miss ratio: transformed vertices per triangle (0.5 is the ideal for big grids, 3 is worst)
+    float ACMR() const { return Triangles ? (float)VerticesTransformed / Triangles : 0.0f; }
+    // Average transform to vertex ratio: how often each vertex is transformed (1 is ideal)
+    float ATVR() const { return VerticesReferenced ? (float)VerticesTransformed / VerticesReferenced : 0.0f; }
+
+    VertexCacheStats& operator+=(const VertexCacheStats& other)
+    {
+        Triangles += other.Triangles;
+        VerticesTransformed += other.VerticesTransformed;
+        VerticesReferenced += other.VerticesReferenced;
+        return *this;
+    }
+};
+
+// FIFO size used to score index buffers, matches the classic post-transform cache model
+static const u32 kAnalyzeCacheSize = 16;
+
+// Simulates a FIFO post-transform cache over a triangle list
+VertexCacheStats AnalyzeVertexCache(const u32* indices, size_t indexCount, u32 cacheSize = kAnalyzeCacheSize);
+
+// Reorders the triangles of one index range to maximize post-transform cache hits (Forsyth's algorithm)
+void OptimizeVertexCache(u32* indices, size_t indexCount);
+
+// Allowed ACMR degradation when splitting the cache-optimized order into clusters
+static const float kOverdrawThreshold = 1.05f;
+
+// Sample views the overdraw pass orders clusters from when the caller doesn't pick a count
+static const u32 kOverdrawViews = 8;
+// Ranges split into more clusters are only sorted by outwardness, the pairwise occlusion table grows with the square
+static const u32 kMaxOcclusionClusters = 512;
+
+// Reorders clusters of the cache-optimized triangle order so the clusters occluding the rest come first: by how much
+// they hide each other from viewCount sample views, or how far out they face on ranges with too many clusters.
+// Triangles stay inside the given index range, which should already be cache-optimized. The range is left untouched,
+// returning false, unless AnalyzeOverdraw from the same views improves.
+bool OptimizeOverdraw(u32* indices, size_t indexCount, const L_StaticVertex* vertices, u32 viewCount = kOverdrawViews,
+                      float threshold = kOverdrawThreshold);
+
+struct OverdrawStats
+{
+    uint64_t PixelsCovered = 0;
+    uint64_t PixelsShaded = 0;
+
+    // Fragments shaded per visible pixel, 1 means no overdraw
+    float Overdraw() const { return PixelsCovered ? (float)PixelsShaded / PixelsCovered : 0.0f; }
+
+    OverdrawStats& operator+=(const OverdrawStats& other)
+    {
+        PixelsCovered += other.PixelsCovered;
+        PixelsShaded += other.PixelsShaded;
+        return *this;
+    }
+};
+
+// Rasterizes the index range with a depth test from viewCount directions around its bounds.
+// Both faces are rasterized since the gbuffer and shadow pipelines don't cull.
+OverdrawStats AnalyzeOverdraw(const u32* indices, size_t indexCount, const L_StaticVertex* vertices, u32 viewCount);
+
+// Fetch strides are clamped to this, a jump to another page costs the same however far it goes
+constexpr uint64_t kFetchStridePageSize = 4096;
+
+struct VertexFetchStats
+{
+    uint64_t Fetches = 0;
+    uint64_t StrideBytes = 0;
+
+    // Average distance in bytes between consecutive vertex fetches (post-transform cache misses)
+    float AverageStride() const { return Fetches ? (float)((double)StrideBytes / Fetches) : 0.0f; }
+
+    VertexFetchStats& operator+=(const VertexFetchStats& other)
+    {
+        Fetches += other.Fetches;
+        StrideBytes += other.StrideBytes;
+        return *this;
+    }
+};
+
+// Simulates the vertex fetches of one index range through the FIFO cache model
+VertexFetchStats AnalyzeVertexFetch(const u32* indices, size_t indexCount, size_t vertexSize, u32 cacheSize = kAnalyzeCacheSize);
+
+// Reorders vertices into the order the index buffer first references them and rewrites the indices.
+// Unreferenced vertices are dropped.
+void OptimizeVertexFetch(std::vector<L_StaticVertex>& vertices, std::vector<u32>& indices);
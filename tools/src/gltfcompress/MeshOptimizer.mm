@@ -0,0 +1,717 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <unordered_map>
+
+// Attribute cell sizes for quantized welding, positions use the caller's epsilon
+static const float kWeldNormalStep = 1.0f / 1024.0f;
+static const float kWeldUVStep = 1.0f / 16384.0f;
+
+struct WeldKey
+{
+    uint64_t Values[12]; // Quantized cells can need more than 32 bits, float bits are zero-extended
+
+    bool operator==(const WeldKey& other) const { return memcmp(Values, other.Values, sizeof(Values)) == 0; }
+};
+
+struct WeldKeyHash
+{
+    size_t operator()(const WeldKey& key) const
+    {
+        uint64_t h = 0xcbf29ce484222325ull;
+        for (uint64_t value : key.Values) {
+            h ^= value;
+            h *= 0x100000001b3ull;
+            h ^= h >> 29;
+        }
+        return (size_t)h;
+    }
+};
+
+static u32 ExactBits(float value)
+{
+    // +0 and -0 compare equal, so they should weld
+    if (value == 0.0f)
+        value = 0.0f;
+    u32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Cell index of value. Cells are clamped to +-2^62 and NaN goes to cell 0, because converting an out-of-range double
+// to an integer is undefined.
+static uint64_t QuantizedBits(float value, float step)
+{
+    const double kMaxCell = 4611686018427387904.0;
+    double cell = std::floor((double)value / step + 0.5);
+    cell = std::isnan(cell) ? 0.0 : std::clamp(cell, -kMaxCell, kMaxCell);
+    return (uint64_t)(int64_t)cell;
+}
+
+static WeldKey MakeWeldKey(const L_StaticVertex& v, WeldMode mode, float positionEpsilon)
+{
+    const float attributes[12] = {
+        v.Position.x, v.Position.y, v.Position.z,
+        v.Normal.x, v.Normal.y, v.Normal.z,
+        v.UV.x, v.UV.y,
+        v.Tangent.x, v.Tangent.y, v.Tangent.z, v.Tangent.w
+    };
+    const float steps[12] = {
+        positionEpsilon, positionEpsilon, positionEpsilon,
+        kWeldNormalStep, kWeldNormalStep, kWeldNormalStep,
+        kWeldUVStep, kWeldUVStep,
+        kWeldNormalStep, kWeldNormalStep, kWeldNormalStep, 1.0f
+    };
+
+    WeldKey key;
+    for (int i = 0; i < 12; ++i)
+        key.Values[i] = mode == WeldMode::Quantized ? QuantizedBits(attributes[i], steps[i]) : ExactBits(attributes[i]);
+    return key;
+}
+
+WeldStats WeldVertices(std::vector<L_StaticVertex>& vertices, std::vector<u32>& indices,
+                       std::vector<L_SubmeshData>& submeshes, WeldMode mode, float positionEpsilon)
+{
+    WeldStats stats;
+    stats.VerticesBefore = (u32)vertices.size();
+    stats.VerticesAfter = (u32)vertices.size();
+    if (mode == WeldMode::None || vertices.empty())
+        return stats;
+
+    std::vector<bool> referenced(vertices.size(), false);
+    for (u32 index : indices)
+        referenced[index] = true;
+
+    // Map every referenced vertex to the first vertex with the same key
+    const u32 kUnused = ~0u;
+    std::vector<u32> remap(vertices.size(), kUnused);
+    std::unordered_map<WeldKey, u32, WeldKeyHash> uniqueVertices;
+    uniqueVertices.reserve(vertices.size());
+
+    std::vector<L_StaticVertex> welded;
+    welded.reserve(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        if (!referenced[i])
+            continue;
+
+        auto result = uniqueVertices.emplace(MakeWeldKey(vertices[i], mode, positionEpsilon), (u32)welded.size());
+        if (result.second)
+            welded.push_back(vertices[i]);
+        remap[i] = result.first->second;
+    }
+
+    // Rewrite indices submesh by submesh, dropping triangles that collapsed
+    std::vector<u32> newIndices;
+    newIndices.reserve(indices.size());
+    for (auto& submesh : submeshes) {
+        u32 newOffset = (u32)newIndices.size();
+        for (u32 i = 0; i + 2 < submesh.IndexCount; i += 3) {
+            u32 a = remap[indices[submesh.IndexOffset + i + 0]];
+            u32 b = remap[indices[submesh.IndexOffset + i + 1]];
+            u32 c = remap[indices[submesh.IndexOffset + i + 2]];
+            if (a == b || b == c || a == c) {
+                stats.DroppedTriangles++;
+                continue;
+            }
+            newIndices.push_back(a);
+            newIndices.push_back(b);
+            newIndices.push_back(c);
+        }
+        submesh.IndexOffset = newOffset;
+        submesh.IndexCount = (u32)newIndices.size() - newOffset;
+    }
+
+    vertices.swap(welded);
+    indices.swap(newIndices);
+    stats.VerticesAfter = (u32)vertices.size();
+    return stats;
+}
+
+u32 CountSubmeshClusters(u32 triangleCount, u32 maxTriangles)
+{
+    if (maxTriangles == 0 || triangleCount <= maxTriangles)
+        return 1;
+    u32 half = triangleCount / 2;
+    return CountSubmeshClusters(half, maxTriangles) + CountSubmeshClusters(triangleCount - half, maxTriangles);
+}
+
+// Median split along the longest centroid axis until every range fits, emitting the leaf ranges in kd order
+static void PartitionTriangles(u32* triangles, u32 count, const std::vector<vec3>& centroids, u32 maxTriangles,
+                               std::vector<u32>& outClusterSizes)
+{
+    if (count <= maxTriangles) {
+        outClusterSizes.push_back(count);
+        return;
+    }
+
+    vec3 boundsMin(FLT_MAX);
+    vec3 boundsMax(-FLT_MAX);
+    for (u32 i = 0; i < count; ++i) {
+        boundsMin = minVec3(boundsMin, centroids[triangles[i]]);
+        boundsMax = maxVec3(boundsMax, centroids[triangles[i]]);
+    }
+    vec3 extent = boundsMax - boundsMin;
+    int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+    u32 half = count / 2;
+    std::nth_element(triangles, triangles + half, triangles + count, [&](u32 a, u32 b) {
+        return (&centroids[a].x)[axis] < (&centroids[b].x)[axis];
+    });
+    PartitionTriangles(triangles, half, centroids, maxTriangles, outClusterSizes);
+    PartitionTriangles(triangles + half, count - half, centroids, maxTriangles, outClusterSizes);
+}
+
+SubmeshSplitStats SplitLargeSubmeshes(const std::vector<L_StaticVertex>& vertices, std::vector<u32>& indices,
+                                      std::vector<L_SubmeshData>& submeshes, u32 maxTriangles, std::vector<u32>& outFirstCluster)
+{
+    SubmeshSplitStats stats;
+    stats.MaxTriangles = maxTriangles;
+
+    std::vector<L_SubmeshData> split;
+    outFirstCluster.assign(submeshes.size() + 1, 0);
+    double diagonalRatioSum = 0.0;
+
+    for (size_t s = 0; s < submeshes.size(); ++s) {
+        const L_SubmeshData& submesh = submeshes[s];
+        outFirstCluster[s] = (u32)split.size();
+        u32 triangleCount = submesh.IndexCount / 3;
+        if (CountSubmeshClusters(triangleCount, maxTriangles) <= 1) {
+            split.push_back(submesh);
+            continue;
+        }
+
+        std::vector<vec3> centroids(triangleCount);
+        std::vector<u32> order(triangleCount);
+        const u32* source = indices.data() + submesh.IndexOffset;
+        for (u32 t = 0; t < triangleCount; ++t) {
+            centroids[t] = (vertices[source[t * 3]].Position + vertices[source[t * 3 + 1]].Position +
+                            vertices[source[t * 3 + 2]].Position) * (1.0f / 3.0f);
+            order[t] = t;
+        }
+
+        std::vector<u32> clusterSizes;
+        PartitionTriangles(order.data(), triangleCount, centroids, maxTriangles, clusterSizes);
+
+        std::vector<u32> reordered(triangleCount * 3);
+        for (u32 t = 0; t < triangleCount; ++t)
+            memcpy(&reordered[t * 3], source + order[t] * 3, 3 * sizeof(u32));
+        memcpy(indices.data() + submesh.IndexOffset, reordered.data(), reordered.size() * sizeof(u32));
+
+        float diagonal = (submesh.Max - submesh.Min).length();
+        u32 indexOffset = submesh.IndexOffset;
+        for (u32 size : clusterSizes) {
+            L_SubmeshData cluster = submesh;
+            cluster.IndexOffset = indexOffset;
+            cluster.IndexCount = size * 3;
+            cluster.Min = vec3(FLT_MAX);
+            cluster.Max = vec3(-FLT_MAX);
+            for (u32 i = cluster.IndexOffset; i < cluster.IndexOffset + cluster.IndexCount; ++i) {
+                cluster.Min = minVec3(cluster.Min, vertices[indices[i]].Position);
+                cluster.Max = maxVec3(cluster.Max, vertices[indices[i]].Position);
+            }
+            diagonalRatioSum += diagonal > 0.0f ? (cluster.Max - cluster.Min).length() / diagonal : 1.0f;
+            split.push_back(cluster);
+            indexOffset += cluster.IndexCount;
+        }
+
+        stats.SplitSubmeshes++;
+        stats.Clusters += (u32)clusterSizes.size();
+    }
+
+    outFirstCluster[submeshes.size()] = (u32)split.size();
+    stats.MeanDiagonal = stats.Clusters ? (float)(diagonalRatioSum / stats.Clusters) : 0.0f;
+    submeshes.swap(split);
+    return stats;
+}
+
+VertexCacheStats AnalyzeVertexCache(const u32* indices, size_t indexCount, u32 cacheSize)
+{
+    VertexCacheStats stats;
+    stats.Triangles = (u32)(indexCount / 3);
+    if (indexCount == 0)
+        return stats;
+
+    u32 minIndex = *std::min_element(indices, indices + indexCount);
+    u32 maxIndex = *std::max_element(indices, indices + indexCount);
+
+    // Timestamp of the last time a vertex entered the FIFO
+    std::vector<u32> cacheTimestamp(maxIndex - minIndex + 1, 0);
+    u32 time = cacheSize + 1;
+
+    for (size_t i = 0; i < indexCount; ++i) {
+        u32& stamp = cacheTimestamp[indices[i] - minIndex];
+        if (stamp == 0)
+            stats.VerticesReferenced++;
+
+        if (time - stamp > cacheSize) {
+            stamp = time++;
+            stats.VerticesTransformed++;
+        }
+    }
+    return stats;
+}
+
+// Forsyth's scoring parameters, from "Linear-Speed Vertex Cache Optimisation"
+static const int kForsythCacheSize = 32;
+static const float kForsythCacheDecayPower = 1.5f;
+static const float kForsythLastTriScore = 0.75f;
+static const float kForsythValenceBoostScale = 2.0f;
+static const float kForsythValenceBoostPower = 0.5f;
+
+static float ForsythVertexScore(int cachePosition, u32 liveTriangles)
+{
+    if (liveTriangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            // The vertices of the last triangle get a fixed score so it isn't immediately reused
+            score = kForsythLastTriScore;
+        } else {
+            float scaler = 1.0f / (kForsythCacheSize - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scaler, kForsythCacheDecayPower);
+        }
+    }
+
+    // Boost vertices with few triangles left so lone triangles get cleaned up early
+    score += kForsythValenceBoostScale * std::pow((float)liveTriangles, -kForsythValenceBoostPower);
+    return score;
+}
+
+void OptimizeVertexCache(u32* indices, size_t indexCount)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2)
+        return;
+
+    u32 minIndex = *std::min_element(indices, indices + indexCount);
+    u32 maxIndex = *std::max_element(indices, indices + indexCount);
+    size_t vertexCount = maxIndex - minIndex + 1;
+
+    // Vertex -> triangle adjacency
+    std::vector<u32> liveTriangles(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; ++i)
+        liveTriangles[indices[i] - minIndex]++;
+
+    std::vector<u32> adjacencyOffset(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v];
+
+    std::vector<u32> adjacency(indexCount);
+    {
+        std::vector<u32> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t t = 0; t < triangleCount; ++t)
+            for (int k = 0; k < 3; ++k)
+                adjacency[fill[indices[t * 3 + k] - minIndex]++] = (u32)t;
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        vertexScore[v] = ForsythVertexScore(-1, liveTriangles[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        const u32* tri = indices + t * 3;
+        triangleScore[t] = vertexScore[tri[0] - minIndex] + vertexScore[tri[1] - minIndex] + vertexScore[tri[2] - minIndex];
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<u32> output;
+    output.reserve(indexCount);
+
+    // LRU cache with room for the 3 vertices pushed by each emitted triangle
+    std::vector<u32> cache;
+    std::vector<u32> newCache;
+    cache.reserve(kForsythCacheSize + 3);
+    newCache.reserve(kForsythCacheSize + 3);
+
+    size_t fallbackCursor = 0;
+    int64_t bestTriangle = 0;
+    for (size_t t = 1; t < triangleCount; ++t)
+        if (triangleScore[t] > triangleScore[bestTriangle])
+            bestTriangle = (int64_t)t;
+
+    while (bestTriangle >= 0) {
+        emitted[bestTriangle] = true;
+        const u32* tri = indices + bestTriangle * 3;
+        output.insert(output.end(), tri, tri + 3);
+
+        // Move the triangle's vertices to the front of the cache
+        newCache.clear();
+        for (int k = 0; k < 3; ++k) {
+            u32 v = tri[k] - minIndex;
+            newCache.push_back(v);
+            liveTriangles[v]--;
+        }
+        for (u32 v : cache)
+            if (v != newCache[0] && v != newCache[1] && v != newCache[2])
+                newCache.push_back(v);
+
+        // Rescore everything in the cache, including vertices that just fell out
+        for (size_t i = 0; i < newCache.size(); ++i) {
+            u32 v = newCache[i];
+            cachePosition[v] = i < (size_t)kForsythCacheSize ? (int)i : -1;
+            vertexScore[v] = ForsythVertexScore(cachePosition[v], liveTriangles[v]);
+        }
+
+        // The next triangle is the best one touching the cache
+        bestTriangle = -1;
+        float bestScore = -FLT_MAX;
+        for (u32 v : newCache) {
+            for (u32 a = adjacencyOffset[v]; a < adjacencyOffset[v + 1]; ++a) {
+                u32 t = adjacency[a];
+                if (emitted[t])
+                    continue;
+
+                const u32* adj = indices + t * 3;
+                float score = vertexScore[adj[0] - minIndex] + vertexScore[adj[1] - minIndex] + vertexScore[adj[2] - minIndex];
+                triangleScore[t] = score;
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        if (newCache.size() > (size_t)kForsythCacheSize)
+            newCache.resize(kForsythCacheSize);
+        cache.swap(newCache);
+
+        // Dead end: continue with the next unemitted triangle in input order
+        if (bestTriangle < 0) {
+            while (fallbackCursor < triangleCount && emitted[fallbackCursor])
+                fallbackCursor++;
+            if (fallbackCursor < triangleCount)
+                bestTriangle = (int64_t)fallbackCursor;
+        }
+    }
+
+    memcpy(indices, output.data(), output.size() * sizeof(u32));
+}
+
+// Resolution of the overdraw estimation viewport
+static const int kOverdrawViewportSize = 256;
+
+// Rasterizes the index range with both faces from viewCount orthographic views spread around its bounds, calling
+// fragment(view, pixel, depth, triangle) for every pixel center a triangle covers. Depth grows away from the viewer.
+template <typename Fragment>
+static void RasterizeViews(const u32* indices, size_t indexCount, const L_StaticVertex* vertices, u32 viewCount, Fragment&& fragment)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0 || viewCount == 0)
+        return;
+
+    vec3 boundsMin(FLT_MAX);
+    vec3 boundsMax(-FLT_MAX);
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+        boundsMin = minVec3(boundsMin, vertices[indices[i]].Position);
+        boundsMax = maxVec3(boundsMax, vertices[indices[i]].Position);
+    }
+    vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = std::max((boundsMax - boundsMin).length() * 0.5f, 1e-6f);
+
+    const int size = kOverdrawViewportSize;
+    std::vector<float> projected(triangleCount * 9);
+
+    for (u32 view = 0; view < viewCount; ++view) {
+        // Fibonacci sphere for evenly spread orthographic view directions
+        float z = 1.0f - 2.0f * (view + 0.5f) / viewCount;
+        float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        float phi = view * 2.39996323f;
+        vec3 forward(r * std::cos(phi), r * std::sin(phi), z);
+        vec3 helper = std::abs(forward.y) < 0.99f ? vec3(0, 1, 0) : vec3(1, 0, 0);
+        vec3 right = cross(helper, forward).normalize();
+        vec3 up = cross(forward, right);
+
+        // Map the bounding sphere onto the viewport
+        float scale = (size * 0.5f) / radius;
+        for (size_t i = 0; i < triangleCount * 3; ++i) {
+            vec3 p = vertices[indices[i]].Position - center;
+            projected[i * 3 + 0] = dot(p, right) * scale + size * 0.5f;
+            projected[i * 3 + 1] = dot(p, up) * scale + size * 0.5f;
+            projected[i * 3 + 2] = radius - dot(p, forward);
+        }
+
+        for (size_t t = 0; t < triangleCount; ++t) {
+            const float* v0 = &projected[t * 9 + 0];
+            const float* v1 = &projected[t * 9 + 3];
+            const float* v2 = &projected[t * 9 + 6];
+
+            float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v1[1] - v0[1]) * (v2[0] - v0[0]);
+            if (area == 0.0f)
+                continue;
+            float invArea = 1.0f / area;
+
+            int minX = std::max(0, (int)std::floor(std::min({ v0[0], v1[0], v2[0] })));
+            int maxX = std::min(size - 1, (int)std::ceil(std::max({ v0[0], v1[0], v2[0] })));
+            int minY = std::max(0, (int)std::floor(std::min({ v0[1], v1[1], v2[1] })));
+            int maxY = std::min(size - 1, (int)std::ceil(std::max({ v0[1], v1[1], v2[1] })));
+
+            for (int y = minY; y <= maxY; ++y) {
+                for (int x = minX; x <= maxX; ++x) {
+                    float px = x + 0.5f;
+                    float py = y + 0.5f;
+
+                    // Barycentrics, normalized by the signed area so both windings rasterize
+                    float w0 = ((v1[0] - px) * (v2[1] - py) - (v1[1] - py) * (v2[0] - px)) * invArea;
+                    float w1 = ((v2[0] - px) * (v0[1] - py) - (v2[1] - py) * (v0[0] - px)) * invArea;
+                    float w2 = 1.0f - w0 - w1;
+                    if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+                        continue;
+
+                    fragment(view, (u32)(y * size + x), w0 * v0[2] + w1 * v1[2] + w2 * v2[2], t);
+                }
+            }
+        }
+    }
+}
+
+bool OptimizeOverdraw(u32* indices, size_t indexCount, const L_StaticVertex* vertices, u32 viewCount, float threshold)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2 || viewCount == 0)
+        return false;
+
+    VertexCacheStats global = AnalyzeVertexCache(indices, indexCount);
+    float targetACMR = global.ACMR() * threshold;
+
+    u32 minIndex = *std::min_element(indices, indices + indexCount);
+    u32 maxIndex = *std::max_element(indices, indices + indexCount);
+    std::vector<u32> cacheTimestamp(maxIndex - minIndex + 1, 0);
+    u32 time = kAnalyzeCacheSize + 1;
+
+    // Split the order into clusters (Sander et al. 2007): a hard boundary wherever the simulated
+    // cache misses a whole triangle, a soft boundary once the running ACMR is close to the global one
+    std::vector<u32> clusterStarts;
+    u32 clusterMisses = 0;
+    u32 clusterTriangles = 0;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        u32 misses = 0;
+        for (int k = 0; k < 3; ++k) {
+            u32& stamp = cacheTimestamp[indices[t * 3 + k] - minIndex];
+            if (time - stamp > kAnalyzeCacheSize) {
+                stamp = time++;
+                misses++;
+            }
+        }
+
+        bool hardBoundary = misses == 3;
+        bool softBoundary = clusterTriangles > 0 && (float)clusterMisses / clusterTriangles <= targetACMR;
+        if (t == 0 || hardBoundary || softBoundary) {
+            clusterStarts.push_back((u32)t);
+            clusterMisses = 0;
+            clusterTriangles = 0;
+
+            // Clusters can end up in any order, so measure each one from a cold cache
+            if (softBoundary && !hardBoundary) {
+                time += kAnalyzeCacheSize + 1;
+                misses = 0;
+                for (int k = 0; k < 3; ++k) {
+                    cacheTimestamp[indices[t * 3 + k] - minIndex] = time++;
+                    misses++;
+                }
+            }
+        }
+        clusterMisses += misses;
+        clusterTriangles++;
+    }
+    clusterStarts.push_back((u32)triangleCount);
+
+    size_t clusterCount = clusterStarts.size() - 1;
+    if (clusterCount < 2)
+        return false;
+
+    // Area-weighted centroid and normal of each cluster and of the whole range
+    std::vector<vec3> clusterCentroid(clusterCount);
+    std::vector<vec3> clusterNormal(clusterCount);
+    std::vector<u32> triangleCluster(triangleCount);
+    vec3 meshCentroid(0.0f);
+    vec3 boundsMin(FLT_MAX);
+    vec3 boundsMax(-FLT_MAX);
+    float meshArea = 0.0f;
+
+    for (size_t c = 0; c < clusterCount; ++c) {
+        vec3 centroid(0.0f);
+        vec3 normal(0.0f);
+        float area = 0.0f;
+
+        for (u32 t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t) {
+            const vec3& a = vertices[indices[t * 3 + 0]].Position;
+            const vec3& b = vertices[indices[t * 3 + 1]].Position;
+            const vec3& p = vertices[indices[t * 3 + 2]].Position;
+
+            vec3 n = cross(b - a, p - a);
+            float triangleArea = n.length();
+            centroid = centroid + (a + b + p) * (triangleArea / 3.0f);
+            normal = normal + n;
+            area += triangleArea;
+            boundsMin = minVec3(minVec3(boundsMin, a), minVec3(b, p));
+            boundsMax = maxVec3(maxVec3(boundsMax, a), maxVec3(b, p));
+            triangleCluster[t] = (u32)c;
+        }
+
+        meshCentroid = meshCentroid + centroid;
+        meshArea += area;
+        clusterCentroid[c] = area > 0.0f ? centroid * (1.0f / area) : vertices[indices[clusterStarts[c] * 3]].Position;
+        clusterNormal[c] = normal.normalize();
+    }
+    if (meshArea > 0.0f)
+        meshCentroid = meshCentroid * (1.0f / meshArea);
+
+    // Clusters facing away from the center are likely to occlude the rest. Keys are rounded so clusters that are
+    // equally far out, like the faces of a box, keep their cache order instead of being shuffled by float noise.
+    float keyStep = std::max((boundsMax - boundsMin).length() * 1e-4f, 1e-12f);
+    std::vector<float> sortKey(clusterCount);
+    std::vector<u32> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c) {
+        sortKey[c] = std::round(dot(clusterCentroid[c] - meshCentroid, clusterNormal[c]) / keyStep);
+        order[c] = (u32)c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](u32 a, u32 b) { return sortKey[a] > sortKey[b]; });
+
+    // Outwardness says nothing about convex parts, where every cluster is equally far out. When the table fits, the
+    // clusters are ordered from the sample views instead (Nehab et al. 2006): occludes[a * n + b] counts the pixels
+    // where a lies in front of b, and clusters that occlude more than they are occluded go first.
+    if (clusterCount <= kMaxOcclusionClusters) {
+        struct Fragment
+        {
+            u32 Pixel; // Across all views
+            float Depth;
+            u32 Cluster;
+        };
+        std::vector<Fragment> fragments;
+        const u32 viewPixels = kOverdrawViewportSize * kOverdrawViewportSize;
+        RasterizeViews(indices, indexCount, vertices, viewCount, [&](u32 view, u32 pixel, float depth, size_t triangle) {
+            fragments.push_back({ view * viewPixels + pixel, depth, triangleCluster[triangle] });
+        });
+        std::sort(fragments.begin(), fragments.end(), [](const Fragment& a, const Fragment& b) {
+            return a.Pixel != b.Pixel ? a.Pixel < b.Pixel : a.Depth < b.Depth;
+        });
+
+        size_t n = clusterCount;
+        std::vector<u32> occludes(n * n, 0);
+        for (size_t first = 0; first < fragments.size();) {
+            size_t last = first;
+            while (last < fragments.size() && fragments[last].Pixel == fragments[first].Pixel)
+                last++;
+            for (size_t i = first; i < last; ++i) {
+                for (size_t j = i + 1; j < last; ++j) {
+                    if (fragments[i].Cluster != fragments[j].Cluster && fragments[i].Depth < fragments[j].Depth)
+                        occludes[fragments[i].Cluster * n + fragments[j].Cluster]++;
+                }
+            }
+            first = last;
+        }
+
+        // Greedy feedback arc set (Eades et al. 1993) over the clusters still to place, outwardness breaks ties
+        std::vector<int64_t> score(n, 0);
+        for (size_t a = 0; a < n; ++a) {
+            for (size_t b = 0; b < n; ++b) {
+                score[a] += occludes[a * n + b];
+                score[b] -= occludes[a * n + b];
+            }
+        }
+        std::vector<bool> placed(n, false);
+        std::vector<u32> occlusionOrder;
+        occlusionOrder.reserve(n);
+        while (occlusionOrder.size() < n) {
+            u32 best = UINT32_MAX;
+            for (u32 c : order) {
+                if (!placed[c] && (best == UINT32_MAX || score[c] > score[best]))
+                    best = c;
+            }
+            placed[best] = true;
+            occlusionOrder.push_back(best);
+            for (size_t c = 0; c < n; ++c)
+                score[c] += (int64_t)occludes[best * n + c] - (int64_t)occludes[c * n + best];
+        }
+        order.swap(occlusionOrder);
+    }
+
+    std::vector<u32> output;
+    output.reserve(triangleCount * 3);
+    for (u32 c : order)
+        output.insert(output.end(), indices + clusterStarts[c] * 3, indices + clusterStarts[c + 1] * 3);
+
+    // Only keep the new order when the estimate from the same views improves, the cache order costs nothing to keep
+    OverdrawStats before = AnalyzeOverdraw(indices, indexCount, vertices, viewCount);
+    OverdrawStats after = AnalyzeOverdraw(output.data(), output.size(), vertices, viewCount);
+    if (after.PixelsShaded >= before.PixelsShaded)
+        return false;
+
+    memcpy(indices, output.data(), output.size() * sizeof(u32));
+    return true;
+}
+
+OverdrawStats AnalyzeOverdraw(const u32* indices, size_t indexCount, const L_StaticVertex* vertices, u32 viewCount)
+{
+    OverdrawStats stats;
+    const size_t viewPixels = kOverdrawViewportSize * kOverdrawViewportSize;
+    std::vector<float> depth(viewPixels * viewCount, FLT_MAX);
+    RasterizeViews(indices, indexCount, vertices, viewCount, [&](u32 view, u32 pixel, float d, size_t) {
+        float& stored = depth[view * viewPixels + pixel];
+        if (d < stored) {
+            stored = d;
+            stats.PixelsShaded++;
+        }
+    });
+
+    for (float d : depth)
+        if (d != FLT_MAX)
+            stats.PixelsCovered++;
+    return stats;
+}
+
+VertexFetchStats AnalyzeVertexFetch(const u32* indices, size_t indexCount, size_t vertexSize, u32 cacheSize)
+{
+    VertexFetchStats stats;
+    if (indexCount == 0)
+        return stats;
+
+    u32 minIndex = *std::min_element(indices, indices + indexCount);
+    u32 maxIndex = *std::max_element(indices, indices + indexCount);
+    std::vector<u32> cacheTimestamp(maxIndex - minIndex + 1, 0);
+    u32 time = cacheSize + 1;
+
+    bool first = true;
+    u32 lastFetch = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        u32& stamp = cacheTimestamp[indices[i] - minIndex];
+        if (time - stamp <= cacheSize)
+            continue;
+        stamp = time++;
+
+        if (!first) {
+            // Anything past a page costs the same, so far jumps don't drown out the common case
+            u32 distance = indices[i] > lastFetch ? indices[i] - lastFetch : lastFetch - indices[i];
+            stats.StrideBytes += std::min<uint64_t>((uint64_t)distance * vertexSize, kFetchStridePageSize);
+            stats.Fetches++;
+        }
+        first = false;
+        lastFetch = indices[i];
+    }
+    return stats;
+}
+
+void OptimizeVertexFetch(std::vector<L_StaticVertex>& vertices, std::vector<u32>& indices)
+{
+    const u32 kUnused = ~0u;
+    std::vector<u32> remap(vertices.size(), kUnused);
+
+    std::vector<L_StaticVertex> reordered;
+    reordered.reserve(vertices.size());
+
+    for (u32& index : indices) {
+        if (remap[index] == kUnused) {
+            remap[index] = (u32)reordered.size();
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices.swap(reordered);
+}
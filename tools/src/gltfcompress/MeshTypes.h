@@ -0,0 +1,331 @@
+//
+// Math and on-disk mesh structures shared by the gltfcompress stages
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+// Type definitions
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef int16_t i16;
+
+// Math structures
+struct vec2 {
+    float x, y;
+    vec2() : x(0), y(0) {}
+    vec2(float s) : x(s), y(s) {}
+    vec2(float x, float y) : x(x), y(y) {}
+};
+
+struct vec3 {
+    float x, y, z;
+    vec3() : x(0), y(0), z(0) {}
+    vec3(float s) : x(s), y(s), z(s) {}
+    vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+
+    vec3 operator+(const vec3& v) const { return vec3(x + v.x, y + v.y, z + v.z); }
+    vec3 operator-(const vec3& v) const { return vec3(x - v.x, y - v.y, z - v.z); }
+    vec3 operator*(float s) const { return vec3(x * s, y * s, z * s); }
+    float length() const { return std::sqrt(x*x + y*y + z*z); }
+    vec3 normalize() const { float len = length(); return len > 0 ? *this * (1.0f / len) : *this; }
+};
+
+struct vec4 {
+    float x, y, z, w;
+    vec4() : x(0), y(0), z(0), w(0) {}
+    vec4(float s) : x(s), y(s), z(s), w(s) {}
+    vec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+    vec4(const vec3& v, float w) : x(v.x), y(v.y), z(v.z), w(w) {}
+    vec3 xyz() const { return vec3(x, y, z); }
+};
+
+struct quat {
+    float x, y, z, w;
+    quat() : x(0), y(0), z(0), w(1) {}
+    quat(float w, float x, float y, float z) : x(x), y(y), z(z), w(w) {}
+};
+
+struct mat3 {
+    float m[9];
+    mat3() { for(int i = 0; i < 9; i++) m[i] = (i % 4 == 0) ? 1.0f : 0.0f; }
+    vec3 operator*(const vec3& v) const {
+        return vec3(
+            m[0]*v.x + m[3]*v.y + m[6]*v.z,
+            m[1]*v.x + m[4]*v.y + m[7]*v.z,
+            m[2]*v.x + m[5]*v.y + m[8]*v.z
+        );
+    }
+};
+
+struct mat4 {
+    float m[16];
+
+    mat4() {
+        for(int i = 0; i < 16; i++)
+            m[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+    }
+
+    mat4(const float* data) {
+        memcpy(m, data, 16 * sizeof(float));
+    }
+
+    mat4(const double* data) {
+        for(int i = 0; i < 16; i++)
+            m[i] = static_cast<float>(data[i]);
+    }
+
+    vec4 operator*(const vec4& v) const {
+        return vec4(
+            m[0]*v.x + m[4]*v.y + m[8]*v.z + m[12]*v.w,
+            m[1]*v.x + m[5]*v.y + m[9]*v.z + m[13]*v.w,
+            m[2]*v.x + m[6]*v.y + m[10]*v.z + m[14]*v.w,
+            m[3]*v.x + m[7]*v.y + m[11]*v.z + m[15]*v.w
+        );
+    }
+
+    mat4 operator*(const mat4& other) const {
+        mat4 result;
+        for(int row = 0; row < 4; row++) {
+            for(int col = 0; col < 4; col++) {
+                result.m[col*4 + row] = 0;
+                for(int k = 0; k < 4; k++) {
+                    result.m[col*4 + row] += m[k*4 + row] * other.m[col*4 + k];
+                }
+            }
+        }
+        return result;
+    }
+
+    mat3 toMat3() const {
+        mat3 result;
+        result.m[0] = m[0]; result.m[3] = m[4]; result.m[6] = m[8];
+        result.m[1] = m[1]; result.m[4] = m[5]; result.m[7] = m[9];
+        result.m[2] = m[2]; result.m[5] = m[6]; result.m[8] = m[10];
+        return result;
+    }
+};
+
+// Math utility functions
+inline vec3 minVec3(const vec3& a, const vec3& b) {
+    return vec3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z));
+}
+
+inline vec3 maxVec3(const vec3& a, const vec3& b) {
+    return vec3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z));
+}
+
+inline vec3 cross(const vec3& a, const vec3& b) {
+    return vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+inline float dot(const vec3& a, const vec3& b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline mat4 translate(const mat4& m, const vec3& v) {
+    mat4 result = m;
+    result.m[12] = m.m[0]*v.x + m.m[4]*v.y + m.m[8]*v.z + m.m[12];
+    result.m[13] = m.m[1]*v.x + m.m[5]*v.y + m.m[9]*v.z + m.m[13];
+    result.m[14] = m.m[2]*v.x + m.m[6]*v.y + m.m[10]*v.z + m.m[14];
+    result.m[15] = m.m[3]*v.x + m.m[7]*v.y + m.m[11]*v.z + m.m[15];
+    return result;
+}
+
+inline mat4 scale(const mat4& m, const vec3& v) {
+    mat4 result;
+    for(int i = 0; i < 4; i++) {
+        result.m[i] = m.m[i] * v.x;
+        result.m[4+i] = m.m[4+i] * v.y;
+        result.m[8+i] = m.m[8+i] * v.z;
+        result.m[12+i] = m.m[12+i];
+    }
+    return result;
+}
+
+inline mat4 quatToMat4(const quat& q) {
+    mat4 result;
+    float qxx = q.x * q.x;
+    float qyy = q.y * q.y;
+    float qzz = q.z * q.z;
+    float qxz = q.x * q.z;
+    float qxy = q.x * q.y;
+    float qyz = q.y * q.z;
+    float qwx = q.w * q.x;
+    float qwy = q.w * q.y;
+    float qwz = q.w * q.z;
+
+    result.m[0] = 1.0f - 2.0f * (qyy + qzz);
+    result.m[1] = 2.0f * (qxy + qwz);
+    result.m[2] = 2.0f * (qxz - qwy);
+    result.m[3] = 0.0f;
+
+    result.m[4] = 2.0f * (qxy - qwz);
+    result.m[5] = 1.0f - 2.0f * (qxx + qzz);
+    result.m[6] = 2.0f * (qyz + qwx);
+    result.m[7] = 0.0f;
+
+    result.m[8] = 2.0f * (qxz + qwy);
+    result.m[9] = 2.0f * (qyz - qwx);
+    result.m[10] = 1.0f - 2.0f * (qxx + qyy);
+    result.m[11] = 0.0f;
+
+    result.m[12] = 0.0f;
+    result.m[13] = 0.0f;
+    result.m[14] = 0.0f;
+    result.m[15] = 1.0f;
+
+    return result;
+}
+
+inline mat3 inverseMat3(const mat3& m) {
+    float det = m.m[0] * (m.m[4]*m.m[8] - m.m[7]*m.m[5]) -
+                m.m[3] * (m.m[1]*m.m[8] - m.m[7]*m.m[2]) +
+                m.m[6] * (m.m[1]*m.m[5] - m.m[4]*m.m[2]);
+
+    if (std::abs(det) < 1e-6f) return mat3();
+
+    float invDet = 1.0f / det;
+    mat3 result;
+
+    result.m[0] = (m.m[4]*m.m[8] - m.m[7]*m.m[5]) * invDet;
+    result.m[3] = (m.m[6]*m.m[5] - m.m[3]*m.m[8]) * invDet;
+    result.m[6] = (m.m[3]*m.m[7] - m.m[6]*m.m[4]) * invDet;
+
+    result.m[1] = (m.m[7]*m.m[2] - m.m[1]*m.m[8]) * invDet;
+    result.m[4] = (m.m[0]*m.m[8] - m.m[6]*m.m[2]) * invDet;
+    result.m[7] = (m.m[6]*m.m[1] - m.m[0]*m.m[7]) * invDet;
+
+    result.m[2] = (m.m[1]*m.m[5] - m.m[4]*m.m[2]) * invDet;
+    result.m[5] = (m.m[3]*m.m[2] - m.m[0]*m.m[5]) * invDet;
+    result.m[8] = (m.m[0]*m.m[4] - m.m[3]*m.m[1]) * invDet;
+
+    return result;
+}
+
+inline mat3 transposeMat3(const mat3& m) {
+    mat3 result;
+    for(int i = 0; i < 3; i++) {
+        for(int j = 0; j < 3; j++) {
+            result.m[j*3 + i] = m.m[i*3 + j];
+        }
+    }
+    return result;
+}
+
+// Data structures
+struct L_StaticVertex {
+    vec3 Position;
+    vec3 Normal;
+    vec2 UV;
+    vec4 Tangent;
+};
+
+// 20 byte vertex written when L_MeshFileHeader::VertexFormat is VertexFormat::Compact
+struct L_CompactVertex {
+    u16 Position[4]; // unorm16 within the submesh bounds, w unused
+    u16 UV[2];       // half floats
+    i16 Normal[2];   // Octahedral snorm16
+    i16 Tangent[2];  // Octahedral snorm16, lowest bit of y holds the bitangent sign (1 = negative)
+};
+
+// Position-only stream entry, written next to the VB for passes that only need positions
+struct L_CompactPosition {
+    u16 Position[4]; // Same unorm16 values as L_CompactVertex::Position, w unused
+};
+
+struct L_SubmeshData {
+    u32 IndexOffset;
+    u32 IndexCount;
+    u32 MaterialIndex;
+    vec3 Min;
+    vec3 Max;
+};
+
+// Fixed-size material of files written before the texture table, kept for the size comparison in the stats
+struct L_MaterialData {
+    char AlbedoPath[256];
+    char NormalPath[256];
+    char ORMPath[256];
+    u32 Opaque; // 1 = opaque, 0 = alpha cutout/blend
+};
+
+// Texture table entry, materials reference textures by index and textures reference their path in the string table
+struct L_TextureData {
+    u32 PathOffset; // glTF image URI
+    u32 Usage;      // MeshTextureUsage
+};
+
+struct L_MaterialEntry {
+    u32 AlbedoTexture; // kMeshNoTexture when unset
+    u32 NormalTexture;
+    u32 ORMTexture;
+    u32 Opaque; // 1 = opaque, 0 = alpha cutout/blend
+};
+
+// Meshlets are contiguous triangle ranges of the index buffer, sorted by submesh
+struct L_MeshletData {
+    u32 IndexOffset;
+    u32 TriangleCount;
+    u32 VertexCount; // Unique vertices referenced
+    u32 SubmeshIndex;
+    vec3 Min;
+    vec3 Max;
+    vec3 SphereCenter;
+    float SphereRadius;
+    vec3 ConeAxis;
+    float ConeCutoff; // 1 = never cone culled
+};
+
+// Simplified index ranges of a submesh, sorted by submesh then level. Level 0 is the submesh itself and isn't stored.
+// LOD indices reference the submesh's own vertices and share its base vertex.
+struct L_LodData {
+    u32 SubmeshIndex;
+    u32 Level;
+    u32 IndexOffset;
+    u32 IndexCount;
+    float Error; // World-space geometric error against level 0
+};
+
+// A contiguous submesh range drawn with a transform. Submeshes of meshes referenced by several glTF nodes are stored
+// once in mesh space with one instance per node, the rest are baked in world space under an identity instance.
+struct L_InstanceData {
+    u32 SubmeshOffset;
+    u32 SubmeshCount;
+    mat4 Transform; // Column-major
+};
+
+// 4-wide BVH node for CPU ray queries, child bounds are stored SoA so one node tests a ray against all four at once.
+// Leaves never mix submeshes.
+struct L_BvhNode {
+    float MinX[4];
+    float MinY[4];
+    float MinZ[4];
+    float MaxX[4];
+    float MaxY[4];
+    float MaxZ[4];
+    u32 Child[4]; // Inner: node index. Leaf: first entry of the BVH triangle table. 0xFFFFFFFF = empty slot
+    u32 Leaf[4];  // 0 for inner children, leaves hold triangle count | submesh index << 8
+};
+
+// Box inside the closed volume of a submesh, in the space its vertices are stored in. Sorted by submesh, boxes of a
+// submesh split into clusters belong to its first cluster.
+struct L_OccluderData {
+    u32 SubmeshIndex;
+    vec3 Min;
+    vec3 Max;
+};
+
+// One BVH per distinct instance submesh range, built in the space the range is stored in. The triangle table lists
+// base-level triangles as IndexOffset / 3 of their first index.
+struct L_BvhRootData {
+    u32 SubmeshOffset;
+    u32 SubmeshCount;
+    u32 RootNode;
+    u32 NodeCount;
+};
@@ -0,0 +1,57 @@
+//
+// Meshlet generation and the CPU reference culler used to validate the meshlet table
+//
+
+#pragma once
+
+#include "MeshTypes.h"
+
+#include <vector>
+
+// Limits that fit a 128 vertex / 256 primitive mesh shader group with room to spare
+static const u32 kMeshletMaxVertices = 64;
+static const u32 kMeshletMaxTriangles = 124;
+
+// Cuts one submesh index range into meshlets, in index buffer order so the cache-optimized order is kept.
+// Bounds and normal cones are filled in, coneCulling = false leaves the cone degenerate (double-sided geometry).
+void BuildMeshlets(const std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices, const L_SubmeshData& submesh,
+                   u32 submeshIndex, bool coneCulling, std::vector<L_MeshletData>& outMeshlets,
+                   u32 maxVertices = kMeshletMaxVertices, u32 maxTriangles = kMeshletMaxTriangles);
+
+struct CullView
+{
+    vec3 CameraPosition;
+    vec4 Planes[6]; // xyz = inward normal, w = distance, inside when dot(xyz, p) + w >= 0
+};
+
+// Perspective view looking at target, with an infinite-ish far plane at farDistance
+CullView MakeCullView(const vec3& eye, const vec3& target, float verticalFov, float aspect, float nearDistance, float farDistance);
+
+enum class MeshletCullResult
+{
+    Visible,
+    Frustum,
+    Backface
+};
+
+// Reference implementation of the per-meshlet test the GPU culling pass is expected to run
+MeshletCullResult CullMeshlet(const L_MeshletData& meshlet, const CullView& view);
+
+struct MeshletValidationStats
+{
+    u32 Meshlets = 0;
+    u32 Triangles = 0;
+    u32 Vertices = 0;
+    uint64_t Tested = 0;
+    uint64_t FrustumCulled = 0;
+    uint64_t BackfaceCulled = 0;
+    uint64_t TrianglesTested = 0;
+    uint64_t TrianglesCulled = 0;
+    uint64_t Errors = 0; // Structural errors and culled triangles that were actually visible
+};
+
+// Checks the meshlet table covers every triangle within the limits, then culls it from viewCount
+// cameras around the bounds and verifies each culled triangle really is outside or back-facing
+MeshletValidationStats ValidateMeshlets(const std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices,
+                                        const std::vector<L_SubmeshData>& submeshes, const std::vector<L_MeshletData>& meshlets,
+                                        u32 viewCount, u32 maxVertices = kMeshletMaxVertices, u32 maxTriangles = kMeshletMaxTriangles);
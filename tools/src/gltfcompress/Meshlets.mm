@@ -0,0 +1,269 @@
+#include "Meshlets.h"
+
+#include <cfloat>
+
+// Below this the normals of a meshlet spread too wide for the cone to ever cull anything
+static const float kMinConeSpread = 0.1f;
+
+static void ComputeMeshletBounds(const std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices,
+                                 const std::vector<u32>& uniqueVertices, bool coneCulling, L_MeshletData& meshlet)
+{
+    meshlet.Min = vec3(FLT_MAX);
+    meshlet.Max = vec3(-FLT_MAX);
+    for (u32 v : uniqueVertices) {
+        meshlet.Min = minVec3(meshlet.Min, vertices[v].Position);
+        meshlet.Max = maxVec3(meshlet.Max, vertices[v].Position);
+    }
+
+    // Ritter's bounding sphere: start from two far apart points, then grow to fit the rest
+    vec3 first = vertices[uniqueVertices[0]].Position;
+    vec3 a = first;
+    vec3 b = first;
+    float farthest = 0.0f;
+    for (u32 v : uniqueVertices) {
+        float distance = (vertices[v].Position - first).length();
+        if (distance > farthest) {
+            farthest = distance;
+            a = vertices[v].Position;
+        }
+    }
+    farthest = 0.0f;
+    for (u32 v : uniqueVertices) {
+        float distance = (vertices[v].Position - a).length();
+        if (distance > farthest) {
+            farthest = distance;
+            b = vertices[v].Position;
+        }
+    }
+
+    vec3 center = (a + b) * 0.5f;
+    float radius = (b - a).length() * 0.5f;
+    for (u32 v : uniqueVertices) {
+        vec3 offset = vertices[v].Position - center;
+        float distance = offset.length();
+        if (distance > radius) {
+            float grown = (radius + distance) * 0.5f;
+            center = center + offset * ((grown - radius) / distance);
+            radius = grown;
+        }
+    }
+    meshlet.SphereCenter = center;
+    // Cover float error from growing, the culler must stay conservative
+    meshlet.SphereRadius = radius * (1.0f + 1e-5f) + 1e-6f;
+
+    meshlet.ConeAxis = vec3(0.0f);
+    meshlet.ConeCutoff = 1.0f;
+    if (!coneCulling)
+        return;
+
+    std::vector<vec3> normals;
+    normals.reserve(meshlet.TriangleCount);
+    vec3 axis(0.0f);
+    for (u32 t = 0; t < meshlet.TriangleCount; ++t) {
+        const u32* triangle = &indices[meshlet.IndexOffset + t * 3];
+        const vec3& p0 = vertices[triangle[0]].Position;
+        const vec3& p1 = vertices[triangle[1]].Position;
+        const vec3& p2 = vertices[triangle[2]].Position;
+
+        vec3 normal = cross(p1 - p0, p2 - p0);
+        float length = normal.length();
+        if (length == 0.0f)
+            continue;
+
+        normals.push_back(normal * (1.0f / length));
+        axis = axis + normals.back();
+    }
+
+    if (normals.empty() || axis.length() == 0.0f)
+        return;
+    axis = axis.normalize();
+
+    float minSpread = 1.0f;
+    for (const vec3& normal : normals)
+        minSpread = std::min(minSpread, dot(normal, axis));
+    if (minSpread <= kMinConeSpread)
+        return;
+
+    // Stored as sin of the half-angle, the test compares it against the cosine of the view angle
+    meshlet.ConeAxis = axis;
+    meshlet.ConeCutoff = std::sqrt(1.0f - minSpread * minSpread);
+}
+
+void BuildMeshlets(const std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices, const L_SubmeshData& submesh,
+                   u32 submeshIndex, bool coneCulling, std::vector<L_MeshletData>& outMeshlets, u32 maxVertices, u32 maxTriangles)
+{
+    u32 triangleCount = submesh.IndexCount / 3;
+    std::vector<u32> uniqueVertices;
+    uniqueVertices.reserve(maxVertices);
+
+    u32 start = 0;
+    auto emit = [&](u32 end) {
+        L_MeshletData meshlet = {};
+        meshlet.IndexOffset = submesh.IndexOffset + start * 3;
+        meshlet.TriangleCount = end - start;
+        meshlet.VertexCount = (u32)uniqueVertices.size();
+        meshlet.SubmeshIndex = submeshIndex;
+        ComputeMeshletBounds(vertices, indices, uniqueVertices, coneCulling, meshlet);
+        outMeshlets.push_back(meshlet);
+    };
+
+    for (u32 t = 0; t < triangleCount; ++t) {
+        const u32* triangle = &indices[submesh.IndexOffset + t * 3];
+
+        u32 newVertices = 0;
+        for (int k = 0; k < 3; ++k) {
+            if (std::find(uniqueVertices.begin(), uniqueVertices.end(), triangle[k]) == uniqueVertices.end())
+                newVertices++;
+        }
+
+        if (t > start && (uniqueVertices.size() + newVertices > maxVertices || t - start >= maxTriangles)) {
+            emit(t);
+            start = t;
+            uniqueVertices.clear();
+        }
+
+        for (int k = 0; k < 3; ++k) {
+            if (std::find(uniqueVertices.begin(), uniqueVertices.end(), triangle[k]) == uniqueVertices.end())
+                uniqueVertices.push_back(triangle[k]);
+        }
+    }
+
+    if (start < triangleCount)
+        emit(triangleCount);
+}
+
+static vec4 MakePlane(const vec3& normal, const vec3& point)
+{
+    vec3 n = normal.normalize();
+    return vec4(n, -dot(n, point));
+}
+
+CullView MakeCullView(const vec3& eye, const vec3& target, float verticalFov, float aspect, float nearDistance, float farDistance)
+{
+    vec3 forward = (target - eye).normalize();
+    vec3 helper = std::abs(forward.y) < 0.99f ? vec3(0, 1, 0) : vec3(1, 0, 0);
+    vec3 right = cross(forward, helper).normalize();
+    vec3 up = cross(right, forward);
+
+    float tanY = std::tan(verticalFov * 0.5f);
+    float tanX = tanY * aspect;
+
+    CullView view;
+    view.CameraPosition = eye;
+    view.Planes[0] = MakePlane(forward, eye + forward * nearDistance);
+    view.Planes[1] = MakePlane(forward * -1.0f, eye + forward * farDistance);
+    view.Planes[2] = MakePlane(forward * tanX + right, eye);
+    view.Planes[3] = MakePlane(forward * tanX - right, eye);
+    view.Planes[4] = MakePlane(forward * tanY + up, eye);
+    view.Planes[5] = MakePlane(forward * tanY - up, eye);
+    return view;
+}
+
+MeshletCullResult CullMeshlet(const L_MeshletData& meshlet, const CullView& view)
+{
+    for (const vec4& plane : view.Planes) {
+        if (dot(plane.xyz(), meshlet.SphereCenter) + plane.w < -meshlet.SphereRadius)
+            return MeshletCullResult::Frustum;
+    }
+
+    // Every triangle faces away when the view direction stays inside the cone widened by the sphere
+    vec3 toCenter = meshlet.SphereCenter - view.CameraPosition;
+    if (dot(toCenter, meshlet.ConeAxis) >= meshlet.ConeCutoff * toCenter.length() + meshlet.SphereRadius)
+        return MeshletCullResult::Backface;
+
+    return MeshletCullResult::Visible;
+}
+
+static bool TriangleOutsideFrustum(const vec3* p, const CullView& view)
+{
+    for (const vec4& plane : view.Planes) {
+        if (dot(plane.xyz(), p[0]) + plane.w < 0.0f && dot(plane.xyz(), p[1]) + plane.w < 0.0f &&
+            dot(plane.xyz(), p[2]) + plane.w < 0.0f)
+            return true;
+    }
+    return false;
+}
+
+static bool TriangleBackfacing(const vec3* p, const CullView& view)
+{
+    vec3 normal = cross(p[1] - p[0], p[2] - p[0]);
+    vec3 toTriangle = p[0] - view.CameraPosition;
+    // Degenerate or edge-on triangles produce no fragments either way
+    return dot(normal, toTriangle) >= -1e-5f * normal.length() * toTriangle.length();
+}
+
+MeshletValidationStats ValidateMeshlets(const std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices,
+                                        const std::vector<L_SubmeshData>& submeshes, const std::vector<L_MeshletData>& meshlets,
+                                        u32 viewCount, u32 maxVertices, u32 maxTriangles)
+{
+    MeshletValidationStats stats;
+    stats.Meshlets = (u32)meshlets.size();
+
+    // Meshlets must tile every submesh exactly, in order
+    size_t next = 0;
+    for (u32 s = 0; s < submeshes.size(); ++s) {
+        u32 expectedOffset = submeshes[s].IndexOffset;
+        u32 submeshEnd = submeshes[s].IndexOffset + submeshes[s].IndexCount;
+        while (next < meshlets.size() && meshlets[next].SubmeshIndex == s) {
+            const L_MeshletData& meshlet = meshlets[next++];
+            if (meshlet.IndexOffset != expectedOffset || meshlet.TriangleCount == 0 || meshlet.TriangleCount > maxTriangles ||
+                meshlet.VertexCount > maxVertices) {
+                stats.Errors++;
+            }
+            expectedOffset = meshlet.IndexOffset + meshlet.TriangleCount * 3;
+            stats.Triangles += meshlet.TriangleCount;
+            stats.Vertices += meshlet.VertexCount;
+        }
+        if (expectedOffset != submeshEnd)
+            stats.Errors++;
+    }
+    if (next != meshlets.size())
+        stats.Errors++;
+
+    if (meshlets.empty() || viewCount == 0)
+        return stats;
+
+    vec3 boundsMin(FLT_MAX);
+    vec3 boundsMax(-FLT_MAX);
+    for (const auto& meshlet : meshlets) {
+        boundsMin = minVec3(boundsMin, meshlet.Min);
+        boundsMax = maxVec3(boundsMax, meshlet.Max);
+    }
+    vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = std::max((boundsMax - boundsMin).length() * 0.5f, 1e-3f);
+
+    for (u32 v = 0; v < viewCount; ++v) {
+        // Fibonacci sphere of cameras, alternating between outside the bounds and inside them
+        float z = 1.0f - 2.0f * (v + 0.5f) / viewCount;
+        float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        float phi = v * 2.39996323f;
+        vec3 direction(r * std::cos(phi), r * std::sin(phi), z);
+        float distance = (v % 2 == 0) ? radius * 2.5f : radius * 0.5f;
+
+        CullView view = MakeCullView(center + direction * distance, center, 1.0f, 1.0f, radius * 0.01f, radius * 10.0f);
+
+        for (const auto& meshlet : meshlets) {
+            MeshletCullResult result = CullMeshlet(meshlet, view);
+            stats.Tested++;
+            stats.TrianglesTested += meshlet.TriangleCount;
+            if (result == MeshletCullResult::Visible)
+                continue;
+
+            stats.TrianglesCulled += meshlet.TriangleCount;
+            if (result == MeshletCullResult::Frustum)
+                stats.FrustumCulled++;
+            else
+                stats.BackfaceCulled++;
+
+            for (u32 t = 0; t < meshlet.TriangleCount; ++t) {
+                const u32* triangle = &indices[meshlet.IndexOffset + t * 3];
+                vec3 p[3] = { vertices[triangle[0]].Position, vertices[triangle[1]].Position, vertices[triangle[2]].Position };
+                bool culled = result == MeshletCullResult::Frustum ? TriangleOutsideFrustum(p, view) : TriangleBackfacing(p, view);
+                if (!culled)
+                    stats.Errors++;
+            }
+        }
+    }
+
+    return stats;
+}
@@ -0,0 +1,35 @@
+//
+// Conservative occluder boxes for the runtime CPU occlusion culler
+//
+
+#pragma once
+
+#include "MeshTypes.h"
+
+#include <vector>
+
+// Voxels along each axis of a connected part, cells stretch with the part so thin walls still get an interior
+static const u32 kOccluderGridSize = 32;
+// Boxes kept per connected part, later boxes only fill in what the first ones missed
+static const u32 kMaxOccludersPerPart = 4;
+// Boxes whose largest face is below this fraction of the part's largest bounds face hide too little to be worth a draw
+static const float kMinOccluderFaceFraction = 0.1f;
+
+struct OccluderStats
+{
+    u32 Submeshes = 0;       // Opaque submeshes large enough to be considered
+    u32 Parts = 0;           // Connected parts of those submeshes large enough to be considered
+    u32 Boxes = 0;
+    u32 Rejected = 0;        // Hollow enclosures, rays from the box center didn't leave through the front of a surface
+    double PartVolume = 0.0; // Sum of the considered parts' bounds volumes
+    double BoxVolume = 0.0;
+    u32 Errors = 0;          // Boxes dropped because they still overlapped a triangle of their part
+};
+
+// Builds boxes that lie entirely inside the closed volume of one submesh, in the space its vertices are in. Every
+// connected part whose bounds diagonal reaches minDiagonal is voxelized, the cells no triangle touches and that can't
+// be reached from outside make up its interior, and boxes are grown over the interior from its deepest cells. Open
+// geometry and rooms (surfaces facing into the enclosed space) produce nothing, so the boxes never hide anything the
+// mesh itself doesn't.
+void BuildOccluders(const std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices, const L_SubmeshData& submesh,
+                    u32 submeshIndex, float minDiagonal, std::vector<L_OccluderData>& outOccluders, OccluderStats& stats);
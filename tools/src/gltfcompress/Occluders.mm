@@ -0,0 +1,406 @@
+#include "Occluders.h"
+
+#include <cfloat>
+#include <deque>
+
+// Cells a box is grown by before the separating axis test, so float error can only mark extra cells as surface
+static const float kCellInflation = 1e-3f;
+// Kept boxes are checked against their part shrunk by this fraction of a cell, they share faces with surface cells
+static const float kValidationShrink = 1e-2f;
+
+enum : u8
+{
+    kCellEmpty = 0,
+    kCellSurface,
+    kCellOutside,
+    kCellInterior
+};
+
+static u32 FindRoot(std::vector<u32>& parent, u32 v)
+{
+    while (parent[v] != v) {
+        parent[v] = parent[parent[v]];
+        v = parent[v];
+    }
+    return v;
+}
+
+// Groups the submesh's triangles into parts connected through shared positions, so hard edges and split UV seams
+// don't cut a closed shape apart whether or not the vertices were welded
+static std::vector<std::vector<u32>> FindConnectedParts(const std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices,
+                                                        const L_SubmeshData& submesh)
+{
+    std::vector<u32> used(indices.begin() + submesh.IndexOffset, indices.begin() + submesh.IndexOffset + submesh.IndexCount);
+    std::sort(used.begin(), used.end());
+    used.erase(std::unique(used.begin(), used.end()), used.end());
+
+    // Local vertex ids in position order, equal positions end up next to each other
+    std::vector<u32> byPosition(used.size());
+    for (u32 i = 0; i < used.size(); ++i)
+        byPosition[i] = i;
+    auto positionLess = [&](u32 a, u32 b) {
+        const vec3& pa = vertices[used[a]].Position;
+        const vec3& pb = vertices[used[b]].Position;
+        return pa.x != pb.x ? pa.x < pb.x : pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z;
+    };
+    std::sort(byPosition.begin(), byPosition.end(), positionLess);
+
+    std::vector<u32> parent(used.size());
+    for (u32 i = 0; i < used.size(); ++i)
+        parent[i] = i;
+    for (size_t i = 1; i < byPosition.size(); ++i) {
+        if (!positionLess(byPosition[i - 1], byPosition[i]))
+            parent[FindRoot(parent, byPosition[i])] = FindRoot(parent, byPosition[i - 1]);
+    }
+
+    auto localId = [&](u32 vertex) { return (u32)(std::lower_bound(used.begin(), used.end(), vertex) - used.begin()); };
+    for (u32 i = 0; i + 2 < submesh.IndexCount; i += 3) {
+        u32 a = FindRoot(parent, localId(indices[submesh.IndexOffset + i]));
+        u32 b = FindRoot(parent, localId(indices[submesh.IndexOffset + i + 1]));
+        u32 c = FindRoot(parent, localId(indices[submesh.IndexOffset + i + 2]));
+        parent[b] = a;
+        parent[FindRoot(parent, c)] = a;
+    }
+
+    // Triangles listed by the index offset of their first index
+    std::vector<u32> partOfRoot(used.size(), UINT32_MAX);
+    std::vector<std::vector<u32>> parts;
+    for (u32 i = 0; i + 2 < submesh.IndexCount; i += 3) {
+        u32 root = FindRoot(parent, localId(indices[submesh.IndexOffset + i]));
+        if (partOfRoot[root] == UINT32_MAX) {
+            partOfRoot[root] = (u32)parts.size();
+            parts.emplace_back();
+        }
+        parts[partOfRoot[root]].push_back(submesh.IndexOffset + i);
+    }
+    return parts;
+}
+
+// Separating axis test of a triangle against an axis-aligned box (Akenine-Moller), touching counts as overlapping
+static bool TriangleOverlapsBox(const vec3& center, const vec3& half, const vec3& a, const vec3& b, const vec3& c)
+{
+    vec3 v[3] = { a - center, b - center, c - center };
+    vec3 edges[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+    const vec3 boxAxes[3] = { vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f) };
+
+    auto separated = [&](const vec3& axis) {
+        float p0 = dot(v[0], axis);
+        float p1 = dot(v[1], axis);
+        float p2 = dot(v[2], axis);
+        float r = half.x * std::fabs(axis.x) + half.y * std::fabs(axis.y) + half.z * std::fabs(axis.z);
+        return std::min(p0, std::min(p1, p2)) > r || std::max(p0, std::max(p1, p2)) < -r;
+    };
+
+    for (const vec3& boxAxis : boxAxes) {
+        if (separated(boxAxis))
+            return false;
+        for (const vec3& edge : edges) {
+            if (separated(cross(boxAxis, edge)))
+                return false;
+        }
+    }
+    return !separated(cross(edges[0], edges[1]));
+}
+
+// Closest two-sided hit of the ray, geometric normal of the hit triangle in outNormal
+static bool IntersectPart(const std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices, const std::vector<u32>& triangles,
+                          const vec3& origin, const vec3& direction, vec3& outNormal)
+{
+    float closest = FLT_MAX;
+    for (u32 first : triangles) {
+        const vec3& a = vertices[indices[first]].Position;
+        const vec3& b = vertices[indices[first + 1]].Position;
+        const vec3& c = vertices[indices[first + 2]].Position;
+        vec3 ab = b - a;
+        vec3 ac = c - a;
+        vec3 p = cross(direction, ac);
+        float det = dot(ab, p);
+        if (std::fabs(det) < 1e-12f)
+            continue;
+        float inverseDet = 1.0f / det;
+        vec3 toOrigin = origin - a;
+        float u = dot(toOrigin, p) * inverseDet;
+        if (u < 0.0f || u > 1.0f)
+            continue;
+        vec3 q = cross(toOrigin, ab);
+        float w = dot(direction, q) * inverseDet;
+        if (w < 0.0f || u + w > 1.0f)
+            continue;
+        float t = dot(ac, q) * inverseDet;
+        if (t > 0.0f && t < closest) {
+            closest = t;
+            outNormal = cross(ab, ac);
+        }
+    }
+    return closest < FLT_MAX;
+}
+
+struct VoxelGrid
+{
+    u32 Size[3];
+    vec3 Origin;
+    vec3 Cell;
+    std::vector<u8> State;
+
+    u32 Index(u32 x, u32 y, u32 z) const { return (z * Size[1] + y) * Size[0] + x; }
+    vec3 CellMin(u32 x, u32 y, u32 z) const { return Origin + vec3(x * Cell.x, y * Cell.y, z * Cell.z); }
+};
+
+struct CellBox
+{
+    u32 Lo[3];
+    u32 Hi[3]; // Inclusive
+
+    uint64_t Volume() const { return (uint64_t)(Hi[0] - Lo[0] + 1) * (Hi[1] - Lo[1] + 1) * (Hi[2] - Lo[2] + 1); }
+};
+
+// True when the slab just past one face of the box is entirely interior
+static bool CanGrow(const VoxelGrid& grid, const CellBox& box, int axis, bool positive)
+{
+    u32 slab = positive ? box.Hi[axis] + 1 : box.Lo[axis] - 1;
+    if (positive ? slab >= grid.Size[axis] : box.Lo[axis] == 0)
+        return false;
+    int u = (axis + 1) % 3;
+    int v = (axis + 2) % 3;
+    for (u32 i = box.Lo[u]; i <= box.Hi[u]; ++i) {
+        for (u32 j = box.Lo[v]; j <= box.Hi[v]; ++j) {
+            u32 cell[3];
+            cell[axis] = slab;
+            cell[u] = i;
+            cell[v] = j;
+            if (grid.State[grid.Index(cell[0], cell[1], cell[2])] != kCellInterior)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Grows a box from a seed cell over interior cells. Round-robin growth over all faces and growth one axis at a time
+// in each of three orders are tried, the largest result wins.
+static CellBox GrowBox(const VoxelGrid& grid, u32 x, u32 y, u32 z)
+{
+    CellBox seed = { { x, y, z }, { x, y, z } };
+
+    CellBox box = seed;
+    for (bool grew = true; grew;) {
+        grew = false;
+        for (int face = 0; face < 6; ++face) {
+            int axis = face / 2;
+            bool positive = face & 1;
+            if (CanGrow(grid, box, axis, positive)) {
+                positive ? ++box.Hi[axis] : --box.Lo[axis];
+                grew = true;
+            }
+        }
+    }
+    CellBox best = box;
+
+    for (int first = 0; first < 3; ++first) {
+        box = seed;
+        for (int step = 0; step < 3; ++step) {
+            int axis = (first + step) % 3;
+            while (CanGrow(grid, box, axis, true))
+                ++box.Hi[axis];
+            while (CanGrow(grid, box, axis, false))
+                --box.Lo[axis];
+        }
+        if (box.Volume() > best.Volume())
+            best = box;
+    }
+    return best;
+}
+
+static float LargestFace(const vec3& extent)
+{
+    return std::max(extent.x * extent.y, std::max(extent.y * extent.z, extent.x * extent.z));
+}
+
+static void BuildPartOccluders(const std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices,
+                               const std::vector<u32>& triangles, const vec3& partMin, const vec3& partMax, u32 submeshIndex,
+                               std::vector<L_OccluderData>& outOccluders, OccluderStats& stats)
+{
+    vec3 extent = partMax - partMin;
+    if (extent.x <= 0.0f || extent.y <= 0.0f || extent.z <= 0.0f)
+        return;
+
+    // One padding cell on every side keeps the outside connected for the flood fill
+    VoxelGrid grid;
+    grid.Cell = extent * (1.0f / kOccluderGridSize);
+    grid.Origin = partMin - grid.Cell;
+    for (int axis = 0; axis < 3; ++axis)
+        grid.Size[axis] = kOccluderGridSize + 2;
+    grid.State.assign(grid.Size[0] * grid.Size[1] * grid.Size[2], kCellEmpty);
+
+    const float cell[3] = { grid.Cell.x, grid.Cell.y, grid.Cell.z };
+    const float origin[3] = { grid.Origin.x, grid.Origin.y, grid.Origin.z };
+    vec3 half = grid.Cell * (0.5f + kCellInflation);
+    for (u32 first : triangles) {
+        const vec3& a = vertices[indices[first]].Position;
+        const vec3& b = vertices[indices[first + 1]].Position;
+        const vec3& c = vertices[indices[first + 2]].Position;
+        vec3 lo = minVec3(a, minVec3(b, c));
+        vec3 hi = maxVec3(a, maxVec3(b, c));
+        const float los[3] = { lo.x, lo.y, lo.z };
+        const float his[3] = { hi.x, hi.y, hi.z };
+
+        u32 begin[3], end[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            float lowCell = std::floor((los[axis] - origin[axis]) / cell[axis]) - 1.0f;
+            float highCell = std::floor((his[axis] - origin[axis]) / cell[axis]) + 1.0f;
+            begin[axis] = (u32)std::max(lowCell, 0.0f);
+            end[axis] = (u32)std::min(highCell, (float)grid.Size[axis] - 1.0f);
+        }
+        for (u32 z = begin[2]; z <= end[2]; ++z) {
+            for (u32 y = begin[1]; y <= end[1]; ++y) {
+                for (u32 x = begin[0]; x <= end[0]; ++x) {
+                    u8& state = grid.State[grid.Index(x, y, z)];
+                    if (state == kCellEmpty && TriangleOverlapsBox(grid.CellMin(x, y, z) + grid.Cell * 0.5f, half, a, b, c))
+                        state = kCellSurface;
+                }
+            }
+        }
+    }
+
+    // Everything the outside reaches without crossing a surface cell, the rest of the empty cells is enclosed
+    std::deque<u32> queue;
+    grid.State[0] = kCellOutside;
+    queue.push_back(0);
+    const int offsets[6][3] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+    while (!queue.empty()) {
+        u32 index = queue.front();
+        queue.pop_front();
+        int pos[3] = { (int)(index % grid.Size[0]), (int)(index / grid.Size[0] % grid.Size[1]), (int)(index / (grid.Size[0] * grid.Size[1])) };
+        for (const auto& offset : offsets) {
+            int n[3] = { pos[0] + offset[0], pos[1] + offset[1], pos[2] + offset[2] };
+            if (n[0] < 0 || n[1] < 0 || n[2] < 0 || n[0] >= (int)grid.Size[0] || n[1] >= (int)grid.Size[1] || n[2] >= (int)grid.Size[2])
+                continue;
+            u32 neighbour = grid.Index(n[0], n[1], n[2]);
+            if (grid.State[neighbour] == kCellEmpty) {
+                grid.State[neighbour] = kCellOutside;
+                queue.push_back(neighbour);
+            }
+        }
+    }
+
+    // Distance of every interior cell to the nearest non-interior one, seeds are taken deepest first
+    std::vector<u32> depth(grid.State.size(), 0);
+    for (u32 i = 0; i < grid.State.size(); ++i) {
+        if (grid.State[i] == kCellEmpty) {
+            grid.State[i] = kCellInterior;
+            depth[i] = UINT32_MAX;
+        } else {
+            queue.push_back(i);
+        }
+    }
+    if (queue.size() == grid.State.size())
+        return;
+    while (!queue.empty()) {
+        u32 index = queue.front();
+        queue.pop_front();
+        int pos[3] = { (int)(index % grid.Size[0]), (int)(index / grid.Size[0] % grid.Size[1]), (int)(index / (grid.Size[0] * grid.Size[1])) };
+        for (const auto& offset : offsets) {
+            int n[3] = { pos[0] + offset[0], pos[1] + offset[1], pos[2] + offset[2] };
+            if (n[0] < 0 || n[1] < 0 || n[2] < 0 || n[0] >= (int)grid.Size[0] || n[1] >= (int)grid.Size[1] || n[2] >= (int)grid.Size[2])
+                continue;
+            u32 neighbour = grid.Index(n[0], n[1], n[2]);
+            if (depth[neighbour] == UINT32_MAX) {
+                depth[neighbour] = depth[index] + 1;
+                queue.push_back(neighbour);
+            }
+        }
+    }
+
+    float minFace = LargestFace(extent) * kMinOccluderFaceFraction;
+    std::vector<bool> covered(grid.State.size(), false);
+    u32 kept = 0;
+    for (u32 attempt = 0; attempt < 2 * kMaxOccludersPerPart && kept < kMaxOccludersPerPart; ++attempt) {
+        u32 seed = UINT32_MAX;
+        for (u32 i = 0; i < grid.State.size(); ++i) {
+            if (grid.State[i] == kCellInterior && !covered[i] && (seed == UINT32_MAX || depth[i] > depth[seed]))
+                seed = i;
+        }
+        if (seed == UINT32_MAX)
+            break;
+
+        CellBox box = GrowBox(grid, seed % grid.Size[0], seed / grid.Size[0] % grid.Size[1], seed / (grid.Size[0] * grid.Size[1]));
+        for (u32 z = box.Lo[2]; z <= box.Hi[2]; ++z) {
+            for (u32 y = box.Lo[1]; y <= box.Hi[1]; ++y) {
+                for (u32 x = box.Lo[0]; x <= box.Hi[0]; ++x)
+                    covered[grid.Index(x, y, z)] = true;
+            }
+        }
+
+        L_OccluderData occluder = {};
+        occluder.SubmeshIndex = submeshIndex;
+        occluder.Min = grid.CellMin(box.Lo[0], box.Lo[1], box.Lo[2]);
+        occluder.Max = grid.CellMin(box.Hi[0] + 1, box.Hi[1] + 1, box.Hi[2] + 1);
+        vec3 boxExtent = occluder.Max - occluder.Min;
+        // Seeds only get shallower, so later boxes would be smaller still
+        if (LargestFace(boxExtent) < minFace)
+            break;
+
+        // Enclosed space is only solid when the surfaces around it face away from it. The first surface hit from the
+        // center along each axis has to be left through its front, a room's walls face into it and are rejected.
+        const vec3 directions[6] = { vec3(-1.0f, 0.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f),
+                                     vec3(0.0f, 1.0f, 0.0f),  vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, 0.0f, 1.0f) };
+        vec3 center = (occluder.Min + occluder.Max) * 0.5f;
+        bool solid = true;
+        for (const vec3& direction : directions) {
+            vec3 normal;
+            if (!IntersectPart(vertices, indices, triangles, center, direction, normal) || dot(normal, direction) <= 0.0f) {
+                solid = false;
+                break;
+            }
+        }
+        if (!solid) {
+            stats.Rejected++;
+            continue;
+        }
+
+        // A box poking through the surface would hide what is in front of it, it is dropped rather than shipped
+        vec3 shrunkHalf = boxExtent * 0.5f - grid.Cell * kValidationShrink;
+        bool overlaps = false;
+        for (u32 first : triangles) {
+            if (TriangleOverlapsBox(center, shrunkHalf, vertices[indices[first]].Position, vertices[indices[first + 1]].Position,
+                                    vertices[indices[first + 2]].Position)) {
+                overlaps = true;
+                break;
+            }
+        }
+        if (overlaps) {
+            stats.Errors++;
+            continue;
+        }
+
+        outOccluders.push_back(occluder);
+        stats.Boxes++;
+        stats.BoxVolume += (double)boxExtent.x * boxExtent.y * boxExtent.z;
+        kept++;
+    }
+}
+
+void BuildOccluders(const std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices, const L_SubmeshData& submesh,
+                    u32 submeshIndex, float minDiagonal, std::vector<L_OccluderData>& outOccluders, OccluderStats& stats)
+{
+    if ((submesh.Max - submesh.Min).length() < minDiagonal)
+        return;
+    stats.Submeshes++;
+
+    for (const std::vector<u32>& triangles : FindConnectedParts(vertices, indices, submesh)) {
+        vec3 partMin(FLT_MAX);
+        vec3 partMax(-FLT_MAX);
+        for (u32 first : triangles) {
+            for (u32 corner = 0; corner < 3; ++corner) {
+                partMin = minVec3(partMin, vertices[indices[first + corner]].Position);
+                partMax = maxVec3(partMax, vertices[indices[first + corner]].Position);
+            }
+        }
+        vec3 extent = partMax - partMin;
+        if (extent.length() < minDiagonal)
+            continue;
+
+        stats.Parts++;
+        stats.PartVolume += (double)extent.x * extent.y * extent.z;
+        BuildPartOccluders(vertices, indices, triangles, partMin, partMax, submeshIndex, outOccluders, stats);
+    }
+}
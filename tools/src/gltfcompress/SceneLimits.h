@@ -0,0 +1,8 @@
+//
+// Scene-wide limits of the runtime renderer, shared by gltfcompress so cooked files are budgeted against the same numbers
+//
+
+#pragma once
+
+// Draws of every loaded model together, one per submesh of each placed mesh instance
+constexpr int MAX_SCENE_INSTANCES = 2048;
@@ -0,0 +1,32 @@
+//
+// Quadric error edge-collapse simplification used to build LOD chains
+//
+
+#pragma once
+
+#include "MeshTypes.h"
+
+#include <vector>
+
+// Levels generated below the full-resolution submesh
+static const u32 kMaxLodLevels = 4;
+// Each level targets this fraction of the previous level's triangles
+static const float kLodReduction = 0.5f;
+// Submeshes at or below this many triangles don't get another level
+static const u32 kLodMinTriangles = 64;
+
+// Simplifies one triangle list until it reaches targetIndexCount or every remaining collapse would cost more than maxError.
+// Collapses snap a vertex onto a neighbour instead of creating new vertices, so the result indexes a subset of the input
+// vertices. Attribute seams are locked and open borders only collapse along themselves.
+// Returns the geometric error of the result in world units, including the attribute penalty.
+float SimplifyIndices(const std::vector<L_StaticVertex>& vertices, const u32* indices, size_t indexCount,
+                      size_t targetIndexCount, float maxError, std::vector<u32>& outIndices);
+
+struct LodLevel
+{
+    std::vector<u32> Indices;
+    float Error = 0.0f; // Relative to the full-resolution submesh
+};
+
+// Builds up to maxLevels successively coarser index lists for one submesh, stopping once simplification stalls
+std::vector<LodLevel> BuildLodChain(const std::vector<L_StaticVertex>& vertices, const u32* indices, size_t indexCount, u32 maxLevels);
@@ -0,0 +1,339 @@
+#include "Simplifier.h"
+
+#include <cfloat>
+#include <unordered_map>
+
+// Open borders resist collapsing across themselves this much more than the surface does
+static const float kBorderWeight = 10.0f;
+// Attribute penalties, scaled by the squared edge length so they stay in world units
+static const float kNormalWeight = 0.5f;
+static const float kUVWeight = 1.0f;
+// Collapses that turn a triangle further than this (cosine) are rejected
+static const float kMinFlipCosine = 0.25f;
+// A level that keeps more than this fraction of its parent's triangles isn't worth storing
+static const float kLodStallRatio = 0.85f;
+
+enum class VertexKind : u8
+{
+    Manifold, // Collapses in any direction
+    Border,   // On an open border, only collapses along it
+    Locked    // Attribute seam or non-manifold, never moves
+};
+
+// Symmetric 4x4 error matrix of a sum of squared plane distances, plus the total weight of the planes
+struct Quadric
+{
+    double a2 = 0, ab = 0, ac = 0, ad = 0;
+    double b2 = 0, bc = 0, bd = 0;
+    double c2 = 0, cd = 0;
+    double d2 = 0;
+    double w = 0;
+
+    void AddPlane(const vec3& n, float d, float weight)
+    {
+        a2 += weight * n.x * n.x; ab += weight * n.x * n.y; ac += weight * n.x * n.z; ad += weight * n.x * d;
+        b2 += weight * n.y * n.y; bc += weight * n.y * n.z; bd += weight * n.y * d;
+        c2 += weight * n.z * n.z; cd += weight * n.z * d;
+        d2 += weight * (double)d * d;
+        w += weight;
+    }
+
+    void Add(const Quadric& q)
+    {
+        a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+        b2 += q.b2; bc += q.bc; bd += q.bd;
+        c2 += q.c2; cd += q.cd;
+        d2 += q.d2;
+        w += q.w;
+    }
+
+    double Evaluate(const vec3& p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double error = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                     + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                     + c2 * z * z + 2 * cd * z
+                     + d2;
+        return std::max(error, 0.0);
+    }
+};
+
+struct PositionKey
+{
+    u32 Bits[3];
+    bool operator==(const PositionKey& other) const { return memcmp(Bits, other.Bits, sizeof(Bits)) == 0; }
+};
+
+struct PositionKeyHash
+{
+    size_t operator()(const PositionKey& key) const
+    {
+        return (key.Bits[0] * 73856093u) ^ (key.Bits[1] * 19349663u) ^ (key.Bits[2] * 83492791u);
+    }
+};
+
+static uint64_t EdgeKey(u32 a, u32 b)
+{
+    return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+struct Collapse
+{
+    u32 From;
+    u32 To;
+    float Cost; // Squared error
+};
+
+float SimplifyIndices(const std::vector<L_StaticVertex>& vertices, const u32* indices, size_t indexCount,
+                      size_t targetIndexCount, float maxError, std::vector<u32>& outIndices)
+{
+    // Work on a compact local copy of the vertices this range references
+    std::unordered_map<u32, u32> localIndex;
+    std::vector<u32> globalIndex;
+    std::vector<u32> triangles(indexCount);
+    for (size_t i = 0; i < indexCount; ++i) {
+        auto inserted = localIndex.emplace(indices[i], (u32)globalIndex.size());
+        if (inserted.second)
+            globalIndex.push_back(indices[i]);
+        triangles[i] = inserted.first->second;
+    }
+    const u32 vertexCount = (u32)globalIndex.size();
+    auto position = [&](u32 v) -> const vec3& { return vertices[globalIndex[v]].Position; };
+
+    // Vertices at the same position belong to one group, more than one vertex per group marks an attribute seam
+    std::unordered_map<PositionKey, u32, PositionKeyHash> groupIndex;
+    std::vector<u32> group(vertexCount);
+    std::vector<u32> groupSize;
+    for (u32 v = 0; v < vertexCount; ++v) {
+        PositionKey key;
+        memcpy(key.Bits, &position(v).x, sizeof(key.Bits));
+        auto inserted = groupIndex.emplace(key, (u32)groupSize.size());
+        if (inserted.second)
+            groupSize.push_back(0);
+        group[v] = inserted.first->second;
+        groupSize[group[v]]++;
+    }
+
+    // Edges are counted between position groups so seams aren't mistaken for open borders
+    std::unordered_map<uint64_t, u32> edgeUses;
+    for (size_t t = 0; t < indexCount; t += 3) {
+        for (int k = 0; k < 3; ++k)
+            edgeUses[EdgeKey(group[triangles[t + k]], group[triangles[t + (k + 1) % 3]])]++;
+    }
+    auto isBorderEdge = [&](u32 a, u32 b) {
+        auto it = edgeUses.find(EdgeKey(group[a], group[b]));
+        return it != edgeUses.end() && it->second == 1;
+    };
+
+    std::vector<VertexKind> kind(vertexCount, VertexKind::Manifold);
+    for (u32 v = 0; v < vertexCount; ++v) {
+        if (groupSize[group[v]] > 1)
+            kind[v] = VertexKind::Locked;
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t t = 0; t < indexCount; t += 3) {
+        const u32* triangle = &triangles[t];
+        vec3 normal = cross(position(triangle[1]) - position(triangle[0]), position(triangle[2]) - position(triangle[0]));
+        float area = normal.length() * 0.5f;
+        if (area == 0.0f)
+            continue;
+        normal = normal.normalize();
+
+        for (int k = 0; k < 3; ++k)
+            quadrics[triangle[k]].AddPlane(normal, -dot(normal, position(triangle[k])), area);
+
+        for (int k = 0; k < 3; ++k) {
+            u32 a = triangle[k];
+            u32 b = triangle[(k + 1) % 3];
+            auto uses = edgeUses[EdgeKey(group[a], group[b])];
+            if (uses > 2) {
+                kind[a] = VertexKind::Locked;
+                kind[b] = VertexKind::Locked;
+            } else if (uses == 1) {
+                if (kind[a] == VertexKind::Manifold)
+                    kind[a] = VertexKind::Border;
+                if (kind[b] == VertexKind::Manifold)
+                    kind[b] = VertexKind::Border;
+
+                // Plane through the edge perpendicular to the triangle keeps the border in place
+                vec3 edge = position(b) - position(a);
+                vec3 borderNormal = cross(edge, normal).normalize();
+                float weight = dot(edge, edge) * kBorderWeight;
+                quadrics[a].AddPlane(borderNormal, -dot(borderNormal, position(a)), weight);
+                quadrics[b].AddPlane(borderNormal, -dot(borderNormal, position(a)), weight);
+            }
+        }
+    }
+
+    auto collapseCost = [&](u32 from, u32 to) {
+        Quadric q = quadrics[from];
+        q.Add(quadrics[to]);
+        double error = q.w > 0.0 ? q.Evaluate(position(to)) / q.w : 0.0;
+
+        const L_StaticVertex& a = vertices[globalIndex[from]];
+        const L_StaticVertex& b = vertices[globalIndex[to]];
+        vec3 edge = b.Position - a.Position;
+        vec3 normalDelta = b.Normal - a.Normal;
+        float du = b.UV.x - a.UV.x;
+        float dv = b.UV.y - a.UV.y;
+        error += dot(edge, edge) * (kNormalWeight * dot(normalDelta, normalDelta) + kUVWeight * (du * du + dv * dv));
+        return (float)error;
+    };
+
+    const double maxCost = (double)maxError * maxError;
+    const size_t targetTriangles = targetIndexCount / 3;
+    size_t triangleCount = indexCount / 3;
+    float resultCost = 0.0f;
+
+    std::vector<u32> remap(vertexCount);
+    std::vector<u32> adjacencyOffsets(vertexCount + 1);
+    std::vector<u32> adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<u8> touched(vertexCount);
+
+    while (triangleCount > targetTriangles) {
+        // Vertex -> triangle adjacency of the current triangles
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (u32 index : triangles)
+            adjacencyOffsets[index + 1]++;
+        for (u32 v = 0; v < vertexCount; ++v)
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        adjacency.resize(triangles.size());
+        {
+            std::vector<u32> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < triangles.size(); ++i)
+                adjacency[cursor[triangles[i]]++] = (u32)(i / 3);
+        }
+
+        // Cheapest valid collapse per vertex
+        collapses.clear();
+        std::vector<Collapse> best(vertexCount, Collapse{ 0, 0, FLT_MAX });
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            for (int k = 0; k < 3; ++k) {
+                u32 a = triangles[t + k];
+                u32 b = triangles[t + (k + 1) % 3];
+                for (int direction = 0; direction < 2; ++direction) {
+                    u32 from = direction == 0 ? a : b;
+                    u32 to = direction == 0 ? b : a;
+                    if (kind[from] == VertexKind::Locked)
+                        continue;
+                    if (kind[from] == VertexKind::Border && !isBorderEdge(from, to))
+                        continue;
+
+                    float cost = collapseCost(from, to);
+                    if (cost < best[from].Cost)
+                        best[from] = Collapse{ from, to, cost };
+                }
+            }
+        }
+        for (u32 v = 0; v < vertexCount; ++v) {
+            if (best[v].Cost <= maxCost)
+                collapses.push_back(best[v]);
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.Cost < b.Cost; });
+
+        for (u32 v = 0; v < vertexCount; ++v)
+            remap[v] = v;
+        std::fill(touched.begin(), touched.end(), 0);
+
+        size_t removed = 0;
+        for (const Collapse& collapse : collapses) {
+            if (triangleCount - removed <= targetTriangles)
+                break;
+            if (touched[collapse.From] || touched[collapse.To])
+                continue;
+
+            // Reject collapses that fold a surviving triangle over
+            bool flips = false;
+            u32 collapsing = 0;
+            for (u32 i = adjacencyOffsets[collapse.From]; i < adjacencyOffsets[collapse.From + 1] && !flips; ++i) {
+                const u32* triangle = &triangles[adjacency[i] * 3];
+                if (triangle[0] == collapse.To || triangle[1] == collapse.To || triangle[2] == collapse.To) {
+                    collapsing++;
+                    continue;
+                }
+
+                vec3 p[3];
+                for (int k = 0; k < 3; ++k)
+                    p[k] = position(triangle[k]);
+                vec3 before = cross(p[1] - p[0], p[2] - p[0]);
+                for (int k = 0; k < 3; ++k) {
+                    if (triangle[k] == collapse.From)
+                        p[k] = position(collapse.To);
+                }
+                vec3 after = cross(p[1] - p[0], p[2] - p[0]);
+                flips = dot(before, after) <= kMinFlipCosine * before.length() * after.length();
+            }
+            if (flips)
+                continue;
+
+            remap[collapse.From] = collapse.To;
+            quadrics[collapse.To].Add(quadrics[collapse.From]);
+            for (u32 i = adjacencyOffsets[collapse.From]; i < adjacencyOffsets[collapse.From + 1]; ++i) {
+                const u32* triangle = &triangles[adjacency[i] * 3];
+                for (int k = 0; k < 3; ++k)
+                    touched[triangle[k]] = 1;
+            }
+            removed += collapsing;
+            resultCost = std::max(resultCost, collapse.Cost);
+        }
+
+        if (removed == 0)
+            break;
+
+        size_t write = 0;
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            u32 a = remap[triangles[t + 0]];
+            u32 b = remap[triangles[t + 1]];
+            u32 c = remap[triangles[t + 2]];
+            if (a == b || b == c || c == a)
+                continue;
+            triangles[write++] = a;
+            triangles[write++] = b;
+            triangles[write++] = c;
+        }
+        triangles.resize(write);
+        triangleCount = write / 3;
+    }
+
+    outIndices.resize(triangles.size());
+    for (size_t i = 0; i < triangles.size(); ++i)
+        outIndices[i] = globalIndex[triangles[i]];
+    return std::sqrt(resultCost);
+}
+
+std::vector<LodLevel> BuildLodChain(const std::vector<L_StaticVertex>& vertices, const u32* indices, size_t indexCount, u32 maxLevels)
+{
+    std::vector<LodLevel> levels;
+
+    vec3 boundsMin(FLT_MAX);
+    vec3 boundsMax(-FLT_MAX);
+    for (size_t i = 0; i < indexCount; ++i) {
+        boundsMin = minVec3(boundsMin, vertices[indices[i]].Position);
+        boundsMax = maxVec3(boundsMax, vertices[indices[i]].Position);
+    }
+    // Past this a level no longer resembles the submesh, it would only ever show up as a few pixels
+    float maxError = (boundsMax - boundsMin).length() * 0.25f;
+
+    const u32* source = indices;
+    size_t sourceCount = indexCount;
+    float error = 0.0f;
+    while (levels.size() < maxLevels && sourceCount / 3 > kLodMinTriangles) {
+        size_t target = std::max<size_t>((size_t)(sourceCount / 3 * kLodReduction), kLodMinTriangles) * 3;
+
+        LodLevel level;
+        float levelError = SimplifyIndices(vertices, source, sourceCount, target, maxError, level.Indices);
+        if (level.Indices.empty() || level.Indices.size() > sourceCount * kLodStallRatio)
+            break;
+
+        // Each level simplifies the previous one, so errors add up
+        error += levelError;
+        level.Error = error;
+        levels.push_back(std::move(level));
+        source = levels.back().Indices.data();
+        sourceCount = levels.back().Indices.size();
+    }
+
+    return levels;
+}
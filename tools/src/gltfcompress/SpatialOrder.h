@@ -0,0 +1,82 @@
+//
+// Space-filling curve codes for ordering submeshes and scene instances, shared by gltfcompress and the runtime
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+enum class SpatialOrder : uint32_t
+{
+    None = 0,    // Keep the source order
+    Morton = 1,  // Z-order, cheap but jumps between octants
+    Hilbert = 2  // Every step moves to a neighbouring cell
+};
+
+// Bits per axis, three axes fill a 30-bit code
+static const uint32_t kSpatialOrderBits = 10;
+
+// Spreads the low 10 bits of v so there are two zero bits between each of them
+inline uint32_t SpreadBits3(uint32_t v)
+{
+    v &= 0x3FF;
+    v = (v | (v << 16)) & 0x030000FF;
+    v = (v | (v << 8)) & 0x0300F00F;
+    v = (v | (v << 4)) & 0x030C30C3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+inline uint32_t EncodeMorton3(uint32_t x, uint32_t y, uint32_t z)
+{
+    return (SpreadBits3(x) << 2) | (SpreadBits3(y) << 1) | SpreadBits3(z);
+}
+
+// Skilling's transform from axes to the transposed Hilbert index, then interleaved into one code
+inline uint32_t EncodeHilbert3(uint32_t x, uint32_t y, uint32_t z)
+{
+    uint32_t axes[3] = { x, y, z };
+    const uint32_t top = 1u << (kSpatialOrderBits - 1);
+
+    for (uint32_t q = top; q > 1; q >>= 1) {
+        uint32_t p = q - 1;
+        for (int i = 0; i < 3; i++) {
+            if (axes[i] & q) {
+                axes[0] ^= p;
+            } else {
+                uint32_t t = (axes[0] ^ axes[i]) & p;
+                axes[0] ^= t;
+                axes[i] ^= t;
+            }
+        }
+    }
+
+    for (int i = 1; i < 3; i++)
+        axes[i] ^= axes[i - 1];
+    uint32_t t = 0;
+    for (uint32_t q = top; q > 1; q >>= 1) {
+        if (axes[2] & q)
+            t ^= q - 1;
+    }
+    for (int i = 0; i < 3; i++)
+        axes[i] ^= t;
+
+    return EncodeMorton3(axes[0], axes[1], axes[2]);
+}
+
+// Code of point within [boundsMin, boundsMax], 0 for SpatialOrder::None
+inline uint32_t GetSpatialCode(SpatialOrder order, const float point[3], const float boundsMin[3], const float boundsMax[3])
+{
+    if (order == SpatialOrder::None)
+        return 0;
+
+    const float scale = (float)((1u << kSpatialOrderBits) - 1);
+    uint32_t cell[3];
+    for (int k = 0; k < 3; k++) {
+        float extent = boundsMax[k] - boundsMin[k];
+        float t = extent > 0.0f ? std::clamp((point[k] - boundsMin[k]) / extent, 0.0f, 1.0f) : 0.0f;
+        cell[k] = (uint32_t)(t * scale + 0.5f);
+    }
+    return order == SpatialOrder::Morton ? EncodeMorton3(cell[0], cell[1], cell[2]) : EncodeHilbert3(cell[0], cell[1], cell[2]);
+}
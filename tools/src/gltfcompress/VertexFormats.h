@@ -0,0 +1,54 @@
+//
+// Vertex and index formats written to L_MeshFileHeader::VertexFormat / IndexFormat
+//
+
+#pragma once
+
+#include "MeshTypes.h"
+
+#include <vector>
+
+enum class VertexFormat : u32
+{
+    Float = 0,  // L_StaticVertex, 48 bytes
+    Compact = 1 // L_CompactVertex, 20 bytes
+};
+
+size_t GetVertexSize(VertexFormat format);
+
+// Size of one entry of the position-only stream, vec3 or L_CompactPosition
+size_t GetPositionSize(VertexFormat format);
+
+// Copies the positions of either vertex array into a tightly packed stream. compactVertices is only read for Compact.
+std::vector<u8> BuildPositionStream(VertexFormat format, const std::vector<L_StaticVertex>& vertices,
+                                    const std::vector<L_CompactVertex>& compactVertices);
+
+enum class IndexFormat : u32
+{
+    UInt32 = 0,
+    UInt16 = 1 // Relative to the per-submesh base vertex table
+};
+
+struct QuantizationError
+{
+    float MaxPosition = 0.0f;       // World units
+    float MaxNormalDegrees = 0.0f;
+    float MaxTangentDegrees = 0.0f;
+    float MaxUV = 0.0f;
+    u32 TangentSignFlips = 0;
+};
+
+// Gives every submesh its own vertex range by duplicating vertices an earlier submesh already uses,
+// then shrinks the submesh bounds to the vertices it references. Returns the number of duplicates.
+u32 SplitSharedVertices(std::vector<L_StaticVertex>& vertices, std::vector<u32>& indices, std::vector<L_SubmeshData>& submeshes);
+
+// Quantizes vertices into the compact format, positions relative to the bounds of the submesh that owns them.
+// Each submesh must own its vertices (see SplitSharedVertices). The float vertices are replaced with the
+// decoded values, so later stages and statistics see exactly what the GPU will.
+QuantizationError EncodeCompactVertices(std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices,
+                                        const std::vector<L_SubmeshData>& submeshes, std::vector<L_CompactVertex>& outVertices);
+
+// Rebases every submesh and its LOD ranges onto the lowest vertex the submesh references and narrows the indices to 16 bits.
+// Fails without touching the outputs when a submesh spans more than 65536 vertices; returns that submesh in outFailedSubmesh.
+bool BuildShortIndices(const std::vector<u32>& indices, const std::vector<L_SubmeshData>& submeshes, const std::vector<L_LodData>& lods,
+                       std::vector<u16>& outIndices, std::vector<u32>& outBaseVertices, u32* outFailedSubmesh = nullptr);
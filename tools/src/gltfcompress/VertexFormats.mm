@@ -0,0 +1,277 @@
+#include "VertexFormats.h"
+
+#include <cfloat>
+#include <cstring>
+
+size_t GetVertexSize(VertexFormat format)
+{
+    switch (format) {
+        case VertexFormat::Compact: return sizeof(L_CompactVertex);
+        case VertexFormat::Float: break;
+    }
+    return sizeof(L_StaticVertex);
+}
+
+size_t GetPositionSize(VertexFormat format)
+{
+    switch (format) {
+        case VertexFormat::Compact: return sizeof(L_CompactPosition);
+        case VertexFormat::Float: break;
+    }
+    return sizeof(vec3);
+}
+
+std::vector<u8> BuildPositionStream(VertexFormat format, const std::vector<L_StaticVertex>& vertices,
+                                    const std::vector<L_CompactVertex>& compactVertices)
+{
+    std::vector<u8> stream(vertices.size() * GetPositionSize(format));
+    if (format == VertexFormat::Compact) {
+        L_CompactPosition* positions = (L_CompactPosition*)stream.data();
+        for (size_t i = 0; i < compactVertices.size(); ++i)
+            memcpy(positions[i].Position, compactVertices[i].Position, sizeof(positions[i].Position));
+    } else {
+        vec3* positions = (vec3*)stream.data();
+        for (size_t i = 0; i < vertices.size(); ++i)
+            positions[i] = vertices[i].Position;
+    }
+    return stream;
+}
+
+u32 SplitSharedVertices(std::vector<L_StaticVertex>& vertices, std::vector<u32>& indices, std::vector<L_SubmeshData>& submeshes)
+{
+    const u32 kUnowned = ~0u;
+    std::vector<u32> owner(vertices.size(), kUnowned);
+    std::vector<u32> duplicate(vertices.size(), kUnowned);
+    u32 duplicated = 0;
+
+    for (u32 s = 0; s < submeshes.size(); ++s) {
+        L_SubmeshData& submesh = submeshes[s];
+        vec3 boundsMin(FLT_MAX);
+        vec3 boundsMax(-FLT_MAX);
+
+        for (u32 i = submesh.IndexOffset; i < submesh.IndexOffset + submesh.IndexCount; ++i) {
+            u32 index = indices[i];
+            if (owner[index] == kUnowned) {
+                owner[index] = s;
+            } else if (owner[index] != s) {
+                // Duplicates are only reused within the submesh that made them
+                if (duplicate[index] == kUnowned || owner[duplicate[index]] != s) {
+                    duplicate[index] = (u32)vertices.size();
+                    owner.push_back(s);
+                    vertices.push_back(vertices[index]);
+                    duplicated++;
+                }
+                index = duplicate[index];
+            }
+
+            indices[i] = index;
+            boundsMin = minVec3(boundsMin, vertices[index].Position);
+            boundsMax = maxVec3(boundsMax, vertices[index].Position);
+        }
+
+        if (submesh.IndexCount > 0) {
+            submesh.Min = boundsMin;
+            submesh.Max = boundsMax;
+        }
+    }
+
+    return duplicated;
+}
+
+static u16 FloatToHalf(float value)
+{
+    u32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    u32 sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    u32 mantissa = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff)
+        return (u16)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    if (exponent >= 31)
+        return (u16)(sign | 0x7c00);
+    if (exponent <= 0) {
+        if (exponent < -10)
+            return (u16)sign;
+        // Denormal, round to nearest
+        mantissa |= 0x800000;
+        u32 shift = (u32)(14 - exponent);
+        u32 half = (mantissa + (1u << (shift - 1))) >> shift;
+        return (u16)(sign | half);
+    }
+
+    // Round to nearest, a carry into the exponent is still the correct result
+    u32 half = ((u32)exponent << 10) | (mantissa >> 13);
+    half += (mantissa >> 12) & 1;
+    return (u16)(sign | std::min<u32>(half, 0x7c00));
+}
+
+static float HalfToFloat(u16 value)
+{
+    u32 sign = (u32)(value & 0x8000) << 16;
+    u32 exponent = (value >> 10) & 0x1f;
+    u32 mantissa = value & 0x3ff;
+
+    float result;
+    if (exponent == 0) {
+        result = std::ldexp((float)mantissa, -24);
+    } else if (exponent == 31) {
+        result = mantissa ? NAN : INFINITY;
+    } else {
+        result = std::ldexp((float)(mantissa | 0x400), (int)exponent - 25);
+    }
+
+    u32 bits;
+    memcpy(&bits, &result, sizeof(bits));
+    bits |= sign;
+    memcpy(&result, &bits, sizeof(bits));
+    return result;
+}
+
+static i16 EncodeSnorm16(float value)
+{
+    return (i16)std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+static float DecodeSnorm16(i16 value)
+{
+    return std::max(value / 32767.0f, -1.0f);
+}
+
+static void OctEncode(const vec3& direction, i16* out)
+{
+    float sum = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+    if (sum == 0.0f) {
+        out[0] = 0;
+        out[1] = 0;
+        return;
+    }
+
+    float x = direction.x / sum;
+    float y = direction.y / sum;
+    if (direction.z < 0.0f) {
+        // Fold the lower hemisphere over the diagonals
+        float foldedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+
+    out[0] = EncodeSnorm16(x);
+    out[1] = EncodeSnorm16(y);
+}
+
+// Matches oct_decode in assets/shaders/common/scene_ab.h
+static vec3 OctDecode(float x, float y)
+{
+    vec3 n(x, y, 1.0f - std::abs(x) - std::abs(y));
+    float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return n.normalize();
+}
+
+static float AngleDegrees(const vec3& a, const vec3& b)
+{
+    float cosine = std::clamp(dot(a.normalize(), b.normalize()), -1.0f, 1.0f);
+    return std::acos(cosine) * (180.0f / 3.14159265f);
+}
+
+QuantizationError EncodeCompactVertices(std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices,
+                                        const std::vector<L_SubmeshData>& submeshes, std::vector<L_CompactVertex>& outVertices)
+{
+    QuantizationError error;
+
+    std::vector<u32> owner(vertices.size(), 0);
+    for (u32 s = 0; s < submeshes.size(); ++s) {
+        for (u32 i = submeshes[s].IndexOffset; i < submeshes[s].IndexOffset + submeshes[s].IndexCount; ++i)
+            owner[indices[i]] = s;
+    }
+
+    outVertices.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        L_StaticVertex& v = vertices[i];
+        L_CompactVertex& out = outVertices[i];
+        memset(&out, 0, sizeof(out));
+
+        const L_SubmeshData& submesh = submeshes.empty() ? L_SubmeshData{} : submeshes[owner[i]];
+        const float* boundsMin = &submesh.Min.x;
+        const float* boundsMax = &submesh.Max.x;
+        const float* position = &v.Position.x;
+
+        float decodedPosition[3];
+        for (int k = 0; k < 3; ++k) {
+            float extent = boundsMax[k] - boundsMin[k];
+            float t = extent > 0.0f ? std::clamp((position[k] - boundsMin[k]) / extent, 0.0f, 1.0f) : 0.0f;
+            out.Position[k] = (u16)std::lround(t * 65535.0f);
+            decodedPosition[k] = boundsMin[k] + extent * (out.Position[k] / 65535.0f);
+            error.MaxPosition = std::max(error.MaxPosition, std::abs(decodedPosition[k] - position[k]));
+        }
+
+        out.UV[0] = FloatToHalf(v.UV.x);
+        out.UV[1] = FloatToHalf(v.UV.y);
+        vec2 decodedUV(HalfToFloat(out.UV[0]), HalfToFloat(out.UV[1]));
+        error.MaxUV = std::max({ error.MaxUV, std::abs(decodedUV.x - v.UV.x), std::abs(decodedUV.y - v.UV.y) });
+
+        OctEncode(v.Normal, out.Normal);
+        vec3 decodedNormal = OctDecode(DecodeSnorm16(out.Normal[0]), DecodeSnorm16(out.Normal[1]));
+        if (v.Normal.length() > 0.0f)
+            error.MaxNormalDegrees = std::max(error.MaxNormalDegrees, AngleDegrees(v.Normal, decodedNormal));
+
+        vec3 tangent = v.Tangent.xyz();
+        OctEncode(tangent, out.Tangent);
+        out.Tangent[1] = (i16)((out.Tangent[1] & ~1) | (v.Tangent.w < 0.0f ? 1 : 0));
+        vec3 decodedTangent = OctDecode(DecodeSnorm16(out.Tangent[0]), DecodeSnorm16(out.Tangent[1]));
+        float decodedSign = (out.Tangent[1] & 1) ? -1.0f : 1.0f;
+        if (tangent.length() > 0.0f) {
+            error.MaxTangentDegrees = std::max(error.MaxTangentDegrees, AngleDegrees(tangent, decodedTangent));
+            if ((decodedSign < 0.0f) != (v.Tangent.w < 0.0f))
+                error.TangentSignFlips++;
+        } else {
+            decodedTangent = vec3(0.0f);
+        }
+
+        v.Position = vec3(decodedPosition[0], decodedPosition[1], decodedPosition[2]);
+        v.UV = decodedUV;
+        v.Normal = decodedNormal;
+        v.Tangent = vec4(decodedTangent, decodedSign);
+    }
+
+    return error;
+}
+
+bool BuildShortIndices(const std::vector<u32>& indices, const std::vector<L_SubmeshData>& submeshes, const std::vector<L_LodData>& lods,
+                       std::vector<u16>& outIndices, std::vector<u32>& outBaseVertices, u32* outFailedSubmesh)
+{
+    std::vector<u32> baseVertices(submeshes.size(), 0);
+    for (u32 s = 0; s < submeshes.size(); ++s) {
+        if (submeshes[s].IndexCount == 0)
+            continue;
+
+        const u32* begin = indices.data() + submeshes[s].IndexOffset;
+        const u32* end = begin + submeshes[s].IndexCount;
+        u32 minIndex = *std::min_element(begin, end);
+        u32 maxIndex = *std::max_element(begin, end);
+        if (maxIndex - minIndex > 0xffff) {
+            if (outFailedSubmesh)
+                *outFailedSubmesh = s;
+            return false;
+        }
+        baseVertices[s] = minIndex;
+    }
+
+    // Indices outside every submesh can't be drawn, they stay 0
+    outIndices.assign(indices.size(), 0);
+    for (u32 s = 0; s < submeshes.size(); ++s) {
+        for (u32 i = submeshes[s].IndexOffset; i < submeshes[s].IndexOffset + submeshes[s].IndexCount; ++i)
+            outIndices[i] = (u16)(indices[i] - baseVertices[s]);
+    }
+    // LODs only reference vertices of their submesh, so they fit the same range
+    for (const L_LodData& lod : lods) {
+        for (u32 i = lod.IndexOffset; i < lod.IndexOffset + lod.IndexCount; ++i)
+            outIndices[i] = (u16)(indices[i] - baseVertices[lod.SubmeshIndex]);
+    }
+    outBaseVertices.swap(baseVertices);
+    return true;
+}
@@ -4,323 +4,1265 @@
 //
 
 #include "tiny_gltf.h"
+#include "GLTFSource.h"
+#include "JobPool.h"
+#include "MeshTypes.h"
+#include "MeshOptimizer.h"
+#include "Meshlets.h"
+#include "VertexFormats.h"
+#include "Simplifier.h"
+#include "Bvh.h"
+#include "Occluders.h"
+#include "MeshCodec.h"
+#include "CookCache.h"
+#include "SpatialOrder.h"
+#include "SceneLimits.h"
+#include "MeshFile.h"
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <vector>
 #include <string>
 #include <cstring>
 #include <cmath>
 #include <unordered_map>
 #include <cfloat>
+#include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <functional>
+#include <iterator>
+#include <cstddef>
 
-// Type definitions
-typedef uint8_t u8;
-typedef uint16_t u16;
-typedef uint32_t u32;
-
-// Math structures
-struct vec2 {
-    float x, y;
-    vec2() : x(0), y(0) {}
-    vec2(float s) : x(s), y(s) {}
-    vec2(float x, float y) : x(x), y(y) {}
-};
+#include <sys/resource.h>
 
-struct vec3 {
-    float x, y, z;
-    vec3() : x(0), y(0), z(0) {}
-    vec3(float s) : x(s), y(s), z(s) {}
-    vec3(float x, float y, float z) : x(x), y(y), z(z) {}
-
-    vec3 operator+(const vec3& v) const { return vec3(x + v.x, y + v.y, z + v.z); }
-    vec3 operator-(const vec3& v) const { return vec3(x - v.x, y - v.y, z - v.z); }
-    vec3 operator*(float s) const { return vec3(x * s, y * s, z * s); }
-    float length() const { return std::sqrt(x*x + y*y + z*z); }
-    vec3 normalize() const { float len = length(); return len > 0 ? *this * (1.0f / len) : *this; }
-};
+// Helper functions
+// View of a float vertex attribute, invalid when the primitive doesn't have it or it isn't stored as floats
+static AccessorView GetAttributeView(const GLTFSource& source, const tinygltf::Primitive& prim, const char* name, size_t elementSize)
+{
+    AccessorView view;
+    auto it = prim.attributes.find(name);
+    if (it == prim.attributes.end() || !source.GetAccessor(it->second, elementSize, view) ||
+        view.ComponentType != TINYGLTF_COMPONENT_TYPE_FLOAT) {
+        return AccessorView();
+    }
+    return view;
+}
 
-struct vec4 {
-    float x, y, z, w;
-    vec4() : x(0), y(0), z(0), w(0) {}
-    vec4(float s) : x(s), y(s), z(s), w(s) {}
-    vec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
-    vec4(const vec3& v, float w) : x(v.x), y(v.y), z(v.z), w(w) {}
-    vec3 xyz() const { return vec3(x, y, z); }
-};
+static void BuildNodeTransforms(const tinygltf::Model& model, int nodeIdx, const mat4& parentTransform,
+                               std::unordered_map<int, mat4>& nodeTransforms)
+{
+    const auto& node = model.nodes[nodeIdx];
+    mat4 localTransform;
 
-struct quat {
-    float x, y, z, w;
-    quat() : x(0), y(0), z(0), w(1) {}
-    quat(float w, float x, float y, float z) : x(x), y(y), z(z), w(w) {}
-};
+    if (node.matrix.size() == 16) {
+        localTransform = mat4(node.matrix.data());
+    } else {
+        vec3 translation(0.0f);
+        quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+        vec3 scaleVec(1.0f);
+
+        if (node.translation.size() == 3)
+            translation = vec3(node.translation[0], node.translation[1], node.translation[2]);
+        if (node.rotation.size() == 4)
+            rotation = quat(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]);
+        if (node.scale.size() == 3)
+            scaleVec = vec3(node.scale[0], node.scale[1], node.scale[2]);
 
-struct mat3 {
-    float m[9];
-    mat3() { for(int i = 0; i < 9; i++) m[i] = (i % 4 == 0) ? 1.0f : 0.0f; }
-    vec3 operator*(const vec3& v) const {
-        return vec3(
-            m[0]*v.x + m[3]*v.y + m[6]*v.z,
-            m[1]*v.x + m[4]*v.y + m[7]*v.z,
-            m[2]*v.x + m[5]*v.y + m[8]*v.z
-        );
+        mat4 identity;
+        localTransform = translate(identity, translation);
+        localTransform = localTransform * quatToMat4(rotation);
+        localTransform = scale(localTransform, scaleVec);
     }
-};
 
-struct mat4 {
-    float m[16];
+    mat4 worldTransform = parentTransform * localTransform;
+    nodeTransforms[nodeIdx] = worldTransform;
 
-    mat4() {
-        for(int i = 0; i < 16; i++)
-            m[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+    for (int childIdx : node.children) {
+        BuildNodeTransforms(model, childIdx, worldTransform, nodeTransforms);
     }
+}
 
-    mat4(const float* data) {
-        memcpy(m, data, 16 * sizeof(float));
-    }
+struct CompressOptions
+{
+    WeldMode Weld = WeldMode::Exact;
+    float WeldEpsilon = 1e-4f;
+    bool OptimizeVertexCache = true;
+    bool OptimizeOverdraw = true;
+    bool OptimizeVertexFetch = true;
+    bool BuildMeshlets = true;
+    bool BakeBvh = true;
+    bool WritePositionStream = true;
+    VertexFormat Format = VertexFormat::Float;
+    bool AllowShortIndices = true;
+    u32 LodLevels = 3;
+    bool PreserveInstancing = true;
+    PayloadCodec Payload = PayloadCodec::Raw;
+    u32 OverdrawViews = 8;
+    bool MapBuffers = true; // Doesn't change the output, only how the input is read
+    SpatialOrder SubmeshOrder = SpatialOrder::None;
+    u32 MaxSubmeshTriangles = 16384; // Larger submeshes are split into culling clusters, 0 keeps them whole
+    bool BuildOccluders = true;
+    float OccluderMinSize = 0.05f; // Smallest connected part that gets occluder boxes, as a fraction of the scene diagonal
+    u32 MaxDraws = MAX_SCENE_INSTANCES / 4; // Splitting stops here, the rest of the scene budget is left to other models
+    bool Streaming = false; // One primitive at a time, see CompressStreamed
+};
 
-    mat4(const double* data) {
-        for(int i = 0; i < 16; i++)
-            m[i] = static_cast<float>(data[i]);
-    }
+// Cache key component for the options, every field that changes the output has to be in here
+static uint64_t HashOptions(const CompressOptions& options, uint64_t seed)
+{
+    std::ostringstream desc;
+    desc << (u32)options.Weld << " " << options.WeldEpsilon << " " << options.OptimizeVertexCache << " "
+         << options.OptimizeOverdraw << " " << options.OptimizeVertexFetch << " " << options.BuildMeshlets << " " << options.BakeBvh << " "
+         << options.WritePositionStream << " " << (u32)options.Format << " " << options.AllowShortIndices << " " << options.LodLevels << " "
+         << options.PreserveInstancing << " " << (u32)options.Payload << " " << options.OverdrawViews << " "
+         << (u32)options.SubmeshOrder << " " << options.MaxSubmeshTriangles << " " << options.BuildOccluders << " "
+         << options.OccluderMinSize << " " << options.MaxDraws << " " << options.Streaming;
+    std::string text = desc.str();
+    return HashBytes(text.data(), text.size(), seed);
+}
 
-    vec4 operator*(const vec4& v) const {
-        return vec4(
-            m[0]*v.x + m[4]*v.y + m[8]*v.z + m[12]*v.w,
-            m[1]*v.x + m[5]*v.y + m[9]*v.z + m[13]*v.w,
-            m[2]*v.x + m[6]*v.y + m[10]*v.z + m[14]*v.w,
-            m[3]*v.x + m[7]*v.y + m[11]*v.z + m[15]*v.w
-        );
-    }
+// Per-file output sink, batch mode buffers it so concurrent files don't interleave
+struct CompressLog
+{
+    std::ostream& Out;
+    std::ostream& Err;
+};
 
-    mat4 operator*(const mat4& other) const {
-        mat4 result;
-        for(int row = 0; row < 4; row++) {
-            for(int col = 0; col < 4; col++) {
-                result.m[col*4 + row] = 0;
-                for(int k = 0; k < 4; k++) {
-                    result.m[col*4 + row] += m[k*4 + row] * other.m[col*4 + k];
-                }
+// A primitive instantiated by one node transform, with its final location in the shared buffers
+struct PrimitiveRef
+{
+    const tinygltf::Primitive* Primitive;
+    mat4 Transform;
+    u32 VertexBase;
+    u32 VertexCount;
+    u32 IndexBase;
+    u32 IndexCount;
+};
+
+// Vertices per job when splitting a primitive across workers
+static const size_t kVertexGrainSize = 16384;
+
+// Attributes are read straight from the source buffers, the layout pass already checked POSITION and the indices
+static void ProcessPrimitive(const GLTFSource& source, const PrimitiveRef& ref, JobPool& pool,
+                             L_StaticVertex* outVertices, u32* outIndices, L_SubmeshData& outSubmesh)
+{
+    const tinygltf::Primitive& prim = *ref.Primitive;
+
+    AccessorView positions = GetAttributeView(source, prim, "POSITION", sizeof(vec3));
+    AccessorView normals = GetAttributeView(source, prim, "NORMAL", sizeof(vec3));
+    AccessorView uvs = GetAttributeView(source, prim, "TEXCOORD_0", sizeof(vec2));
+    AccessorView tangents = GetAttributeView(source, prim, "TANGENT", sizeof(vec4));
+    if (normals.Count < ref.VertexCount)
+        normals = AccessorView();
+    if (uvs.Count < ref.VertexCount)
+        uvs = AccessorView();
+    if (tangents.Count < ref.VertexCount)
+        tangents = AccessorView();
+
+    const mat4& transform = ref.Transform;
+    mat3 normalMatrix = transposeMat3(inverseMat3(transform.toMat3()));
+
+    // Initialize submesh AABB
+    vec3 submeshMin(FLT_MAX);
+    vec3 submeshMax(-FLT_MAX);
+    std::mutex boundsMutex;
+
+    // Build vertices with transforms, big primitives get split across workers
+    pool.ParallelFor(ref.VertexCount, kVertexGrainSize, [&](size_t begin, size_t end) {
+        vec3 rangeMin(FLT_MAX);
+        vec3 rangeMax(-FLT_MAX);
+
+        for (size_t i = begin; i < end; ++i) {
+            L_StaticVertex v;
+            vec4 worldPos = transform * vec4(positions.Get<vec3>(i), 1.0f);
+            v.Position = worldPos.xyz();
+
+            rangeMin = minVec3(rangeMin, v.Position);
+            rangeMax = maxVec3(rangeMax, v.Position);
+
+            v.Normal = normals.IsValid() ? (normalMatrix * normals.Get<vec3>(i)).normalize() : vec3(0, 1, 0);
+            v.UV = uvs.IsValid() ? uvs.Get<vec2>(i) : vec2(0);
+
+            if (tangents.IsValid()) {
+                vec4 tangent = tangents.Get<vec4>(i);
+                vec3 transformedTangent = (normalMatrix * tangent.xyz()).normalize();
+                v.Tangent = vec4(transformedTangent, tangent.w);
+            } else {
+                v.Tangent = vec4(0);
             }
+
+            outVertices[ref.VertexBase + i] = v;
         }
-        return result;
+
+        std::lock_guard<std::mutex> lock(boundsMutex);
+        submeshMin = minVec3(submeshMin, rangeMin);
+        submeshMax = maxVec3(submeshMax, rangeMax);
+    });
+
+    // Load indices
+    AccessorView indices;
+    u32* dst = outIndices + ref.IndexBase;
+    if (source.GetModel().accessors[prim.indices].componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
+        source.GetAccessor(prim.indices, sizeof(u16), indices);
+        for (size_t i = 0; i < ref.IndexCount; ++i)
+            dst[i] = ref.VertexBase + indices.Get<u16>(i);
+    } else {
+        source.GetAccessor(prim.indices, sizeof(u32), indices);
+        for (size_t i = 0; i < ref.IndexCount; ++i)
+            dst[i] = ref.VertexBase + indices.Get<u32>(i);
     }
 
-    mat3 toMat3() const {
-        mat3 result;
-        result.m[0] = m[0]; result.m[3] = m[4]; result.m[6] = m[8];
-        result.m[1] = m[1]; result.m[4] = m[5]; result.m[7] = m[9];
-        result.m[2] = m[2]; result.m[5] = m[6]; result.m[8] = m[10];
-        return result;
+    // Create submesh entry
+    outSubmesh.IndexOffset = ref.IndexBase;
+    outSubmesh.IndexCount = ref.IndexCount;
+    outSubmesh.MaterialIndex = prim.material >= 0 ? prim.material : 0;
+    outSubmesh.Min = submeshMin;
+    outSubmesh.Max = submeshMax;
+}
+
+static std::string FormatPercent(double value)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.1f%%", value);
+    return buffer;
+}
+
+// Decodes a freshly encoded payload and compares it against the source bytes
+static bool VerifyPayload(const std::vector<u8>& payload, const void* data, size_t size)
+{
+    u32 chunkCount = GetPayloadChunkCount(payload.data(), payload.size(), size);
+    if (chunkCount == 0 && size > 0)
+        return false;
+
+    std::vector<u8> decoded(size);
+    for (u32 c = 0; c < chunkCount; ++c) {
+        if (!DecodePayloadChunk(payload.data(), payload.size(), c, decoded.data(), size))
+            return false;
+    }
+    return size == 0 || memcmp(decoded.data(), data, size) == 0;
+}
+
+static VertexCacheStats AnalyzeSubmeshes(const std::vector<u32>& indices, const std::vector<L_SubmeshData>& submeshes, JobPool& pool)
+{
+    std::vector<VertexCacheStats> perSubmesh(submeshes.size());
+    pool.ParallelFor(submeshes.size(), 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            perSubmesh[i] = AnalyzeVertexCache(indices.data() + submeshes[i].IndexOffset, submeshes[i].IndexCount);
+    });
+
+    VertexCacheStats total;
+    for (const auto& stats : perSubmesh)
+        total += stats;
+    return total;
+}
+
+static VertexFetchStats AnalyzeSubmeshFetch(const std::vector<u32>& indices, const std::vector<L_SubmeshData>& submeshes,
+                                            size_t vertexSize, JobPool& pool)
+{
+    std::vector<VertexFetchStats> perSubmesh(submeshes.size());
+    pool.ParallelFor(submeshes.size(), 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            perSubmesh[i] = AnalyzeVertexFetch(indices.data() + submeshes[i].IndexOffset, submeshes[i].IndexCount, vertexSize);
+    });
+
+    VertexFetchStats total;
+    for (const auto& stats : perSubmesh)
+        total += stats;
+    return total;
+}
+
+static OverdrawStats AnalyzeSubmeshOverdraw(const std::vector<L_StaticVertex>& vertices, const std::vector<u32>& indices,
+                                            const std::vector<L_SubmeshData>& submeshes, const std::vector<bool>& opaqueSubmesh,
+                                            u32 viewCount, JobPool& pool)
+{
+    std::vector<OverdrawStats> perSubmesh(submeshes.size());
+    if (viewCount > 0) {
+        pool.ParallelFor(submeshes.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                if (opaqueSubmesh[i])
+                    perSubmesh[i] = AnalyzeOverdraw(indices.data() + submeshes[i].IndexOffset, submeshes[i].IndexCount, vertices.data(), viewCount);
+            }
+        });
     }
-};
 
-// Math utility functions
-inline vec3 minVec3(const vec3& a, const vec3& b) {
-    return vec3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z));
+    OverdrawStats total;
+    for (const auto& stats : perSubmesh)
+        total += stats;
+    return total;
 }
 
-inline vec3 maxVec3(const vec3& a, const vec3& b) {
-    return vec3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z));
+static bool IsOpaqueMaterial(const tinygltf::Model& model, u32 materialIndex)
+{
+    if (materialIndex >= model.materials.size())
+        return true;
+
+    const std::string& alphaMode = model.materials[materialIndex].alphaMode;
+    return alphaMode != "MASK" && alphaMode != "BLEND";
 }
 
-mat4 translate(const mat4& m, const vec3& v) {
-    mat4 result = m;
-    result.m[12] = m.m[0]*v.x + m.m[4]*v.y + m.m[8]*v.z + m.m[12];
-    result.m[13] = m.m[1]*v.x + m.m[5]*v.y + m.m[9]*v.z + m.m[13];
-    result.m[14] = m.m[2]*v.x + m.m[6]*v.y + m.m[10]*v.z + m.m[14];
-    result.m[15] = m.m[3]*v.x + m.m[7]*v.y + m.m[11]*v.z + m.m[15];
-    return result;
+// glTF back faces are culled unless the material says otherwise
+static bool IsSingleSidedMaterial(const tinygltf::Model& model, u32 materialIndex)
+{
+    if (materialIndex >= model.materials.size())
+        return true;
+
+    return !model.materials[materialIndex].doubleSided;
 }
 
-mat4 scale(const mat4& m, const vec3& v) {
-    mat4 result;
-    for(int i = 0; i < 4; i++) {
-        result.m[i] = m.m[i] * v.x;
-        result.m[4+i] = m.m[4+i] * v.y;
-        result.m[8+i] = m.m[8+i] * v.z;
-        result.m[12+i] = m.m[12+i];
+// Cameras the meshlet table is culled from to check the bounds and cones are conservative
+static const u32 kMeshletValidationViews = 16;
+
+static const char* VertexFormatName(VertexFormat format)
+{
+    switch (format) {
+        case VertexFormat::Float: return "float";
+        case VertexFormat::Compact: return "compact";
     }
-    return result;
+    return "unknown";
+}
+
+// High-water mark of the whole process, batch mode includes the other files being cooked concurrently
+static uint64_t GetPeakRSSBytes()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return (uint64_t)usage.ru_maxrss;
+#else
+    return (uint64_t)usage.ru_maxrss * 1024;
+#endif
 }
 
-mat4 quatToMat4(const quat& q) {
-    mat4 result;
-    float qxx = q.x * q.x;
-    float qyy = q.y * q.y;
-    float qzz = q.z * q.z;
-    float qxz = q.x * q.z;
-    float qxy = q.x * q.y;
-    float qyz = q.y * q.z;
-    float qwx = q.w * q.x;
-    float qwy = q.w * q.y;
-    float qwz = q.w * q.z;
-
-    result.m[0] = 1.0f - 2.0f * (qyy + qzz);
-    result.m[1] = 2.0f * (qxy + qwz);
-    result.m[2] = 2.0f * (qxz - qwy);
-    result.m[3] = 0.0f;
-
-    result.m[4] = 2.0f * (qxy - qwz);
-    result.m[5] = 1.0f - 2.0f * (qxx + qzz);
-    result.m[6] = 2.0f * (qyz + qwx);
-    result.m[7] = 0.0f;
-
-    result.m[8] = 2.0f * (qxz + qwy);
-    result.m[9] = 2.0f * (qyz - qwx);
-    result.m[10] = 1.0f - 2.0f * (qxx + qyy);
-    result.m[11] = 0.0f;
-
-    result.m[12] = 0.0f;
-    result.m[13] = 0.0f;
-    result.m[14] = 0.0f;
-    result.m[15] = 1.0f;
-
-    return result;
+static const char* SpatialOrderName(SpatialOrder order)
+{
+    switch (order) {
+        case SpatialOrder::None: return "gltf";
+        case SpatialOrder::Morton: return "morton";
+        case SpatialOrder::Hilbert: return "hilbert";
+    }
+    return "unknown";
 }
 
-mat3 inverseMat3(const mat3& m) {
-    float det = m.m[0] * (m.m[4]*m.m[8] - m.m[7]*m.m[5]) -
-                m.m[3] * (m.m[1]*m.m[8] - m.m[7]*m.m[2]) +
-                m.m[6] * (m.m[1]*m.m[5] - m.m[4]*m.m[2]);
+// How coherent a submesh order is: material changes and mean centroid step between consecutive submeshes
+struct SubmeshOrderStats
+{
+    u32 MaterialSwitches = 0;
+    double MeanStep = 0.0;
+};
+
+// Transformed AABB of a primitive from its POSITION accessor bounds, false when they are missing
+static bool GetPrimitiveBounds(const tinygltf::Model& input, const PrimitiveRef& ref, vec3& outMin, vec3& outMax)
+{
+    const auto& accessor = input.accessors[ref.Primitive->attributes.at("POSITION")];
+    if (accessor.minValues.size() < 3 || accessor.maxValues.size() < 3)
+        return false;
+
+    outMin = vec3(FLT_MAX);
+    outMax = vec3(-FLT_MAX);
+    for (int corner = 0; corner < 8; ++corner) {
+        vec3 p((float)((corner & 1) ? accessor.maxValues[0] : accessor.minValues[0]),
+               (float)((corner & 2) ? accessor.maxValues[1] : accessor.minValues[1]),
+               (float)((corner & 4) ? accessor.maxValues[2] : accessor.minValues[2]));
+        vec3 transformed = (ref.Transform * vec4(p, 1.0f)).xyz();
+        outMin = minVec3(outMin, transformed);
+        outMax = maxVec3(outMax, transformed);
+    }
+    return true;
+}
 
-    if (std::abs(det) < 1e-6f) return mat3();
+// World-space AABB centroid of a primitive from its POSITION accessor bounds, the origin when they are missing
+static vec3 GetPrimitiveCentroid(const tinygltf::Model& input, const PrimitiveRef& ref)
+{
+    vec3 boundsMin, boundsMax;
+    if (!GetPrimitiveBounds(input, ref, boundsMin, boundsMax))
+        return (ref.Transform * vec4(vec3(0.0f), 1.0f)).xyz();
+    return (boundsMin + boundsMax) * 0.5f;
+}
 
-    float invDet = 1.0f / det;
-    mat3 result;
+static SubmeshOrderStats AnalyzeSubmeshOrder(const tinygltf::Model& input, const std::vector<PrimitiveRef>& refs)
+{
+    SubmeshOrderStats stats;
+    for (size_t i = 1; i < refs.size(); ++i) {
+        stats.MaterialSwitches += refs[i].Primitive->material != refs[i - 1].Primitive->material ? 1 : 0;
+        stats.MeanStep += (GetPrimitiveCentroid(input, refs[i]) - GetPrimitiveCentroid(input, refs[i - 1])).length();
+    }
+    if (refs.size() > 1)
+        stats.MeanStep /= (double)(refs.size() - 1);
+    return stats;
+}
 
-    result.m[0] = (m.m[4]*m.m[8] - m.m[7]*m.m[5]) * invDet;
-    result.m[3] = (m.m[6]*m.m[5] - m.m[3]*m.m[8]) * invDet;
-    result.m[6] = (m.m[3]*m.m[7] - m.m[6]*m.m[4]) * invDet;
+// Sorts the primitives of each instance range by material, then by the curve code of their centroid within the range.
+// Ranges stay where they are so the instance table keeps pointing at the same meshes.
+static void SortSubmeshes(const tinygltf::Model& input, SpatialOrder order, const std::vector<L_InstanceData>& instances,
+                          std::vector<PrimitiveRef>& refs)
+{
+    if (order == SpatialOrder::None)
+        return;
+
+    std::vector<std::pair<u32, u32>> ranges;
+    for (const auto& instance : instances) {
+        auto range = std::make_pair(instance.SubmeshOffset, instance.SubmeshCount);
+        if (std::find(ranges.begin(), ranges.end(), range) == ranges.end())
+            ranges.push_back(range);
+    }
 
-    result.m[1] = (m.m[7]*m.m[2] - m.m[1]*m.m[8]) * invDet;
-    result.m[4] = (m.m[0]*m.m[8] - m.m[6]*m.m[2]) * invDet;
-    result.m[7] = (m.m[6]*m.m[1] - m.m[0]*m.m[7]) * invDet;
+    for (const auto& [offset, count] : ranges) {
+        std::vector<vec3> centroids(count);
+        vec3 boundsMin(FLT_MAX);
+        vec3 boundsMax(-FLT_MAX);
+        for (u32 i = 0; i < count; ++i) {
+            centroids[i] = GetPrimitiveCentroid(input, refs[offset + i]);
+            boundsMin = minVec3(boundsMin, centroids[i]);
+            boundsMax = maxVec3(boundsMax, centroids[i]);
+        }
 
-    result.m[2] = (m.m[1]*m.m[5] - m.m[4]*m.m[2]) * invDet;
-    result.m[5] = (m.m[3]*m.m[2] - m.m[0]*m.m[5]) * invDet;
-    result.m[8] = (m.m[0]*m.m[4] - m.m[3]*m.m[1]) * invDet;
+        // Material in the high bits groups submeshes for state changes, the curve code orders them within a group
+        std::vector<std::pair<uint64_t, PrimitiveRef>> keyed(count);
+        for (u32 i = 0; i < count; ++i) {
+            const PrimitiveRef& ref = refs[offset + i];
+            uint64_t material = (uint64_t)(u32)(ref.Primitive->material + 1);
+            keyed[i] = { (material << 32) | GetSpatialCode(order, &centroids[i].x, &boundsMin.x, &boundsMax.x), ref };
+        }
+        std::stable_sort(keyed.begin(), keyed.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (u32 i = 0; i < count; ++i)
+            refs[offset + i] = keyed[i].second;
+    }
 
-    return result;
+    // Vertex and index ranges follow the new order
+    u32 vertexBase = 0;
+    u32 indexBase = 0;
+    for (auto& ref : refs) {
+        ref.VertexBase = vertexBase;
+        ref.IndexBase = indexBase;
+        vertexBase += ref.VertexCount;
+        indexBase += ref.IndexCount;
+    }
 }
 
-mat3 transposeMat3(const mat3& m) {
-    mat3 result;
-    for(int i = 0; i < 3; i++) {
-        for(int j = 0; j < 3; j++) {
-            result.m[j*3 + i] = m.m[i*3 + j];
+// Bounds of every instance's submeshes, instanced submesh bounds are in mesh space
+static void ComputeSceneBounds(const std::vector<L_InstanceData>& instances, const std::vector<L_SubmeshData>& submeshes,
+                               vec3& outMin, vec3& outMax)
+{
+    outMin = vec3(FLT_MAX);
+    outMax = vec3(-FLT_MAX);
+    for (const auto& instance : instances) {
+        for (u32 s = instance.SubmeshOffset; s < instance.SubmeshOffset + instance.SubmeshCount; ++s) {
+            for (int corner = 0; corner < 8; ++corner) {
+                vec3 p((corner & 1) ? submeshes[s].Max.x : submeshes[s].Min.x,
+                       (corner & 2) ? submeshes[s].Max.y : submeshes[s].Min.y,
+                       (corner & 4) ? submeshes[s].Max.z : submeshes[s].Min.z);
+                vec3 transformed = (instance.Transform * vec4(p, 1.0f)).xyz();
+                outMin = minVec3(outMin, transformed);
+                outMax = maxVec3(outMax, transformed);
+            }
         }
     }
-    return result;
 }
 
-// Data structures
-struct L_StaticVertex {
-    vec3 Position;
-    vec3 Normal;
-    vec2 UV;
-    vec4 Tangent;
-};
+// Cluster size for SplitLargeSubmeshes, doubled from the requested one until every instance's draws fit this file's
+// share of the scene instance budget. 0 when the submeshes alone already exceed it or splitting is off.
+static u32 FitClusterSize(const std::vector<L_InstanceData>& instances, const std::vector<u32>& submeshTriangles,
+                          const CompressOptions& options, CompressLog& log)
+{
+    auto countDraws = [&](u32 maxTriangles) {
+        uint64_t draws = 0;
+        for (const auto& instance : instances) {
+            for (u32 s = instance.SubmeshOffset; s < instance.SubmeshOffset + instance.SubmeshCount; ++s)
+                draws += CountSubmeshClusters(submeshTriangles[s], maxTriangles);
+        }
+        return draws;
+    };
 
-struct L_SubmeshData {
-    u32 IndexOffset;
-    u32 IndexCount;
-    u32 MaterialIndex;
-    vec3 Min;
-    vec3 Max;
-};
+    u32 maxTriangles = options.MaxSubmeshTriangles;
+    if (maxTriangles > 0 && countDraws(0) > options.MaxDraws) {
+        log.Err << "Warning: " << countDraws(0) << " draws exceed the budget of " << options.MaxDraws << ", not splitting submeshes" << std::endl;
+        maxTriangles = 0;
+    }
+    while (maxTriangles > 0 && maxTriangles < (1u << 30) && countDraws(maxTriangles) > options.MaxDraws)
+        maxTriangles *= 2;
+    return maxTriangles;
+}
 
-struct L_MaterialData {
-    char AlbedoPath[256];
-    char NormalPath[256];
-    char ORMPath[256];
-    u32 Opaque; // 1 = opaque, 0 = alpha cutout/blend
-};
+// Image URIs go into a string table once each and materials reference a texture table by index, in first-use order
+// (albedo, normal, ORM per material) so texture indices match the order the runtime loads them.
+static void CollectMaterials(const tinygltf::Model& input, std::vector<char>& strings, std::vector<L_TextureData>& textures,
+                             std::vector<L_MaterialEntry>& materials)
+{
+    std::unordered_map<std::string, u32> textureIndices;
+    auto findTexture = [&](int textureIndex, MeshTextureUsage usage) -> u32 {
+        if (textureIndex < 0 || textureIndex >= (int)input.textures.size())
+            return kMeshNoTexture;
+        int source = input.textures[textureIndex].source;
+        if (source < 0 || source >= (int)input.images.size() || input.images[source].uri.empty())
+            return kMeshNoTexture;
+
+        const std::string& uri = input.images[source].uri;
+        auto found = textureIndices.find(uri);
+        if (found != textureIndices.end())
+            return found->second;
+
+        L_TextureData texture = {};
+        texture.PathOffset = (u32)strings.size();
+        texture.Usage = (u32)usage;
+        strings.insert(strings.end(), uri.begin(), uri.end());
+        strings.push_back('\0');
+        textures.push_back(texture);
+        textureIndices.emplace(uri, (u32)textures.size() - 1);
+        return (u32)textures.size() - 1;
+    };
 
-struct L_StaticMeshHeader {
-    u32 VertexCount;
-    u32 IndexCount;
-    u32 VertexFormat;
-    u32 IndexFormat;
-    u32 SubmeshCount;
-    u32 MaterialCount;
-    vec3 Min;
-    vec3 Max;
-    u32 SubmeshTableOffset;
-    u32 MaterialTableOffset;
-    u32 VBOffset;
-    u32 VBSize;
-    u32 IBOffset;
-    u32 IBSize;
-};
+    materials.reserve(input.materials.size());
+    for (const auto& mat : input.materials) {
+        L_MaterialEntry m = {};
+        m.AlbedoTexture = findTexture(mat.pbrMetallicRoughness.baseColorTexture.index, MeshTextureUsage::Albedo);
+        m.NormalTexture = findTexture(mat.normalTexture.index, MeshTextureUsage::Normal);
+        m.ORMTexture = findTexture(mat.pbrMetallicRoughness.metallicRoughnessTexture.index, MeshTextureUsage::ORM);
 
-// Helper functions
-template<typename T>
-static std::vector<T> ReadAccessor(const tinygltf::Model& model, const tinygltf::Accessor& accessor)
-{
-    const auto& view = model.bufferViews[accessor.bufferView];
-    const auto& buffer = model.buffers[view.buffer];
-    const unsigned char* dataPtr = buffer.data.data() + view.byteOffset + accessor.byteOffset;
-    std::vector<T> result(accessor.count);
-    size_t stride = accessor.ByteStride(view);
-    for (size_t i = 0; i < accessor.count; ++i)
-        memcpy(&result[i], dataPtr + i * stride, sizeof(T));
-    return result;
+        // Alpha cutout and blending both need the texture in every pass, the default is OPAQUE
+        m.Opaque = (mat.alphaMode == "MASK" || mat.alphaMode == "BLEND") ? 0 : 1;
+        materials.push_back(m);
+    }
 }
 
-static void BuildNodeTransforms(const tinygltf::Model& model, int nodeIdx, const mat4& parentTransform,
-                               std::unordered_map<int, mat4>& nodeTransforms)
+static const char* WeldModeName(WeldMode mode)
 {
-    const auto& node = model.nodes[nodeIdx];
-    mat4 localTransform;
+    switch (mode) {
+        case WeldMode::None: return "none";
+        case WeldMode::Exact: return "exact";
+        case WeldMode::Quantized: return "quantized";
+    }
+    return "unknown";
+}
 
-    if (node.matrix.size() == 16) {
-        localTransform = mat4(node.matrix.data());
-    } else {
-        vec3 translation(0.0f);
-        quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
-        vec3 scaleVec(1.0f);
+// Decoded bytes per stream segment of a streamed cook, small enough that encoding one costs less than a large primitive
+static const uint64_t kStreamedSegmentBytes = 64ull << 20;
+// Bytes moved at a time when copying a spilled table or raw segment into the output
+static const uint64_t kSpillCopyBytes = 4ull << 20;
 
-        if (node.translation.size() == 3)
-            translation = vec3(node.translation[0], node.translation[1], node.translation[2]);
-        if (node.rotation.size() == 4)
-            rotation = quat(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]);
-        if (node.scale.size() == 3)
-            scaleVec = vec3(node.scale[0], node.scale[1], node.scale[2]);
+// Scratch file next to the output that a stream or table grows into while a streamed cook runs, removed with the object
+class SpillFile
+{
+public:
+    SpillFile() = default;
+    ~SpillFile()
+    {
+        if (!m_Stream.is_open())
+            return;
+        m_Stream.close();
+        std::error_code error;
+        std::filesystem::remove(m_Path, error);
+    }
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+
+    bool Open(const std::string& path)
+    {
+        m_Path = path;
+        m_Stream.open(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+        return m_Stream.is_open();
+    }
 
-        mat4 identity;
-        localTransform = translate(identity, translation);
-        localTransform = localTransform * quatToMat4(rotation);
-        localTransform = scale(localTransform, scaleVec);
+    void WriteAt(uint64_t offset, const void* data, uint64_t size)
+    {
+        m_Stream.seekp((std::streamoff)offset);
+        m_Stream.write(reinterpret_cast<const char*>(data), (std::streamsize)size);
+        m_Size = std::max(m_Size, offset + size);
     }
 
-    mat4 worldTransform = parentTransform * localTransform;
-    nodeTransforms[nodeIdx] = worldTransform;
+    template<typename T>
+    void Append(const std::vector<T>& values) { WriteAt(m_Size, values.data(), values.size() * sizeof(T)); }
 
-    for (int childIdx : node.children) {
-        BuildNodeTransforms(model, childIdx, worldTransform, nodeTransforms);
+    void ReadAt(uint64_t offset, void* data, uint64_t size)
+    {
+        m_Stream.seekg((std::streamoff)offset);
+        m_Stream.read(reinterpret_cast<char*>(data), (std::streamsize)size);
+    }
+
+    uint64_t GetSize() const { return m_Size; }
+    bool IsGood() const { return !m_Stream.fail(); }
+
+private:
+    std::string m_Path;
+    std::fstream m_Stream;
+    uint64_t m_Size = 0;
+};
+
+// --stream: each primitive instance is read, welded, split, optimized, simplified and given its BVH on its own, then
+// appended to scratch files, so peak memory follows the largest primitive rather than the scene. Only per-submesh
+// tables stay in memory. The file is assembled from the scratch files at the end. Differences from a whole-scene cook:
+// welding and vertex fetch ordering don't cross primitives, and an instance range's BVH is the per-primitive BVHs
+// joined under a few top nodes.
+static bool CompressStreamed(const std::string& inputPath, const std::string& outputPath, const CompressOptions& options,
+                             const GLTFSource& source, const std::vector<PrimitiveRef>& refs, std::vector<L_InstanceData> instances,
+                             JobPool& pool, CompressLog& log)
+{
+    const tinygltf::Model& input = source.GetModel();
+
+    SpillFile vertexFile, positionFile, indexFile, lodIndexFile, meshletFile, bvhNodeFile, bvhTriangleFile;
+    const std::pair<SpillFile*, const char*> spillFiles[] = {
+        { &vertexFile, ".vertices.tmp" }, { &positionFile, ".positions.tmp" }, { &indexFile, ".indices.tmp" },
+        { &lodIndexFile, ".lodindices.tmp" }, { &meshletFile, ".meshlets.tmp" }, { &bvhNodeFile, ".bvhnodes.tmp" },
+        { &bvhTriangleFile, ".bvhtriangles.tmp" }
+    };
+    for (const auto& [file, suffix] : spillFiles) {
+        if (!file->Open(outputPath + suffix)) {
+            log.Err << "Error: Could not create scratch file " << outputPath << suffix << std::endl;
+            return false;
+        }
+    }
+
+    // Every primitive instance is in exactly one instance range, a range's BVH is finished with its last primitive
+    std::vector<std::pair<u32, u32>> ranges;
+    std::vector<u32> rangeOf(refs.size(), 0);
+    for (const auto& instance : instances) {
+        auto range = std::make_pair(instance.SubmeshOffset, instance.SubmeshCount);
+        if (std::find(ranges.begin(), ranges.end(), range) != ranges.end())
+            continue;
+        for (u32 r = range.first; r < range.first + range.second; ++r)
+            rangeOf[r] = (u32)ranges.size();
+        ranges.push_back(range);
+    }
+
+    // The occluder size threshold and the cluster size need the whole scene, they come from the accessor bounds
+    std::vector<L_SubmeshData> refBounds(refs.size());
+    std::vector<u32> refTriangles(refs.size());
+    for (size_t r = 0; r < refs.size(); ++r) {
+        refTriangles[r] = refs[r].IndexCount / 3;
+        if (GetPrimitiveBounds(input, refs[r], refBounds[r].Min, refBounds[r].Max))
+            continue;
+        AccessorView positions = GetAttributeView(source, *refs[r].Primitive, "POSITION", sizeof(vec3));
+        refBounds[r].Min = vec3(FLT_MAX);
+        refBounds[r].Max = vec3(-FLT_MAX);
+        for (size_t i = 0; i < refs[r].VertexCount; ++i) {
+            vec3 p = (refs[r].Transform * vec4(positions.Get<vec3>(i), 1.0f)).xyz();
+            refBounds[r].Min = minVec3(refBounds[r].Min, p);
+            refBounds[r].Max = maxVec3(refBounds[r].Max, p);
+        }
+        source.EvictMappedPages();
     }
+    vec3 sceneMin, sceneMax;
+    ComputeSceneBounds(instances, refBounds, sceneMin, sceneMax);
+    float minDiagonal = (sceneMax - sceneMin).length() * options.OccluderMinSize;
+    u32 maxTriangles = FitClusterSize(instances, refTriangles, options, log);
+
+    std::vector<L_SubmeshData> submeshes;
+    std::vector<u32> firstSubmesh(refs.size() + 1, 0);
+    std::vector<u32> baseVertices;
+    std::vector<L_LodData> lods;
+    std::vector<L_OccluderData> occluders;
+    std::vector<L_BvhRootData> bvhRoots;
+    std::vector<BvhSubtree> rangeSubtrees;
+    u32 rangeFirstNode = 0;
+    uint64_t vertexCount = 0;
+    uint64_t indexCount = 0;
+    uint64_t lodIndexCount = 0;
+    uint64_t meshletCount = 0;
+    uint64_t bvhNodeCount = 0;
+    uint64_t bvhTriangleCount = 0;
+    bool shortIndices = options.AllowShortIndices;
+    u32 wideSubmesh = 0;
+    u32 largestVertices = 0;
+    u32 largestIndices = 0;
+
+    WeldStats weldStats;
+    OccluderStats occluderStats;
+    SubmeshSplitStats splitStats;
+    double splitDiagonalSum = 0.0;
+    u32 splitVertices = 0;
+    QuantizationError quantizationError;
+    MeshletValidationStats meshletStats;
+    std::vector<u32> lodTriangles(options.LodLevels + 1, 0);
+    std::vector<float> lodErrors(options.LodLevels + 1, 0.0f);
+    BvhBuildStats bvhStats;
+    BvhValidationStats bvhValidation;
+    size_t vertexSize = GetVertexSize(options.Format);
+    auto cookStart = std::chrono::steady_clock::now();
+
+    for (u32 r = 0; r < refs.size(); ++r) {
+        const std::pair<u32, u32>& range = ranges[rangeOf[r]];
+        u32 submeshBase = (u32)submeshes.size();
+        firstSubmesh[r] = submeshBase;
+
+        // The nodes joining the range's BVHs go first, the loader wants the root at the start of its node range
+        if (options.BakeBvh && r == range.first) {
+            rangeFirstNode = (u32)bvhNodeCount;
+            rangeSubtrees.clear();
+            std::vector<L_BvhNode> reserved(CountBvhJoinNodes(range.second));
+            bvhNodeFile.Append(reserved);
+            bvhNodeCount += reserved.size();
+        }
+
+        PrimitiveRef ref = refs[r];
+        ref.VertexBase = 0;
+        ref.IndexBase = 0;
+        std::vector<L_StaticVertex> vertices(ref.VertexCount);
+        std::vector<u32> indices(ref.IndexCount);
+        std::vector<L_SubmeshData> unitSubmeshes(1);
+        ProcessPrimitive(source, ref, pool, vertices.data(), indices.data(), unitSubmeshes[0]);
+        source.EvictMappedPages();
+        largestVertices = std::max(largestVertices, ref.VertexCount);
+        largestIndices = std::max(largestIndices, ref.IndexCount);
+
+        // BVH triangles are numbered IndexOffset / 3, so every primitive starts on a whole triangle
+        indices.resize(indices.size() / 3 * 3);
+        unitSubmeshes[0].IndexCount = (u32)indices.size();
+
+        WeldStats weld = WeldVertices(vertices, indices, unitSubmeshes, options.Weld, options.WeldEpsilon);
+        weldStats.VerticesBefore += weld.VerticesBefore;
+        weldStats.VerticesAfter += weld.VerticesAfter;
+        weldStats.DroppedTriangles += weld.DroppedTriangles;
+
+        bool opaque = IsOpaqueMaterial(input, unitSubmeshes[0].MaterialIndex);
+        if (options.BuildOccluders && opaque)
+            BuildOccluders(vertices, indices, unitSubmeshes[0], submeshBase, minDiagonal, occluders, occluderStats);
+
+        if (maxTriangles > 0) {
+            std::vector<u32> firstCluster;
+            SubmeshSplitStats split = SplitLargeSubmeshes(vertices, indices, unitSubmeshes, maxTriangles, firstCluster);
+            splitStats.SplitSubmeshes += split.SplitSubmeshes;
+            splitStats.Clusters += split.Clusters;
+            splitStats.MaxTriangles = split.MaxTriangles;
+            splitDiagonalSum += (double)split.MeanDiagonal * split.Clusters;
+        }
+
+        if (options.OptimizeVertexCache || (options.OptimizeOverdraw && opaque)) {
+            u32 views = options.OverdrawViews > 0 ? options.OverdrawViews : kOverdrawViews;
+            pool.ParallelFor(unitSubmeshes.size(), 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    u32* clusterIndices = indices.data() + unitSubmeshes[i].IndexOffset;
+                    if (options.OptimizeVertexCache)
+                        OptimizeVertexCache(clusterIndices, unitSubmeshes[i].IndexCount);
+                    if (options.OptimizeOverdraw && opaque)
+                        OptimizeOverdraw(clusterIndices, unitSubmeshes[i].IndexCount, vertices.data(), views);
+                }
+            });
+        }
+
+        if (options.Format == VertexFormat::Compact)
+            splitVertices += SplitSharedVertices(vertices, indices, unitSubmeshes);
+        if (options.OptimizeVertexFetch)
+            OptimizeVertexFetch(vertices, indices);
+
+        std::vector<L_CompactVertex> compactVertices;
+        if (options.Format == VertexFormat::Compact) {
+            QuantizationError error = EncodeCompactVertices(vertices, indices, unitSubmeshes, compactVertices);
+            quantizationError.MaxPosition = std::max(quantizationError.MaxPosition, error.MaxPosition);
+            quantizationError.MaxNormalDegrees = std::max(quantizationError.MaxNormalDegrees, error.MaxNormalDegrees);
+            quantizationError.MaxTangentDegrees = std::max(quantizationError.MaxTangentDegrees, error.MaxTangentDegrees);
+            quantizationError.MaxUV = std::max(quantizationError.MaxUV, error.MaxUV);
+            quantizationError.TangentSignFlips += error.TangentSignFlips;
+        }
+
+        if (vertexCount + vertices.size() > UINT32_MAX) {
+            log.Err << "Error: " << inputPath << " has more than " << UINT32_MAX << " vertices, split the scene into several files" << std::endl;
+            return false;
+        }
+        u32 vertexBase = (u32)vertexCount;
+        u32 indexBase = (u32)indexCount;
+
+        if (options.BuildMeshlets) {
+            std::vector<std::vector<L_MeshletData>> clusterMeshlets(unitSubmeshes.size());
+            pool.ParallelFor(unitSubmeshes.size(), 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    bool coneCulling = IsSingleSidedMaterial(input, unitSubmeshes[i].MaterialIndex);
+                    BuildMeshlets(vertices, indices, unitSubmeshes[i], (u32)i, coneCulling, clusterMeshlets[i]);
+                }
+            });
+            std::vector<L_MeshletData> meshlets;
+            for (const auto& list : clusterMeshlets)
+                meshlets.insert(meshlets.end(), list.begin(), list.end());
+
+            MeshletValidationStats validation = ValidateMeshlets(vertices, indices, unitSubmeshes, meshlets, kMeshletValidationViews);
+            meshletStats.Meshlets += validation.Meshlets;
+            meshletStats.Triangles += validation.Triangles;
+            meshletStats.Vertices += validation.Vertices;
+            meshletStats.Tested += validation.Tested;
+            meshletStats.FrustumCulled += validation.FrustumCulled;
+            meshletStats.BackfaceCulled += validation.BackfaceCulled;
+            meshletStats.TrianglesTested += validation.TrianglesTested;
+            meshletStats.TrianglesCulled += validation.TrianglesCulled;
+            meshletStats.Errors += validation.Errors;
+
+            for (L_MeshletData& meshlet : meshlets) {
+                meshlet.IndexOffset += indexBase;
+                meshlet.SubmeshIndex += submeshBase;
+            }
+            meshletFile.Append(meshlets);
+            meshletCount += meshlets.size();
+        }
+
+        // LOD offsets count from the start of the LOD indices until the base indices are all written
+        if (options.LodLevels > 0) {
+            std::vector<std::vector<LodLevel>> clusterLods(unitSubmeshes.size());
+            pool.ParallelFor(unitSubmeshes.size(), 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    clusterLods[i] = BuildLodChain(vertices, indices.data() + unitSubmeshes[i].IndexOffset, unitSubmeshes[i].IndexCount,
+                                                   options.LodLevels);
+                    if (options.OptimizeVertexCache) {
+                        for (LodLevel& level : clusterLods[i])
+                            OptimizeVertexCache(level.Indices.data(), level.Indices.size());
+                    }
+                }
+            });
+
+            for (u32 s = 0; s < unitSubmeshes.size(); ++s) {
+                lodTriangles[0] += unitSubmeshes[s].IndexCount / 3;
+                for (u32 l = 0; l < clusterLods[s].size(); ++l) {
+                    LodLevel& level = clusterLods[s][l];
+                    L_LodData lod = {};
+                    lod.SubmeshIndex = submeshBase + s;
+                    lod.Level = l + 1;
+                    lod.IndexOffset = (u32)lodIndexCount;
+                    lod.IndexCount = (u32)level.Indices.size();
+                    lod.Error = level.Error;
+                    lods.push_back(lod);
+                    for (u32& index : level.Indices)
+                        index += vertexBase;
+                    lodIndexFile.Append(level.Indices);
+                    lodIndexCount += level.Indices.size();
+
+                    lodTriangles[lod.Level] += lod.IndexCount / 3;
+                    lodErrors[lod.Level] = std::max(lodErrors[lod.Level], lod.Error);
+                }
+            }
+        }
+
+        if (options.BakeBvh) {
+            // Compact positions are quantized, build over what the runtime decodes so leaf bounds still contain them
+            std::vector<L_StaticVertex> decodedVertices;
+            if (options.Format == VertexFormat::Compact) {
+                decodedVertices = vertices;
+                for (const auto& submesh : unitSubmeshes) {
+                    vec3 extent = submesh.Max - submesh.Min;
+                    for (u32 i = submesh.IndexOffset; i < submesh.IndexOffset + submesh.IndexCount; ++i) {
+                        const L_CompactVertex& v = compactVertices[indices[i]];
+                        decodedVertices[indices[i]].Position = vec3(submesh.Min.x + extent.x * (v.Position[0] / 65535.0f),
+                                                                    submesh.Min.y + extent.y * (v.Position[1] / 65535.0f),
+                                                                    submesh.Min.z + extent.z * (v.Position[2] / 65535.0f));
+                    }
+                }
+            }
+            const std::vector<L_StaticVertex>& bvhVertices = decodedVertices.empty() ? vertices : decodedVertices;
+
+            std::vector<L_BvhNode> nodes;
+            std::vector<u32> triangles;
+            L_BvhRootData root = {};
+            root.SubmeshCount = (u32)unitSubmeshes.size();
+            root.RootNode = BuildBvh(bvhVertices, indices, unitSubmeshes, 0, root.SubmeshCount, pool, nodes, triangles, bvhStats);
+            root.NodeCount = (u32)nodes.size();
+
+            BvhValidationStats validation = ValidateBvh(bvhVertices, indices, unitSubmeshes, { root }, nodes, triangles,
+                                                        kBvhValidationRays, pool);
+            bvhValidation.Rays += validation.Rays;
+            bvhValidation.Hits += validation.Hits;
+            bvhValidation.Mismatches += validation.Mismatches;
+            bvhValidation.NodesVisited += validation.NodesVisited;
+            bvhValidation.Errors += validation.Errors;
+
+            // Move the nodes, triangles and submesh references to where this primitive lands in the shared tables
+            u32 nodeBase = (u32)bvhNodeCount;
+            u32 triangleBase = (u32)bvhTriangleCount;
+            for (L_BvhNode& node : nodes) {
+                for (u32 slot = 0; slot < kBvhWidth; ++slot) {
+                    if (node.Child[slot] == kBvhEmpty)
+                        continue;
+                    if (node.Leaf[slot] == 0) {
+                        node.Child[slot] += nodeBase;
+                    } else {
+                        node.Child[slot] += triangleBase;
+                        node.Leaf[slot] += submeshBase << 8;
+                    }
+                }
+            }
+            for (u32& triangle : triangles)
+                triangle += indexBase / 3;
+
+            BvhSubtree subtree;
+            subtree.RootNode = nodeBase + root.RootNode;
+            GetBvhNodeBounds(nodes[root.RootNode], subtree.Min, subtree.Max);
+            rangeSubtrees.push_back(subtree);
+
+            bvhNodeFile.Append(nodes);
+            bvhTriangleFile.Append(triangles);
+            bvhNodeCount += nodes.size();
+            bvhTriangleCount += triangles.size();
+
+            // Instance ranges are remapped to submeshes once every primitive's cluster count is known
+            if (r == range.first + range.second - 1) {
+                L_BvhRootData rangeRoot = {};
+                rangeRoot.SubmeshOffset = range.first;
+                rangeRoot.SubmeshCount = range.second;
+                rangeRoot.RootNode = rangeFirstNode;
+                rangeRoot.NodeCount = (u32)bvhNodeCount - rangeFirstNode;
+                if (rangeSubtrees.size() > 1) {
+                    std::vector<L_BvhNode> joinNodes = JoinBvhs(rangeSubtrees, rangeFirstNode);
+                    bvhNodeFile.WriteAt((uint64_t)rangeFirstNode * sizeof(L_BvhNode), joinNodes.data(), joinNodes.size() * sizeof(L_BvhNode));
+                    bvhStats.Nodes += (u32)joinNodes.size();
+                }
+                bvhRoots.push_back(rangeRoot);
+            }
+        }
+
+        if (options.WritePositionStream)
+            positionFile.Append(BuildPositionStream(options.Format, vertices, compactVertices));
+        if (options.Format == VertexFormat::Compact)
+            vertexFile.Append(compactVertices);
+        else
+            vertexFile.Append(vertices);
+
+        // 16-bit indices are relative to the lowest vertex of their submesh, checked here and narrowed when copying
+        for (u32 s = 0; s < unitSubmeshes.size(); ++s) {
+            L_SubmeshData submesh = unitSubmeshes[s];
+            u32 baseVertex = 0;
+            if (submesh.IndexCount > 0) {
+                const u32* begin = indices.data() + submesh.IndexOffset;
+                const u32* end = begin + submesh.IndexCount;
+                u32 minIndex = *std::min_element(begin, end);
+                u32 maxIndex = *std::max_element(begin, end);
+                if (shortIndices && maxIndex - minIndex > 0xffff) {
+                    shortIndices = false;
+                    wideSubmesh = submeshBase + s;
+                }
+                baseVertex = vertexBase + minIndex;
+            }
+            baseVertices.push_back(baseVertex);
+
+            submesh.IndexOffset += indexBase;
+            submeshes.push_back(submesh);
+        }
+        for (u32& index : indices)
+            index += vertexBase;
+        indexFile.Append(indices);
+        vertexCount += vertices.size();
+        indexCount += indices.size();
+    }
+    firstSubmesh[refs.size()] = (u32)submeshes.size();
+    double cookSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - cookStart).count();
+
+    for (const auto& [file, suffix] : spillFiles) {
+        if (!file->IsGood()) {
+            log.Err << "Error: Failed writing scratch file " << outputPath << suffix << std::endl;
+            return false;
+        }
+    }
+    if (indexCount + lodIndexCount > UINT32_MAX) {
+        log.Err << "Error: " << inputPath << " has more than " << UINT32_MAX << " indices with its LODs, split the scene into several files"
+                << std::endl;
+        return false;
+    }
+
+    // Simplified levels go after every base index, instance and BVH ranges move from primitives to submeshes
+    for (L_LodData& lod : lods)
+        lod.IndexOffset += (u32)indexCount;
+    for (auto& instance : instances) {
+        u32 end = instance.SubmeshOffset + instance.SubmeshCount;
+        instance.SubmeshOffset = firstSubmesh[instance.SubmeshOffset];
+        instance.SubmeshCount = firstSubmesh[end] - instance.SubmeshOffset;
+    }
+    for (auto& root : bvhRoots) {
+        u32 end = root.SubmeshOffset + root.SubmeshCount;
+        root.SubmeshOffset = firstSubmesh[root.SubmeshOffset];
+        root.SubmeshCount = firstSubmesh[end] - root.SubmeshOffset;
+    }
+
+    vec3 boundsMin, boundsMax;
+    ComputeSceneBounds(instances, submeshes, boundsMin, boundsMax);
+
+    std::vector<char> strings;
+    std::vector<L_TextureData> textures;
+    std::vector<L_MaterialEntry> materials;
+    CollectMaterials(input, strings, textures, materials);
+
+    if (options.AllowShortIndices && !shortIndices)
+        log.Out << "  Submesh " << wideSubmesh << " spans more than 65536 vertices, keeping 32-bit indices" << std::endl;
+    if (!shortIndices)
+        baseVertices.clear();
+    IndexFormat indexFormat = shortIndices ? IndexFormat::UInt16 : IndexFormat::UInt32;
+    size_t indexSize = shortIndices ? sizeof(u16) : sizeof(u32);
+    size_t positionSize = GetPositionSize(options.Format);
+
+    // The decoded index stream is the base indices followed by the LOD indices, narrowed against each range's base vertex
+    auto readWideIndices = [&](uint64_t first, uint64_t count, u32* out) {
+        uint64_t fromBase = first < indexCount ? std::min(count, indexCount - first) : 0;
+        if (fromBase > 0)
+            indexFile.ReadAt(first * sizeof(u32), out, fromBase * sizeof(u32));
+        if (count > fromBase)
+            lodIndexFile.ReadAt((first + fromBase - indexCount) * sizeof(u32), out + fromBase, (count - fromBase) * sizeof(u32));
+    };
+    struct IndexRange
+    {
+        uint64_t First;
+        uint64_t Count;
+        u32 BaseVertex;
+    };
+    std::vector<IndexRange> indexRanges;
+    if (shortIndices) {
+        for (size_t s = 0; s < submeshes.size(); ++s)
+            indexRanges.push_back({ submeshes[s].IndexOffset, submeshes[s].IndexCount, baseVertices[s] });
+        for (const L_LodData& lod : lods)
+            indexRanges.push_back({ lod.IndexOffset, lod.IndexCount, baseVertices[lod.SubmeshIndex] });
+    }
+    auto readIndices = [&](uint64_t offset, uint64_t size, u8* out) {
+        if (!shortIndices) {
+            readWideIndices(offset / sizeof(u32), size / sizeof(u32), reinterpret_cast<u32*>(out));
+            return;
+        }
+        uint64_t first = offset / sizeof(u16);
+        uint64_t count = size / sizeof(u16);
+        std::vector<u32> wide(count);
+        readWideIndices(first, count, wide.data());
+        u16* narrow = reinterpret_cast<u16*>(out);
+        auto range = std::upper_bound(indexRanges.begin(), indexRanges.end(), first,
+                                      [](uint64_t index, const IndexRange& r) { return index < r.First; });
+        if (range != indexRanges.begin())
+            --range;
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t index = first + i;
+            while (range != indexRanges.end() && index >= range->First + range->Count)
+                ++range;
+            bool inside = range != indexRanges.end() && index >= range->First;
+            narrow[i] = inside ? (u16)(wide[i] - range->BaseVertex) : 0;
+        }
+    };
+
+    // Sections in file order, each read from memory or a scratch file as it is written
+    struct PendingSection
+    {
+        L_MeshSection Section;
+        uint64_t Alignment;
+        size_t ElementSize;
+        u32 LaneSize;
+        std::function<void(uint64_t, uint64_t, u8*)> Read;
+    };
+    std::vector<PendingSection> sections;
+    auto addTable = [&](MeshSectionType type, const void* data, size_t size) {
+        if (size == 0)
+            return;
+        L_MeshSection section = {};
+        section.Type = (u32)type;
+        section.Codec = (u32)PayloadCodec::Raw;
+        section.DecodedSize = size;
+        sections.push_back({ section, kMeshTableAlignment, 1, 1,
+                             [data](uint64_t offset, uint64_t bytes, u8* out) { memcpy(out, (const u8*)data + offset, bytes); } });
+    };
+    auto addSpilledTable = [&](MeshSectionType type, SpillFile& file) {
+        if (file.GetSize() == 0)
+            return;
+        L_MeshSection section = {};
+        section.Type = (u32)type;
+        section.Codec = (u32)PayloadCodec::Raw;
+        section.DecodedSize = file.GetSize();
+        sections.push_back({ section, kMeshTableAlignment, 1, 1,
+                             [&file](uint64_t offset, uint64_t bytes, u8* out) { file.ReadAt(offset, out, bytes); } });
+    };
+    auto addStream = [&](MeshSectionType type, uint64_t size, size_t elementSize, u32 laneSize,
+                         std::function<void(uint64_t, uint64_t, u8*)> read) {
+        uint64_t segmentBytes = kStreamedSegmentBytes / elementSize * elementSize;
+        for (uint64_t begin = 0; begin < size; begin += segmentBytes) {
+            L_MeshSection section = {};
+            section.Type = (u32)type;
+            section.Codec = (u32)options.Payload;
+            section.DecodedOffset = begin;
+            section.DecodedSize = std::min(segmentBytes, size - begin);
+            uint64_t alignment = options.Payload == PayloadCodec::Raw ? kMeshStreamAlignment : kMeshTableAlignment;
+            sections.push_back({ section, alignment, elementSize, laneSize, read });
+        }
+    };
+    addTable(MeshSectionType::Submeshes, submeshes.data(), submeshes.size() * sizeof(L_SubmeshData));
+    addTable(MeshSectionType::Strings, strings.data(), strings.size());
+    addTable(MeshSectionType::Textures, textures.data(), textures.size() * sizeof(L_TextureData));
+    addTable(MeshSectionType::MaterialEntries, materials.data(), materials.size() * sizeof(L_MaterialEntry));
+    addSpilledTable(MeshSectionType::Meshlets, meshletFile);
+    addTable(MeshSectionType::BaseVertices, baseVertices.data(), baseVertices.size() * sizeof(u32));
+    addTable(MeshSectionType::Lods, lods.data(), lods.size() * sizeof(L_LodData));
+    addTable(MeshSectionType::Instances, instances.data(), instances.size() * sizeof(L_InstanceData));
+    addTable(MeshSectionType::Occluders, occluders.data(), occluders.size() * sizeof(L_OccluderData));
+    addTable(MeshSectionType::BvhRoots, bvhRoots.data(), bvhRoots.size() * sizeof(L_BvhRootData));
+    addSpilledTable(MeshSectionType::BvhNodes, bvhNodeFile);
+    addSpilledTable(MeshSectionType::BvhTriangles, bvhTriangleFile);
+
+    // Compact vertices are all 16-bit fields, float vertices and 32-bit indices delta code per 32-bit lane
+    u32 vertexLaneSize = options.Format == VertexFormat::Compact ? 2 : 4;
+    addStream(MeshSectionType::Vertices, vertexFile.GetSize(), vertexSize, vertexLaneSize,
+              [&](uint64_t offset, uint64_t bytes, u8* out) { vertexFile.ReadAt(offset, out, bytes); });
+    addStream(MeshSectionType::Positions, positionFile.GetSize(), positionSize, vertexLaneSize,
+              [&](uint64_t offset, uint64_t bytes, u8* out) { positionFile.ReadAt(offset, out, bytes); });
+    addStream(MeshSectionType::Indices, (indexCount + lodIndexCount) * indexSize, indexSize, (u32)indexSize, readIndices);
+
+    L_MeshFileHeader header = {};
+    header.Magic = kMeshFileMagic;
+    header.Version = kMeshFileVersion;
+    header.HeaderSize = sizeof(L_MeshFileHeader);
+    header.SectionCount = sections.size();
+    header.SectionTableOffset = sizeof(L_MeshFileHeader);
+    header.VertexCount = vertexCount;
+    header.IndexCount = indexCount + lodIndexCount;
+    header.VertexFormat = (u32)options.Format;
+    header.IndexFormat = (u32)indexFormat;
+    memcpy(header.Min, &boundsMin, sizeof(header.Min));
+    memcpy(header.Max, &boundsMax, sizeof(header.Max));
+
+    // Payloads go out one at a time, the section table is written last once every stored size is known
+    std::ofstream outFile(outputPath, std::ios::binary);
+    if (!outFile) {
+        log.Err << "Error: Could not open output file: " << outputPath << std::endl;
+        return false;
+    }
+
+    uint64_t currentOffset = header.SectionTableOffset + sections.size() * sizeof(L_MeshSection);
+    std::vector<u8> placeholder(currentOffset, 0);
+    outFile.write(reinterpret_cast<const char*>(placeholder.data()), placeholder.size());
+
+    double encodeSeconds = 0.0;
+    bool payloadsVerified = true;
+    uint64_t decodedStreamBytes = 0;
+    uint64_t storedStreamBytes = 0;
+    u32 streamSegments = 0;
+    std::vector<u8> buffer;
+    for (PendingSection& pending : sections) {
+        static const u8 kPadding[kMeshStreamAlignment] = {};
+        uint64_t aligned = (currentOffset + pending.Alignment - 1) / pending.Alignment * pending.Alignment;
+        outFile.write(reinterpret_cast<const char*>(kPadding), aligned - currentOffset);
+        currentOffset = aligned;
+
+        L_MeshSection& section = pending.Section;
+        section.Offset = currentOffset;
+        bool stream = pending.ElementSize > 1;
+        if (section.Codec == (u32)PayloadCodec::Chunked) {
+            buffer.resize(section.DecodedSize);
+            pending.Read(section.DecodedOffset, section.DecodedSize, buffer.data());
+            auto encodeStart = std::chrono::steady_clock::now();
+            std::vector<u8> payload = EncodePayload(buffer.data(), buffer.size(), (u32)pending.ElementSize, pending.LaneSize);
+            encodeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - encodeStart).count();
+            payloadsVerified = payloadsVerified && VerifyPayload(payload, buffer.data(), buffer.size());
+            outFile.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+            section.StoredSize = payload.size();
+        } else {
+            for (uint64_t copied = 0; copied < section.DecodedSize; copied += kSpillCopyBytes) {
+                uint64_t bytes = std::min(kSpillCopyBytes, section.DecodedSize - copied);
+                buffer.resize(bytes);
+                pending.Read(section.DecodedOffset + copied, bytes, buffer.data());
+                outFile.write(reinterpret_cast<const char*>(buffer.data()), bytes);
+            }
+            section.StoredSize = section.DecodedSize;
+        }
+        currentOffset += section.StoredSize;
+        if (stream) {
+            decodedStreamBytes += section.DecodedSize;
+            storedStreamBytes += section.StoredSize;
+            streamSegments++;
+        }
+    }
+    if (!payloadsVerified) {
+        log.Err << "Error: Chunked payload failed to round-trip" << std::endl;
+        return false;
+    }
+
+    outFile.seekp(0);
+    outFile.write(reinterpret_cast<const char*>(&header), sizeof(L_MeshFileHeader));
+    for (const PendingSection& pending : sections)
+        outFile.write(reinterpret_cast<const char*>(&pending.Section), sizeof(L_MeshSection));
+    outFile.close();
+    std::error_code sizeError;
+    bool spillsRead = std::all_of(std::begin(spillFiles), std::end(spillFiles), [](const auto& spill) { return spill.first->IsGood(); });
+    if (!outFile || !spillsRead || std::filesystem::file_size(outputPath, sizeError) != currentOffset || sizeError) {
+        log.Err << "Error: Failed writing output file: " << outputPath << std::endl;
+        return false;
+    }
+
+    log.Out << "Successfully compressed mesh (streamed, " << refs.size() << " primitives one at a time in "
+            << cookSeconds * 1000.0 << " ms):" << std::endl;
+    log.Out << "  Input: " << (options.MapBuffers ? "mapped, " : "loaded, ") << source.GetMappedBytes() / (1024 * 1024)
+            << " MB mapped, largest primitive " << largestVertices << " vertices and " << largestIndices << " indices ("
+            << ((uint64_t)largestVertices * sizeof(L_StaticVertex) + (uint64_t)largestIndices * sizeof(u32)) / (1024 * 1024)
+            << " MB expanded), process peak RSS " << GetPeakRSSBytes() / (1024 * 1024) << " MB" << std::endl;
+    log.Out << "  Vertices: " << header.VertexCount << std::endl;
+    if (options.Weld != WeldMode::None) {
+        u32 removed = weldStats.VerticesBefore - weldStats.VerticesAfter;
+        double percent = weldStats.VerticesBefore ? 100.0 * removed / weldStats.VerticesBefore : 0.0;
+        log.Out << "  Weld (" << WeldModeName(options.Weld) << ", within primitives): " << weldStats.VerticesBefore << " -> "
+                << weldStats.VerticesAfter << " vertices (-" << FormatPercent(percent) << ", "
+                << weldStats.DroppedTriangles << " degenerate triangles dropped)" << std::endl;
+    }
+    log.Out << "  Vertex format: " << VertexFormatName(options.Format) << " (" << vertexSize << " bytes, VB "
+            << vertexFile.GetSize() / 1024 << " KB)" << std::endl;
+    if (options.Format == VertexFormat::Compact) {
+        log.Out << "  Quantization error: position " << quantizationError.MaxPosition << ", normal "
+                << quantizationError.MaxNormalDegrees << " deg, tangent " << quantizationError.MaxTangentDegrees << " deg, uv "
+                << quantizationError.MaxUV << ", " << quantizationError.TangentSignFlips << " tangent sign flips, "
+                << splitVertices << " vertices split between submeshes" << std::endl;
+    }
+    log.Out << "  Indices: " << header.IndexCount << " (" << indexSize * 8 << "-bit, IB " << header.IndexCount * indexSize / 1024
+            << " KB)" << std::endl;
+    if (options.Payload == PayloadCodec::Chunked) {
+        log.Out << "  Payload (chunked): streams " << decodedStreamBytes / 1024 << " -> " << storedStreamBytes / 1024 << " KB (ratio "
+                << (storedStreamBytes ? (double)decodedStreamBytes / storedStreamBytes : 0.0) << ", encoded in "
+                << encodeSeconds * 1000.0 << " ms)" << std::endl;
+    }
+    log.Out << "  Submeshes: " << submeshes.size() << std::endl;
+    if (splitStats.SplitSubmeshes > 0) {
+        log.Out << "  Split: " << splitStats.SplitSubmeshes << " submeshes into " << splitStats.Clusters << " clusters of up to "
+                << splitStats.MaxTriangles << " triangles, cluster bounds "
+                << FormatPercent(splitDiagonalSum / splitStats.Clusters * 100.0) << " of the submesh diagonal" << std::endl;
+    }
+    if (options.BuildMeshlets && meshletStats.Meshlets > 0) {
+        log.Out << "  Meshlets: " << meshletCount << " (avg " << (float)meshletStats.Vertices / meshletStats.Meshlets
+                << " vertices, " << (float)meshletStats.Triangles / meshletStats.Meshlets << " triangles), "
+                << meshletStats.Errors << " validation errors" << std::endl;
+    }
+    if (!lods.empty()) {
+        log.Out << "  LODs: " << lods.size() << " levels, triangles " << lodTriangles[0];
+        for (u32 l = 1; l < lodTriangles.size() && lodTriangles[l] > 0; ++l)
+            log.Out << " -> " << lodTriangles[l] << " (error " << lodErrors[l] << ")";
+        log.Out << std::endl;
+    }
+    if (options.BuildOccluders) {
+        log.Out << "  Occluders: " << occluderStats.Boxes << " boxes in " << occluderStats.Parts << " parts of "
+                << occluderStats.Submeshes << " submeshes, " << occluderStats.Rejected << " rejected as hollow, "
+                << occluderStats.Errors << " dropped as overlapping" << std::endl;
+    }
+    if (!bvhRoots.empty()) {
+        log.Out << "  BVH: " << bvhRoots.size() << " roots joined from " << refs.size() << " primitive BVHs, " << bvhNodeCount
+                << " nodes, " << bvhStats.Leaves << " leaves, " << (bvhNodeFile.GetSize() + bvhTriangleFile.GetSize()) / 1024 << " KB" << std::endl;
+        log.Out << "  BVH validation (" << bvhValidation.Rays << " rays over " << refs.size() << " primitives): " << bvhValidation.Hits << " hits, "
+                << bvhValidation.Mismatches << " mismatches, " << bvhValidation.Errors << " errors" << std::endl;
+    }
+    log.Out << "  Materials: " << materials.size() << ", " << textures.size() << " unique textures" << std::endl;
+    log.Out << "  Bounds: [" << boundsMin.x << ", " << boundsMin.y << ", " << boundsMin.z << "] to ["
+            << boundsMax.x << ", " << boundsMax.y << ", " << boundsMax.z << "]" << std::endl;
+    log.Out << "  Output size: " << currentOffset << " bytes (v" << header.Version << ", " << sections.size() << " sections, "
+            << streamSegments << " stream segments)" << std::endl;
+
+    if (meshletStats.Errors > 0)
+        log.Err << "Warning: meshlet validation found " << meshletStats.Errors << " errors in " << inputPath << std::endl;
+    if (bvhValidation.Errors > 0 || bvhValidation.Mismatches > 0) {
+        log.Err << "Warning: BVH validation found " << bvhValidation.Errors << " errors and " << bvhValidation.Mismatches
+                << " ray mismatches in " << inputPath << std::endl;
+    }
+    return true;
 }
 
-bool CompressGLTF(const std::string& inputPath, const std::string& outputPath)
+bool CompressGLTF(const std::string& inputPath, const std::string& outputPath, const CompressOptions& options,
+                  JobPool& pool, CompressLog& log)
 {
-    tinygltf::TinyGLTF loader;
-    tinygltf::Model input;
+    // Buffers stay mapped, only the JSON document is parsed into the tinygltf model
+    GLTFSource source;
     std::string err, warn;
-
-    bool ok = false;
-    if (inputPath.size() >= 4 && inputPath.substr(inputPath.size() - 4) == ".glb")
-        ok = loader.LoadBinaryFromFile(&input, &err, &warn, inputPath);
-    else
-        ok = loader.LoadASCIIFromFile(&input, &err, &warn, inputPath);
+    bool ok = source.Load(inputPath, options.MapBuffers, err, warn);
+    const tinygltf::Model& input = source.GetModel();
 
     if (!ok) {
-        std::cerr << "Error loading GLTF: " << err << std::endl;
+        log.Err << "Error loading GLTF: " << err << std::endl;
         return false;
     }
 
     if (!warn.empty()) {
-        std::cout << "Warning: " << warn << std::endl;
+        log.Out << "Warning: " << warn << std::endl;
     }
 
     // Build node transforms
@@ -334,13 +1276,6 @@ bool CompressGLTF(const std::string& inputPath, const std::string& outputPath)
         }
     }
 
-    // Collect all vertices and indices with transforms applied
-    std::vector<L_StaticVertex> allVertices;
-    std::vector<u32> allIndices;
-    std::vector<L_SubmeshData> submeshes;
-    vec3 boundsMin(FLT_MAX);
-    vec3 boundsMax(-FLT_MAX);
-
     // Build mesh-to-node transforms map
     std::unordered_map<int, std::vector<mat4>> meshNodeTransforms;
     for (size_t nodeIdx = 0; nodeIdx < input.nodes.size(); ++nodeIdx) {
@@ -356,9 +1291,33 @@ bool CompressGLTF(const std::string& inputPath, const std::string& outputPath)
         }
     }
 
-    // Process meshes
+    // Lay out every primitive instance up front so they can be filled in parallel. Meshes used by a single node are
+    // baked in world space first, meshes shared by several nodes follow once in mesh space with an instance per node.
+    std::vector<PrimitiveRef> primitiveRefs;
+    std::vector<L_InstanceData> instances(1);
+    instances[0].SubmeshOffset = 0;
+    // 64-bit so a scene past the 32-bit index range is caught below instead of wrapping
+    uint64_t totalVertexCount = 0;
+    uint64_t totalIndexCount = 0;
+    u32 instancedVertexSavings = 0;
+
+    std::vector<size_t> meshOrder;
+    std::vector<size_t> instancedMeshes;
     for (size_t meshIdx = 0; meshIdx < input.meshes.size(); ++meshIdx) {
+        auto transformIt = meshNodeTransforms.find(meshIdx);
+        bool shared = transformIt != meshNodeTransforms.end() && transformIt->second.size() > 1;
+        if (shared && options.PreserveInstancing)
+            instancedMeshes.push_back(meshIdx);
+        else
+            meshOrder.push_back(meshIdx);
+    }
+    size_t bakedMeshCount = meshOrder.size();
+    meshOrder.insert(meshOrder.end(), instancedMeshes.begin(), instancedMeshes.end());
+
+    for (size_t orderIdx = 0; orderIdx < meshOrder.size(); ++orderIdx) {
+        size_t meshIdx = meshOrder[orderIdx];
         const auto& mesh = input.meshes[meshIdx];
+        bool instanced = orderIdx >= bakedMeshCount;
 
         mat4 identity;
         std::vector<mat4> transforms = { identity };
@@ -367,258 +1326,1007 @@ bool CompressGLTF(const std::string& inputPath, const std::string& outputPath)
             transforms = transformIt->second;
         }
 
-        for (const auto& prim : mesh.primitives) {
-            for (const auto& transform : transforms) {
-                if (prim.attributes.find("POSITION") == prim.attributes.end()) {
-                    std::cerr << "Warning: Primitive missing POSITION attribute" << std::endl;
-                    continue;
-                }
+        if (orderIdx == bakedMeshCount)
+            instances[0].SubmeshCount = (u32)primitiveRefs.size();
+        u32 meshSubmeshOffset = (u32)primitiveRefs.size();
 
-                const auto& posAccessor = input.accessors[prim.attributes.at("POSITION")];
-                const auto positions = ReadAccessor<vec3>(input, posAccessor);
+        // Shared meshes are stored once untransformed, their node transforms go in the instance table
+        std::vector<mat4> storedTransforms = instanced ? std::vector<mat4>{ identity } : transforms;
 
-                std::vector<vec3> normals;
-                if (prim.attributes.count("NORMAL"))
-                    normals = ReadAccessor<vec3>(input, input.accessors[prim.attributes.at("NORMAL")]);
+        for (const auto& prim : mesh.primitives) {
+            if (prim.attributes.find("POSITION") == prim.attributes.end()) {
+                log.Err << "Warning: Primitive missing POSITION attribute" << std::endl;
+                continue;
+            }
+            if (prim.indices < 0) {
+                log.Err << "Warning: Primitive missing indices" << std::endl;
+                continue;
+            }
 
-                std::vector<vec2> uvs;
-                if (prim.attributes.count("TEXCOORD_0"))
-                    uvs = ReadAccessor<vec2>(input, input.accessors[prim.attributes.at("TEXCOORD_0")]);
+            const auto& indexAccessor = input.accessors[prim.indices];
+            if (indexAccessor.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT &&
+                indexAccessor.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) {
+                log.Err << "Error: Unsupported index type" << std::endl;
+                continue;
+            }
 
-                std::vector<vec4> tangents;
-                if (prim.attributes.count("TANGENT"))
-                    tangents = ReadAccessor<vec4>(input, input.accessors[prim.attributes.at("TANGENT")]);
+            // Accessors are read in place, so anything pointing outside its buffer is rejected here
+            size_t indexSize = indexAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT ? sizeof(u16) : sizeof(u32);
+            AccessorView indexView;
+            if (!GetAttributeView(source, prim, "POSITION", sizeof(vec3)).IsValid() || !source.GetAccessor(prim.indices, indexSize, indexView)) {
+                log.Err << "Warning: Primitive with unreadable POSITION or index data" << std::endl;
+                continue;
+            }
 
-                mat3 normalMatrix = transposeMat3(inverseMat3(transform.toMat3()));
+            uint64_t vertexCount = input.accessors[prim.attributes.at("POSITION")].count;
+            uint64_t indexCount = indexAccessor.count;
 
-                u32 vertexBaseIndex = allVertices.size();
-                size_t vertexCount = positions.size();
+            // Stats only, the vertices the other nodes' copies would have added
+            if (instanced)
+                instancedVertexSavings += (u32)vertexCount * (u32)(transforms.size() - 1);
 
-                // Initialize submesh AABB
-                vec3 submeshMin(FLT_MAX);
-                vec3 submeshMax(-FLT_MAX);
+            for (const auto& transform : storedTransforms) {
+                // Vertex and index positions are 32-bit in the file and every pass, bigger scenes have to be split
+                if (totalVertexCount + vertexCount > UINT32_MAX || totalIndexCount + indexCount > UINT32_MAX) {
+                    log.Err << "Error: " << inputPath << " has more than " << UINT32_MAX
+                            << " vertices or indices, split the scene into several files" << std::endl;
+                    return false;
+                }
 
-                // Build vertices with transforms
-                for (size_t i = 0; i < vertexCount; ++i) {
-                    L_StaticVertex v;
-                    vec4 worldPos = transform * vec4(positions[i], 1.0f);
-                    v.Position = worldPos.xyz();
+                PrimitiveRef ref;
+                ref.Primitive = &prim;
+                ref.Transform = transform;
+                ref.VertexBase = (u32)totalVertexCount;
+                ref.VertexCount = (u32)vertexCount;
+                ref.IndexBase = (u32)totalIndexCount;
+                ref.IndexCount = (u32)indexCount;
+                primitiveRefs.push_back(ref);
+
+                totalVertexCount += vertexCount;
+                totalIndexCount += indexCount;
+            }
+        }
 
-                    // Update bounds
-                    boundsMin = minVec3(boundsMin, v.Position);
-                    boundsMax = maxVec3(boundsMax, v.Position);
+        u32 meshSubmeshCount = (u32)primitiveRefs.size() - meshSubmeshOffset;
+        if (instanced && meshSubmeshCount > 0) {
+            for (const auto& transform : transforms)
+                instances.push_back(L_InstanceData{ meshSubmeshOffset, meshSubmeshCount, transform });
+        }
+    }
+    if (bakedMeshCount == meshOrder.size())
+        instances[0].SubmeshCount = (u32)primitiveRefs.size();
+    if (instances[0].SubmeshCount == 0)
+        instances.erase(instances.begin());
 
-                    // Update submesh bounds
-                    submeshMin = minVec3(submeshMin, v.Position);
-                    submeshMax = maxVec3(submeshMax, v.Position);
+    // Spatially and material coherent submesh order, so culling and draws walk neighbouring submeshes together
+    SubmeshOrderStats orderBefore = AnalyzeSubmeshOrder(input, primitiveRefs);
+    SortSubmeshes(input, options.SubmeshOrder, instances, primitiveRefs);
+    SubmeshOrderStats orderAfter = AnalyzeSubmeshOrder(input, primitiveRefs);
 
-                    v.Normal = normals.empty() ? vec3(0, 1, 0) : (normalMatrix * normals[i]).normalize();
-                    v.UV = uvs.empty() ? vec2(0) : uvs[i];
+    if (options.Streaming)
+        return CompressStreamed(inputPath, outputPath, options, source, primitiveRefs, instances, pool, log);
 
-                    if (!tangents.empty()) {
-                        vec3 transformedTangent = (normalMatrix * tangents[i].xyz()).normalize();
-                        v.Tangent = vec4(transformedTangent, tangents[i].w);
-                    } else {
-                        v.Tangent = vec4(0);
-                    }
+    // Collect all vertices and indices with transforms applied
+    std::vector<L_StaticVertex> allVertices(totalVertexCount);
+    std::vector<u32> allIndices(totalIndexCount);
+    std::vector<L_SubmeshData> submeshes(primitiveRefs.size());
+
+    JobCounter primitiveCounter;
+    for (size_t i = 0; i < primitiveRefs.size(); ++i) {
+        pool.Submit(primitiveCounter, [&, i] {
+            ProcessPrimitive(source, primitiveRefs[i], pool, allVertices.data(), allIndices.data(), submeshes[i]);
+        });
+    }
+    pool.Wait(primitiveCounter);
+
+    // Merge split seams and primitives that share vertex data
+    WeldStats weldStats = WeldVertices(allVertices, allIndices, submeshes, options.Weld, options.WeldEpsilon);
+
+    // Occluder boxes for the CPU occlusion culler, fitted before the split since a cluster of a closed mesh is open
+    std::vector<std::vector<L_OccluderData>> submeshOccluders(submeshes.size());
+    OccluderStats occluderStats;
+    double occluderSeconds = 0.0;
+    if (options.BuildOccluders) {
+        auto occluderStart = std::chrono::steady_clock::now();
+        vec3 sceneMin, sceneMax;
+        ComputeSceneBounds(instances, submeshes, sceneMin, sceneMax);
+        float minDiagonal = (sceneMax - sceneMin).length() * options.OccluderMinSize;
+
+        std::vector<OccluderStats> submeshStats(submeshes.size());
+        pool.ParallelFor(submeshes.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                if (IsOpaqueMaterial(input, submeshes[i].MaterialIndex))
+                    BuildOccluders(allVertices, allIndices, submeshes[i], (u32)i, minDiagonal, submeshOccluders[i], submeshStats[i]);
+            }
+        });
+        for (const OccluderStats& stats : submeshStats) {
+            occluderStats.Submeshes += stats.Submeshes;
+            occluderStats.Parts += stats.Parts;
+            occluderStats.Boxes += stats.Boxes;
+            occluderStats.Rejected += stats.Rejected;
+            occluderStats.PartVolume += stats.PartVolume;
+            occluderStats.BoxVolume += stats.BoxVolume;
+            occluderStats.Errors += stats.Errors;
+        }
+        occluderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - occluderStart).count();
+        if (occluderStats.Errors > 0)
+            log.Err << "Warning: " << occluderStats.Errors << " occluder boxes overlapping their mesh dropped in " << inputPath << std::endl;
+    }
 
-                    allVertices.push_back(v);
-                }
+    // Split huge submeshes into clusters with tight bounds so frustum and cascade culling can reject parts of them
+    SubmeshSplitStats splitStats;
+    std::vector<u32> firstCluster;
+    if (options.MaxSubmeshTriangles > 0) {
+        std::vector<u32> submeshTriangles(submeshes.size());
+        for (size_t i = 0; i < submeshes.size(); ++i)
+            submeshTriangles[i] = submeshes[i].IndexCount / 3;
+        u32 maxTriangles = FitClusterSize(instances, submeshTriangles, options, log);
+        if (maxTriangles > 0) {
+            splitStats = SplitLargeSubmeshes(allVertices, allIndices, submeshes, maxTriangles, firstCluster);
+            for (auto& instance : instances) {
+                u32 end = instance.SubmeshOffset + instance.SubmeshCount;
+                instance.SubmeshOffset = firstCluster[instance.SubmeshOffset];
+                instance.SubmeshCount = firstCluster[end] - instance.SubmeshOffset;
+            }
+        }
+    }
 
-                // Load indices
-                if (prim.indices < 0) {
-                    std::cerr << "Warning: Primitive missing indices" << std::endl;
-                    continue;
-                }
+    // Occluders of a split submesh go with its first cluster, the runtime only needs the instance range they are in
+    std::vector<L_OccluderData> occluders;
+    for (u32 s = 0; s < submeshOccluders.size(); ++s) {
+        for (L_OccluderData occluder : submeshOccluders[s]) {
+            occluder.SubmeshIndex = firstCluster.empty() ? s : firstCluster[s];
+            occluders.push_back(occluder);
+        }
+    }
 
-                u32 indexBaseOffset = allIndices.size();
-                const auto& indexAccessor = input.accessors[prim.indices];
-                switch (indexAccessor.componentType) {
-                    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
-                        std::vector<u16> u16indices = ReadAccessor<u16>(input, indexAccessor);
-                        for (u16 index : u16indices) {
-                            allIndices.push_back(vertexBaseIndex + index);
-                        }
-                        break;
-                    }
-                    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: {
-                        std::vector<u32> indices = ReadAccessor<u32>(input, indexAccessor);
-                        for (u32 index : indices) {
-                            allIndices.push_back(vertexBaseIndex + index);
-                        }
-                        break;
-                    }
-                    default:
-                        std::cerr << "Error: Unsupported index type" << std::endl;
-                        break;
-                }
+    // Reorder triangles within each submesh for the post-transform cache
+    VertexCacheStats cacheBefore = AnalyzeSubmeshes(allIndices, submeshes, pool);
+    if (options.OptimizeVertexCache) {
+        pool.ParallelFor(submeshes.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                OptimizeVertexCache(allIndices.data() + submeshes[i].IndexOffset, submeshes[i].IndexCount);
+        });
+    }
 
-                // Create submesh entry
-                L_SubmeshData submesh;
-                submesh.IndexOffset = indexBaseOffset;
-                submesh.IndexCount = allIndices.size() - indexBaseOffset;
-                submesh.MaterialIndex = prim.material >= 0 ? prim.material : 0;
-                submesh.Min = submeshMin;
-                submesh.Max = submeshMax;
-                submeshes.push_back(submesh);
+    // Put outward-facing clusters of opaque submeshes first to cut gbuffer overdraw
+    std::vector<bool> opaqueSubmesh(submeshes.size());
+    for (size_t i = 0; i < submeshes.size(); ++i)
+        opaqueSubmesh[i] = IsOpaqueMaterial(input, submeshes[i].MaterialIndex);
+
+    OverdrawStats overdrawBefore = AnalyzeSubmeshOverdraw(allVertices, allIndices, submeshes, opaqueSubmesh, options.OverdrawViews, pool);
+    std::atomic<u32> overdrawReordered{0};
+    if (options.OptimizeOverdraw) {
+        // Ordered and checked from the views the estimate reports, or the default ones when it is skipped
+        u32 views = options.OverdrawViews > 0 ? options.OverdrawViews : kOverdrawViews;
+        pool.ParallelFor(submeshes.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                if (opaqueSubmesh[i] &&
+                    OptimizeOverdraw(allIndices.data() + submeshes[i].IndexOffset, submeshes[i].IndexCount, allVertices.data(), views))
+                    overdrawReordered++;
             }
-        }
+        });
     }
+    OverdrawStats overdrawAfter = AnalyzeSubmeshOverdraw(allVertices, allIndices, submeshes, opaqueSubmesh, options.OverdrawViews, pool);
+
+    VertexCacheStats cacheAfter = AnalyzeSubmeshes(allIndices, submeshes, pool);
+
+    // Compact positions are relative to the submesh bounds, so a vertex can only belong to one submesh
+    u32 splitVertices = 0;
+    if (options.Format == VertexFormat::Compact)
+        splitVertices = SplitSharedVertices(allVertices, allIndices, submeshes);
+
+    // Lay vertices out in first-use order so vertex fetches walk memory linearly
+    size_t vertexSize = GetVertexSize(options.Format);
+    VertexFetchStats fetchBefore = AnalyzeSubmeshFetch(allIndices, submeshes, vertexSize, pool);
+    if (options.OptimizeVertexFetch)
+        OptimizeVertexFetch(allVertices, allIndices);
+    VertexFetchStats fetchAfter = AnalyzeSubmeshFetch(allIndices, submeshes, vertexSize, pool);
+
+    std::vector<L_CompactVertex> compactVertices;
+    QuantizationError quantizationError;
+    if (options.Format == VertexFormat::Compact)
+        quantizationError = EncodeCompactVertices(allVertices, allIndices, submeshes, compactVertices);
+
+    // Cut the final index order into meshlets for culling below submesh granularity
+    std::vector<L_MeshletData> meshlets;
+    MeshletValidationStats meshletStats;
+    if (options.BuildMeshlets) {
+        std::vector<std::vector<L_MeshletData>> submeshMeshlets(submeshes.size());
+        pool.ParallelFor(submeshes.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                bool coneCulling = IsSingleSidedMaterial(input, submeshes[i].MaterialIndex);
+                BuildMeshlets(allVertices, allIndices, submeshes[i], (u32)i, coneCulling, submeshMeshlets[i]);
+            }
+        });
+        for (const auto& list : submeshMeshlets)
+            meshlets.insert(meshlets.end(), list.begin(), list.end());
 
-    // Collect materials
-    std::vector<L_MaterialData> materials;
-    materials.reserve(input.materials.size());
-    for (const auto& mat : input.materials) {
-        L_MaterialData m = {};
-
-        // Initialize paths to empty strings
-        memset(m.AlbedoPath, 0, sizeof(m.AlbedoPath));
-        memset(m.NormalPath, 0, sizeof(m.NormalPath));
-        memset(m.ORMPath, 0, sizeof(m.ORMPath));
-        
-        // Check alpha mode (default is OPAQUE)
-        m.Opaque = 1; // Default to opaque
-        if (mat.alphaMode == "MASK" || mat.alphaMode == "BLEND") {
-            m.Opaque = 0; // Not opaque (uses alpha cutout or blending)
-        }
-
-        // Get albedo texture path
-        if (mat.pbrMetallicRoughness.baseColorTexture.index >= 0) {
-            int texIndex = mat.pbrMetallicRoughness.baseColorTexture.index;
-            if (texIndex < (int)input.textures.size()) {
-                const auto& texture = input.textures[texIndex];
-                if (texture.source >= 0 && texture.source < (int)input.images.size()) {
-                    const std::string& uri = input.images[texture.source].uri;
-                    if (!uri.empty()) {
-                        strncpy(m.AlbedoPath, uri.c_str(), sizeof(m.AlbedoPath) - 1);
-                    }
+        meshletStats = ValidateMeshlets(allVertices, allIndices, submeshes, meshlets, kMeshletValidationViews);
+        if (meshletStats.Errors > 0)
+            log.Err << "Warning: meshlet validation found " << meshletStats.Errors << " errors in " << inputPath << std::endl;
+    }
+
+    // Simplified levels go after every submesh so the submesh and meshlet ranges stay where they are
+    std::vector<L_LodData> lods;
+    std::vector<u32> lodTriangles(options.LodLevels + 1, 0);
+    std::vector<float> lodErrors(options.LodLevels + 1, 0.0f);
+    if (options.LodLevels > 0) {
+        std::vector<std::vector<LodLevel>> submeshLods(submeshes.size());
+        pool.ParallelFor(submeshes.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                submeshLods[i] = BuildLodChain(allVertices, allIndices.data() + submeshes[i].IndexOffset, submeshes[i].IndexCount,
+                                               options.LodLevels);
+                if (options.OptimizeVertexCache) {
+                    for (LodLevel& level : submeshLods[i])
+                        OptimizeVertexCache(level.Indices.data(), level.Indices.size());
                 }
             }
+        });
+
+        for (u32 s = 0; s < submeshes.size(); ++s) {
+            lodTriangles[0] += submeshes[s].IndexCount / 3;
+            for (u32 l = 0; l < submeshLods[s].size(); ++l) {
+                const LodLevel& level = submeshLods[s][l];
+                L_LodData lod = {};
+                lod.SubmeshIndex = s;
+                lod.Level = l + 1;
+                lod.IndexOffset = (u32)allIndices.size();
+                lod.IndexCount = (u32)level.Indices.size();
+                lod.Error = level.Error;
+                lods.push_back(lod);
+                allIndices.insert(allIndices.end(), level.Indices.begin(), level.Indices.end());
+
+                lodTriangles[lod.Level] += lod.IndexCount / 3;
+                lodErrors[lod.Level] = std::max(lodErrors[lod.Level], lod.Error);
+            }
         }
+    }
 
-        // Get normal texture path
-        if (mat.normalTexture.index >= 0) {
-            int texIndex = mat.normalTexture.index;
-            if (texIndex < (int)input.textures.size()) {
-                const auto& texture = input.textures[texIndex];
-                if (texture.source >= 0 && texture.source < (int)input.images.size()) {
-                    const std::string& uri = input.images[texture.source].uri;
-                    if (!uri.empty()) {
-                        strncpy(m.NormalPath, uri.c_str(), sizeof(m.NormalPath) - 1);
-                    }
+    // Model bounds cover every instance
+    vec3 boundsMin, boundsMax;
+    ComputeSceneBounds(instances, submeshes, boundsMin, boundsMax);
+
+    std::vector<char> strings;
+    std::vector<L_TextureData> textures;
+    std::vector<L_MaterialEntry> materials;
+    CollectMaterials(input, strings, textures, materials);
+
+    // One BVH per distinct instance range, over the final positions so CPU ray queries see what the GPU draws
+    std::vector<L_BvhRootData> bvhRoots;
+    std::vector<L_BvhNode> bvhNodes;
+    std::vector<u32> bvhTriangles;
+    BvhBuildStats bvhStats;
+    BvhValidationStats bvhValidation;
+    double bvhSeconds = 0.0;
+    if (options.BakeBvh) {
+        auto bvhStart = std::chrono::steady_clock::now();
+
+        // Compact positions are quantized, build over what the runtime decodes so leaf bounds still contain them
+        std::vector<L_StaticVertex> decodedVertices;
+        if (options.Format == VertexFormat::Compact) {
+            decodedVertices = allVertices;
+            for (const auto& submesh : submeshes) {
+                vec3 extent = submesh.Max - submesh.Min;
+                for (u32 i = submesh.IndexOffset; i < submesh.IndexOffset + submesh.IndexCount; ++i) {
+                    const L_CompactVertex& v = compactVertices[allIndices[i]];
+                    decodedVertices[allIndices[i]].Position = vec3(submesh.Min.x + extent.x * (v.Position[0] / 65535.0f),
+                                                                   submesh.Min.y + extent.y * (v.Position[1] / 65535.0f),
+                                                                   submesh.Min.z + extent.z * (v.Position[2] / 65535.0f));
                 }
             }
         }
+        const std::vector<L_StaticVertex>& bvhVertices = decodedVertices.empty() ? allVertices : decodedVertices;
+
+        for (const auto& instance : instances) {
+            bool built = std::any_of(bvhRoots.begin(), bvhRoots.end(), [&](const L_BvhRootData& root) {
+                return root.SubmeshOffset == instance.SubmeshOffset && root.SubmeshCount == instance.SubmeshCount;
+            });
+            if (built)
+                continue;
+
+            L_BvhRootData root = {};
+            root.SubmeshOffset = instance.SubmeshOffset;
+            root.SubmeshCount = instance.SubmeshCount;
+            u32 firstNode = (u32)bvhNodes.size();
+            root.RootNode = BuildBvh(bvhVertices, allIndices, submeshes, instance.SubmeshOffset, instance.SubmeshCount, pool,
+                                     bvhNodes, bvhTriangles, bvhStats);
+            root.NodeCount = (u32)bvhNodes.size() - firstNode;
+            bvhRoots.push_back(root);
+        }
+        bvhSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - bvhStart).count();
 
-        // Get ORM (Occlusion-Roughness-Metallic) texture path
-        if (mat.pbrMetallicRoughness.metallicRoughnessTexture.index >= 0) {
-            int texIndex = mat.pbrMetallicRoughness.metallicRoughnessTexture.index;
-            if (texIndex < (int)input.textures.size()) {
-                const auto& texture = input.textures[texIndex];
-                if (texture.source >= 0 && texture.source < (int)input.images.size()) {
-                    const std::string& uri = input.images[texture.source].uri;
-                    if (!uri.empty()) {
-                        strncpy(m.ORMPath, uri.c_str(), sizeof(m.ORMPath) - 1);
-                    }
-                }
-            }
+        bvhValidation = ValidateBvh(bvhVertices, allIndices, submeshes, bvhRoots, bvhNodes, bvhTriangles, kBvhValidationRays, pool);
+        if (bvhValidation.Errors > 0 || bvhValidation.Mismatches > 0) {
+            log.Err << "Warning: BVH validation found " << bvhValidation.Errors << " errors and " << bvhValidation.Mismatches
+                    << " ray mismatches in " << inputPath << std::endl;
         }
+    }
 
-        materials.push_back(m);
+    // Narrow indices to 16 bits when every submesh's vertex range allows it
+    std::vector<u16> shortIndices;
+    std::vector<u32> baseVertices;
+    u32 wideSubmesh = 0;
+    bool useShortIndices = options.AllowShortIndices && BuildShortIndices(allIndices, submeshes, lods, shortIndices, baseVertices, &wideSubmesh);
+    if (options.AllowShortIndices && !useShortIndices) {
+        log.Out << "  Submesh " << wideSubmesh << " spans more than 65536 vertices, keeping 32-bit indices" << std::endl;
+    }
+    IndexFormat indexFormat = useShortIndices ? IndexFormat::UInt16 : IndexFormat::UInt32;
+    size_t indexSize = useShortIndices ? sizeof(u16) : sizeof(u32);
+
+    // Depth-only passes and BLAS builds read just the positions, a separate packed copy keeps their fetches small
+    std::vector<u8> positionStream;
+    if (options.WritePositionStream)
+        positionStream = BuildPositionStream(options.Format, allVertices, compactVertices);
+    size_t positionSize = GetPositionSize(options.Format);
+
+    // Sections in file order, the directory is filled in once every payload is encoded
+    struct PendingSection
+    {
+        L_MeshSection Section;
+        const void* Data;
+        uint64_t Alignment;
+    };
+    std::vector<PendingSection> sections;
+    auto addTable = [&](MeshSectionType type, const void* data, size_t size) {
+        if (size == 0)
+            return;
+        L_MeshSection section = {};
+        section.Type = (u32)type;
+        section.Codec = (u32)PayloadCodec::Raw;
+        section.StoredSize = size;
+        section.DecodedSize = size;
+        sections.push_back({ section, data, kMeshTableAlignment });
+    };
+    addTable(MeshSectionType::Submeshes, submeshes.data(), submeshes.size() * sizeof(L_SubmeshData));
+    addTable(MeshSectionType::Strings, strings.data(), strings.size());
+    addTable(MeshSectionType::Textures, textures.data(), textures.size() * sizeof(L_TextureData));
+    addTable(MeshSectionType::MaterialEntries, materials.data(), materials.size() * sizeof(L_MaterialEntry));
+    addTable(MeshSectionType::Meshlets, meshlets.data(), meshlets.size() * sizeof(L_MeshletData));
+    addTable(MeshSectionType::BaseVertices, baseVertices.data(), baseVertices.size() * sizeof(u32));
+    addTable(MeshSectionType::Lods, lods.data(), lods.size() * sizeof(L_LodData));
+    addTable(MeshSectionType::Instances, instances.data(), instances.size() * sizeof(L_InstanceData));
+    addTable(MeshSectionType::Occluders, occluders.data(), occluders.size() * sizeof(L_OccluderData));
+    addTable(MeshSectionType::BvhRoots, bvhRoots.data(), bvhRoots.size() * sizeof(L_BvhRootData));
+    addTable(MeshSectionType::BvhNodes, bvhNodes.data(), bvhNodes.size() * sizeof(L_BvhNode));
+    addTable(MeshSectionType::BvhTriangles, bvhTriangles.data(), bvhTriangles.size() * sizeof(u32));
+
+    // Streams are cut into segments of whole elements, each encoded on its own
+    struct StreamTotals
+    {
+        uint64_t DecodedSize = 0;
+        uint64_t StoredSize = 0;
+        u32 Segments = 0;
+    };
+    std::vector<std::vector<u8>> payloads;
+    double encodeSeconds = 0.0;
+    bool payloadsVerified = true;
+    auto addStream = [&](MeshSectionType type, const void* data, uint64_t size, size_t elementSize, u32 laneSize) {
+        StreamTotals totals;
+        uint64_t segmentBytes = kMaxStreamSegmentBytes / elementSize * elementSize;
+        for (uint64_t begin = 0; begin < size; begin += segmentBytes) {
+            L_MeshSection section = {};
+            section.Type = (u32)type;
+            section.Codec = (u32)options.Payload;
+            section.DecodedOffset = begin;
+            section.DecodedSize = std::min(segmentBytes, size - begin);
+            const u8* segment = (const u8*)data + begin;
+
+            const void* stored = segment;
+            section.StoredSize = section.DecodedSize;
+            if (options.Payload == PayloadCodec::Chunked) {
+                auto encodeStart = std::chrono::steady_clock::now();
+                payloads.push_back(EncodePayload(segment, section.DecodedSize, elementSize, laneSize));
+                encodeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - encodeStart).count();
+                payloadsVerified = payloadsVerified && VerifyPayload(payloads.back(), segment, section.DecodedSize);
+                stored = payloads.back().data();
+                section.StoredSize = payloads.back().size();
+            }
+            // Raw segments are page aligned so they can be mapped, chunked ones are decoded into a new buffer anyway
+            uint64_t alignment = options.Payload == PayloadCodec::Raw ? kMeshStreamAlignment : kMeshTableAlignment;
+            sections.push_back({ section, stored, alignment });
+            totals.DecodedSize += section.DecodedSize;
+            totals.StoredSize += section.StoredSize;
+            totals.Segments++;
+        }
+        return totals;
+    };
+
+    // Compact vertices are all 16-bit fields, float vertices and 32-bit indices delta code per 32-bit lane
+    u32 vertexLaneSize = options.Format == VertexFormat::Compact ? 2 : 4;
+    const void* vertexData = options.Format == VertexFormat::Compact ? (const void*)compactVertices.data() : (const void*)allVertices.data();
+    const void* indexData = useShortIndices ? (const void*)shortIndices.data() : (const void*)allIndices.data();
+    StreamTotals vertexTotals = addStream(MeshSectionType::Vertices, vertexData, (uint64_t)allVertices.size() * vertexSize, vertexSize, vertexLaneSize);
+    StreamTotals positionTotals = addStream(MeshSectionType::Positions, positionStream.data(), positionStream.size(), positionSize, vertexLaneSize);
+    StreamTotals indexTotals = addStream(MeshSectionType::Indices, indexData, (uint64_t)allIndices.size() * indexSize, indexSize, indexSize);
+    if (!payloadsVerified) {
+        log.Err << "Error: Chunked payload failed to round-trip" << std::endl;
+        return false;
     }
 
-    // Build file structure
-    L_StaticMeshHeader header = {};
+    L_MeshFileHeader header = {};
+    header.Magic = kMeshFileMagic;
+    header.Version = kMeshFileVersion;
+    header.HeaderSize = sizeof(L_MeshFileHeader);
+    header.SectionCount = sections.size();
+    header.SectionTableOffset = sizeof(L_MeshFileHeader);
     header.VertexCount = allVertices.size();
     header.IndexCount = allIndices.size();
-    header.VertexFormat = 0; // Standard format
-    header.IndexFormat = 0;  // u32
-    header.SubmeshCount = submeshes.size();
-    header.MaterialCount = materials.size();
-    header.Min = boundsMin;
-    header.Max = boundsMax;
+    header.VertexFormat = (u32)options.Format;
+    header.IndexFormat = (u32)indexFormat;
+    memcpy(header.Min, &boundsMin, sizeof(header.Min));
+    memcpy(header.Max, &boundsMax, sizeof(header.Max));
+
+    // 64-bit offsets, a scene can be any size
+    uint64_t currentOffset = header.SectionTableOffset + sections.size() * sizeof(L_MeshSection);
+    for (PendingSection& pending : sections) {
+        currentOffset = (currentOffset + pending.Alignment - 1) / pending.Alignment * pending.Alignment;
+        pending.Section.Offset = currentOffset;
+        currentOffset += pending.Section.StoredSize;
+    }
 
-    // Calculate offsets
-    u32 currentOffset = sizeof(L_StaticMeshHeader);
+    // Stream every section straight to the file, the payloads are never copied into one big buffer
+    std::ofstream outFile(outputPath, std::ios::binary);
+    if (!outFile) {
+        log.Err << "Error: Could not open output file: " << outputPath << std::endl;
+        return false;
+    }
 
-    header.SubmeshTableOffset = currentOffset;
-    currentOffset += submeshes.size() * sizeof(L_SubmeshData);
+    uint64_t writtenOffset = 0;
+    auto writeSection = [&](const void* data, uint64_t size) {
+        outFile.write(reinterpret_cast<const char*>(data), size);
+        writtenOffset += size;
+    };
+    writeSection(&header, sizeof(L_MeshFileHeader));
+    for (const PendingSection& pending : sections)
+        writeSection(&pending.Section, sizeof(L_MeshSection));
+    for (const PendingSection& pending : sections) {
+        static const u8 kPadding[kMeshStreamAlignment] = {};
+        writeSection(kPadding, pending.Section.Offset - writtenOffset);
+        writeSection(pending.Data, pending.Section.StoredSize);
+    }
 
-    header.MaterialTableOffset = currentOffset;
-    currentOffset += materials.size() * sizeof(L_MaterialData);
+    outFile.close();
+    std::error_code sizeError;
+    if (!outFile || std::filesystem::file_size(outputPath, sizeError) != currentOffset || sizeError) {
+        log.Err << "Error: Failed writing output file: " << outputPath << std::endl;
+        return false;
+    }
 
-    header.VBOffset = currentOffset;
-    header.VBSize = allVertices.size() * sizeof(L_StaticVertex);
-    currentOffset += header.VBSize;
+    log.Out << "Successfully compressed mesh:" << std::endl;
+    log.Out << "  Input: " << (options.MapBuffers ? "mapped, " : "loaded, ") << source.GetMappedBytes() / (1024 * 1024)
+            << " MB mapped, process peak RSS " << GetPeakRSSBytes() / (1024 * 1024) << " MB" << std::endl;
+    log.Out << "  Vertices: " << header.VertexCount << std::endl;
+    if (options.Weld != WeldMode::None) {
+        u32 removed = weldStats.VerticesBefore - weldStats.VerticesAfter;
+        double percent = weldStats.VerticesBefore ? 100.0 * removed / weldStats.VerticesBefore : 0.0;
+        log.Out << "  Weld (" << WeldModeName(options.Weld) << "): " << weldStats.VerticesBefore << " -> "
+                << weldStats.VerticesAfter << " vertices (-" << FormatPercent(percent) << ", "
+                << (removed * vertexSize) / 1024 << " KB saved, "
+                << weldStats.DroppedTriangles << " degenerate triangles dropped)" << std::endl;
+    }
+    log.Out << "  Vertex format: " << VertexFormatName(options.Format) << " (" << vertexSize << " bytes, VB "
+            << vertexTotals.DecodedSize / 1024 << " KB, " << (allVertices.size() * sizeof(L_StaticVertex)) / 1024 << " KB as float)" << std::endl;
+    if (options.Format == VertexFormat::Compact) {
+        log.Out << "  Quantization error: position " << quantizationError.MaxPosition << ", normal "
+                << quantizationError.MaxNormalDegrees << " deg, tangent " << quantizationError.MaxTangentDegrees << " deg, uv "
+                << quantizationError.MaxUV << ", " << quantizationError.TangentSignFlips << " tangent sign flips, "
+                << splitVertices << " vertices split between submeshes" << std::endl;
+    }
+    if (!positionStream.empty()) {
+        log.Out << "  Position stream: " << positionSize << " bytes per vertex (" << positionTotals.DecodedSize / 1024 << " KB, "
+                << FormatPercent(100.0 * positionSize / vertexSize) << " of the vertex fetch for depth-only passes)" << std::endl;
+    }
+    log.Out << "  Indices: " << header.IndexCount << " (" << indexSize * 8 << "-bit, IB " << indexTotals.DecodedSize / 1024 << " KB)" << std::endl;
+    if (options.Payload == PayloadCodec::Chunked) {
+        uint64_t rawSize = vertexTotals.DecodedSize + indexTotals.DecodedSize + positionTotals.DecodedSize;
+        uint64_t storedSize = vertexTotals.StoredSize + indexTotals.StoredSize + positionTotals.StoredSize;
+        log.Out << "  Payload (chunked): VB " << vertexTotals.DecodedSize / 1024 << " -> " << vertexTotals.StoredSize / 1024 << " KB, IB "
+                << indexTotals.DecodedSize / 1024 << " -> " << indexTotals.StoredSize / 1024 << " KB, positions "
+                << positionTotals.DecodedSize / 1024 << " -> " << positionTotals.StoredSize / 1024 << " KB (ratio "
+                << (storedSize ? (double)rawSize / storedSize : 0.0) << ", encoded in " << encodeSeconds * 1000.0 << " ms)" << std::endl;
+    }
+    log.Out << "  Vertex cache (FIFO " << kAnalyzeCacheSize << "): ACMR " << cacheBefore.ACMR() << " -> " << cacheAfter.ACMR()
+            << ", ATVR " << cacheBefore.ATVR() << " -> " << cacheAfter.ATVR() << std::endl;
+    log.Out << "  Vertex fetch: average stride " << fetchBefore.AverageStride() << " -> " << fetchAfter.AverageStride()
+            << " bytes over " << fetchAfter.Fetches << " fetches" << std::endl;
+    if (options.OverdrawViews > 0) {
+        log.Out << "  Overdraw (opaque, " << options.OverdrawViews << " views): " << overdrawBefore.Overdraw() << " -> "
+                << overdrawAfter.Overdraw() << ", " << overdrawReordered.load() << " submeshes reordered" << std::endl;
+    }
+    log.Out << "  Submeshes: " << submeshes.size() << std::endl;
+    if (splitStats.SplitSubmeshes > 0) {
+        log.Out << "  Split: " << splitStats.SplitSubmeshes << " submeshes into " << splitStats.Clusters << " clusters of up to "
+                << splitStats.MaxTriangles << " triangles, cluster bounds " << FormatPercent(splitStats.MeanDiagonal * 100.0)
+                << " of the submesh diagonal" << std::endl;
+    }
+    if (options.SubmeshOrder != SpatialOrder::None) {
+        log.Out << "  Submesh order (" << SpatialOrderName(options.SubmeshOrder) << "): material switches " << orderBefore.MaterialSwitches
+                << " -> " << orderAfter.MaterialSwitches << ", mean centroid step " << orderBefore.MeanStep << " -> "
+                << orderAfter.MeanStep << std::endl;
+    }
+    if (!instancedMeshes.empty()) {
+        log.Out << "  Instancing: " << instancedMeshes.size() << " shared meshes, " << instances.size() << " instances, "
+                << instancedVertexSavings << " vertices not duplicated (" << (instancedVertexSavings * vertexSize) / 1024
+                << " KB)" << std::endl;
+    }
+    if (options.BuildMeshlets && meshletStats.Meshlets > 0) {
+        double triangleTests = (double)std::max<uint64_t>(1, meshletStats.TrianglesTested);
+        double meshletTests = (double)std::max<uint64_t>(1, meshletStats.Tested);
+        log.Out << "  Meshlets: " << meshletStats.Meshlets << " (avg " << (float)meshletStats.Vertices / meshletStats.Meshlets
+                << " vertices, " << (float)meshletStats.Triangles / meshletStats.Meshlets << " triangles)" << std::endl;
+        log.Out << "  Meshlet culling (" << kMeshletValidationViews << " views): "
+                << FormatPercent(100.0 * meshletStats.FrustumCulled / meshletTests) << " frustum, "
+                << FormatPercent(100.0 * meshletStats.BackfaceCulled / meshletTests) << " backface, "
+                << FormatPercent(100.0 * meshletStats.TrianglesCulled / triangleTests) << " of triangles skipped, "
+                << meshletStats.Errors << " errors" << std::endl;
+    }
+    if (!lods.empty()) {
+        log.Out << "  LODs: " << lods.size() << " levels, triangles " << lodTriangles[0];
+        for (u32 l = 1; l < lodTriangles.size() && lodTriangles[l] > 0; ++l)
+            log.Out << " -> " << lodTriangles[l] << " (error " << lodErrors[l] << ")";
+        log.Out << std::endl;
+    }
+    if (options.BuildOccluders) {
+        log.Out << "  Occluders: " << occluderStats.Boxes << " boxes in " << occluderStats.Parts << " parts of "
+                << occluderStats.Submeshes << " submeshes, " << FormatPercent(occluderStats.PartVolume > 0.0 ?
+                   100.0 * occluderStats.BoxVolume / occluderStats.PartVolume : 0.0) << " of part bounds volume, "
+                << occluderStats.Rejected << " rejected as hollow, " << occluderStats.Errors << " dropped as overlapping, built in "
+                << occluderSeconds * 1000.0 << " ms" << std::endl;
+    }
+    if (!bvhRoots.empty()) {
+        log.Out << "  BVH: " << bvhRoots.size() << " roots, " << bvhStats.Nodes << " nodes (" << kBvhWidth << "-wide), "
+                << bvhStats.Leaves << " leaves (avg " << (bvhStats.Leaves ? (float)bvhStats.Triangles / bvhStats.Leaves : 0.0f)
+                << " triangles), binary depth " << bvhStats.MaxDepth << ", SAH cost " << bvhStats.SahCost << ", "
+                << (bvhNodes.size() * sizeof(L_BvhNode) + bvhTriangles.size() * sizeof(u32)) / 1024 << " KB, built in "
+                << bvhSeconds * 1000.0 << " ms" << std::endl;
+        log.Out << "  BVH validation (" << bvhValidation.Rays << " rays): " << bvhValidation.Hits << " hits, "
+                << (bvhValidation.Rays ? (double)bvhValidation.NodesVisited / bvhValidation.Rays : 0.0) << " nodes per ray, "
+                << bvhValidation.Mismatches << " mismatches, " << bvhValidation.Errors << " errors" << std::endl;
+    }
+    log.Out << "  Materials: " << materials.size() << ", " << textures.size() << " unique textures, "
+            << materials.size() * sizeof(L_MaterialEntry) + textures.size() * sizeof(L_TextureData) + strings.size()
+            << " bytes (" << materials.size() * sizeof(L_MaterialData) << " as fixed-size paths)" << std::endl;
+    log.Out << "  Bounds: [" << boundsMin.x << ", " << boundsMin.y << ", " << boundsMin.z << "] to ["
+              << boundsMax.x << ", " << boundsMax.y << ", " << boundsMax.z << "]" << std::endl;
+    log.Out << "  Output size: " << currentOffset << " bytes (v" << header.Version << ", " << sections.size() << " sections, "
+            << vertexTotals.Segments + positionTotals.Segments + indexTotals.Segments << " stream segments)" << std::endl;
 
-    header.IBOffset = currentOffset;
-    header.IBSize = allIndices.size() * sizeof(u32);
-    currentOffset += header.IBSize;
+    return true;
+}
 
-    // Write file
-    std::vector<u8> fileData;
-    fileData.resize(currentOffset);
+// Measures chunked payload decode throughput of a .mesh file, raw files are encoded in memory first
+static int RunDecodeBenchmark(const std::string& meshPath, JobPool& pool)
+{
+    std::ifstream file(meshPath, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error: Could not open mesh file: " << meshPath << std::endl;
+        return 1;
+    }
+    std::vector<u8> fileData((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
 
-    u8* ptr = fileData.data();
+    // Only files this tool writes, older ones are re-cooked
+    MeshFileDirectory directory;
+    if (const char* error = ReadMeshFileDirectory(fileData.data(), fileData.size(), directory)) {
+        std::cerr << "Error: Invalid mesh file " << meshPath << ": " << error << std::endl;
+        return 1;
+    }
 
-    // Header
-    memcpy(ptr, &header, sizeof(L_StaticMeshHeader));
-    ptr += sizeof(L_StaticMeshHeader);
+    // Every stream segment is a payload of its own
+    struct Segment
+    {
+        std::vector<u8> Payload;
+        const u8* Raw; // Stored bytes when the file is raw, to check the decode against
+        uint64_t DecodedOffset;
+        uint64_t DecodedSize;
+        u32 ChunkCount;
+        u32 Stream;
+    };
+    struct StreamInfo
+    {
+        MeshSectionType Type;
+        u32 ElementSize;
+        u32 LaneSize;
+    };
+    bool compact = (VertexFormat)directory.VertexFormat == VertexFormat::Compact;
+    u32 indexSize = (IndexFormat)directory.IndexFormat == IndexFormat::UInt16 ? sizeof(u16) : sizeof(u32);
+    const StreamInfo streams[3] = {
+        { MeshSectionType::Vertices, (u32)GetVertexSize((VertexFormat)directory.VertexFormat), compact ? 2u : 4u },
+        { MeshSectionType::Positions, (u32)GetPositionSize((VertexFormat)directory.VertexFormat), compact ? 2u : 4u },
+        { MeshSectionType::Indices, indexSize, indexSize },
+    };
+
+    std::vector<Segment> segments;
+    std::vector<u8> destinations[3];
+    bool chunked = false;
+    uint64_t storedBytes = 0;
+    for (u32 s = 0; s < 3; ++s) {
+        std::vector<L_MeshSection> sections;
+        uint64_t decodedSize = 0;
+        if (!directory.GetStream(streams[s].Type, sections, decodedSize)) {
+            std::cerr << "Error: Stream segments don't line up: " << meshPath << std::endl;
+            return 1;
+        }
+        destinations[s].resize(decodedSize);
+
+        for (const L_MeshSection& section : sections) {
+            Segment segment;
+            const u8* stored = fileData.data() + section.Offset;
+            if (section.Codec == (u32)PayloadCodec::Chunked) {
+                chunked = true;
+                segment.Payload.assign(stored, stored + section.StoredSize);
+                segment.Raw = nullptr;
+            } else {
+                segment.Payload = EncodePayload(stored, section.DecodedSize, streams[s].ElementSize, streams[s].LaneSize);
+                segment.Raw = stored;
+            }
+            segment.DecodedOffset = section.DecodedOffset;
+            segment.DecodedSize = section.DecodedSize;
+            segment.Stream = s;
+            segment.ChunkCount = GetPayloadChunkCount(segment.Payload.data(), segment.Payload.size(), segment.DecodedSize);
+            if (segment.ChunkCount == 0 && segment.DecodedSize > 0) {
+                std::cerr << "Error: Invalid payload segment: " << meshPath << std::endl;
+                return 1;
+            }
+            storedBytes += segment.Payload.size();
+            segments.push_back(std::move(segment));
+        }
+    }
 
-    // Submesh table
-    memcpy(ptr, submeshes.data(), submeshes.size() * sizeof(L_SubmeshData));
-    ptr += submeshes.size() * sizeof(L_SubmeshData);
+    uint64_t decodedBytes = destinations[0].size() + destinations[1].size() + destinations[2].size();
+    u32 chunkCount = 0;
+    for (const Segment& segment : segments)
+        chunkCount += segment.ChunkCount;
+    std::cout << "Decode benchmark: " << meshPath << (chunked ? "" : " (raw file, encoded in memory)") << std::endl;
+    std::cout << "  Payload: " << decodedBytes / 1024 << " KB -> " << storedBytes / 1024 << " KB (ratio "
+              << (storedBytes ? (double)decodedBytes / storedBytes : 0.0) << "), " << segments.size() << " segments, "
+              << chunkCount << " chunks" << std::endl;
+    if (decodedBytes == 0)
+        return 0;
+
+    std::atomic<u32> failures{0};
+    auto decodeChunks = [&](const Segment& segment, size_t begin, size_t end) {
+        u8* destination = destinations[segment.Stream].data() + segment.DecodedOffset;
+        for (size_t c = begin; c < end; ++c) {
+            if (!DecodePayloadChunk(segment.Payload.data(), segment.Payload.size(), (u32)c, destination, segment.DecodedSize))
+                failures++;
+        }
+    };
+
+    // Repeat each measurement until it covers enough time to be stable
+    static const double kMinBenchmarkSeconds = 0.5;
+    auto measure = [&](const std::function<void()>& decodeAll) {
+        u32 rounds = 0;
+        auto start = std::chrono::steady_clock::now();
+        double seconds = 0.0;
+        do {
+            decodeAll();
+            rounds++;
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        } while (seconds < kMinBenchmarkSeconds);
+        return (double)decodedBytes * rounds / seconds / 1e9;
+    };
+
+    double serial = measure([&]() {
+        for (const Segment& segment : segments)
+            decodeChunks(segment, 0, segment.ChunkCount);
+    });
+    double parallel = measure([&]() {
+        for (const Segment& segment : segments)
+            pool.ParallelFor(segment.ChunkCount, 1, [&](size_t begin, size_t end) { decodeChunks(segment, begin, end); });
+    });
+
+    bool matches = failures == 0;
+    for (const Segment& segment : segments) {
+        if (matches && segment.Raw)
+            matches = memcmp(destinations[segment.Stream].data() + segment.DecodedOffset, segment.Raw, segment.DecodedSize) == 0;
+    }
+    if (!matches) {
+        std::cerr << "Error: Decoded payload doesn't match" << std::endl;
+        return 1;
+    }
 
-    // Material table
-    memcpy(ptr, materials.data(), materials.size() * sizeof(L_MaterialData));
-    ptr += materials.size() * sizeof(L_MaterialData);
+    u32 threads = pool.GetThreadCount();
+    std::cout << "  1 thread: " << serial << " GB/s" << std::endl;
+    std::cout << "  " << threads << " threads: " << parallel << " GB/s (" << parallel / threads << " GB/s per core)" << std::endl;
+    return 0;
+}
 
-    // Vertex buffer
-    memcpy(ptr, allVertices.data(), header.VBSize);
-    ptr += header.VBSize;
+static bool IsGLTFPath(const std::filesystem::path& path)
+{
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return ext == ".gltf" || ext == ".glb";
+}
 
-    // Index buffer
-    memcpy(ptr, allIndices.data(), header.IBSize);
+// Compresses every .gltf/.glb under inputDir into outputDir, preserving the directory structure
+// cache is optional, keySeed covers the tool binary and options
+static int RunBatch(const std::string& inputDir, const std::string& outputDir, const CompressOptions& options, JobPool& pool,
+                    CookCache* cache, uint64_t keySeed)
+{
+    namespace stdfs = std::filesystem;
+
+    struct BatchItem
+    {
+        stdfs::path Input;
+        stdfs::path Output;
+        std::string Name;
+        uintmax_t Size;
+    };
+
+    std::vector<BatchItem> items;
+    std::error_code ec;
+    for (auto it = stdfs::recursive_directory_iterator(inputDir, ec); !ec && it != stdfs::recursive_directory_iterator(); it.increment(ec)) {
+        if (!it->is_regular_file() || !IsGLTFPath(it->path()))
+            continue;
+
+        stdfs::path rel = stdfs::relative(it->path(), inputDir);
+        BatchItem item;
+        item.Input = it->path();
+        item.Output = stdfs::path(outputDir) / rel.parent_path() / (rel.stem().string() + ".mesh");
+        item.Name = rel.string();
+        item.Size = it->file_size();
+        items.push_back(item);
+    }
 
-    // Write to file
-    std::ofstream outFile(outputPath, std::ios::binary);
-    if (!outFile) {
-        std::cerr << "Error: Could not open output file: " << outputPath << std::endl;
-        return false;
+    if (ec) {
+        std::cerr << "Error: Could not scan input directory: " << inputDir << " (" << ec.message() << ")" << std::endl;
+        return 1;
     }
 
-    outFile.write(reinterpret_cast<const char*>(fileData.data()), fileData.size());
-    outFile.close();
+    // Submitted smallest to biggest: the submitting thread pops its newest job first, so the
+    // biggest models start right away instead of ending up alone at the tail of the batch
+    std::sort(items.begin(), items.end(), [](const BatchItem& a, const BatchItem& b) { return a.Size < b.Size; });
 
-    std::cout << "Successfully compressed mesh:" << std::endl;
-    std::cout << "  Vertices: " << header.VertexCount << std::endl;
-    std::cout << "  Indices: " << header.IndexCount << std::endl;
-    std::cout << "  Submeshes: " << header.SubmeshCount << std::endl;
-    std::cout << "  Materials: " << header.MaterialCount << std::endl;
-    std::cout << "  Bounds: [" << boundsMin.x << ", " << boundsMin.y << ", " << boundsMin.z << "] to ["
-              << boundsMax.x << ", " << boundsMax.y << ", " << boundsMax.z << "]" << std::endl;
-    std::cout << "  Output size: " << fileData.size() << " bytes" << std::endl;
+    std::cout << "Batch: " << items.size() << " files on " << pool.GetThreadCount() << " threads" << std::endl;
+    std::cout << std::endl;
 
-    return true;
+    auto startTime = std::chrono::steady_clock::now();
+    std::mutex printMutex;
+    std::atomic<u32> finished{0};
+    std::atomic<u32> failed{0};
+    std::atomic<u32> cached{0};
+
+    JobCounter fileCounter;
+    for (const BatchItem& item : items) {
+        pool.Submit(fileCounter, [&, item] {
+            std::ostringstream buffer;
+            CompressLog log = { buffer, buffer };
+
+            CookKey key = 0;
+            bool hashed = cache && HashGLTFInputs(item.Input.string(), keySeed, key);
+            if (hashed && cache->IsUpToDate(item.Output.string(), key)) {
+                cached++;
+                std::lock_guard<std::mutex> lock(printMutex);
+                std::cout << "[" << ++finished << "/" << items.size() << "] " << item.Name << " -> " << item.Output.string()
+                          << " (cached)" << std::endl;
+                return;
+            }
+
+            bool ok = false;
+            try {
+                stdfs::create_directories(item.Output.parent_path());
+                ok = CompressGLTF(item.Input.string(), item.Output.string(), options, pool, log);
+            } catch (const std::exception& e) {
+                log.Err << "Error: " << e.what() << std::endl;
+            }
+
+            if (!ok)
+                failed++;
+            if (cache && ok && hashed)
+                cache->Record(item.Output.string(), key);
+            else if (cache)
+                cache->Forget(item.Output.string());
+
+            std::lock_guard<std::mutex> lock(printMutex);
+            std::cout << "[" << ++finished << "/" << items.size() << "] " << item.Name << " -> " << item.Output.string()
+                      << (ok ? "" : " (FAILED)") << std::endl;
+            std::cout << buffer.str() << std::endl;
+        });
+    }
+    pool.Wait(fileCounter);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << "Batch complete: " << (items.size() - failed - cached) << " compressed, " << cached << " up to date, "
+              << failed << " failed in " << seconds << "s" << std::endl;
+    if (cache) {
+        std::cout << "Cook cache: " << cached << " hits, " << (items.size() - cached) << " misses" << std::endl;
+        if (!cache->Save())
+            std::cerr << "Warning: Could not write " << CookCache::kManifestName << " in " << outputDir << std::endl;
+    }
+
+    // Exit code is the number of failed files, capped to stay clear of shell-reserved codes
+    return (int)std::min<u32>(failed, 125);
+}
+
+static void PrintUsage(const char* exe)
+{
+    std::cerr << "Usage: " << exe << " <input.gltf> <output.mesh> [-j N]" << std::endl;
+    std::cerr << "       " << exe << " --batch <input_dir> <output_dir> [-j N]" << std::endl;
+    std::cerr << "       " << exe << " --bench-decode <input.mesh> [-j N]" << std::endl;
+    std::cerr << "Example: " << exe << " input/model.gltf output/model.mesh" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  -j N                              Number of worker threads (default: all cores)" << std::endl;
+    std::cerr << "  --weld <none|exact|quantized>     Vertex deduplication mode (default: exact)" << std::endl;
+    std::cerr << "  --weld-epsilon <e>                Position cell size for quantized welding (default: 0.0001)" << std::endl;
+    std::cerr << "  --vertex-format <float|compact>   Vertex layout, compact is 20 bytes quantized (default: float)" << std::endl;
+    std::cerr << "  --index-format <auto|u32>         auto writes 16-bit indices when every submesh fits (default: auto)" << std::endl;
+    std::cerr << "  --lods N                          Simplified levels per submesh, 0 disables them (default: 3, max: 4)" << std::endl;
+    std::cerr << "  --no-instancing                   Bake meshes used by several nodes once per node" << std::endl;
+    std::cerr << "  --submesh-order <gltf|morton|hilbert>  Submesh order within each instance range, grouped by material (default: gltf)" << std::endl;
+    std::cerr << "  --split-triangles N               Split larger submeshes into culling clusters, 0 disables (default: 16384)" << std::endl;
+    std::cerr << "  --max-draws N                     Draws splitting may grow the file to, of the scene's " << MAX_SCENE_INSTANCES << " (default: " << MAX_SCENE_INSTANCES / 4 << ")" << std::endl;
+    std::cerr << "  --no-mmap                         Load glTF buffers into memory instead of mapping them" << std::endl;
+    std::cerr << "  --stream                          Cook one primitive at a time through scratch files, memory follows the largest primitive" << std::endl;
+    std::cerr << "  --no-cache                        Recompress every input instead of skipping up-to-date outputs" << std::endl;
+    std::cerr << "  --payload <raw|chunked>           VB/IB storage, chunked is delta + entropy coded (default: raw)" << std::endl;
+    std::cerr << "  --no-vcache                       Keep the glTF triangle order" << std::endl;
+    std::cerr << "  --no-overdraw                     Skip overdraw-aware cluster ordering of opaque submeshes" << std::endl;
+    std::cerr << "  --no-vfetch                       Keep vertices in glTF order instead of first-use order" << std::endl;
+    std::cerr << "  --no-meshlets                     Don't write the meshlet table" << std::endl;
+    std::cerr << "  --no-bvh                          Don't write the BVH used for CPU ray queries" << std::endl;
+    std::cerr << "  --no-position-stream              Don't write the position-only stream for depth passes" << std::endl;
+    std::cerr << "  --no-occluders                    Don't write occluder boxes for CPU occlusion culling" << std::endl;
+    std::cerr << "  --occluder-size <f>               Smallest part that gets occluders, fraction of the scene size (default: 0.05)" << std::endl;
+    std::cerr << "  --overdraw-views N                Viewpoints for the overdraw estimate, 0 skips it (default: 8)" << std::endl;
 }
 
 int main(int argc, char* argv[])
 {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <input.gltf> <output.mesh>" << std::endl;
-        std::cerr << "Example: " << argv[0] << " input/model.gltf output/model.mesh" << std::endl;
+    bool batch = false;
+    bool benchDecode = false;
+    bool useCache = true;
+    u32 threadCount = 0;
+    CompressOptions options;
+    std::vector<std::string> positional;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--batch") {
+            batch = true;
+        } else if (arg == "--bench-decode") {
+            benchDecode = true;
+        } else if (arg == "-j" && i + 1 < argc) {
+            threadCount = (u32)std::max(0, atoi(argv[++i]));
+        } else if (arg.size() > 2 && arg.compare(0, 2, "-j") == 0) {
+            threadCount = (u32)std::max(0, atoi(arg.c_str() + 2));
+        } else if (arg == "--weld" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "none") options.Weld = WeldMode::None;
+            else if (mode == "exact") options.Weld = WeldMode::Exact;
+            else if (mode == "quantized") options.Weld = WeldMode::Quantized;
+            else {
+                std::cerr << "Unknown weld mode: " << mode << std::endl;
+                return 1;
+            }
+        } else if (arg == "--vertex-format" && i + 1 < argc) {
+            std::string format = argv[++i];
+            if (format == "float") options.Format = VertexFormat::Float;
+            else if (format == "compact") options.Format = VertexFormat::Compact;
+            else {
+                std::cerr << "Unknown vertex format: " << format << std::endl;
+                return 1;
+            }
+        } else if (arg == "--index-format" && i + 1 < argc) {
+            std::string format = argv[++i];
+            if (format == "auto") options.AllowShortIndices = true;
+            else if (format == "u32") options.AllowShortIndices = false;
+            else {
+                std::cerr << "Unknown index format: " << format << std::endl;
+                return 1;
+            }
+        } else if (arg == "--weld-epsilon" && i + 1 < argc) {
+            options.WeldEpsilon = std::max(1e-9f, (float)atof(argv[++i]));
+        } else if (arg == "--lods" && i + 1 < argc) {
+            options.LodLevels = std::min<u32>((u32)std::max(0, atoi(argv[++i])), kMaxLodLevels);
+        } else if (arg == "--payload" && i + 1 < argc) {
+            std::string codec = argv[++i];
+            if (codec == "raw") options.Payload = PayloadCodec::Raw;
+            else if (codec == "chunked") options.Payload = PayloadCodec::Chunked;
+            else {
+                std::cerr << "Unknown payload codec: " << codec << std::endl;
+                return 1;
+            }
+        } else if (arg == "--submesh-order" && i + 1 < argc) {
+            std::string order = argv[++i];
+            if (order == "gltf") options.SubmeshOrder = SpatialOrder::None;
+            else if (order == "morton") options.SubmeshOrder = SpatialOrder::Morton;
+            else if (order == "hilbert") options.SubmeshOrder = SpatialOrder::Hilbert;
+            else {
+                std::cerr << "Unknown submesh order: " << order << std::endl;
+                return 1;
+            }
+        } else if (arg == "--split-triangles" && i + 1 < argc) {
+            options.MaxSubmeshTriangles = (u32)std::max(0, atoi(argv[++i]));
+        } else if (arg == "--max-draws" && i + 1 < argc) {
+            options.MaxDraws = (u32)std::clamp(atoi(argv[++i]), 1, MAX_SCENE_INSTANCES);
+        } else if (arg == "--no-mmap") {
+            options.MapBuffers = false;
+        } else if (arg == "--stream") {
+            options.Streaming = true;
+        } else if (arg == "--no-cache") {
+            useCache = false;
+        } else if (arg == "--no-instancing") {
+            options.PreserveInstancing = false;
+        } else if (arg == "--no-vcache") {
+            options.OptimizeVertexCache = false;
+        } else if (arg == "--no-vfetch") {
+            options.OptimizeVertexFetch = false;
+        } else if (arg == "--no-meshlets") {
+            options.BuildMeshlets = false;
+        } else if (arg == "--no-bvh") {
+            options.BakeBvh = false;
+        } else if (arg == "--no-position-stream") {
+            options.WritePositionStream = false;
+        } else if (arg == "--no-occluders") {
+            options.BuildOccluders = false;
+        } else if (arg == "--occluder-size" && i + 1 < argc) {
+            options.OccluderMinSize = std::max(0.0f, (float)atof(argv[++i]));
+        } else if (arg == "--no-overdraw") {
+            options.OptimizeOverdraw = false;
+        } else if (arg == "--overdraw-views" && i + 1 < argc) {
+            options.OverdrawViews = (u32)std::max(0, atoi(argv[++i]));
+        } else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            PrintUsage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() != (benchDecode ? 1u : 2u)) {
+        PrintUsage(argv[0]);
         return 1;
     }
 
-    std::string inputPath = argv[1];
-    std::string outputPath = argv[2];
+    JobPool pool(threadCount);
+
+    if (benchDecode)
+        return RunDecodeBenchmark(positional[0], pool);
 
     std::cout << "GLTF Compression Tool" << std::endl;
-    std::cout << "Input: " << inputPath << std::endl;
-    std::cout << "Output: " << outputPath << std::endl;
+    std::cout << "Input: " << positional[0] << std::endl;
+    std::cout << "Output: " << positional[1] << std::endl;
     std::cout << std::endl;
 
-    if (!CompressGLTF(inputPath, outputPath)) {
+    // Cooks are keyed by the input content, the tool binary and the options
+    uint64_t keySeed = useCache ? HashOptions(options, HashToolBinary(argv[0])) : 0;
+
+    if (batch) {
+        CookCache cache(positional[1]);
+        if (useCache)
+            cache.Load();
+        return RunBatch(positional[0], positional[1], options, pool, useCache ? &cache : nullptr, keySeed);
+    }
+
+    std::string outputDir = std::filesystem::path(positional[1]).parent_path().string();
+    CookCache cache(outputDir.empty() ? "." : outputDir);
+    CookKey key = 0;
+    bool hashed = false;
+    if (useCache) {
+        cache.Load();
+        hashed = HashGLTFInputs(positional[0], keySeed, key);
+        if (hashed && cache.IsUpToDate(positional[1], key)) {
+            std::cout << "Up to date: " << positional[1] << std::endl;
+            std::cout << "Cook cache: 1 hit, 0 misses" << std::endl;
+            return 0;
+        }
+    }
+
+    CompressLog log = { std::cout, std::cerr };
+    bool ok = CompressGLTF(positional[0], positional[1], options, pool, log);
+    if (useCache) {
+        if (ok && hashed)
+            cache.Record(positional[1], key);
+        else
+            cache.Forget(positional[1]);
+        std::cout << "Cook cache: 0 hits, 1 miss" << std::endl;
+        if (!cache.Save() && ok)
+            std::cerr << "Warning: Could not write " << CookCache::kManifestName << " in " << outputDir << std::endl;
+    }
+
+    if (!ok) {
         std::cerr << "Failed to compress GLTF file" << std::endl;
         return 1;
     }